@@ -83,6 +83,13 @@ typedef struct _T_EC_DEMO_APP_PARMS
     EC_T_BOOL           bPcapRecorder;                  /* EtherCAT packet capture in pcap format (wireshark) enabled */
     EC_T_CHAR           szPcapRecorderFileprefix[64];   /* log file prefix string */
     EC_T_DWORD          dwPcapRecorderBufferFrameCnt;   /* max number of buffered frames */
+    EC_T_BOOL           bFlightRecorder;                /* last seconds of EtherCAT traffic kept in memory, dumped on errors */
+    EC_T_CHAR           szFlightRecorderFileprefix[64]; /* dump file prefix string */
+    EC_T_DWORD          dwFlightRecorderBufferSize;     /* [byte] frame ring size */
+    EC_T_DWORD          dwFlightRecorderPreTriggerMsec; /* [ms] frames before the trigger */
+    EC_T_DWORD          dwFlightRecorderPostTriggerMsec;/* [ms] frames after the trigger */
+    EC_T_DWORD          dwNotifyRateLimitMsec;          /* [ms] between two log lines of the same error notification and slave */
+    EC_T_CHAR           szNotifyFilter[256];            /* <code>=<off|error|warning|info>,... */
     /* RAS */
     EC_T_BOOL           bStartRasServer;
     EC_T_BYTE           abyRasServerIpAddress[4];       /* Remote Access Server (RAS) listen IP address */
@@ -163,6 +170,12 @@ typedef struct _T_EC_DEMO_APP_CONTEXT
     struct _T_MASTER_RED_DEMO_PARMS* pMasterRedParms;   /* Master redundancy parameters */
     struct _T_EC_MONITOR_DEMO_PARMS* pMonitorParms;     /* EC-Monitor parameters */
     EC_T_VOID*                pTimingTaskContext;       /* Timing Task Context for various Busshift, Mastershift, MasterRefClock and DCX.Mastershift mode */
+    EC_T_VOID*                pvPcapRecorder;           /* pcap recorder, cycle drop accounting in the job task */
+    EC_T_VOID*                pvFlightRecorder;         /* flight recorder, triggered by the job task and notifications */
+    EC_T_VOID*                pvNotifyStat;             /* raw notification counts in shared memory (rocos::NotificationStat) */
+    EC_T_VOID*                pvEventRing;              /* events for the clients in shared memory (rocos::EventRing) */
+    EC_T_VOID*                pvDiagnostics;            /* per slave error counters in shared memory (rocos::EcatDiagnostics) */
+    volatile EC_T_BOOL        bLayoutChanged;           /* hot connect topology changed, slave descriptors are rebuilt by the main loop */
 } T_EC_DEMO_APP_CONTEXT;
 
 /*-GLOBAL VARIABLES-----------------------------------------------------------*/
@@ -4,6 +4,7 @@
  * Last Modification Date   2023.04.04 18:00
  *---------------------------------------------------------------------------*/
 #include <regex>
+#include <strings.h>
 #include "EcFlags.h"
 
 
@@ -46,6 +47,15 @@ DEFINE_int32(dcmmode, 1, "Set DCM mode. 0 = off, 1 = busshift, 2 = mastershift,
 //! @brief Disable DCM control loop for diagnosis
 DEFINE_bool(ctloff, false, "Disable DCM control loop for diagnosis. ");
 
+//! @brief Bus cycles between two DCM deviation samples in the shared memory
+DEFINE_int32(dcsample, 1, "Bus cycles between two DCM deviation samples (ecatDcmGetStatus) written to the DC time series of the shared memory, in bus shift and master shift mode. 0 = off. The default is 1.");
+
+//! @brief Reach the requested state in as few steps as possible
+DEFINE_bool(faststart, false, "Set up the application while the bus goes to PREOP and request SAFEOP/OP with a single state change. The default is false.");
+
+//! @brief Chrome trace file of the start-up phases
+DEFINE_string(starttrace, "/tmp/rocos_ecm%d_startup.json", "Chrome/Perfetto trace (JSON) of the start-up phases, written when the bus reached the requested state or at shutdown if it never did. %d is replaced by the master id (--id). Empty = off. The default is /tmp/rocos_ecm%d_startup.json.");
+
 //! @brief Intel network card instances and mode
 DEFINE_int32(link, 2, "Link layer selection: 0 = Intel 8254x, 1 = Intel 8255x, 2 = Intel Gbe. The link layer selection specifies which link layer is used by the demo application. The default is Intel Gbe. ");
 DEFINE_int32(instance, 1, "Device instance 1=first, 2=second. The device instance specifies which network card is used by the demo application. The default is the first network card. ");
@@ -59,6 +69,75 @@ DEFINE_int32(maxbusslaves, 256, "The maximum number of slaves in the EtherCAT ne
 
 DEFINE_int32(mbxsrv, 0x88A4, "Mailbox server port. The default is 0x88A4.");
 
+//! @brief Default number of missed cycles before a client's outputs are replaced by safe outputs
+DEFINE_int32(wdcycles, 10, "Default number of cycles a watched client may miss its commit before the safe outputs are applied to its slaves. Used when the client registers with timeout 0. The default is 10.");
+
+//! @brief Safe output template applied to slaves of a stale client
+DEFINE_string(safeoutput, "quickstop", "Safe output applied to slaves of a stale client. value can be none/quickstop/zerotorque/hold. The default is quickstop.");
+static bool ValidateSafeOutput(const char* flagname, const std::string& value) {
+    for (const char* name : {"none", "quickstop", "zerotorque", "hold"}) {
+        if (strcasecmp(value.c_str(), name) == 0)
+            return true;
+    }
+    printf("Invalid value for --%s: %s, must be none/quickstop/zerotorque/hold\n", flagname, value.c_str());
+    return false;
+}
+DEFINE_validator(safeoutput, &ValidateSafeOutput);
+
+//! @brief CPU affinity, scheduling policy and priority of the master threads
+DEFINE_string(placement, "", "Placement of the master threads as <thread>=<cpulist>[:<policy>[:<prio>]] separated by ';'. thread can be job/timing/recv/log/main/ras/pcap, policy can be fifo/rr/other, CPUs 0..31 only. e.g. \"job=2:fifo:98;timing=2:fifo:99;log=3:other:0\". Threads not listed run on the CPU of the master ID. The default is empty.");
+
+//! @brief NUMA node of the shared memory regions
+DEFINE_int32(shmnode, -1, "NUMA node the shared memory regions are bound to, should be the node of the job thread CPU. -1 = no binding. The default is -1.");
+
+//! @brief Back the shared memory with huge pages
+DEFINE_bool(hugepages, false, "Back the bus and process data shared memory with huge pages from /dev/hugepages (hugetlbfs). Falls back to POSIX shm if no huge pages are available. The default is false.");
+
+//! @brief Defer log message formatting from the calling thread to the log task
+DEFINE_bool(binlog, false, "Binary logging: the calling thread (e.g. the job task) only stores the raw arguments of a log message, the log task formats it. The default is false.");
+
+//! @brief Buffer level in percent waking up the log task
+DEFINE_int32(logwatermark, 25, "Wake up the log task as soon as a log buffer is filled by this percentage. Errors always wake it up. The default is 25.");
+
+//! @brief Maximum time in ms the log task sleeps without being woken up
+DEFINE_int32(logidle, 20, "Idle timeout of the log task in ms, messages below the watermark are printed at the latest after this time. The default is 20.");
+
+//! @brief Log file size in MB starting a new log file
+DEFINE_int32(logsize, 0, "Start a new log file when the current one reaches this size in MB. 0 = off. The default is 0.");
+
+//! @brief Log file age in s starting a new log file
+DEFINE_int32(logtime, 0, "Start a new log file when the current one is open for this time in s. 0 = off. The default is 0.");
+
+//! @brief Number of closed log files to keep
+DEFINE_int32(logretain, 0, "Keep only this number of closed log files, older ones are deleted. 0 = keep all. The default is 0.");
+
+//! @brief Compress closed log files
+DEFINE_bool(logcompress, false, "Compress closed log files to .gz in a background task. The default is false.");
+
+//! @brief pcap recorder file prefix
+DEFINE_string(pcap, "", "Record the EtherCAT traffic to <prefix>.00000.pcap (wireshark). Empty = off. The default is empty.");
+
+//! @brief pcap recorder capture ring size in frames
+DEFINE_int32(pcapbuf, 4096, "Size of the pcap capture ring in frames of maximum size. Frames are dropped and counted when it is full. The default is 4096.");
+
+//! @brief Flight recorder dump file prefix
+DEFINE_string(flightrec, "", "Keep the last frames in memory and dump them to <prefix>.<date>-<time>.<reason>.pcap on frame loss, overload, WKC error, unexpected state change or client request. Empty = off. The default is empty.");
+
+//! @brief Flight recorder frame ring size in MB
+DEFINE_int32(flightbuf, 64, "Size of the flight recorder frame ring in MB, must hold --flightpre + --flightpost of traffic. The default is 64.");
+
+//! @brief Flight recorder time before the trigger in ms
+DEFINE_int32(flightpre, 10000, "Flight recorder: time in ms before the trigger that is dumped, also the hold-off between two dumps. The default is 10000.");
+
+//! @brief Flight recorder time after the trigger in ms
+DEFINE_int32(flightpost, 2000, "Flight recorder: time in ms after the trigger until the window is frozen and dumped. The default is 2000.");
+
+//! @brief Minimum time between two log lines of the same error notification and slave in ms
+DEFINE_int32(notifyrate, 1000, "Minimum time in ms between two log lines of the same error notification and slave. Repeated notifications are counted and summarized, 0 = log every notification. The default is 1000.");
+
+//! @brief Enable/severity of error notification codes
+DEFINE_string(notifyfilter, "", "Comma separated <code>=<off|error|warning|info> for error notifications, e.g. 0x10001=off,0x1000a=warning. The level is the lowest log level (-v) the notification is logged at, the message keeps its severity. Notifications that are off or above the log level are only counted. The default is empty.");
+
 //DEFINE_string(i8254x, "1 1", "<instance>: Device instance 1=first, 2=second; <mode>: Mode 0 = Interrupt mode, 1= Polling mode");
 //static bool Validate8254x(const char* flagname, const std::string& value) {
 //    std::regex ws_re("\\s+"); // whitespace
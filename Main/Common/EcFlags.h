@@ -51,6 +51,12 @@ DECLARE_int32(flash);
 DECLARE_int32(dcmmode);
 //! @brief Disable DCM control loop for diagnosis
 DECLARE_bool(ctloff);
+//! @brief Bus cycles between two DCM deviation samples in the shared memory
+DECLARE_int32(dcsample);
+//! @brief Reach the requested state in as few steps as possible
+DECLARE_bool(faststart);
+//! @brief Chrome trace file of the start-up phases
+DECLARE_string(starttrace);
 
 //! @brief Intel network card instances and mode
 DECLARE_int32(link);
@@ -67,6 +73,49 @@ DECLARE_int32(maxbusslaves);
 
 DECLARE_int32(mbxsrv);
 
+//! @brief Default number of missed cycles before a client's outputs are replaced by safe outputs
+DECLARE_int32(wdcycles);
+//! @brief Safe output template applied to slaves of a stale client
+DECLARE_string(safeoutput);
+
+//! @brief CPU affinity, scheduling policy and priority of the master threads
+DECLARE_string(placement);
+//! @brief NUMA node of the shared memory regions
+DECLARE_int32(shmnode);
+//! @brief Back the shared memory with huge pages
+DECLARE_bool(hugepages);
+
+//! @brief Defer log message formatting from the calling thread to the log task
+DECLARE_bool(binlog);
+//! @brief Buffer level in percent waking up the log task
+DECLARE_int32(logwatermark);
+//! @brief Maximum time in ms the log task sleeps without being woken up
+DECLARE_int32(logidle);
+//! @brief Log file size in MB starting a new log file
+DECLARE_int32(logsize);
+//! @brief Log file age in s starting a new log file
+DECLARE_int32(logtime);
+//! @brief Number of closed log files to keep
+DECLARE_int32(logretain);
+//! @brief Compress closed log files
+DECLARE_bool(logcompress);
+//! @brief pcap recorder file prefix
+DECLARE_string(pcap);
+//! @brief pcap recorder capture ring size in frames
+DECLARE_int32(pcapbuf);
+//! @brief Flight recorder dump file prefix
+DECLARE_string(flightrec);
+//! @brief Flight recorder frame ring size in MB
+DECLARE_int32(flightbuf);
+//! @brief Flight recorder time before the trigger in ms
+DECLARE_int32(flightpre);
+//! @brief Flight recorder time after the trigger in ms
+DECLARE_int32(flightpost);
+//! @brief Minimum time between two log lines of the same error notification and slave in ms
+DECLARE_int32(notifyrate);
+//! @brief Enable/log level threshold of error notification codes
+DECLARE_string(notifyfilter);
+
 //DECLARE_string(i8254x);
 
 
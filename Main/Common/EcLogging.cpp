@@ -7,8 +7,30 @@
 
 /*-INCLUDES------------------------------------------------------------------*/
 #include "EcDemoApp.h"
+#if (defined EC_VERSION_LINUX)
+#include "EcPlacement.h"
+#endif
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#if (defined INCLUDE_LOG_COMPRESSION)
+#include <zlib.h>
+#endif
+#if (defined EC_VERSION_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <dirent.h>
+#endif
 
 /*-MACROS--------------------------------------------------------------------*/
+#define LOG_COMPRESS_CHUNK_SIZE    0x10000
 /*#define NOPRINTF    1*/
 
 /*-DEFINES-------------------------------------------------------------------*/
@@ -63,6 +85,27 @@
 #endif
 EC_T_LOG_PARMS G_aLogParms[MAX_NUMOF_MASTER_INSTANCES];
 
+/* producer ring of the calling thread, given back when the thread exits */
+static EC_T_DWORD s_dwProducerGeneration = 0;
+static volatile EC_T_DWORD s_adwLiveGeneration[MAX_NUMOF_MASTER_INSTANCES]; /* 0: instance not initialized */
+class CProducerRegistration
+{
+public:
+    ~CProducerRegistration()
+    {
+        /* skip registrations of a logging instance that was de-initialized meanwhile */
+        if ((EC_NULL != pInst) && (dwInstanceId < MAX_NUMOF_MASTER_INSTANCES) && (s_adwLiveGeneration[dwInstanceId] == dwGeneration))
+        {
+            pInst->UnregisterProducer();
+        }
+    }
+    CAtEmLogging* pInst = EC_NULL;
+    EC_T_DWORD    dwInstanceId = 0;
+    EC_T_DWORD    dwGeneration = 0;
+    EC_T_DWORD    dwIdx = LOG_NO_PRODUCER;
+};
+static thread_local CProducerRegistration S_oProducer;
+
 #ifdef INCLUDE_FRAME_SPY
 CFrameLogMultiplexer* CFrameLogMultiplexer::G_aLogMultiplexer = EC_NULL;
 EC_T_BOOL CFrameLogMultiplexer::G_bAutoDispose = EC_FALSE;
@@ -76,6 +119,10 @@ EC_T_BOOL bLogFileEnb = EC_FALSE;
 #else
 EC_T_BOOL bLogFileEnb = EC_TRUE;
 #endif
+EC_T_UINT64 qwLogFileRotateSize = 0;
+EC_T_DWORD  dwLogFileRotateTime = 0;
+EC_T_DWORD  dwLogFileRetain     = 0;
+EC_T_BOOL   bLogFileCompress    = EC_FALSE;
 #endif /* INCLUDE_FILE_LOGGING */
 
 #if (defined INCLUDE_EC_MASTER) || (defined INCLUDE_EC_MONITOR) || (defined INCLUDE_EC_SIMULATOR) || (defined INCLUDE_EC_EAP)
@@ -105,6 +152,21 @@ CAtEmLogging::CAtEmLogging(EC_T_VOID)
     m_poInsertMsgLock = EC_NULL;
     m_poProcessMsgLock = EC_NULL;
     m_pchTempbuffer = EC_NULL;
+    m_pchBinTempBuffer = EC_NULL;
+    m_bBinaryLogging = EC_FALSE;
+    m_nWakeupFd = -1;
+    m_bWakeupPending = EC_FALSE;
+    m_dwWakeupWatermark = LOG_WAKEUP_WATERMARK_DEFAULT;
+    m_dwIdleTimeout = LOG_IDLE_TIMEOUT_DEFAULT;
+    m_pchConsoleBatch = EC_NULL;
+    m_dwConsoleBatchLen = 0;
+    m_dwConsoleSegStart = 0;
+    m_dwConsoleSegCnt = 0;
+    m_pchFileBatch = EC_NULL;
+    m_dwFileBatchLen = 0;
+    m_poFlushLock = EC_NULL;
+    OsMemset((EC_T_VOID*)m_adwProducerUsed, 0, sizeof(m_adwProducerUsed));
+    m_dwProducerGeneration = 0;
     m_pFirstMsgBufferDesc = EC_NULL;
     m_pLastMsgBufferDesc = EC_NULL;
     m_pAllMsgBufferDesc = EC_NULL;
@@ -114,6 +176,13 @@ CAtEmLogging::CAtEmLogging(EC_T_VOID)
 #if (defined INCLUDE_FILE_LOGGING)
     m_pchLogDir[0] = '\0';
     m_pchLogDir[MAX_PATH_LEN - 1] = '\0';
+    m_pvCompressThreadObj = EC_NULL;
+    m_pvCompressEvent = EC_NULL;
+    m_poClosedFileLock = EC_NULL;
+    m_bCompressTaskRunning = EC_FALSE;
+    m_bShutdownCompressTask = EC_FALSE;
+    m_dwClosedFileRd = 0;
+    m_dwClosedFileWr = 0;
 #endif
 
 #if (defined INCLUDE_EC_MASTER) || (defined INCLUDE_EC_MONITOR) || (defined INCLUDE_EC_SIMULATOR)
@@ -144,7 +213,8 @@ EC_T_DWORD CAtEmLogging::InitLogging(
     EC_T_DWORD  dwStackSize,
     EC_T_DWORD  dwLogMsgBufferSize,
     EC_T_DWORD  dwErrMsgBufferSize,
-    EC_T_DWORD  dwDcmMsgBufferSize
+    EC_T_DWORD  dwDcmMsgBufferSize,
+    EC_T_DWORD  dwProducerMsgBufferSize
     )
 {
     EC_T_CHAR   szLogFilename[256];
@@ -164,6 +234,28 @@ EC_T_DWORD CAtEmLogging::InitLogging(
         goto Exit;
     }
     OsMemset(m_pchTempbuffer, 0, MAX_MESSAGE_SIZE);
+    m_pchBinTempBuffer = (EC_T_CHAR*)OsMalloc(MAX_MESSAGE_SIZE + 1);
+    if (EC_NULL == m_pchBinTempBuffer)
+    {
+        dwRetVal = EC_E_NOMEMORY;
+        goto Exit;
+    }
+    OsMemset(m_pchBinTempBuffer, 0, MAX_MESSAGE_SIZE + 1);
+    m_poFlushLock = OsCreateLock();
+    OsMemset((EC_T_VOID*)m_adwProducerUsed, 0, sizeof(m_adwProducerUsed));
+    m_dwProducerGeneration = ++s_dwProducerGeneration;
+    if (dwInstanceId < MAX_NUMOF_MASTER_INSTANCES)
+    {
+        s_adwLiveGeneration[dwInstanceId] = m_dwProducerGeneration;
+    }
+#if (defined INCLUDE_FILE_LOGGING)
+    m_pchFileBatch = (EC_T_CHAR*)OsMalloc(LOG_FILE_BATCH_SIZE);
+    m_dwFileBatchLen = 0;
+#endif
+#if (defined EC_VERSION_LINUX)
+    m_pchConsoleBatch = (EC_T_CHAR*)OsMalloc(LOG_CONSOLE_BATCH_SIZE);
+    m_nWakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
 
     if ((EC_NULL == szFilenamePrefix) || ('\0' == szFilenamePrefix[0]))
     {
@@ -190,6 +282,12 @@ EC_T_DWORD CAtEmLogging::InitLogging(
         dwRetVal = EC_E_NOMEMORY;
         goto Exit;
     }
+    m_pErrorMsgBufferDesc->bPerProducer = EC_TRUE;
+    if (!AllocProducerRings(m_pErrorMsgBufferDesc, dwProducerMsgBufferSize))
+    {
+        dwRetVal = EC_E_NOMEMORY;
+        goto Exit;
+    }
 
     OsSnprintf(szLogFilename, sizeof(szLogFilename) - 1, "%s", szFilenamePrefix);
 
@@ -212,6 +310,12 @@ EC_T_DWORD CAtEmLogging::InitLogging(
         dwRetVal = EC_E_NOMEMORY;
         goto Exit;
     }
+    m_pAllMsgBufferDesc->bPerProducer = EC_TRUE;
+    if (!AllocProducerRings(m_pAllMsgBufferDesc, dwProducerMsgBufferSize))
+    {
+        dwRetVal = EC_E_NOMEMORY;
+        goto Exit;
+    }
 
     OsSnprintf(szLogFilename, sizeof(szLogFilename) - 1, "%s_dcm", szFilenamePrefix);
 
@@ -242,6 +346,21 @@ EC_T_DWORD CAtEmLogging::InitLogging(
 #if (defined INCLUDE_LOG_TASK)
         m_pvLogThreadObj = OsCreateThread(szThreadName, tAtEmLogWrapper, CpuSet, dwPrio, dwStackSize, this);
     while (!m_bLogTaskRunning) OsSleep(1);
+
+#if (defined INCLUDE_FILE_LOGGING)
+    /* compression / retention of rotated log files */
+    m_poClosedFileLock = OsCreateLock();
+    m_dwClosedFileRd = 0;
+    m_dwClosedFileWr = 0;
+    if (bLogFileEnb && (bLogFileCompress || (0 != dwLogFileRetain)))
+    {
+        m_pvCompressEvent = OsCreateEvent();
+        m_bShutdownCompressTask = EC_FALSE;
+        OsSnprintf(szThreadName, sizeof(szThreadName) - 1, "tAtEmZip_%d", dwInstanceId);
+        m_pvCompressThreadObj = OsCreateThread(szThreadName, tCompressWrapper, CpuSet, dwPrio, dwStackSize, this);
+        while (!m_bCompressTaskRunning) OsSleep(1);
+    }
+#endif
 #else
     EC_UNREFPARM(dwStackSize);
     EC_UNREFPARM(CpuSet);
@@ -257,6 +376,12 @@ Exit:
         MSG_BUFFER_DESC* pCurrMsgBuf = EC_NULL;
         SafeOsFree(m_pchTempbuffer);
         m_pchTempbuffer = EC_NULL;
+        SafeOsFree(m_pchBinTempBuffer);
+        m_pchBinTempBuffer = EC_NULL;
+        SafeOsFree(m_pchConsoleBatch);
+        m_pchConsoleBatch = EC_NULL;
+        SafeOsFree(m_pchFileBatch);
+        m_pchFileBatch = EC_NULL;
 
         /* free all message buffers */
         pNextMsgBuf = m_pFirstMsgBufferDesc;
@@ -421,9 +546,28 @@ EC_T_VOID CAtEmLogging::DeinitLogging(EC_T_VOID)
     MSG_BUFFER_DESC* pNextMsgBuf = EC_NULL;
 
     m_bShutdownLogTask = EC_TRUE;
+    WakeupLogTask();
 
     while (m_bLogTaskRunning) OsSleep(1);
 
+#if (defined INCLUDE_FILE_LOGGING)
+    /* finish queued compressions */
+    if (EC_NULL != m_pvCompressThreadObj)
+    {
+        m_bShutdownCompressTask = EC_TRUE;
+        OsSetEvent(m_pvCompressEvent);
+        while (m_bCompressTaskRunning) OsSleep(1);
+        OsDeleteThreadHandle(m_pvCompressThreadObj);
+        m_pvCompressThreadObj = EC_NULL;
+    }
+    SafeOsDeleteEvent(m_pvCompressEvent);
+    if (EC_NULL != m_poClosedFileLock)
+    {
+        OsDeleteLock(m_poClosedFileLock);
+        m_poClosedFileLock = EC_NULL;
+    }
+#endif
+
     /* shutdown all message buffers */
     pNextMsgBuf = m_pFirstMsgBufferDesc;
     while (EC_NULL != pNextMsgBuf)
@@ -457,6 +601,28 @@ EC_T_VOID CAtEmLogging::DeinitLogging(EC_T_VOID)
     OsDeleteLock(m_poProcessMsgLock);
     SafeOsFree(m_pchTempbuffer);
     m_pchTempbuffer = EC_NULL;
+    SafeOsFree(m_pchBinTempBuffer);
+    m_pchBinTempBuffer = EC_NULL;
+    OsDeleteLock(m_poFlushLock);
+    m_poFlushLock = EC_NULL;
+    /* registrations of threads still running are void, their thread exit does not touch this instance */
+    if ((m_dwInstanceId < MAX_NUMOF_MASTER_INSTANCES) && (s_adwLiveGeneration[m_dwInstanceId] == m_dwProducerGeneration))
+    {
+        s_adwLiveGeneration[m_dwInstanceId] = 0;
+    }
+    m_dwProducerGeneration = 0;
+    OsMemset((EC_T_VOID*)m_adwProducerUsed, 0, sizeof(m_adwProducerUsed));
+    SafeOsFree(m_pchConsoleBatch);
+    m_pchConsoleBatch = EC_NULL;
+    SafeOsFree(m_pchFileBatch);
+    m_pchFileBatch = EC_NULL;
+#if (defined EC_VERSION_LINUX)
+    if (m_nWakeupFd >= 0)
+    {
+        close(m_nWakeupFd);
+        m_nWakeupFd = -1;
+    }
+#endif
 
    /* delete performance measurement buffers */
 #if (defined INCLUDE_EC_MASTER) || (defined INCLUDE_EC_MONITOR) || (defined INCLUDE_EC_SIMULATOR)
@@ -483,7 +649,7 @@ EC_T_VOID CAtEmLogging::tAtEmLogWrapper(EC_T_VOID* pvParm)
 }
 
 /********************************************************************************/
-/** \brief cyclically process all messages
+/** \brief process all messages, wait for new messages in between
 *
 * \return N/A
 */
@@ -491,23 +657,246 @@ EC_T_VOID CAtEmLogging::tAtEmLog(EC_T_VOID* pvParm)
 {
     EC_UNREFPARM(pvParm);
 
+#if (defined EC_VERSION_LINUX)
+    EcPlacementApplyThread(ePlacementThread_Log);
+#endif
     m_bLogTaskRunning = EC_TRUE;
     while (!m_bShutdownLogTask)
     {
         ProcessAllMsgs();
-        OsSleep(1);
+
+        /* ProcessMsgs() handles a limited number of messages per pass */
+        if (!IsMsgPending())
+        {
+#if (defined INCLUDE_FILE_LOGGING)
+            /* once per wakeup, not per pass */
+            FlushFiles();
+#endif
+            WaitForMsgs();
+        }
     }
     ProcessAllMsgs();
+#if (defined INCLUDE_FILE_LOGGING)
+    FlushFiles();
+#endif
     m_bLogTaskRunning = EC_FALSE;
 }
 
 EC_T_VOID CAtEmLogging::ProcessAllMsgs(EC_T_VOID)
 {
+    OsLock(m_poFlushLock);
     for (MSG_BUFFER_DESC* pNextMsgBuf = m_pFirstMsgBufferDesc; EC_NULL != pNextMsgBuf; pNextMsgBuf = pNextMsgBuf->pNextMsgBuf)
     {
         ProcessMsgs(pNextMsgBuf);
+        CloseConsoleSegment();
+    }
+    FlushConsole();
+    OsUnlock(m_poFlushLock);
+}
+
+EC_T_BOOL CAtEmLogging::IsMsgPending(EC_T_VOID)
+{
+    for (MSG_BUFFER_DESC* pNextMsgBuf = m_pFirstMsgBufferDesc; EC_NULL != pNextMsgBuf; pNextMsgBuf = pNextMsgBuf->pNextMsgBuf)
+    {
+        if (pNextMsgBuf->bIsInitialized && (EC_NULL != GetNextMsgSource(pNextMsgBuf)))
+        {
+            return EC_TRUE;
+        }
+    }
+    return EC_FALSE;
+}
+
+/********************************************************************************/
+/** \brief Signal the log task, called by producers
+*
+* Only the first call after the log task went to sleep issues a system call.
+*
+* \return N/A
+*/
+EC_T_VOID CAtEmLogging::WakeupLogTask(EC_T_VOID)
+{
+#if (defined EC_VERSION_LINUX)
+    if ((m_nWakeupFd >= 0) && !m_bWakeupPending)
+    {
+        eventfd_t qwVal = 1;
+
+        m_bWakeupPending = EC_TRUE;
+        if (write(m_nWakeupFd, &qwVal, sizeof(qwVal)) < 0)
+        {
+            /* counter overflow only, the log task is signaled anyway */
+        }
+    }
+#endif
+}
+
+/********************************************************************************/
+/** \brief Sleep until a producer signals or the idle timeout elapses
+*
+* \return N/A
+*/
+EC_T_VOID CAtEmLogging::WaitForMsgs(EC_T_VOID)
+{
+#if (defined EC_VERSION_LINUX)
+    if (m_nWakeupFd >= 0)
+    {
+        struct pollfd oPollFd;
+        eventfd_t     qwVal = 0;
+
+        oPollFd.fd = m_nWakeupFd;
+        oPollFd.events = POLLIN;
+        oPollFd.revents = 0;
+        if ((poll(&oPollFd, 1, (EC_T_INT)m_dwIdleTimeout) > 0) && (read(m_nWakeupFd, &qwVal, sizeof(qwVal)) < 0))
+        {
+            /* already consumed */
+        }
+        m_bWakeupPending = EC_FALSE;
+        OsMemoryBarrier();
+        return;
+    }
+#endif
+    OsSleep(1);
+}
+
+/********************************************************************************/
+/** \brief Terminate the console output segment of the current message buffer
+*
+* \return N/A
+*/
+EC_T_VOID CAtEmLogging::CloseConsoleSegment(EC_T_VOID)
+{
+    if (m_dwConsoleBatchLen == m_dwConsoleSegStart)
+    {
+        return;
+    }
+    if (m_dwConsoleSegCnt >= LOG_CONSOLE_MAX_SEGMENTS)
+    {
+        FlushConsole();
+        return;
+    }
+    m_adwConsoleSeg[2 * m_dwConsoleSegCnt]     = m_dwConsoleSegStart;
+    m_adwConsoleSeg[2 * m_dwConsoleSegCnt + 1] = m_dwConsoleBatchLen - m_dwConsoleSegStart;
+    m_dwConsoleSegCnt++;
+    m_dwConsoleSegStart = m_dwConsoleBatchLen;
+}
+
+/********************************************************************************/
+/** \brief Write the console output of all message buffers with a single writev()
+*
+* \return N/A
+*/
+EC_T_VOID CAtEmLogging::FlushConsole(EC_T_VOID)
+{
+#if (defined EC_VERSION_LINUX)
+    struct iovec aIov[LOG_CONSOLE_MAX_SEGMENTS + 1];
+    EC_T_DWORD   dwIovCnt = 0;
+    EC_T_DWORD   dwIovIdx = 0;
+
+    if (m_dwConsoleBatchLen == 0)
+    {
+        return;
+    }
+    for (dwIovCnt = 0; dwIovCnt < m_dwConsoleSegCnt; dwIovCnt++)
+    {
+        aIov[dwIovCnt].iov_base = &m_pchConsoleBatch[m_adwConsoleSeg[2 * dwIovCnt]];
+        aIov[dwIovCnt].iov_len  = m_adwConsoleSeg[2 * dwIovCnt + 1];
+    }
+    if (m_dwConsoleBatchLen != m_dwConsoleSegStart)
+    {
+        aIov[dwIovCnt].iov_base = &m_pchConsoleBatch[m_dwConsoleSegStart];
+        aIov[dwIovCnt].iov_len  = m_dwConsoleBatchLen - m_dwConsoleSegStart;
+        dwIovCnt++;
+    }
+
+    /* keep the order with output already buffered by stdio */
+    fflush(stdout);
+    while (dwIovIdx < dwIovCnt)
+    {
+        ssize_t nWritten = writev(STDOUT_FILENO, &aIov[dwIovIdx], (EC_T_INT)(dwIovCnt - dwIovIdx));
+        if (nWritten < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        /* partial write */
+        while ((dwIovIdx < dwIovCnt) && ((size_t)nWritten >= aIov[dwIovIdx].iov_len))
+        {
+            nWritten -= (ssize_t)aIov[dwIovIdx].iov_len;
+            dwIovIdx++;
+        }
+        if (dwIovIdx < dwIovCnt)
+        {
+            aIov[dwIovIdx].iov_base = (EC_T_BYTE*)aIov[dwIovIdx].iov_base + nWritten;
+            aIov[dwIovIdx].iov_len -= (size_t)nWritten;
+        }
+    }
+#endif
+    m_dwConsoleBatchLen = 0;
+    m_dwConsoleSegStart = 0;
+    m_dwConsoleSegCnt = 0;
+}
+
+#if (defined INCLUDE_FILE_LOGGING)
+/********************************************************************************/
+/** \brief Gather the file output of the current message buffer
+*
+* \return N/A
+*/
+EC_T_VOID CAtEmLogging::PrintFile(FILE* pFileHandle, EC_T_CHAR* szMsgBuffer, EC_T_DWORD dwLen)
+{
+    /* written by FlushFileBatch() */
+    if (EC_NULL != m_pchFileBatch)
+    {
+        if (m_dwFileBatchLen + dwLen > LOG_FILE_BATCH_SIZE)
+        {
+            FlushFileBatch(pFileHandle);
+        }
+        if (dwLen <= LOG_FILE_BATCH_SIZE)
+        {
+            OsMemcpy(&m_pchFileBatch[m_dwFileBatchLen], szMsgBuffer, dwLen);
+            m_dwFileBatchLen += dwLen;
+            return;
+        }
+    }
+    OsFwrite(szMsgBuffer, dwLen, 1, pFileHandle);
+}
+
+/********************************************************************************/
+/** \brief Write the gathered file output with a single fwrite()
+*
+* Called at the end of each ProcessMsgs() pass and before the file is closed.
+*
+* \return N/A
+*/
+EC_T_VOID CAtEmLogging::FlushFileBatch(FILE* pFileHandle)
+{
+    if ((m_dwFileBatchLen != 0) && (EC_NULL != pFileHandle))
+    {
+        OsFwrite(m_pchFileBatch, m_dwFileBatchLen, 1, pFileHandle);
+    }
+    m_dwFileBatchLen = 0;
+}
+
+/********************************************************************************/
+/** \brief Flush the log files, called once per log task wakeup
+*
+* \return N/A
+*/
+EC_T_VOID CAtEmLogging::FlushFiles(EC_T_VOID)
+{
+    OsLock(m_poProcessMsgLock);
+    for (MSG_BUFFER_DESC* pNextMsgBuf = m_pFirstMsgBufferDesc; EC_NULL != pNextMsgBuf; pNextMsgBuf = pNextMsgBuf->pNextMsgBuf)
+    {
+        if (pNextMsgBuf->bIsInitialized && (EC_NULL != pNextMsgBuf->pfMsgFile))
+        {
+            OsFflush(pNextMsgBuf->pfMsgFile);
+        }
     }
+    OsUnlock(m_poProcessMsgLock);
 }
+#endif /* INCLUDE_FILE_LOGGING */
 
 /********************************************************************************/
 /** \brief Initialize message buffer
@@ -530,9 +919,6 @@ EC_T_BOOL CAtEmLogging::InitMsgBuffer
 )
 {
     EC_T_BOOL  bOk = EC_FALSE;
-    EC_T_CHAR* pchMsgBuffer = EC_NULL;
-    EC_T_DWORD dwBufSiz;
-    EC_T_DWORD dwCnt;
 #if (defined INCLUDE_FILE_LOGGING)
     EC_T_CHAR  szfileNameTemp[MAX_PATH_LEN] = {0};
 #endif
@@ -552,61 +938,35 @@ EC_T_BOOL CAtEmLogging::InitMsgBuffer
     pMsgBufferDesc->dwNumDuplicates = 0;
     pMsgBufferDesc->pszLastMsg = EC_NULL;
 
-    pMsgBufferDesc->paMsg = (LOG_MSG_DESC*)OsMalloc(dwNumMsgs*sizeof(LOG_MSG_DESC));
-    if (pMsgBufferDesc->paMsg == EC_NULL)
-    {
-        OsPrintf("CAtEmLogging::InitMsgBuffer: cannot get memory for logging buffer '%s'\n", szBufferName);
-        goto Exit;
-    }
-    OsMemset(pMsgBufferDesc->paMsg, 0, dwNumMsgs*sizeof(LOG_MSG_DESC));
-
-    dwBufSiz = dwNumMsgs * (dwMsgSize + 1);
-    pchMsgBuffer = (EC_T_CHAR*)OsMalloc(dwBufSiz);
-    if (pchMsgBuffer == EC_NULL)
+    if (!AllocMsgSlots(pMsgBufferDesc, dwMsgSize, dwNumMsgs, szBufferName))
     {
-        OsPrintf("CAtEmLogging::InitMsgBuffer: cannot get memory for logging buffer '%s'\n", szBufferName);
         goto Exit;
     }
 
-    /* Same as below. Needed to prevent false positive from static code analysis. */
-    pMsgBufferDesc->paMsg[0].szMsgBuffer = pchMsgBuffer;
-
-    OsMemset(pchMsgBuffer,0,dwBufSiz);
-    for( dwCnt=0; dwCnt < dwNumMsgs; dwCnt++ )
-    {
-        pMsgBufferDesc->paMsg[dwCnt].szMsgBuffer = &pchMsgBuffer[dwCnt*(dwMsgSize+1)];
-
-        if (pMsgBufferDesc->bPrintTimestamp)
-        {
-            pMsgBufferDesc->paMsg[dwCnt].szMsg = &pchMsgBuffer[dwCnt*(dwMsgSize+1) + LOG_MSG_OFFSET_AFTER_TIMESTAMP];
-        }
-        else
-        {
-            pMsgBufferDesc->paMsg[dwCnt].szMsg = &pchMsgBuffer[dwCnt*(dwMsgSize+1)];
-        }
-    }
-
 #if (defined INCLUDE_FILE_LOGGING)
-    pMsgBufferDesc->wLogFileIndex = 0;
+    pMsgBufferDesc->dwLogFileIndex = 0;
     pMsgBufferDesc->wEntryCounterLimit = wRollOver;
     OsStrncpy(pMsgBufferDesc->szMsgLogFileName, szMsgLogFileName, MAX_PATH_LEN - 1);
     pMsgBufferDesc->szMsgLogFileName[MAX_PATH_LEN - 1] = '\0';
     OsStrncpy(pMsgBufferDesc->szMsgLogFileExt,  szMsgLogFileExt,  MAX_EXT_LEN - 1);
     pMsgBufferDesc->szMsgLogFileExt[MAX_EXT_LEN - 1] = '\0';
 
-    if (0 != pMsgBufferDesc->wEntryCounterLimit )
-    {
-#ifdef FILESYS_8_3
-        OsSnprintf(szfileNameTemp, sizeof(szfileNameTemp) - 1, "%s_%03d.%s", pMsgBufferDesc->szMsgLogFileName, pMsgBufferDesc->wLogFileIndex, pMsgBufferDesc->szMsgLogFileExt);
-#else
-        OsSnprintf(szfileNameTemp, sizeof(szfileNameTemp) - 1, "%s.%03d.%s", pMsgBufferDesc->szMsgLogFileName, pMsgBufferDesc->wLogFileIndex, pMsgBufferDesc->szMsgLogFileExt);
-#endif
-    }
-    else
+    /* continue after the files of earlier runs instead of overwriting them */
+    if (bLogFileEnb && IsLogFileRotated(pMsgBufferDesc))
     {
-        OsSnprintf(szfileNameTemp, sizeof(szfileNameTemp) - 1, "%s.%s", pMsgBufferDesc->szMsgLogFileName, pMsgBufferDesc->szMsgLogFileExt);
+        EC_T_DWORD dwHighest = 0;
+
+        if (0 != ScanLogFiles(pMsgBufferDesc->szMsgLogFileName, pMsgBufferDesc->szMsgLogFileExt, EC_NULL, 0, &dwHighest))
+        {
+            pMsgBufferDesc->dwLogFileIndex = dwHighest + 1;
+        }
     }
 
+    GetLogFileName(szfileNameTemp, sizeof(szfileNameTemp), pMsgBufferDesc->szMsgLogFileName, pMsgBufferDesc->szMsgLogFileExt,
+        IsLogFileRotated(pMsgBufferDesc), pMsgBufferDesc->dwLogFileIndex);
+    pMsgBufferDesc->qwFileSize = 0;
+    pMsgBufferDesc->dwFileOpenTime = OsQueryMsecCount();
+
     if (bLogFileEnb)
     {
         pMsgBufferDesc->pfMsgFile = OsFopen( szfileNameTemp, "w+");
@@ -630,50 +990,119 @@ EC_T_BOOL CAtEmLogging::InitMsgBuffer
     bOk = EC_TRUE;
 
 Exit:
-    if (!bOk)
-    {
-        SafeOsFree(pMsgBufferDesc->paMsg);
-        SafeOsFree(pchMsgBuffer);
-    }
     return bOk;
 }
 
 /********************************************************************************/
-/** \brief De-Init message buffer
+/** \brief Allocate the message descriptors and message memory of a buffer
 *
-* \return N/A
+* \return EC_TRUE on success
 */
-EC_T_VOID CAtEmLogging::DeinitMsgBuffer
-(MSG_BUFFER_DESC*   pMsgBufferDesc
+EC_T_BOOL CAtEmLogging::AllocMsgSlots
+(MSG_BUFFER_DESC*   pMsgBufferDesc      /* [in]  pointer to message buffer descriptor, bPrintTimestamp set */
+,EC_T_DWORD         dwMsgSize           /* [in]  size of a single message */
+,EC_T_DWORD         dwNumMsgs           /* [in]  number of messages */
+,EC_T_CHAR*         szBufferName        /* [in]  name of the logging buffer */
 )
 {
-    CEcTimer oTimeout;
+    EC_T_BOOL  bOk = EC_FALSE;
+    EC_T_CHAR* pchMsgBuffer = EC_NULL;
+    EC_T_DWORD dwBufSiz;
+    EC_T_DWORD dwCnt;
 
-    if (pMsgBufferDesc->bIsInitialized)
+    pMsgBufferDesc->paMsg = (LOG_MSG_DESC*)OsMalloc(dwNumMsgs*sizeof(LOG_MSG_DESC));
+    if (pMsgBufferDesc->paMsg == EC_NULL)
     {
-        /* let the log task print out all messages */
-        if (pMsgBufferDesc->dwNextPrintMsgIndex != pMsgBufferDesc->dwNextEmptyMsgIndex)
-        {
-            OsPrintf("Store unsaved messages in '%s' message/logging buffer...", pMsgBufferDesc->szLogName);
-            oTimeout.Start(3000);
-            while (pMsgBufferDesc->dwNextPrintMsgIndex != pMsgBufferDesc->dwNextEmptyMsgIndex)
-            {
-                ProcessAllMsgs();
-                OsSleep(100);
-                if (oTimeout.IsElapsed())
-                {
-                    OsPrintf(".");
-                    oTimeout.Start(3000);
-                }
-            }
-            OsPrintf(" done!\n");
-        }
+        OsPrintf("CAtEmLogging::InitMsgBuffer: cannot get memory for logging buffer '%s'\n", szBufferName);
+        goto Exit;
+    }
+    OsMemset(pMsgBufferDesc->paMsg, 0, dwNumMsgs*sizeof(LOG_MSG_DESC));
 
-        OsFree(pMsgBufferDesc->paMsg[0].szMsgBuffer);
-        OsFree(pMsgBufferDesc->paMsg);
+    dwBufSiz = dwNumMsgs * (dwMsgSize + 1);
+    pchMsgBuffer = (EC_T_CHAR*)OsMalloc(dwBufSiz);
+    if (pchMsgBuffer == EC_NULL)
+    {
+        OsPrintf("CAtEmLogging::InitMsgBuffer: cannot get memory for logging buffer '%s'\n", szBufferName);
+        goto Exit;
+    }
 
-#if (defined INCLUDE_FILE_LOGGING)
-        if (EC_NULL != pMsgBufferDesc->pfMsgFile)
+    /* Same as below. Needed to prevent false positive from static code analysis. */
+    pMsgBufferDesc->paMsg[0].szMsgBuffer = pchMsgBuffer;
+
+    OsMemset(pchMsgBuffer,0,dwBufSiz);
+    for( dwCnt=0; dwCnt < dwNumMsgs; dwCnt++ )
+    {
+        pMsgBufferDesc->paMsg[dwCnt].szMsgBuffer = &pchMsgBuffer[dwCnt*(dwMsgSize+1)];
+
+        if (pMsgBufferDesc->bPrintTimestamp)
+        {
+            pMsgBufferDesc->paMsg[dwCnt].szMsg = &pchMsgBuffer[dwCnt*(dwMsgSize+1) + LOG_MSG_OFFSET_AFTER_TIMESTAMP];
+        }
+        else
+        {
+            pMsgBufferDesc->paMsg[dwCnt].szMsg = &pchMsgBuffer[dwCnt*(dwMsgSize+1)];
+        }
+    }
+    bOk = EC_TRUE;
+
+Exit:
+    if (!bOk)
+    {
+        SafeOsFree(pMsgBufferDesc->paMsg);
+        SafeOsFree(pchMsgBuffer);
+    }
+    return bOk;
+}
+
+/********************************************************************************/
+/** \brief De-Init message buffer
+*
+* \return N/A
+*/
+EC_T_VOID CAtEmLogging::DeinitMsgBuffer
+(MSG_BUFFER_DESC*   pMsgBufferDesc
+)
+{
+    CEcTimer oTimeout;
+    EC_T_DWORD dwProducerIdx = 0;
+
+    if (pMsgBufferDesc->bIsInitialized)
+    {
+        /* let the log task print out all messages */
+        if (!IsMsgBufferEmpty(pMsgBufferDesc))
+        {
+            OsPrintf("Store unsaved messages in '%s' message/logging buffer...", pMsgBufferDesc->szLogName);
+            oTimeout.Start(3000);
+            while (!IsMsgBufferEmpty(pMsgBufferDesc))
+            {
+                ProcessAllMsgs();
+                OsSleep(100);
+                if (oTimeout.IsElapsed())
+                {
+                    OsPrintf(".");
+                    oTimeout.Start(3000);
+                }
+            }
+            OsPrintf(" done!\n");
+        }
+
+        OsFree(pMsgBufferDesc->paMsg[0].szMsgBuffer);
+        OsFree(pMsgBufferDesc->paMsg);
+
+        for (dwProducerIdx = 0; dwProducerIdx < LOG_MAX_PRODUCERS; dwProducerIdx++)
+        {
+            MSG_BUFFER_DESC* pProducerBuf = pMsgBufferDesc->apProducerBuf[dwProducerIdx];
+            if (EC_NULL != pProducerBuf)
+            {
+                pMsgBufferDesc->apProducerBuf[dwProducerIdx] = EC_NULL;
+                OsFree(pProducerBuf->paMsg[0].szMsgBuffer);
+                OsFree(pProducerBuf->paMsg);
+                OsFree(pProducerBuf);
+            }
+        }
+
+#if (defined INCLUDE_FILE_LOGGING)
+        if (EC_NULL != pMsgBufferDesc->pfMsgFile)
         {
             OsFclose(pMsgBufferDesc->pfMsgFile);
         }
@@ -691,6 +1120,201 @@ EC_T_VOID CAtEmLogging::DeinitMsgBuffer
     }
 }
 
+/********************************************************************************/
+/** \brief Check if a message buffer and its producer rings are empty
+*
+* \return EC_TRUE if all messages are processed
+*/
+EC_T_BOOL CAtEmLogging::IsMsgBufferEmpty(MSG_BUFFER_DESC* pMsgBufferDesc)
+{
+    EC_T_DWORD dwProducerIdx = 0;
+
+    if (pMsgBufferDesc->dwNextPrintMsgIndex != pMsgBufferDesc->dwNextEmptyMsgIndex)
+    {
+        return EC_FALSE;
+    }
+    for (dwProducerIdx = 0; dwProducerIdx < LOG_MAX_PRODUCERS; dwProducerIdx++)
+    {
+        MSG_BUFFER_DESC* pProducerBuf = pMsgBufferDesc->apProducerBuf[dwProducerIdx];
+        if ((EC_NULL != pProducerBuf) && (pProducerBuf->dwNextPrintMsgIndex != pProducerBuf->dwNextEmptyMsgIndex))
+        {
+            return EC_FALSE;
+        }
+    }
+    return EC_TRUE;
+}
+
+/********************************************************************************/
+/** \brief Allocate the single producer rings of a per-producer message buffer
+*
+* All LOG_MAX_PRODUCERS rings are allocated up front with dwNumMsgs messages each (at most the
+* size of the shared ring), registering a thread then only claims one of them.
+*
+* \return EC_TRUE on success
+*/
+EC_T_BOOL CAtEmLogging::AllocProducerRings(MSG_BUFFER_DESC* pMsgBufferDesc, EC_T_DWORD dwNumMsgs)
+{
+    EC_T_DWORD dwProducerIdx = 0;
+
+    if (dwNumMsgs > pMsgBufferDesc->dwNumMsgs)
+    {
+        dwNumMsgs = pMsgBufferDesc->dwNumMsgs;
+    }
+    if (dwNumMsgs < 2)
+    {
+        /* a ring keeps one entry free */
+        dwNumMsgs = 2;
+    }
+    for (dwProducerIdx = 0; dwProducerIdx < LOG_MAX_PRODUCERS; dwProducerIdx++)
+    {
+        MSG_BUFFER_DESC* pProducerBuf = (MSG_BUFFER_DESC*)OsMalloc(sizeof(MSG_BUFFER_DESC));
+        if (EC_NULL == pProducerBuf)
+        {
+            return EC_FALSE;
+        }
+        OsMemset(pProducerBuf, 0, sizeof(MSG_BUFFER_DESC));
+        pProducerBuf->dwMsgSize = pMsgBufferDesc->dwMsgSize;
+        pProducerBuf->dwNumMsgs = dwNumMsgs;
+        pProducerBuf->bPrintTimestamp = pMsgBufferDesc->bPrintTimestamp;
+        if (!AllocMsgSlots(pProducerBuf, pMsgBufferDesc->dwMsgSize, dwNumMsgs, pMsgBufferDesc->szLogName))
+        {
+            OsFree(pProducerBuf);
+            return EC_FALSE;
+        }
+        pProducerBuf->bIsInitialized = EC_TRUE;
+        pMsgBufferDesc->apProducerBuf[dwProducerIdx] = pProducerBuf;
+    }
+    return EC_TRUE;
+}
+
+/********************************************************************************/
+/** \brief Register the calling thread as producer
+*
+* Claims one of the preallocated single producer rings of every per-producer message buffer,
+* nothing is allocated. Messages of the thread are then inserted without taking the insert lock
+* and merged by the log task. The ring is given back by UnregisterProducer() or when the thread
+* exits. Threads exceeding LOG_MAX_PRODUCERS keep using the shared ring.
+*
+* \return EC_E_NOERROR or error code
+*/
+EC_T_DWORD CAtEmLogging::RegisterProducer(EC_T_VOID)
+{
+    EC_T_DWORD dwRetVal = EC_E_NOERROR;
+    EC_T_DWORD dwProducerIdx = LOG_NO_PRODUCER;
+    EC_T_DWORD dwIdx = 0;
+
+    if ((S_oProducer.pInst == this) && (S_oProducer.dwGeneration == m_dwProducerGeneration))
+    {
+        /* already registered */
+        goto Exit;
+    }
+    if (0 == m_dwProducerGeneration)
+    {
+        dwRetVal = EC_E_INVALIDSTATE;
+        goto Exit;
+    }
+    for (dwIdx = 0; dwIdx < LOG_MAX_PRODUCERS; dwIdx++)
+    {
+        /* the ring's previous thread exited, it stays single producer */
+        if ((0 == m_adwProducerUsed[dwIdx]) && __sync_bool_compare_and_swap(&m_adwProducerUsed[dwIdx], 0, 1))
+        {
+            dwProducerIdx = dwIdx;
+            break;
+        }
+    }
+
+    S_oProducer.pInst = this;
+    S_oProducer.dwInstanceId = m_dwInstanceId;
+    S_oProducer.dwGeneration = m_dwProducerGeneration;
+    S_oProducer.dwIdx = dwProducerIdx;
+
+Exit:
+    return dwRetVal;
+}
+
+/********************************************************************************/
+/** \brief Give the rings of the calling thread back
+*
+* Messages still queued in them are printed by the log task as usual.
+*
+* \return N/A
+*/
+EC_T_VOID CAtEmLogging::UnregisterProducer(EC_T_VOID)
+{
+    if ((S_oProducer.pInst != this) || (S_oProducer.dwGeneration != m_dwProducerGeneration))
+    {
+        return;
+    }
+    if (S_oProducer.dwIdx < LOG_MAX_PRODUCERS)
+    {
+        /* inserts of this thread happen before the next thread claims the ring */
+        __sync_synchronize();
+        m_adwProducerUsed[S_oProducer.dwIdx] = 0;
+    }
+    S_oProducer.pInst = EC_NULL;
+    S_oProducer.dwGeneration = 0;
+    S_oProducer.dwIdx = LOG_NO_PRODUCER;
+}
+
+/********************************************************************************/
+/** \brief Get the ring of the calling thread, registers the thread on first use
+*
+* \return producer ring or EC_NULL to use the shared ring
+*/
+MSG_BUFFER_DESC* CAtEmLogging::GetProducerBuffer(MSG_BUFFER_DESC* pMsgBufferDesc)
+{
+    if (!pMsgBufferDesc->bPerProducer)
+    {
+        return EC_NULL;
+    }
+    if ((S_oProducer.pInst != this) || (S_oProducer.dwGeneration != m_dwProducerGeneration))
+    {
+        RegisterProducer();
+    }
+    if (S_oProducer.dwIdx >= LOG_MAX_PRODUCERS)
+    {
+        return EC_NULL;
+    }
+    return pMsgBufferDesc->apProducerBuf[S_oProducer.dwIdx];
+}
+
+/********************************************************************************/
+/** \brief Select the ring holding the oldest complete message
+*
+* \return ring (the buffer itself or one of its producer rings) or EC_NULL if no message is complete
+*/
+MSG_BUFFER_DESC* CAtEmLogging::GetNextMsgSource(MSG_BUFFER_DESC* pMsgBufferDesc)
+{
+    MSG_BUFFER_DESC* pSrcBuf = EC_NULL;
+    EC_T_UINT64      qwOrder = 0;
+    EC_T_DWORD       dwProducerIdx = 0;
+    MSG_BUFFER_DESC* pCandidate = pMsgBufferDesc;
+
+    for (dwProducerIdx = 0; dwProducerIdx <= LOG_MAX_PRODUCERS; dwProducerIdx++)
+    {
+        if (dwProducerIdx > 0)
+        {
+            pCandidate = pMsgBufferDesc->apProducerBuf[dwProducerIdx - 1];
+        }
+        if ((EC_NULL != pCandidate) && (pCandidate->dwNextPrintMsgIndex != pCandidate->dwNextEmptyMsgIndex))
+        {
+            LOG_MSG_DESC* pHead = &pCandidate->paMsg[pCandidate->dwNextPrintMsgIndex];
+
+            /* message complete? */
+            if (pHead->bValid && ((EC_NULL == pSrcBuf) || (pHead->qwMsgOrder < qwOrder)))
+            {
+                pSrcBuf = pCandidate;
+                qwOrder = pHead->qwMsgOrder;
+            }
+        }
+        if (!pMsgBufferDesc->bPerProducer)
+        {
+            break;
+        }
+    }
+    return pSrcBuf;
+}
+
 /********************************************************************************/
 /** \brief Process log message
 *
@@ -746,6 +1370,23 @@ EC_T_DWORD CAtEmLogging::LogMsgOsPrintf(struct _EC_T_LOG_CONTEXT* pContext, EC_T
     return dwRetVal;
 }
 
+/********************************************************************************/
+/** \brief Time used to merge the producer rings
+*
+* \return monotonic time in ns
+*/
+static EC_T_UINT64 LogGetOrderTime(EC_T_VOID)
+{
+#if (defined EC_VERSION_LINUX)
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (EC_T_UINT64)ts.tv_sec * 1000000000ULL + (EC_T_UINT64)ts.tv_nsec;
+#else
+    return (EC_T_UINT64)OsQueryMsecCount() * 1000000ULL;
+#endif
+}
+
 /********************************************************************************/
 /** \brief Insert a new message into message buffer with Log Message Severity
 *
@@ -762,6 +1403,8 @@ EC_T_DWORD CAtEmLogging::InsertNewMsgVa
     EC_T_DWORD    dwRes       = EC_E_NOERROR;
     EC_T_BOOL     bBufferFull = EC_FALSE;
     LOG_MSG_DESC* pMsgDesc    = EC_NULL;
+    MSG_BUFFER_DESC* pRingDesc = EC_NULL;
+    EC_T_BOOL     bSharedRing = EC_TRUE;
 
     /* select default message queue if needed */
     if (pMsgBufferDesc == EC_NULL)
@@ -774,36 +1417,62 @@ EC_T_DWORD CAtEmLogging::InsertNewMsgVa
         dwRes = EC_E_INVALIDSTATE;
         goto Exit;
     }
+    /* registered threads are the only producer of their ring, no lock needed */
+    pRingDesc = GetProducerBuffer(pMsgBufferDesc);
+    if (EC_NULL != pRingDesc)
+    {
+        bSharedRing = EC_FALSE;
+    }
+    else
+    {
+        pRingDesc = pMsgBufferDesc;
+    }
+
     /* get message descriptor */
-    OsLock(m_poInsertMsgLock);
+    if (bSharedRing)
+    {
+        OsLock(m_poInsertMsgLock);
+    }
     {
         EC_T_DWORD dwNewNextEmpty = 0;
 
-        pMsgDesc = &pMsgBufferDesc->paMsg[pMsgBufferDesc->dwNextEmptyMsgIndex];
+        pMsgDesc = &pRingDesc->paMsg[pRingDesc->dwNextEmptyMsgIndex];
         pMsgDesc->dwMsgBufferLen = 0;
         pMsgDesc->dwMsgLen = 0;
 
-        dwNewNextEmpty = pMsgBufferDesc->dwNextEmptyMsgIndex + 1;
-        if (dwNewNextEmpty >= pMsgBufferDesc->dwNumMsgs)
+        dwNewNextEmpty = pRingDesc->dwNextEmptyMsgIndex + 1;
+        if (dwNewNextEmpty >= pRingDesc->dwNumMsgs)
         {
             dwNewNextEmpty = 0;
         }
-        if (dwNewNextEmpty == pMsgBufferDesc->dwNextPrintMsgIndex)
+        if (dwNewNextEmpty == pRingDesc->dwNextPrintMsgIndex)
         {
-            LOG_MSG_DESC* pDropReportMsg = &pMsgBufferDesc->paMsg[pMsgBufferDesc->dwDropReportMsgIndex];
-            if (pDropReportMsg->dwMsgsDropped < 0xFFFFFFFF)
+            if (bSharedRing)
+            {
+                LOG_MSG_DESC* pDropReportMsg = &pRingDesc->paMsg[pRingDesc->dwDropReportMsgIndex];
+
+                if (pDropReportMsg->dwMsgsDropped < 0xFFFFFFFF)
+                {
+                    pDropReportMsg->dwMsgsDropped++;
+                }
+            }
+            else
             {
-                pDropReportMsg->dwMsgsDropped++;
+                /* no lock shared with the log task on the producer path */
+                __atomic_fetch_add(&pRingDesc->dwMsgsDropped, 1, __ATOMIC_RELAXED);
             }
             bBufferFull = EC_TRUE;
         }
         else
         {
-            pMsgBufferDesc->dwDropReportMsgIndex = pMsgBufferDesc->dwNextEmptyMsgIndex;
-            pMsgBufferDesc->dwNextEmptyMsgIndex = dwNewNextEmpty;
+            pRingDesc->dwDropReportMsgIndex = pRingDesc->dwNextEmptyMsgIndex;
+            pRingDesc->dwNextEmptyMsgIndex = dwNewNextEmpty;
         }
     }
-    OsUnlock(m_poInsertMsgLock);
+    if (bSharedRing)
+    {
+        OsUnlock(m_poInsertMsgLock);
+    }
 
     if (bBufferFull)
     {
@@ -812,6 +1481,7 @@ EC_T_DWORD CAtEmLogging::InsertNewMsgVa
     }
     /* fill message descriptor */
     pMsgDesc->dwSeverity = dwLogMsgSeverity;
+    pMsgDesc->qwMsgOrder = LogGetOrderTime();
 
     /* timestamp max. 10 digits, format "%010d: " */
     if (pMsgBufferDesc->bPrintTimestamp)
@@ -823,64 +1493,335 @@ EC_T_DWORD CAtEmLogging::InsertNewMsgVa
         pMsgDesc->dwMsgTimestamp = 0;
     }
 
-    /* format message */
-    pMsgDesc->dwMsgLen = (EC_T_DWORD)EcVsnprintf(pMsgDesc->szMsg, (EC_T_INT)(pMsgBufferDesc->dwMsgSize - (pMsgDesc->szMsg - pMsgDesc->szMsgBuffer)), szFormat, vaArgs);
-    pMsgDesc->dwMsgBufferLen = (EC_T_DWORD)(pMsgDesc->dwMsgLen + (pMsgDesc->szMsg - pMsgDesc->szMsgBuffer));
+    /* binary logging: only store the arguments, the log task formats the message */
+    pMsgDesc->szFormat = EC_NULL;
+    if (m_bBinaryLogging && ((pMsgBufferDesc == m_pAllMsgBufferDesc) || (pMsgBufferDesc == m_pErrorMsgBufferDesc))
+        && StoreMsgArgs(pMsgDesc, (EC_T_DWORD)(pMsgBufferDesc->dwMsgSize - (pMsgDesc->szMsg - pMsgDesc->szMsgBuffer)), szFormat, vaArgs))
+    {
+        /* formatted by FormatMsgArgs() */
+    }
+    else
+    {
+        /* format message */
+        pMsgDesc->dwMsgLen = (EC_T_DWORD)EcVsnprintf(pMsgDesc->szMsg, (EC_T_INT)(pMsgBufferDesc->dwMsgSize - (pMsgDesc->szMsg - pMsgDesc->szMsgBuffer)), szFormat, vaArgs);
+        pMsgDesc->dwMsgBufferLen = (EC_T_DWORD)(pMsgDesc->dwMsgLen + (pMsgDesc->szMsg - pMsgDesc->szMsgBuffer));
 
-    OnLogMsg(pMsgDesc->szMsg);
+        OnLogMsg(pMsgDesc->szMsg);
 
-    if (FilterMsg(pMsgDesc->szMsg))
-    {
-        pMsgDesc->szMsg[0] = '\0';
-        pMsgDesc->dwMsgBufferLen = 0;
-        pMsgDesc->dwMsgLen = 0;
+        if (FilterMsg(pMsgDesc->szMsg))
+        {
+            pMsgDesc->szMsg[0] = '\0';
+            pMsgDesc->dwMsgBufferLen = 0;
+            pMsgDesc->dwMsgLen = 0;
+        }
     }
 
     OsMemoryBarrier();
     pMsgDesc->bValid = EC_TRUE;
 
+    /* wake up the log task on errors or if the buffer reaches the watermark */
+    if (!m_bWakeupPending)
+    {
+        EC_T_DWORD dwPending = (pRingDesc->dwNextEmptyMsgIndex + pRingDesc->dwNumMsgs - pRingDesc->dwNextPrintMsgIndex) % pRingDesc->dwNumMsgs;
+
+        if (((dwLogMsgSeverity != EC_LOG_LEVEL_SILENT) && (dwLogMsgSeverity <= EC_LOG_LEVEL_ERROR))
+            || ((dwPending * 100) >= (pRingDesc->dwNumMsgs * m_dwWakeupWatermark)))
+        {
+            WakeupLogTask();
+        }
+    }
+
 Exit:
     return dwRes;
 }
 
 /********************************************************************************/
-/** \brief Forward to next logging buffer (memory logging)
+/** \brief Parse the conversion specification at szSpec ('%...')
 *
-* \return N/A
+* Only the subset supported by EcVsnprintf() is accepted: '0' flag, width, 'l' / 'll' and d, u, x, X, c, s.
+*
+* \return position after the specification or EC_NULL if it has to be formatted by EcVsnprintf() directly
 */
-EC_T_VOID CAtEmLogging::SelectNextLogMemBuffer
-(MSG_BUFFER_DESC*   pMsgBufferDesc )
+static const EC_T_CHAR* LogBinParseSpec(
+    const EC_T_CHAR* szSpec,
+    EC_T_CHAR*       szOut,         /* [out] copy of the specification, LOG_BIN_MAX_SPEC bytes */
+    EC_T_DWORD*      pdwLongCnt,    /* [out] number of 'l' */
+    EC_T_CHAR*       pchConv        /* [out] conversion character */
+    )
 {
-    pMsgBufferDesc->pbyNextLogMsg = pMsgBufferDesc->pbyNextLogMsg + OsStrlen(pMsgBufferDesc->pbyNextLogMsg);
-    if (pMsgBufferDesc->pbyNextLogMsg >= (pMsgBufferDesc->pbyLogMemory + pMsgBufferDesc->dwLogMemorySize - 3*MAX_MESSAGE_SIZE) )
+    const EC_T_CHAR* pch   = szSpec + 1;
+    EC_T_DWORD       dwOut = 0;
+
+    *pdwLongCnt = 0;
+    szOut[dwOut++] = '%';
+    while ((*pch >= '0') && (*pch <= '9'))
     {
-        /* stop logging if memory is full */
-        // LogMsg(pEcLogContext, EC_LOG_LEVEL_INFO, "logging buffer %s is full, logging stopped!\n", pMsgBufferDesc->szLogName); // TODO: replace with logging of lost msg counter in low prio log task
-        pMsgBufferDesc->bLogBufferFull = EC_TRUE;
+        if (dwOut >= LOG_BIN_MAX_SPEC - 4)
+        {
+            return EC_NULL;
+        }
+        szOut[dwOut++] = *pch++;
+    }
+    while ((*pch == 'l') && (*pdwLongCnt < 2))
+    {
+        (*pdwLongCnt)++;
+        szOut[dwOut++] = *pch++;
+    }
+    *pchConv = *pch;
+    switch (*pch)
+    {
+    case 'd': case 'u': case 'x': case 'X':
+        break;
+    case 'c': case 's':
+        if (*pdwLongCnt != 0)
+        {
+            return EC_NULL;
+        }
+        break;
+    default:
+        return EC_NULL;
     }
+    szOut[dwOut++] = *pch++;
+    szOut[dwOut] = '\0';
 
-    /* zero-terminate log msg (snprintf doesn't include this) */
-    pMsgBufferDesc->pbyNextLogMsg[0] = '\0';
-    pMsgBufferDesc->pbyNextLogMsg[MAX_MESSAGE_SIZE - 1] = '\0';
+    return pch;
 }
 
-/* finalize szMsgBuffer (timestamp, new line) */
-EC_T_VOID CAtEmLogging::FinalizeMsg(LOG_MSG_DESC* pMsgDesc)
+/********************************************************************************/
+/** \brief Store the raw message arguments in the message slot (binary logging)
+*
+* Only the arguments are captured, no formatting is done. String arguments are copied.
+*
+* \return EC_FALSE if the message has to be formatted immediately (unsupported conversion, too many arguments, strings too long)
+*/
+EC_T_BOOL CAtEmLogging::StoreMsgArgs(
+    LOG_MSG_DESC*    pMsgDesc,
+    EC_T_DWORD       dwSlotSize,
+    const EC_T_CHAR* szFormat,
+    EC_T_VALIST      vaArgs
+    )
 {
-    /* szMsgBuffer contains timestamp, message and new line, because e.g. RTX64 requires terminating new line directly appended to the message */
-    if (pMsgDesc->szMsg[pMsgDesc->dwMsgLen - 1] != '\n')
+    EC_T_BOOL        bRetVal  = EC_FALSE;
+    LOG_BIN_MSG      oBinMsg;
+    EC_T_CHAR*       pchStr   = pMsgDesc->szMsg + offsetof(LOG_BIN_MSG, achStr);
+    EC_T_DWORD       dwStrMax = 0;
+    const EC_T_CHAR* pch      = szFormat;
+    EC_T_VALIST      vaCopy;
+
+    if ((EC_NULL == szFormat) || (dwSlotSize <= offsetof(LOG_BIN_MSG, achStr)))
     {
-        pMsgDesc->szMsg[pMsgDesc->dwMsgLen] = '\n';
-        pMsgDesc->dwMsgLen++;
-        pMsgDesc->szMsg[pMsgDesc->dwMsgLen] = '\0';
+        return EC_FALSE;
     }
+    dwStrMax = dwSlotSize - (EC_T_DWORD)offsetof(LOG_BIN_MSG, achStr);
+    OsMemset(&oBinMsg, 0, offsetof(LOG_BIN_MSG, achStr));
 
-    /* add timestamp to buffer */
-    if (pMsgDesc->szMsg != pMsgDesc->szMsgBuffer)
+    /* vaArgs is formatted by the caller if capturing fails */
+    va_copy(vaCopy, vaArgs);
+
+    while (EC_NULL != (pch = strchr(pch, '%')))
     {
-        /* insert timestamp */
-        OsSnprintf(pMsgDesc->szMsgBuffer, LOG_MSG_OFFSET_AFTER_TIMESTAMP, "%010d:", (EC_T_INT)pMsgDesc->dwMsgTimestamp);
-        pMsgDesc->szMsgBuffer[LOG_MSG_OFFSET_AFTER_TIMESTAMP - 1] = ' ';
+        EC_T_CHAR  szSpec[LOG_BIN_MAX_SPEC];
+        EC_T_DWORD dwLongCnt = 0;
+        EC_T_CHAR  chConv    = 0;
+
+        if (pch[1] == '%')
+        {
+            pch += 2;
+            continue;
+        }
+        pch = LogBinParseSpec(pch, szSpec, &dwLongCnt, &chConv);
+        if ((EC_NULL == pch) || (oBinMsg.wArgCnt >= LOG_BIN_MAX_ARGS))
+        {
+            goto Exit;
+        }
+        if (chConv == 's')
+        {
+            const EC_T_CHAR* szVal = va_arg(vaCopy, const EC_T_CHAR*);
+            EC_T_DWORD       dwLen = 0;
+
+            if (EC_NULL == szVal)
+            {
+                goto Exit;
+            }
+            dwLen = (EC_T_DWORD)OsStrlen(szVal);
+            if ((oBinMsg.wStrLen + dwLen + 1) > dwStrMax)
+            {
+                goto Exit;
+            }
+            OsMemcpy(&pchStr[oBinMsg.wStrLen], szVal, dwLen + 1);
+            oBinMsg.abyType[oBinMsg.wArgCnt] = LOG_BIN_ARG_STR;
+            oBinMsg.aqwArg[oBinMsg.wArgCnt++] = oBinMsg.wStrLen;
+            oBinMsg.wStrLen = (EC_T_WORD)(oBinMsg.wStrLen + dwLen + 1);
+        }
+        else if ((chConv == 'd') || (chConv == 'c'))
+        {
+            EC_T_INT64 nVal = 0;
+            switch (dwLongCnt)
+            {
+            case 0:  nVal = va_arg(vaCopy, EC_T_INT);  break;
+            case 1:  nVal = va_arg(vaCopy, long);      break;
+            default: nVal = va_arg(vaCopy, long long); break;
+            }
+            oBinMsg.abyType[oBinMsg.wArgCnt] = LOG_BIN_ARG_INT;
+            oBinMsg.aqwArg[oBinMsg.wArgCnt++] = (EC_T_UINT64)nVal;
+        }
+        else
+        {
+            EC_T_UINT64 qwVal = 0;
+            switch (dwLongCnt)
+            {
+            case 0:  qwVal = va_arg(vaCopy, unsigned int);       break;
+            case 1:  qwVal = va_arg(vaCopy, unsigned long);      break;
+            default: qwVal = va_arg(vaCopy, unsigned long long); break;
+            }
+            oBinMsg.abyType[oBinMsg.wArgCnt] = LOG_BIN_ARG_UINT;
+            oBinMsg.aqwArg[oBinMsg.wArgCnt++] = qwVal;
+        }
+    }
+    OsMemcpy(pMsgDesc->szMsg, &oBinMsg, offsetof(LOG_BIN_MSG, achStr));
+    pMsgDesc->szFormat = szFormat;
+    bRetVal = EC_TRUE;
+
+Exit:
+    va_end(vaCopy);
+    return bRetVal;
+}
+
+/********************************************************************************/
+/** \brief Format a message stored by StoreMsgArgs() (called by the log task)
+*
+* Each argument is passed to EcSnprintf() with its original type, the result is the same as formatting in the caller.
+*
+* \return N/A
+*/
+EC_T_VOID CAtEmLogging::FormatMsgArgs(
+    LOG_MSG_DESC* pMsgDesc,
+    EC_T_DWORD    dwSlotSize
+    )
+{
+    LOG_BIN_MSG      oBinMsg;
+    const EC_T_CHAR* pchStr  = pMsgDesc->szMsg + offsetof(LOG_BIN_MSG, achStr);
+    const EC_T_CHAR* pch     = pMsgDesc->szFormat;
+    EC_T_CHAR*       pchOut  = m_pchBinTempBuffer;
+    EC_T_DWORD       dwOutMax = (dwSlotSize < MAX_MESSAGE_SIZE) ? dwSlotSize : MAX_MESSAGE_SIZE;
+    EC_T_DWORD       dwOut   = 0;
+    EC_T_DWORD       dwArg   = 0;
+
+    OsMemcpy(&oBinMsg, pMsgDesc->szMsg, offsetof(LOG_BIN_MSG, achStr));
+
+    while ((*pch != '\0') && (dwOut + 1 < dwOutMax))
+    {
+        EC_T_CHAR   szSpec[LOG_BIN_MAX_SPEC];
+        EC_T_DWORD  dwLongCnt = 0;
+        EC_T_CHAR   chConv    = 0;
+        EC_T_INT    nRes      = 0;
+        EC_T_UINT64 qwVal     = 0;
+        EC_T_INT    nMaxSize  = (EC_T_INT)(dwOutMax - dwOut);
+
+        if (*pch != '%')
+        {
+            pchOut[dwOut++] = *pch++;
+            continue;
+        }
+        if (pch[1] == '%')
+        {
+            pchOut[dwOut++] = '%';
+            pch += 2;
+            continue;
+        }
+        pch = LogBinParseSpec(pch, szSpec, &dwLongCnt, &chConv);
+        if ((EC_NULL == pch) || (dwArg >= oBinMsg.wArgCnt))
+        {
+            break;
+        }
+        qwVal = oBinMsg.aqwArg[dwArg++];
+        if (chConv == 's')
+        {
+            nRes = OsSnprintf(&pchOut[dwOut], nMaxSize, szSpec, &pchStr[qwVal]);
+        }
+        else if ((chConv == 'd') || (chConv == 'c'))
+        {
+            switch (dwLongCnt)
+            {
+            case 0:  nRes = OsSnprintf(&pchOut[dwOut], nMaxSize, szSpec, (EC_T_INT)qwVal);  break;
+            case 1:  nRes = OsSnprintf(&pchOut[dwOut], nMaxSize, szSpec, (long)qwVal);      break;
+            default: nRes = OsSnprintf(&pchOut[dwOut], nMaxSize, szSpec, (long long)qwVal); break;
+            }
+        }
+        else
+        {
+            switch (dwLongCnt)
+            {
+            case 0:  nRes = OsSnprintf(&pchOut[dwOut], nMaxSize, szSpec, (unsigned int)qwVal);       break;
+            case 1:  nRes = OsSnprintf(&pchOut[dwOut], nMaxSize, szSpec, (unsigned long)qwVal);      break;
+            default: nRes = OsSnprintf(&pchOut[dwOut], nMaxSize, szSpec, (unsigned long long)qwVal); break;
+            }
+        }
+        if (nRes > 0)
+        {
+            dwOut = dwOut + (EC_T_DWORD)nRes;
+            if (dwOut >= dwOutMax)
+            {
+                dwOut = dwOutMax - 1;
+            }
+        }
+    }
+    pchOut[dwOut] = '\0';
+
+    /* replace binary content by the formatted message */
+    OsMemcpy(pMsgDesc->szMsg, pchOut, dwOut + 1);
+    pMsgDesc->dwMsgLen = dwOut;
+    pMsgDesc->dwMsgBufferLen = (EC_T_DWORD)(dwOut + (pMsgDesc->szMsg - pMsgDesc->szMsgBuffer));
+    pMsgDesc->szFormat = EC_NULL;
+
+    OnLogMsg(pMsgDesc->szMsg);
+
+    if (FilterMsg(pMsgDesc->szMsg))
+    {
+        pMsgDesc->szMsg[0] = '\0';
+        pMsgDesc->dwMsgBufferLen = 0;
+        pMsgDesc->dwMsgLen = 0;
+    }
+}
+
+/********************************************************************************/
+/** \brief Forward to next logging buffer (memory logging)
+*
+* \return N/A
+*/
+EC_T_VOID CAtEmLogging::SelectNextLogMemBuffer
+(MSG_BUFFER_DESC*   pMsgBufferDesc )
+{
+    pMsgBufferDesc->pbyNextLogMsg = pMsgBufferDesc->pbyNextLogMsg + OsStrlen(pMsgBufferDesc->pbyNextLogMsg);
+    if (pMsgBufferDesc->pbyNextLogMsg >= (pMsgBufferDesc->pbyLogMemory + pMsgBufferDesc->dwLogMemorySize - 3*MAX_MESSAGE_SIZE) )
+    {
+        /* stop logging if memory is full */
+        // LogMsg(pEcLogContext, EC_LOG_LEVEL_INFO, "logging buffer %s is full, logging stopped!\n", pMsgBufferDesc->szLogName); // TODO: replace with logging of lost msg counter in low prio log task
+        pMsgBufferDesc->bLogBufferFull = EC_TRUE;
+    }
+
+    /* zero-terminate log msg (snprintf doesn't include this) */
+    pMsgBufferDesc->pbyNextLogMsg[0] = '\0';
+    pMsgBufferDesc->pbyNextLogMsg[MAX_MESSAGE_SIZE - 1] = '\0';
+}
+
+/* finalize szMsgBuffer (timestamp, new line) */
+EC_T_VOID CAtEmLogging::FinalizeMsg(LOG_MSG_DESC* pMsgDesc)
+{
+    /* szMsgBuffer contains timestamp, message and new line, because e.g. RTX64 requires terminating new line directly appended to the message */
+    if (pMsgDesc->szMsg[pMsgDesc->dwMsgLen - 1] != '\n')
+    {
+        pMsgDesc->szMsg[pMsgDesc->dwMsgLen] = '\n';
+        pMsgDesc->dwMsgLen++;
+        pMsgDesc->szMsg[pMsgDesc->dwMsgLen] = '\0';
+    }
+
+    /* add timestamp to buffer */
+    if (pMsgDesc->szMsg != pMsgDesc->szMsgBuffer)
+    {
+        /* insert timestamp */
+        OsSnprintf(pMsgDesc->szMsgBuffer, LOG_MSG_OFFSET_AFTER_TIMESTAMP, "%010d:", (EC_T_INT)pMsgDesc->dwMsgTimestamp);
+        pMsgDesc->szMsgBuffer[LOG_MSG_OFFSET_AFTER_TIMESTAMP - 1] = ' ';
 
         /* print with timestamp */
         pMsgDesc->dwMsgBufferLen = pMsgDesc->dwMsgLen + LOG_MSG_OFFSET_AFTER_TIMESTAMP;
@@ -890,6 +1831,22 @@ EC_T_VOID CAtEmLogging::FinalizeMsg(LOG_MSG_DESC* pMsgDesc)
 EC_T_VOID CAtEmLogging::PrintConsole(EC_T_CHAR* szMsgBuffer)
 {
 #if (!defined NOPRINTF)
+    /* gathered and written by FlushConsole() */
+    if (EC_NULL != m_pchConsoleBatch)
+    {
+        EC_T_DWORD dwLen = (EC_T_DWORD)OsStrlen(szMsgBuffer);
+
+        if (m_dwConsoleBatchLen + dwLen > LOG_CONSOLE_BATCH_SIZE)
+        {
+            FlushConsole();
+        }
+        if (dwLen <= LOG_CONSOLE_BATCH_SIZE)
+        {
+            OsMemcpy(&m_pchConsoleBatch[m_dwConsoleBatchLen], szMsgBuffer, dwLen);
+            m_dwConsoleBatchLen += dwLen;
+            return;
+        }
+    }
     OsPrintf("%s", szMsgBuffer);
 #else
     EC_UNREFPARM(szMsgBuffer);
@@ -1403,6 +2360,7 @@ EC_T_DWORD CAtEmLogging::PrintHistogramLine(const EC_T_CHAR* szFormat, ...)
     /* prevent message buffer overflow */
     if (((m_pHistMsgBufferDesc->dwNextEmptyMsgIndex + 2) % m_pHistMsgBufferDesc->dwNumMsgs) == m_pHistMsgBufferDesc->dwNextPrintMsgIndex)
     {
+        WakeupLogTask();
         OsSleep(500);
     }
     return dwRes;
@@ -1419,6 +2377,7 @@ EC_T_VOID CAtEmLogging::ProcessMsgs
 {
     EC_T_DWORD    dwNewNextPrint              = 0;
     LOG_MSG_DESC* pCurrMsg                    = EC_NULL;
+    MSG_BUFFER_DESC* pSrcBuf                  = EC_NULL;
     EC_T_BOOL     bLocked                     = EC_FALSE;
     EC_T_BOOL     bSkipDuplicate              = EC_FALSE;
     EC_T_DWORD    dwNumDuplicatesBeforeNewMsg = 0;
@@ -1435,7 +2394,8 @@ EC_T_VOID CAtEmLogging::ProcessMsgs
         OsLock(m_poProcessMsgLock);
         bLocked = EC_TRUE;
 
-        while (pMsgBufferDesc->dwNextPrintMsgIndex != pMsgBufferDesc->dwNextEmptyMsgIndex)
+        /* oldest complete message of the shared ring and the producer rings */
+        while (EC_NULL != (pSrcBuf = GetNextMsgSource(pMsgBufferDesc)))
         {
             EC_T_DWORD dwMsgsDropped = 0;
 
@@ -1447,12 +2407,12 @@ EC_T_VOID CAtEmLogging::ProcessMsgs
                 break;
             }
 
-            pCurrMsg = &pMsgBufferDesc->paMsg[pMsgBufferDesc->dwNextPrintMsgIndex];
+            pCurrMsg = &pSrcBuf->paMsg[pSrcBuf->dwNextPrintMsgIndex];
 
-            /* wait until message complete */
-            if (!pCurrMsg->bValid)
+            /* binary logging: format now */
+            if (EC_NULL != pCurrMsg->szFormat)
             {
-                break;
+                FormatMsgArgs(pCurrMsg, (EC_T_DWORD)(pMsgBufferDesc->dwMsgSize - (pCurrMsg->szMsg - pCurrMsg->szMsgBuffer)));
             }
 
             /* message complete, not filtered */
@@ -1518,28 +2478,17 @@ EC_T_VOID CAtEmLogging::ProcessMsgs
                         pCurrMsg->dwMsgsDropped = 0;
                         OsUnlock(m_poInsertMsgLock);
                     }
+                    if (pSrcBuf != pMsgBufferDesc)
+                    {
+                        dwMsgsDropped += __atomic_exchange_n(&pSrcBuf->dwMsgsDropped, 0, __ATOMIC_RELAXED);
+                    }
 #if (defined INCLUDE_FILE_LOGGING)
                     if (EC_NULL != pFileHandle)
                     {
                         pMsgBufferDesc->wEntryCounter++;
-                        if (0 != pMsgBufferDesc->wEntryCounterLimit && pMsgBufferDesc->pfMsgFile != EC_NULL)
+                        if ((0 != pMsgBufferDesc->wEntryCounterLimit) && (pMsgBufferDesc->wEntryCounter >= pMsgBufferDesc->wEntryCounterLimit))
                         {
-                            if (pMsgBufferDesc->wEntryCounter >= pMsgBufferDesc->wEntryCounterLimit)
-                            {
-                                bRollOver = EC_TRUE;
-                                pMsgBufferDesc->wEntryCounter = 0;
-                                pMsgBufferDesc->wLogFileIndex++;
-#ifdef FILESYS_8_3
-                                OsSnprintf(szfileNameTemp, sizeof(szfileNameTemp) - 1, "%s_%03d.%s", pMsgBufferDesc->szMsgLogFileName, pMsgBufferDesc->wLogFileIndex, pMsgBufferDesc->szMsgLogFileExt);
-#else
-                                OsSnprintf(szfileNameTemp, sizeof(szfileNameTemp) - 1, "%s.%03d.%s", pMsgBufferDesc->szMsgLogFileName, pMsgBufferDesc->wLogFileIndex, pMsgBufferDesc->szMsgLogFileExt);
-#endif
-                            }
-                            else
-                            {
-                                bRollOver = EC_FALSE;
-                            }
-
+                            bRollOver = EC_TRUE;
                         }
                     }
 #endif /* INCLUDE_FILE_LOGGING */
@@ -1612,39 +2561,60 @@ EC_T_VOID CAtEmLogging::ProcessMsgs
                         {
                             oTmpMsgDesc.dwMsgLen = EcSnprintf(oTmpMsgDesc.szMsg, MAX_MESSAGE_SIZE - dwMsgOffset - 1, "%d identical messages skipped\n", dwNumDuplicatesBeforeNewMsg);
                             FinalizeMsg(&oTmpMsgDesc);
-                            OsFwrite(oTmpMsgDesc.szMsgBuffer, oTmpMsgDesc.dwMsgLen, 1, pFileHandle);
+                            PrintFile(pFileHandle, oTmpMsgDesc.szMsgBuffer, dwMsgOffset + oTmpMsgDesc.dwMsgLen);
+                            pMsgBufferDesc->qwFileSize += dwMsgOffset + oTmpMsgDesc.dwMsgLen;
                         }
                         /* print message */
                         {
                             FinalizeMsg(pCurrMsg);
-                            OsFwrite(pCurrMsg->szMsgBuffer, pCurrMsg->dwMsgBufferLen, 1, pFileHandle);
+                            PrintFile(pFileHandle, pCurrMsg->szMsgBuffer, pCurrMsg->dwMsgBufferLen);
+                            pMsgBufferDesc->qwFileSize += pCurrMsg->dwMsgBufferLen;
                         }
                         /* print dropped messages */
                         if (dwMsgsDropped > 0)
                         {
                             oTmpMsgDesc.dwMsgLen = EcSnprintf(oTmpMsgDesc.szMsg, MAX_MESSAGE_SIZE - dwMsgOffset - 1, "buffer overflow, %d message(s) dropped, log incomplete\n", dwMsgsDropped);
                             FinalizeMsg(&oTmpMsgDesc);
-                            OsFwrite(oTmpMsgDesc.szMsgBuffer, oTmpMsgDesc.dwMsgLen, 1, pFileHandle);
+                            PrintFile(pFileHandle, oTmpMsgDesc.szMsgBuffer, dwMsgOffset + oTmpMsgDesc.dwMsgLen);
+                            pMsgBufferDesc->qwFileSize += dwMsgOffset + oTmpMsgDesc.dwMsgLen;
+                        }
+                    }
+                    if (EC_NULL != pFileHandle)
+                    {
+                        if (IsRotationDue(pMsgBufferDesc))
+                        {
+                            bRollOver = EC_TRUE;
                         }
                     }
-                    OsFflush(pFileHandle);
 #endif
                 }
             }
             pCurrMsg->bValid = EC_FALSE;
             OsMemoryBarrier();
-            dwNewNextPrint = pMsgBufferDesc->dwNextPrintMsgIndex + 1;
-            if (dwNewNextPrint >= pMsgBufferDesc->dwNumMsgs)
+            dwNewNextPrint = pSrcBuf->dwNextPrintMsgIndex + 1;
+            if (dwNewNextPrint >= pSrcBuf->dwNumMsgs)
             {
                 dwNewNextPrint = 0;
             }
-            pMsgBufferDesc->dwNextPrintMsgIndex = dwNewNextPrint;
+            pSrcBuf->dwNextPrintMsgIndex = dwNewNextPrint;
 
 #if (defined INCLUDE_FILE_LOGGING)
             if (bRollOver)
             {
-                /* do roll over */
-                OsFclose(pFileHandle);
+                /* do roll over, compression and retention are done by the compression task */
+                if (EC_NULL != pFileHandle)
+                {
+                    FlushFileBatch(pFileHandle);
+                    OsFclose(pFileHandle);
+                    QueueClosedFile(pMsgBufferDesc, pMsgBufferDesc->dwLogFileIndex);
+                }
+
+                pMsgBufferDesc->dwLogFileIndex++;
+                pMsgBufferDesc->wEntryCounter = 0;
+                pMsgBufferDesc->qwFileSize = 0;
+                pMsgBufferDesc->dwFileOpenTime = OsQueryMsecCount();
+                GetLogFileName(szfileNameTemp, sizeof(szfileNameTemp), pMsgBufferDesc->szMsgLogFileName, pMsgBufferDesc->szMsgLogFileExt,
+                    EC_TRUE, pMsgBufferDesc->dwLogFileIndex);
 
                 pFileHandle = OsFopen(szfileNameTemp, "w+");
                 if (pFileHandle == EC_NULL)
@@ -1652,7 +2622,7 @@ EC_T_VOID CAtEmLogging::ProcessMsgs
 #if (!defined NOPRINTF)
                     OsPrintf("ERROR: cannot create EtherCAT log file %s\n", szfileNameTemp);
 #endif
-                    OsSleep(3000);
+                    /* no OsSleep() here, the message buffers must still be drained */
                 }
 
                 pMsgBufferDesc->pfMsgFile = pFileHandle;
@@ -1661,6 +2631,10 @@ EC_T_VOID CAtEmLogging::ProcessMsgs
             }
 #endif /* INCLUDE_FILE_LOGGING */
         }
+#if (defined INCLUDE_FILE_LOGGING)
+        /* one write per pass, flushed once per wakeup by FlushFiles() */
+        FlushFileBatch(pFileHandle);
+#endif
     }
     if (bLocked)
         OsUnlock(m_poProcessMsgLock);
@@ -1686,105 +2660,490 @@ EC_T_DWORD  dwRes = EC_E_NOERROR;
 
 #if (defined INCLUDE_FILE_LOGGING)
 /********************************************************************************/
-/** \brief set log directory
+/** \brief Check if the log files of a buffer carry an index
 *
-* \return EC_E_NOERROR or EC_E_NOMEMORY if szLogDir too long
+* \return EC_TRUE if any roll over criterion is configured
 */
-EC_T_DWORD CAtEmLogging::SetLogDir(EC_T_CHAR* szLogDir)
+EC_T_BOOL CAtEmLogging::IsLogFileRotated(MSG_BUFFER_DESC* pMsgBufferDesc)
 {
-    if (OsStrlen(szLogDir) >= MAX_PATH_LEN)
-    {
-        return EC_E_NOMEMORY;
-    }
-    OsStrncpy(m_pchLogDir, szLogDir, MAX_PATH_LEN - 1);
-    m_pchLogDir[MAX_PATH_LEN - 1] = '\0';
-
-    return EC_E_NOERROR;
+    return (0 != pMsgBufferDesc->wEntryCounterLimit) || (0 != qwLogFileRotateSize) || (0 != dwLogFileRotateTime);
 }
-#endif /* INCLUDE_FILE_LOGGING */
 
-#ifdef INCLUDE_FRAME_SPY
-CFrameLogMultiplexer::CFrameLogMultiplexer()
+/********************************************************************************/
+/** \brief Build the name of a log file
+*
+* \return N/A
+*/
+EC_T_VOID CAtEmLogging::GetLogFileName(
+    EC_T_CHAR*       szFileName,
+    EC_T_DWORD       dwSize,
+    const EC_T_CHAR* szBaseName,
+    const EC_T_CHAR* szExt,
+    EC_T_BOOL        bIndexed,
+    EC_T_DWORD       dwIndex)
 {
-    m_pvLoggerListLock = OsCreateLock();
+    if (bIndexed)
+    {
+#ifdef FILESYS_8_3
+        OsSnprintf(szFileName, dwSize - 1, "%s_%03u.%s", szBaseName, dwIndex, szExt);
+#else
+        OsSnprintf(szFileName, dwSize - 1, "%s.%03u.%s", szBaseName, dwIndex, szExt);
+#endif
+    }
+    else
+    {
+        OsSnprintf(szFileName, dwSize - 1, "%s.%s", szBaseName, szExt);
+    }
 }
 
-CFrameLogMultiplexer::~CFrameLogMultiplexer()
+/********************************************************************************/
+/** \brief Check the size and time roll over criteria of the current log file
+*
+* \return EC_TRUE if a new log file shall be started
+*/
+EC_T_BOOL CAtEmLogging::IsRotationDue(MSG_BUFFER_DESC* pMsgBufferDesc)
 {
-    if (EC_NULL != m_pvLoggerListLock)
+    if ((0 != qwLogFileRotateSize) && (pMsgBufferDesc->qwFileSize >= qwLogFileRotateSize))
     {
-        OsLock(m_pvLoggerListLock);
-        for (CLoggerDescList::CNode* pNode = m_LoggerList.GetFirstNode(); EC_NULL != pNode; m_LoggerList.GetNext(pNode))
-        {
-            m_LoggerList.RemoveAt(pNode);
-        }
+        return EC_TRUE;
+    }
+    if ((0 != dwLogFileRotateTime) && ((EC_T_DWORD)(OsQueryMsecCount() - pMsgBufferDesc->dwFileOpenTime) >= dwLogFileRotateTime * 1000))
+    {
+        return EC_TRUE;
+    }
+    return EC_FALSE;
+}
 
-#if (defined INCLUDE_EC_SIMULATOR)
-        esLogFrameDisable(m_dwInstanceId);
-#elif (defined INCLUDE_EC_MONITOR)
-        emonLogFrameDisable(m_dwInstanceId);
-#elif (defined INCLUDE_EC_MASTER)
-        emLogFrameDisable(m_dwInstanceId);
-#endif
-        OsUnlock(m_pvLoggerListLock);
+static int CompareLogFileIndex(const void* pvLeft, const void* pvRight)
+{
+    EC_T_DWORD dwLeft  = *(const EC_T_DWORD*)pvLeft;
+    EC_T_DWORD dwRight = *(const EC_T_DWORD*)pvRight;
 
-        OsDeleteLock(m_pvLoggerListLock);
-    }
+    return (dwLeft < dwRight) ? -1 : ((dwLeft > dwRight) ? 1 : 0);
 }
 
 /********************************************************************************/
-/** \brief add logger to list
+/** \brief Find the indexed log files of a base name, compressed ones included
 *
-* \return N/A
+* The indices of up to dwMaxFiles files are stored in padwIndex, oldest (lowest index) first. A file found
+* both plain and compressed (during compression) is stored once. With padwIndex == EC_NULL the files are
+* only counted, a file found twice counts twice.
+*
+* \return number of files found, *pdwHighest is the highest index found
 */
-EC_T_VOID CFrameLogMultiplexer::AddFrameLogger(EC_T_DWORD dwInstanceId, EC_T_VOID* pvContext, EC_T_PFLOGFRAME_CB pvLogFrameCallBack)
+EC_T_DWORD CAtEmLogging::ScanLogFiles(
+    const EC_T_CHAR* szBaseName,
+    const EC_T_CHAR* szExt,
+    EC_T_DWORD*      padwIndex,
+    EC_T_DWORD       dwMaxFiles,
+    EC_T_DWORD*      pdwHighest)
 {
-    if (EC_NULL == G_aLogMultiplexer)
+    EC_T_DWORD dwFound = 0;
+
+    *pdwHighest = 0;
+#if (defined EC_VERSION_LINUX)
+    {
+        EC_T_CHAR        szDir[MAX_PATH_LEN] = ".";
+        const EC_T_CHAR* szPrefix = szBaseName;
+        const EC_T_CHAR* szSlash  = strrchr(szBaseName, '/');
+        EC_T_DWORD       dwPrefixLen = 0;
+        EC_T_DWORD       dwExtLen = (EC_T_DWORD)OsStrlen(szExt);
+        DIR*             pDir = EC_NULL;
+        struct dirent*   pEntry = EC_NULL;
+#ifdef FILESYS_8_3
+        const EC_T_CHAR  cSeparator = '_';
+#else
+        const EC_T_CHAR  cSeparator = '.';
+#endif
+
+        if (EC_NULL != szSlash)
+        {
+            EC_T_DWORD dwDirLen = EC_MIN((EC_T_DWORD)(szSlash - szBaseName), (EC_T_DWORD)(sizeof(szDir) - 1));
+
+            OsMemcpy(szDir, szBaseName, dwDirLen);
+            szDir[dwDirLen] = '\0';
+            if ('\0' == szDir[0])
+            {
+                OsStrncpy(szDir, "/", sizeof(szDir) - 1);
+            }
+            szPrefix = szSlash + 1;
+        }
+        dwPrefixLen = (EC_T_DWORD)OsStrlen(szPrefix);
+
+        pDir = opendir(szDir);
+        while ((EC_NULL != pDir) && (EC_NULL != (pEntry = readdir(pDir))))
+        {
+            const EC_T_CHAR* szPos = pEntry->d_name;
+            EC_T_CHAR*       szEnd = EC_NULL;
+            unsigned long    dwIndex = 0;
+
+            /* <prefix><separator><index>.<ext>[.gz] */
+            if ((0 != OsStrncmp(szPos, szPrefix, dwPrefixLen)) || (cSeparator != szPos[dwPrefixLen]) || !isdigit((unsigned char)szPos[dwPrefixLen + 1]))
+            {
+                continue;
+            }
+            dwIndex = strtoul(&szPos[dwPrefixLen + 1], &szEnd, 10);
+            if ((dwIndex > 0xFFFFFFFFUL) || ('.' != szEnd[0]) || (0 != OsStrncmp(&szEnd[1], szExt, dwExtLen))
+                || (('\0' != szEnd[1 + dwExtLen]) && (0 != OsStrcmp(&szEnd[1 + dwExtLen], ".gz"))))
+            {
+                continue;
+            }
+            if (EC_NULL == padwIndex)
+            {
+                dwFound++;
+            }
+            else if (dwFound < dwMaxFiles)
+            {
+                padwIndex[dwFound++] = (EC_T_DWORD)dwIndex;
+            }
+            if (dwIndex > *pdwHighest)
+            {
+                *pdwHighest = (EC_T_DWORD)dwIndex;
+            }
+        }
+        if (EC_NULL != pDir)
+        {
+            closedir(pDir);
+        }
+    }
+    if ((EC_NULL != padwIndex) && (dwFound > 1))
     {
-        if (EC_E_NOERROR != CreateInstances())
+        EC_T_DWORD dwIdx = 0;
+        EC_T_DWORD dwUnique = 1;
+
+        qsort(padwIndex, dwFound, sizeof(EC_T_DWORD), CompareLogFileIndex);
+        for (dwIdx = 1; dwIdx < dwFound; dwIdx++)
         {
-            return;
+            if (padwIndex[dwIdx] != padwIndex[dwUnique - 1])
+            {
+                padwIndex[dwUnique++] = padwIndex[dwIdx];
+            }
         }
-        G_bAutoDispose = EC_TRUE;
+        dwFound = dwUnique;
     }
-    G_aLogMultiplexer[dwInstanceId].AddFrameLogger(pvContext, pvLogFrameCallBack);
+#else
+    EC_UNREFPARM(szBaseName);
+    EC_UNREFPARM(szExt);
+    EC_UNREFPARM(padwIndex);
+    EC_UNREFPARM(dwMaxFiles);
+#endif
+    return dwFound;
 }
 
-EC_T_DWORD CFrameLogMultiplexer::CreateInstances(EC_T_VOID)
+/********************************************************************************/
+/** \brief Hand a closed log file over to the compression task
+*
+* Never blocks: if the queue is full or there is no compression task, the file is kept as is.
+*
+* \return N/A
+*/
+EC_T_VOID CAtEmLogging::QueueClosedFile(MSG_BUFFER_DESC* pMsgBufferDesc, EC_T_DWORD dwIndex)
 {
-    EC_T_DWORD dwLogMultiplexerIdx = 0;
+    EC_T_DWORD dwNextWr = 0;
 
-    if (EC_NULL != G_aLogMultiplexer)
+    if ((EC_NULL == m_pvCompressThreadObj) || (EC_NULL == m_poClosedFileLock))
     {
-        return EC_E_INVALIDSTATE;
+        return;
     }
-
-    G_aLogMultiplexer = EC_NEW(CFrameLogMultiplexer[MAX_NUMOF_MASTER_INSTANCES]);
-    if (EC_NULL == G_aLogMultiplexer)
+    OsLock(m_poClosedFileLock);
+    dwNextWr = (m_dwClosedFileWr + 1) % LOG_CLOSED_FILE_QUEUE_LEN;
+    if (dwNextWr != m_dwClosedFileRd)
     {
-        return EC_E_NOMEMORY;
-    }
+        LOG_CLOSED_FILE* pClosedFile = &m_aClosedFile[m_dwClosedFileWr];
 
-    for (dwLogMultiplexerIdx = 0; dwLogMultiplexerIdx < MAX_NUMOF_MASTER_INSTANCES; dwLogMultiplexerIdx++)
-    {
-        G_aLogMultiplexer[dwLogMultiplexerIdx].m_dwInstanceId = dwLogMultiplexerIdx;
+        OsStrncpy(pClosedFile->szBaseName, pMsgBufferDesc->szMsgLogFileName, MAX_PATH_LEN - 1);
+        pClosedFile->szBaseName[MAX_PATH_LEN - 1] = '\0';
+        OsStrncpy(pClosedFile->szExt, pMsgBufferDesc->szMsgLogFileExt, MAX_EXT_LEN - 1);
+        pClosedFile->szExt[MAX_EXT_LEN - 1] = '\0';
+        pClosedFile->dwIndex = dwIndex;
+        m_dwClosedFileWr = dwNextWr;
     }
+    OsUnlock(m_poClosedFileLock);
 
-    return EC_E_NOERROR;
+    OsSetEvent(m_pvCompressEvent);
 }
 
 /********************************************************************************/
-/** \brief search logger in list and remove
+/** \brief compression task
 *
 * \return N/A
 */
-EC_T_VOID CFrameLogMultiplexer::RemoveFrameLogger(EC_T_DWORD dwInstanceId, EC_T_VOID* pvContext, EC_T_PFLOGFRAME_CB pvLogFrameCallBack)
+EC_T_VOID CAtEmLogging::tCompressWrapper(EC_T_VOID* pvParm)
 {
-    if (EC_NULL != G_aLogMultiplexer)
-    {
-        G_aLogMultiplexer[dwInstanceId].RemoveFrameLogger(pvContext, pvLogFrameCallBack);
+    CAtEmLogging *pInst = (CAtEmLogging*)pvParm;
 
-        /* delete array if all multiplexers are unused */
+    OsDbgAssert(EC_NULL != pInst);
+    if (pInst)
+    {
+        pInst->tCompress();
+    }
+}
+
+/********************************************************************************/
+/** \brief compress and remove closed log files
+*
+* \return N/A
+*/
+EC_T_VOID CAtEmLogging::tCompress(EC_T_VOID)
+{
+#if (defined EC_VERSION_LINUX)
+    /* idle priority, compression must not delay the log task */
+    struct sched_param oSchedParam;
+    OsMemset(&oSchedParam, 0, sizeof(oSchedParam));
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &oSchedParam);
+#endif
+    m_bCompressTaskRunning = EC_TRUE;
+    for (;;)
+    {
+        LOG_CLOSED_FILE oClosedFile;
+        EC_T_BOOL       bFound = EC_FALSE;
+
+        OsLock(m_poClosedFileLock);
+        if (m_dwClosedFileRd != m_dwClosedFileWr)
+        {
+            OsMemcpy(&oClosedFile, &m_aClosedFile[m_dwClosedFileRd], sizeof(LOG_CLOSED_FILE));
+            m_dwClosedFileRd = (m_dwClosedFileRd + 1) % LOG_CLOSED_FILE_QUEUE_LEN;
+            bFound = EC_TRUE;
+        }
+        OsUnlock(m_poClosedFileLock);
+
+        if (bFound)
+        {
+            ProcessClosedFile(&oClosedFile);
+            continue;
+        }
+        if (m_bShutdownCompressTask)
+        {
+            break;
+        }
+        OsWaitForEvent(m_pvCompressEvent, 1000);
+    }
+    m_bCompressTaskRunning = EC_FALSE;
+}
+
+/********************************************************************************/
+/** \brief Compress a closed log file and apply the retention limit
+*
+* \return N/A
+*/
+EC_T_VOID CAtEmLogging::ProcessClosedFile(LOG_CLOSED_FILE* pClosedFile)
+{
+    EC_T_CHAR  szFileName[MAX_PATH_LEN];
+    EC_T_CHAR  szGzFileName[MAX_PATH_LEN + 3];
+    EC_T_DWORD dwIdx = 0;
+    EC_T_DWORD dwHighest = 0;
+    EC_T_DWORD dwNumFiles = 0;
+    EC_T_DWORD dwNumClosed = 0;
+    EC_T_DWORD* padwIndex = EC_NULL;
+
+    if (bLogFileCompress)
+    {
+        GetLogFileName(szFileName, sizeof(szFileName), pClosedFile->szBaseName, pClosedFile->szExt, EC_TRUE, pClosedFile->dwIndex);
+        if (!CompressLogFile(szFileName))
+        {
+#if (!defined NOPRINTF)
+            OsPrintf("ERROR: cannot compress EtherCAT log file %s\n", szFileName);
+#endif
+        }
+    }
+
+    /* keep the newest dwLogFileRetain closed files of those found on disk, remove the older ones: also those of
+       earlier runs, those missed by a full queue and those behind a gap in the indices */
+    if (0 == dwLogFileRetain)
+    {
+        return;
+    }
+    dwNumFiles = ScanLogFiles(pClosedFile->szBaseName, pClosedFile->szExt, EC_NULL, 0, &dwHighest);
+    if (dwNumFiles <= dwLogFileRetain)
+    {
+        return;
+    }
+    padwIndex = (EC_T_DWORD*)OsMalloc(dwNumFiles * sizeof(EC_T_DWORD));
+    if (EC_NULL == padwIndex)
+    {
+        return;
+    }
+    dwNumFiles = ScanLogFiles(pClosedFile->szBaseName, pClosedFile->szExt, padwIndex, dwNumFiles, &dwHighest);
+
+    /* files newer than the one just closed are still written or not processed yet */
+    while ((dwNumClosed < dwNumFiles) && (padwIndex[dwNumClosed] <= pClosedFile->dwIndex))
+    {
+        dwNumClosed++;
+    }
+    for (dwIdx = 0; dwIdx + dwLogFileRetain < dwNumClosed; dwIdx++)
+    {
+        GetLogFileName(szFileName, sizeof(szFileName), pClosedFile->szBaseName, pClosedFile->szExt, EC_TRUE, padwIndex[dwIdx]);
+        OsSnprintf(szGzFileName, sizeof(szGzFileName) - 1, "%s.gz", szFileName);
+        remove(szFileName);
+        remove(szGzFileName);
+    }
+    SafeOsFree(padwIndex);
+}
+
+/********************************************************************************/
+/** \brief gzip a file to <file>.gz and remove the original
+*
+* \return EC_TRUE on success
+*/
+EC_T_BOOL CAtEmLogging::CompressLogFile(const EC_T_CHAR* szFileName)
+{
+#if (defined INCLUDE_LOG_COMPRESSION)
+    EC_T_BOOL  bOk = EC_FALSE;
+    EC_T_CHAR  szTmpName[MAX_PATH_LEN + 8];
+    EC_T_CHAR  szGzName[MAX_PATH_LEN + 3];
+    EC_T_BYTE* pbyChunk = EC_NULL;
+    FILE*      pSrc = EC_NULL;
+    gzFile     pDst = EC_NULL;
+    size_t     nRead = 0;
+
+    OsSnprintf(szGzName, sizeof(szGzName) - 1, "%s.gz", szFileName);
+    OsSnprintf(szTmpName, sizeof(szTmpName) - 1, "%s.gz.tmp", szFileName);
+
+    pbyChunk = (EC_T_BYTE*)OsMalloc(LOG_COMPRESS_CHUNK_SIZE);
+    pSrc = (FILE*)OsFopen(szFileName, "rb");
+    pDst = gzopen(szTmpName, "wb6");
+    if ((EC_NULL == pbyChunk) || (EC_NULL == pSrc) || (EC_NULL == pDst))
+    {
+        goto Exit;
+    }
+    while ((nRead = fread(pbyChunk, 1, LOG_COMPRESS_CHUNK_SIZE, pSrc)) > 0)
+    {
+        if (gzwrite(pDst, pbyChunk, (unsigned)nRead) != (EC_T_INT)nRead)
+        {
+            goto Exit;
+        }
+    }
+    bOk = !ferror(pSrc);
+
+Exit:
+    if (EC_NULL != pDst)
+    {
+        bOk = (Z_OK == gzclose(pDst)) && bOk;
+    }
+    if (EC_NULL != pSrc)
+    {
+        OsFclose(pSrc);
+    }
+    SafeOsFree(pbyChunk);
+
+    /* publish atomically, the original is only removed once the archive is complete */
+    if (bOk && (0 == rename(szTmpName, szGzName)))
+    {
+        remove(szFileName);
+    }
+    else
+    {
+        remove(szTmpName);
+        bOk = EC_FALSE;
+    }
+    return bOk;
+#else
+    /* built without zlib: keep the file uncompressed */
+    EC_UNREFPARM(szFileName);
+    return EC_TRUE;
+#endif
+}
+
+/********************************************************************************/
+/** \brief set log directory
+*
+* \return EC_E_NOERROR or EC_E_NOMEMORY if szLogDir too long
+*/
+EC_T_DWORD CAtEmLogging::SetLogDir(EC_T_CHAR* szLogDir)
+{
+    if (OsStrlen(szLogDir) >= MAX_PATH_LEN)
+    {
+        return EC_E_NOMEMORY;
+    }
+    OsStrncpy(m_pchLogDir, szLogDir, MAX_PATH_LEN - 1);
+    m_pchLogDir[MAX_PATH_LEN - 1] = '\0';
+
+    return EC_E_NOERROR;
+}
+#endif /* INCLUDE_FILE_LOGGING */
+
+#ifdef INCLUDE_FRAME_SPY
+CFrameLogMultiplexer::CFrameLogMultiplexer()
+{
+    m_pvLoggerListLock = OsCreateLock();
+}
+
+CFrameLogMultiplexer::~CFrameLogMultiplexer()
+{
+    if (EC_NULL != m_pvLoggerListLock)
+    {
+        OsLock(m_pvLoggerListLock);
+        for (CLoggerDescList::CNode* pNode = m_LoggerList.GetFirstNode(); EC_NULL != pNode; m_LoggerList.GetNext(pNode))
+        {
+            m_LoggerList.RemoveAt(pNode);
+        }
+
+#if (defined INCLUDE_EC_SIMULATOR)
+        esLogFrameDisable(m_dwInstanceId);
+#elif (defined INCLUDE_EC_MONITOR)
+        emonLogFrameDisable(m_dwInstanceId);
+#elif (defined INCLUDE_EC_MASTER)
+        emLogFrameDisable(m_dwInstanceId);
+#endif
+        OsUnlock(m_pvLoggerListLock);
+
+        OsDeleteLock(m_pvLoggerListLock);
+    }
+}
+
+/********************************************************************************/
+/** \brief add logger to list
+*
+* \return N/A
+*/
+EC_T_VOID CFrameLogMultiplexer::AddFrameLogger(EC_T_DWORD dwInstanceId, EC_T_VOID* pvContext, EC_T_PFLOGFRAME_CB pvLogFrameCallBack)
+{
+    if (EC_NULL == G_aLogMultiplexer)
+    {
+        if (EC_E_NOERROR != CreateInstances())
+        {
+            return;
+        }
+        G_bAutoDispose = EC_TRUE;
+    }
+    G_aLogMultiplexer[dwInstanceId].AddFrameLogger(pvContext, pvLogFrameCallBack);
+}
+
+EC_T_DWORD CFrameLogMultiplexer::CreateInstances(EC_T_VOID)
+{
+    EC_T_DWORD dwLogMultiplexerIdx = 0;
+
+    if (EC_NULL != G_aLogMultiplexer)
+    {
+        return EC_E_INVALIDSTATE;
+    }
+
+    G_aLogMultiplexer = EC_NEW(CFrameLogMultiplexer[MAX_NUMOF_MASTER_INSTANCES]);
+    if (EC_NULL == G_aLogMultiplexer)
+    {
+        return EC_E_NOMEMORY;
+    }
+
+    for (dwLogMultiplexerIdx = 0; dwLogMultiplexerIdx < MAX_NUMOF_MASTER_INSTANCES; dwLogMultiplexerIdx++)
+    {
+        G_aLogMultiplexer[dwLogMultiplexerIdx].m_dwInstanceId = dwLogMultiplexerIdx;
+    }
+
+    return EC_E_NOERROR;
+}
+
+/********************************************************************************/
+/** \brief search logger in list and remove
+*
+* \return N/A
+*/
+EC_T_VOID CFrameLogMultiplexer::RemoveFrameLogger(EC_T_DWORD dwInstanceId, EC_T_VOID* pvContext, EC_T_PFLOGFRAME_CB pvLogFrameCallBack)
+{
+    if (EC_NULL != G_aLogMultiplexer)
+    {
+        G_aLogMultiplexer[dwInstanceId].RemoveFrameLogger(pvContext, pvLogFrameCallBack);
+
+        /* delete array if all multiplexers are unused */
         if (G_bAutoDispose)
         {
             for (EC_T_DWORD i = 0; i < MAX_NUMOF_MASTER_INSTANCES; i++)
@@ -1909,7 +3268,7 @@ CPcapRecorder::~CPcapRecorder()
         Uninstall();
     }
     Stop(15000);
-    FlushBuffer();
+    FlushBuffer(EC_TRUE);
     if (EC_NULL != m_pfHandle)
     {
         Close();
@@ -1921,8 +3280,6 @@ EC_T_DWORD CPcapRecorder::InitInstance(EC_T_DWORD dwInstanceId, EC_T_DWORD dwBuf
     EC_T_DWORD dwRes = EC_E_ERROR;
     EC_T_DWORD dwRetVal = EC_E_ERROR;
 
-    OsDbgAssert(ETHERNET_MAX_FRAME_LEN < ETHERNET_MAX_FRAMEBUF_LEN - sizeof(EC_T_LINK_FRAME_BUF_ENTRY_FRAME_DESC));
-
     if (0xffff != m_dwInstanceId)
     {
         return EC_E_INVALIDSTATE;
@@ -1980,45 +3337,309 @@ EC_T_VOID CPcapRecorder::Uninstall()
     }
 }
 
-EC_T_VOID CPcapFileBufferedWriter::FlushBuffer(EC_T_VOID)
+/********************************************************************************/
+/** \brief Allocate a capture ring of at least dwMinSize bytes
+*
+* The ring is mapped, pre-faulted and locked, so that capturing a frame never
+* takes a page fault or allocates memory.
+*
+* \return ring or EC_NULL, the size (a power of 2) is returned in pdwRingSize
+*/
+static EC_T_BYTE* PcapRingAlloc(EC_T_UINT64 qwMinSize, EC_T_DWORD* pdwRingSize)
 {
-    EC_T_LINK_FRAME_BUF_ENTRY Entry;
-    OsMemset(&Entry, 0, sizeof(EC_T_LINK_FRAME_BUF_ENTRY));
-    while (m_FrameBuffer.RemoveNoLock(Entry))
+    EC_T_BYTE* pbyRing = EC_NULL;
+    EC_T_DWORD dwRingSize = 0x10000;
+
+    while ((dwRingSize < qwMinSize) && (dwRingSize < 0x40000000))
     {
-        struct pcap_pkthdr FrameHeader;
-        OsMemset(&FrameHeader, 0, sizeof(struct pcap_pkthdr));
+        dwRingSize <<= 1;
+    }
+#if (defined EC_VERSION_LINUX)
+    pbyRing = (EC_T_BYTE*)mmap(EC_NULL, dwRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (MAP_FAILED == (EC_T_VOID*)pbyRing)
+    {
+        return EC_NULL;
+    }
+    /* may fail without CAP_IPC_LOCK, the pages are populated anyway */
+    mlock(pbyRing, dwRingSize);
+#else
+    pbyRing = (EC_T_BYTE*)OsMalloc(dwRingSize);
+    if (EC_NULL == pbyRing)
+    {
+        return EC_NULL;
+    }
+    OsMemset(pbyRing, 0, dwRingSize);
+#endif
+    *pdwRingSize = dwRingSize;
+    return pbyRing;
+}
 
-        FrameHeader.TimeStamp.dwSec = (EC_T_DWORD)(Entry.Desc.qwTimestamp / 1000000000);
-        FrameHeader.TimeStamp.dwUsec = (EC_T_DWORD)((Entry.Desc.qwTimestamp % 1000000000) / 1000);
+static EC_T_VOID PcapRingFree(EC_T_BYTE* pbyRing, EC_T_DWORD dwRingSize)
+{
+    if (EC_NULL == pbyRing)
+    {
+        return;
+    }
+#if (defined EC_VERSION_LINUX)
+    munmap(pbyRing, dwRingSize);
+#else
+    EC_UNREFPARM(dwRingSize);
+    OsFree(pbyRing);
+#endif
+}
 
-        FrameHeader.caplen = FrameHeader.len = Entry.Desc.dwSize;
-        WriteFrame(&FrameHeader, Entry.abyData);
+static EC_T_VOID PcapRingRead(EC_T_BYTE* pbyRing, EC_T_DWORD dwRingSize, EC_T_UINT64 qwPos, EC_T_VOID* pvDst, EC_T_DWORD dwLen)
+{
+    EC_T_DWORD dwOffs  = (EC_T_DWORD)(qwPos & (dwRingSize - 1));
+    EC_T_DWORD dwFirst = dwRingSize - dwOffs;
+
+    if (dwFirst >= dwLen)
+    {
+        OsMemcpy(pvDst, &pbyRing[dwOffs], dwLen);
+    }
+    else
+    {
+        OsMemcpy(pvDst, &pbyRing[dwOffs], dwFirst);
+        OsMemcpy((EC_T_BYTE*)pvDst + dwFirst, pbyRing, dwLen - dwFirst);
     }
 }
 
-EC_T_VOID CPcapFileBufferedWriter::AddFrame(EC_T_DWORD dwFrameSize, EC_T_BYTE* pbyFrame)
+static EC_T_VOID PcapRingWrite(EC_T_BYTE* pbyRing, EC_T_DWORD dwRingSize, EC_T_UINT64 qwPos, const EC_T_VOID* pvSrc, EC_T_DWORD dwLen)
 {
-    EC_T_LINK_FRAME_BUF_ENTRY Entry;
-    OsMemset(&Entry, 0, sizeof(EC_T_LINK_FRAME_BUF_ENTRY));
+    EC_T_DWORD dwOffs  = (EC_T_DWORD)(qwPos & (dwRingSize - 1));
+    EC_T_DWORD dwFirst = dwRingSize - dwOffs;
 
-    if ((EC_NULL == pbyFrame) || (0 == dwFrameSize)) return;
+    if (dwFirst >= dwLen)
+    {
+        OsMemcpy(&pbyRing[dwOffs], pvSrc, dwLen);
+    }
+    else
+    {
+        OsMemcpy(&pbyRing[dwOffs], pvSrc, dwFirst);
+        OsMemcpy(pbyRing, (const EC_T_BYTE*)pvSrc + dwFirst, dwLen - dwFirst);
+    }
+}
 
-    if (dwFrameSize > ETHERNET_MAX_FRAMEBUF_LEN - sizeof(EC_T_LINK_FRAME_BUF_ENTRY_FRAME_DESC)) return;
+/********************************************************************************/
+/** \brief Write the records [qwFrom, qwTo) of a capture ring to a file, at most two writes
+*
+* \return EC_TRUE on success
+*/
+static EC_T_BOOL PcapRingToFile(EC_T_BYTE* pbyRing, EC_T_DWORD dwRingSize, EC_T_UINT64 qwFrom, EC_T_UINT64 qwTo, FILE* pfHandle)
+{
+    EC_T_DWORD dwLen   = (EC_T_DWORD)(qwTo - qwFrom);
+    EC_T_DWORD dwOffs  = (EC_T_DWORD)(qwFrom & (dwRingSize - 1));
+    EC_T_DWORD dwFirst = dwRingSize - dwOffs;
+
+    if (dwFirst > dwLen)
+    {
+        dwFirst = dwLen;
+    }
+    if (dwFirst != OsFwrite(&pbyRing[dwOffs], 1, dwFirst, pfHandle))
+    {
+        return EC_FALSE;
+    }
+    if ((dwLen > dwFirst) && ((dwLen - dwFirst) != OsFwrite(pbyRing, 1, dwLen - dwFirst, pfHandle)))
+    {
+        return EC_FALSE;
+    }
+    return EC_TRUE;
+}
+
+CPcapFileBufferedWriter::~CPcapFileBufferedWriter()
+{
+    Close();
+    PcapRingFree(m_pbyRing, m_dwRingSize);
+    m_pbyRing = EC_NULL;
+    SafeOsDeleteLock(m_poCaptureLock);
+}
 
-    if (m_FrameBuffer.IsFull())
+EC_T_DWORD CPcapFileBufferedWriter::InitInstance(EC_T_DWORD dwBufCnt)
+{
+    if (EC_NULL != m_pbyRing)
+    {
+        return EC_E_INVALIDSTATE;
+    }
+    if (EC_NULL == m_poCaptureLock)
+    {
+        return EC_E_NOMEMORY;
+    }
+    m_pbyRing = PcapRingAlloc((EC_T_UINT64)dwBufCnt * (sizeof(struct pcap_pkthdr) + ETHERNET_MAX_FRAMEBUF_LEN), &m_dwRingSize);
+    if (EC_NULL == m_pbyRing)
+    {
+        return EC_E_NOMEMORY;
+    }
+    m_qwRingWr = 0;
+    m_qwRingRd = 0;
+    m_oStat.dwRingSize = m_dwRingSize;
+    m_dwLastWriteMsec = OsQueryMsecCount();
+
+    return EC_E_NOERROR;
+}
+
+EC_T_VOID CPcapFileBufferedWriter::RingRead(EC_T_UINT64 qwPos, EC_T_VOID* pvDst, EC_T_DWORD dwLen)
+{
+    PcapRingRead(m_pbyRing, m_dwRingSize, qwPos, pvDst, dwLen);
+}
+
+EC_T_VOID CPcapFileBufferedWriter::RingWrite(EC_T_UINT64 qwPos, const EC_T_VOID* pvSrc, EC_T_DWORD dwLen)
+{
+    PcapRingWrite(m_pbyRing, m_dwRingSize, qwPos, pvSrc, dwLen);
+}
+
+EC_T_BOOL CPcapFileBufferedWriter::WriteRingToFile(EC_T_UINT64 qwFrom, EC_T_UINT64 qwTo)
+{
+    if ((qwFrom == qwTo) || (EC_NULL == m_pfHandle))
+    {
+        return EC_TRUE;
+    }
+    if (!PcapRingToFile(m_pbyRing, m_dwRingSize, qwFrom, qwTo, m_pfHandle))
+    {
+        return EC_FALSE;
+    }
+    m_oStat.qwWriteCnt++;
+    m_oStat.qwWriteByteCnt += qwTo - qwFrom;
+
+    return EC_TRUE;
+}
+
+EC_T_VOID CPcapFileBufferedWriter::FlushBuffer(EC_T_BOOL bForce)
+{
+    EC_T_UINT64 qwRd     = m_qwRingRd;
+    EC_T_UINT64 qwWr     = 0;
+    EC_T_UINT64 qwPos    = 0;
+    EC_T_UINT64 qwChunk  = 0;
+    EC_T_DWORD  dwNow    = OsQueryMsecCount();
+    EC_T_UINT64 qwDrops  = 0;
+    EC_T_DWORD  dwBatch  = PCAP_WRITE_BATCH_SIZE;
+
+    if (EC_NULL == m_pbyRing)
     {
-        EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "CPcapRecorder overflow!"));
         return;
     }
-    OsMemcpy(Entry.abyData, pbyFrame, dwFrameSize);
+    /* a small ring must not fill up while waiting for a batch */
+    if (dwBatch > m_dwRingSize / 4)
+    {
+        dwBatch = m_dwRingSize / 4;
+    }
+    qwWr = m_qwRingWr;
+    __sync_synchronize();
+
+    if (qwWr == qwRd)
+    {
+        m_dwLastWriteMsec = dwNow;
+    }
+    else if (bForce || (qwWr - qwRd >= dwBatch) || ((EC_T_DWORD)(dwNow - m_dwLastWriteMsec) >= PCAP_WRITE_MAX_DELAY))
+    {
+        /* walk the records only to split the batch at a file rotation */
+        for (qwPos = qwRd, qwChunk = qwRd; qwPos < qwWr; )
+        {
+            struct pcap_pkthdr FrameHeader;
+
+            RingRead(qwPos, &FrameHeader, sizeof(struct pcap_pkthdr));
+            if (IsRotationNeeded(&FrameHeader))
+            {
+                WriteRingToFile(qwChunk, qwPos);
+                Rotate();
+                qwChunk = qwPos;
+            }
+            m_RotationDesc.qwFileSize += sizeof(struct pcap_pkthdr) + FrameHeader.caplen;
+            m_RotationDesc.dwFrameCnt++;
+            qwPos += sizeof(struct pcap_pkthdr) + FrameHeader.caplen;
+        }
+        WriteRingToFile(qwChunk, qwWr);
+        if (EC_NULL != m_pfHandle)
+        {
+            OsFflush(m_pfHandle);
+        }
+
+        /* release the space to the frame sources */
+        __sync_synchronize();
+        m_qwRingRd = qwWr;
+        m_dwLastWriteMsec = dwNow;
+    }
+
+    /* drops are reported here, the capture path must not log */
+    qwDrops = m_oStat.qwDropFrameCnt;
+    if (qwDrops != m_qwReportedDrops)
+    {
+        EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "CPcapRecorder overflow: %llu frames dropped (%llu total), capture ring %u bytes\n",
+            qwDrops - m_qwReportedDrops, qwDrops, m_dwRingSize));
+        m_qwReportedDrops = qwDrops;
+    }
+}
+
+EC_T_BOOL CPcapFileBufferedWriter::AddFrame(EC_T_DWORD dwFrameSize, EC_T_BYTE* pbyFrame)
+{
+    struct pcap_pkthdr FrameHeader;
+    EC_T_UINT64 qwTimestamp = 0;
+    EC_T_UINT64 qwWr = 0;
+    EC_T_UINT64 qwLevel = 0;
+    EC_T_DWORD  dwRecLen = (EC_T_DWORD)sizeof(struct pcap_pkthdr) + dwFrameSize;
+    EC_T_BOOL   bRetVal = EC_FALSE;
+
+    if ((EC_NULL == pbyFrame) || (0 == dwFrameSize) || (EC_NULL == m_pbyRing)) return EC_FALSE;
 
-    SetFrameTimestamp(&Entry.Desc.qwTimestamp);
+    if (dwFrameSize > ETHERNET_MAX_FRAMEBUF_LEN) return EC_FALSE;
+
+    OsLock(m_poCaptureLock);
+    qwWr = m_qwRingWr;
+    qwLevel = qwWr - m_qwRingRd;
+    if (qwLevel + dwRecLen > m_dwRingSize)
+    {
+        m_oStat.qwDropFrameCnt++;
+        m_oStat.qwDropByteCnt += dwFrameSize;
+        m_dwCycleDrops++;
+        goto Exit;
+    }
+    SetFrameTimestamp(&qwTimestamp);
 
     /* CRC should be already stripped off */
-    Entry.Desc.dwSize = dwFrameSize;
-    OsDbgAssert(0 != dwFrameSize);
-    m_FrameBuffer.Add(Entry);
+    FrameHeader.TimeStamp.dwSec = (EC_T_DWORD)(qwTimestamp / 1000000000);
+    FrameHeader.TimeStamp.dwUsec = (EC_T_DWORD)((qwTimestamp % 1000000000) / 1000);
+    FrameHeader.caplen = FrameHeader.len = dwFrameSize;
+
+    RingWrite(qwWr, &FrameHeader, sizeof(struct pcap_pkthdr));
+    RingWrite(qwWr + sizeof(struct pcap_pkthdr), pbyFrame, dwFrameSize);
+
+    /* publish the record to the writer thread */
+    __sync_synchronize();
+    m_qwRingWr = qwWr + dwRecLen;
+
+    m_oStat.qwFrameCnt++;
+    if (qwLevel + dwRecLen > m_oStat.dwMaxRingLevel)
+    {
+        m_oStat.dwMaxRingLevel = (EC_T_DWORD)(qwLevel + dwRecLen);
+    }
+    bRetVal = EC_TRUE;
+
+Exit:
+    OsUnlock(m_poCaptureLock);
+    return bRetVal;
+}
+
+EC_T_VOID CPcapFileBufferedWriter::EndCycle(EC_T_VOID)
+{
+    OsLock(m_poCaptureLock);
+    m_oStat.dwCycleCnt++;
+    m_oStat.dwLastCycleDrops = m_dwCycleDrops;
+    if (0 != m_dwCycleDrops)
+    {
+        m_oStat.dwDropCycleCnt++;
+        if (m_dwCycleDrops > m_oStat.dwMaxCycleDrops)
+        {
+            m_oStat.dwMaxCycleDrops = m_dwCycleDrops;
+        }
+    }
+    m_dwCycleDrops = 0;
+    OsUnlock(m_poCaptureLock);
+}
+
+EC_T_VOID CPcapFileBufferedWriter::GetCaptureStat(EC_T_PCAP_CAPTURE_STAT* pStat)
+{
+    OsLock(m_poCaptureLock);
+    OsMemcpy(pStat, &m_oStat, sizeof(EC_T_PCAP_CAPTURE_STAT));
+    OsUnlock(m_poCaptureLock);
 }
 
 EC_T_VOID CPcapFileBufferedWriter::SetFrameTimestamp(EC_T_UINT64* pqwTimestamp)
@@ -2060,36 +3681,273 @@ EC_T_VOID CPcapFileBufferedWriter::SetFrameTimestamp(EC_T_UINT64* pqwTimestamp)
 
 EC_T_VOID CPcapRecorder::LogFrame(EC_T_DWORD dwLogFrameFlags, EC_T_DWORD dwFrameSize, EC_T_BYTE* pbyFrame)
 {
-    EC_T_LINK_FRAME_BUF_ENTRY Entry;
-    OsMemset(&Entry, 0, sizeof(EC_T_LINK_FRAME_BUF_ENTRY));
+    if (!AddFrame(dwFrameSize, pbyFrame)) return;
+
+    m_nLoggedFrameCount++;
+
+    EcLogMsg(EC_LOG_LEVEL_VERBOSE_CYC, (pEcLogContext, EC_LOG_LEVEL_VERBOSE_CYC, "%d: CPcapRecorder::LogFrame(%s%s%s %s): frame %d, %d bytes\n",
+        m_dwInstanceId, (m_szFileName ? m_szFileName : ""), (m_szFileName ? " " : ""),
+        ((0 != (dwLogFrameFlags & EC_LOG_FRAME_FLAG_RED_FRAME)) ? "RED" : "MAIN"),
+                      ((0 != (dwLogFrameFlags & EC_LOG_FRAME_FLAG_RX_FRAME)) ? "RX" : "TX"),
+        m_nLoggedFrameCount, dwFrameSize));
+}
+#endif /* INCLUDE_PCAP_RECORDER */
+
+#if (defined INCLUDE_FLIGHT_RECORDER)
+/********************************************************************************/
+/** \brief Wall clock time of a captured frame
+*
+* \return [ns] since 1970
+*/
+static EC_T_UINT64 FlightRecorderTime(EC_T_VOID)
+{
+#if (defined EC_VERSION_LINUX)
+    struct timespec oTime;
+    clock_gettime(CLOCK_REALTIME, &oTime);
+    return (EC_T_UINT64)oTime.tv_sec * 1000000000 + (EC_T_UINT64)oTime.tv_nsec;
+#else
+    EC_T_UINT64 qwTime = 0;
+    OsSystemTimeGet(&qwTime);
+    return qwTime;
+#endif
+}
+
+CFlightRecorder::CFlightRecorder(EC_T_CPUSET cpuAffinity, EC_T_DWORD dwPrio, EC_T_DWORD dwStackSize)
+    : m_pbyRing(EC_NULL), m_dwRingSize(0), m_qwRingWr(0), m_qwRingOldest(0), m_poLock(EC_NULL), m_dwInstanceId(0xffff), m_szFilePrefix(EC_NULL)
+    , m_dwPreTriggerMsec(0), m_dwPostTriggerMsec(0), m_cpuAffinity(cpuAffinity), m_dwPrio(dwPrio), m_dwStackSize(dwStackSize)
+    , m_eState(eFlightRecorderState_Armed), m_szTriggerReason(EC_NULL), m_qwTriggerTime(0), m_dwTriggerMsec(0), m_dwLastDumpMsec(0)
+    , m_dwTriggerCnt(0), m_dwSuppressedCnt(0), m_dwDumpCnt(0), m_dwFrozenDropCnt(0)
+{
+    m_poLock = OsCreateLock();
+}
+
+CFlightRecorder::~CFlightRecorder()
+{
+    Uninstall();
+    Stop(15000);
+
+    /* a problem right before shutdown is worth a dump */
+    if (eFlightRecorderState_Triggered == m_eState)
+    {
+        m_eState = eFlightRecorderState_Frozen;
+        DumpWindow();
+    }
+    PcapRingFree(m_pbyRing, m_dwRingSize);
+    m_pbyRing = EC_NULL;
+    SafeOsFree(m_szFilePrefix);
+    SafeOsDeleteLock(m_poLock);
+}
+
+EC_T_DWORD CFlightRecorder::InitInstance(EC_T_DWORD dwInstanceId, EC_T_DWORD dwRingSize, EC_T_DWORD dwPreTriggerMsec, EC_T_DWORD dwPostTriggerMsec, const EC_T_CHAR* szFilePrefix)
+{
+    EC_T_DWORD dwRetVal = EC_E_ERROR;
+
+    if ((EC_NULL != m_pbyRing) || (dwInstanceId >= MAX_NUMOF_MASTER_INSTANCES))
+    {
+        dwRetVal = EC_E_INVALIDSTATE;
+        goto Exit;
+    }
+    if ((EC_NULL == szFilePrefix) || (0 == OsStrlen(szFilePrefix)))
+    {
+        dwRetVal = EC_E_INVALIDPARM;
+        goto Exit;
+    }
+    m_szFilePrefix = (EC_T_CHAR*)OsMalloc(OsStrlen(szFilePrefix) + 1);
+    m_pbyRing = PcapRingAlloc(dwRingSize, &m_dwRingSize);
+    if ((EC_NULL == m_poLock) || (EC_NULL == m_szFilePrefix) || (EC_NULL == m_pbyRing))
+    {
+        dwRetVal = EC_E_NOMEMORY;
+        goto Exit;
+    }
+    OsStrcpy(m_szFilePrefix, szFilePrefix);
+    m_dwPreTriggerMsec = dwPreTriggerMsec;
+    m_dwPostTriggerMsec = dwPostTriggerMsec;
+    m_dwInstanceId = dwInstanceId;
+
+    dwRetVal = Start(GetLogParms(), ThreadStep, (EC_T_VOID*)this, "tFlightRec", m_cpuAffinity, m_dwPrio, m_dwStackSize, 15000);
+    if (EC_E_NOERROR != dwRetVal)
+    {
+        goto Exit;
+    }
+    CFrameLogMultiplexer::AddFrameLogger(m_dwInstanceId, (EC_T_VOID*)this, LogFrameStatic);
+
+    dwRetVal = EC_E_NOERROR;
+Exit:
+    return dwRetVal;
+}
+
+EC_T_VOID CFlightRecorder::Uninstall(EC_T_VOID)
+{
+    if ((0xffff != m_dwInstanceId) && (EC_NULL != m_pbyRing))
+    {
+        CFrameLogMultiplexer::RemoveFrameLogger(m_dwInstanceId, (EC_T_VOID*)this, LogFrameStatic);
+    }
+}
+
+EC_T_BOOL CFlightRecorder::Trigger(const EC_T_CHAR* szReason)
+{
+    EC_T_BOOL  bRetVal = EC_FALSE;
+    EC_T_DWORD dwNow = OsQueryMsecCount();
+
+    if (EC_NULL == m_pbyRing)
+    {
+        return EC_FALSE;
+    }
+    OsLock(m_poLock);
+    /* hold-off: a trigger storm (e.g. a WKC error every cycle) must not dump the same window over and over */
+    if ((eFlightRecorderState_Armed != m_eState) || ((0 != m_dwDumpCnt) && ((EC_T_DWORD)(dwNow - m_dwLastDumpMsec) < m_dwPreTriggerMsec)))
+    {
+        m_dwSuppressedCnt++;
+    }
+    else
+    {
+        m_szTriggerReason = szReason;
+        m_qwTriggerTime = FlightRecorderTime();
+        m_dwTriggerMsec = dwNow;
+        m_dwTriggerCnt++;
+        m_eState = eFlightRecorderState_Triggered;
+        bRetVal = EC_TRUE;
+    }
+    OsUnlock(m_poLock);
+
+    return bRetVal;
+}
+
+EC_T_VOID CFlightRecorder::LogFrame(EC_T_DWORD dwLogFlags, EC_T_DWORD dwFrameSize, EC_T_BYTE* pbyFrame)
+{
+    struct pcap_pkthdr FrameHeader;
+    EC_T_UINT64 qwTime = 0;
+    EC_T_DWORD  dwRecLen = (EC_T_DWORD)sizeof(struct pcap_pkthdr) + dwFrameSize;
 
-    if ((EC_NULL == pbyFrame) || (0 == dwFrameSize)) return;
+    EC_UNREFPARM(dwLogFlags);
+    if ((EC_NULL == pbyFrame) || (0 == dwFrameSize) || (EC_NULL == m_pbyRing) || (dwRecLen > m_dwRingSize)) return;
 
-    if (dwFrameSize > ETHERNET_MAX_FRAMEBUF_LEN - sizeof(EC_T_LINK_FRAME_BUF_ENTRY_FRAME_DESC)) return;
+    OsLock(m_poLock);
+    if (eFlightRecorderState_Frozen == m_eState)
+    {
+        m_dwFrozenDropCnt++;
+        goto Exit;
+    }
+    qwTime = FlightRecorderTime();
+    FrameHeader.TimeStamp.dwSec = (EC_T_DWORD)(qwTime / 1000000000);
+    FrameHeader.TimeStamp.dwUsec = (EC_T_DWORD)((qwTime % 1000000000) / 1000);
+    FrameHeader.caplen = FrameHeader.len = dwFrameSize;
+
+    /* overwrite the oldest records */
+    while (m_qwRingWr + dwRecLen - m_qwRingOldest > m_dwRingSize)
+    {
+        struct pcap_pkthdr OldHeader;
+
+        PcapRingRead(m_pbyRing, m_dwRingSize, m_qwRingOldest, &OldHeader, sizeof(struct pcap_pkthdr));
+        m_qwRingOldest += sizeof(struct pcap_pkthdr) + OldHeader.caplen;
+    }
+    PcapRingWrite(m_pbyRing, m_dwRingSize, m_qwRingWr, &FrameHeader, sizeof(struct pcap_pkthdr));
+    PcapRingWrite(m_pbyRing, m_dwRingSize, m_qwRingWr + sizeof(struct pcap_pkthdr), pbyFrame, dwFrameSize);
+    m_qwRingWr += dwRecLen;
 
-    if (m_FrameBuffer.IsFull())
+Exit:
+    OsUnlock(m_poLock);
+}
+
+EC_T_VOID CFlightRecorder::ProcessTrigger(EC_T_VOID)
+{
+    if (eFlightRecorderState_Triggered != m_eState)
+    {
+        return;
+    }
+    if ((EC_T_DWORD)(OsQueryMsecCount() - m_dwTriggerMsec) < m_dwPostTriggerMsec)
     {
-        EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "CPcapRecorder overflow!"));
         return;
     }
+    OsLock(m_poLock);
+    m_eState = eFlightRecorderState_Frozen;
+    OsUnlock(m_poLock);
 
-    m_nLoggedFrameCount++;
-    OsMemcpy(Entry.abyData, pbyFrame, dwFrameSize);
+    DumpWindow();
 
-    SetFrameTimestamp(&Entry.Desc.qwTimestamp);
+    /* the ring is kept, frames before the next trigger stay available */
+    OsLock(m_poLock);
+    m_dwLastDumpMsec = OsQueryMsecCount();
+    m_eState = eFlightRecorderState_Armed;
+    OsUnlock(m_poLock);
+}
 
-    /* CRC should be already stripped off */
-    Entry.Desc.dwSize = dwFrameSize;
-    OsDbgAssert(0 != dwFrameSize);
-    m_FrameBuffer.Add(Entry);
+/********************************************************************************/
+/** \brief Write the frozen window to <prefix>.<date>-<time>.<reason>.pcap
+*
+* \return N/A
+*/
+EC_T_VOID CFlightRecorder::DumpWindow(EC_T_VOID)
+{
+    EC_T_CHAR   szFileName[MAX_PATH_LEN];
+    EC_T_UINT64 qwFirstTime = 0;
+    EC_T_UINT64 qwStart = 0;
+    EC_T_UINT64 qwPos = 0;
+    EC_T_DWORD  dwFrameCnt = 0;
+    EC_T_BOOL   bOk = EC_FALSE;
 
-    EcLogMsg(EC_LOG_LEVEL_VERBOSE_CYC, (pEcLogContext, EC_LOG_LEVEL_VERBOSE_CYC, "%d: CPcapRecorder::LogFrame(%s%s%s %s): frame %d, %d bytes\n",
-        m_dwInstanceId, (m_szFileName ? m_szFileName : ""), (m_szFileName ? " " : ""),
-        ((0 != (dwLogFrameFlags & EC_LOG_FRAME_FLAG_RED_FRAME)) ? "RED" : "MAIN"),
-                      ((0 != (dwLogFrameFlags & EC_LOG_FRAME_FLAG_RX_FRAME)) ? "RX" : "TX"),
-        m_nLoggedFrameCount, dwFrameSize));
+    /* skip frames older than the pre-trigger window */
+    if (m_qwTriggerTime > (EC_T_UINT64)m_dwPreTriggerMsec * 1000000)
+    {
+        qwFirstTime = m_qwTriggerTime - (EC_T_UINT64)m_dwPreTriggerMsec * 1000000;
+    }
+    for (qwPos = m_qwRingOldest, qwStart = m_qwRingWr; qwPos < m_qwRingWr; )
+    {
+        struct pcap_pkthdr FrameHeader;
+
+        PcapRingRead(m_pbyRing, m_dwRingSize, qwPos, &FrameHeader, sizeof(struct pcap_pkthdr));
+        if ((qwStart == m_qwRingWr) && ((EC_T_UINT64)FrameHeader.TimeStamp.dwSec * 1000000000 + (EC_T_UINT64)FrameHeader.TimeStamp.dwUsec * 1000 >= qwFirstTime))
+        {
+            qwStart = qwPos;
+        }
+        if (qwStart != m_qwRingWr)
+        {
+            dwFrameCnt++;
+        }
+        qwPos += sizeof(struct pcap_pkthdr) + FrameHeader.caplen;
+    }
+
+#if (defined EC_VERSION_LINUX)
+    {
+        time_t    tTrigger = (time_t)(m_qwTriggerTime / 1000000000);
+        struct tm oTrigger;
+
+        localtime_r(&tTrigger, &oTrigger);
+        OsSnprintf(szFileName, sizeof(szFileName) - 1, "%s.%04d%02d%02d-%02d%02d%02d.%s.pcap", m_szFilePrefix,
+            oTrigger.tm_year + 1900, oTrigger.tm_mon + 1, oTrigger.tm_mday, oTrigger.tm_hour, oTrigger.tm_min, oTrigger.tm_sec, m_szTriggerReason);
+    }
+#else
+    OsSnprintf(szFileName, sizeof(szFileName) - 1, "%s.%05d.%s.pcap", m_szFilePrefix, m_dwDumpCnt, m_szTriggerReason);
+#endif
+
+    m_pfHandle = OsFopen(szFileName, "wb");
+    if (EC_NULL != m_pfHandle)
+    {
+        m_FileHeader.magic = 0xa1b2c3d4;
+        m_FileHeader.version_major = 2;
+        m_FileHeader.version_minor = 4;
+        m_FileHeader.thiszone = 0;
+        m_FileHeader.sigfigs = 0;
+        m_FileHeader.snaplen = 65535;
+        m_FileHeader.linktype = 1;
+
+        bOk = (1 == OsFwrite(&m_FileHeader, sizeof(struct pcap_file_header), 1, m_pfHandle))
+            && PcapRingToFile(m_pbyRing, m_dwRingSize, qwStart, m_qwRingWr, m_pfHandle);
+        CPcapFileProcessor::Close();
+    }
+    m_dwDumpCnt++;
+
+    if (bOk)
+    {
+        EcLogMsg(EC_LOG_LEVEL_WARNING, (pEcLogContext, EC_LOG_LEVEL_WARNING, "Flight recorder (%s): %d frames, %d ms before and %d ms after the trigger, dumped to %s\n",
+            m_szTriggerReason, dwFrameCnt, m_dwPreTriggerMsec, m_dwPostTriggerMsec, szFileName));
+    }
+    else
+    {
+        EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "Flight recorder (%s): cannot write %s\n", m_szTriggerReason, szFileName));
+    }
 }
-#endif /* INCLUDE_PCAP_RECORDER */
+#endif /* INCLUDE_FLIGHT_RECORDER */
 
 #if (defined INCLUDE_PCAP_READER)
 CPcapFileReader::CPcapFileReader()
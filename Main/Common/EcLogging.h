@@ -30,8 +30,16 @@ extern struct _EC_T_LOG_PARMS G_aLogParms[];
 #define INCLUDE_FRAME_SPY
 #endif
 
+#if (!defined INCLUDE_PCAP_RECORDER) && (!defined EXCLUDE_PCAP_RECORDER)
+#define INCLUDE_PCAP_RECORDER
+#endif
+
+#if (defined INCLUDE_PCAP_RECORDER) && (!defined INCLUDE_FLIGHT_RECORDER) && (!defined EXCLUDE_FLIGHT_RECORDER)
+#define INCLUDE_FLIGHT_RECORDER
+#endif
+
 #if (!defined INCLUDE_FILE_LOGGING) && (!defined EXCLUDE_FILE_LOGGING)
-//#define INCLUDE_FILE_LOGGING  //! 屏蔽文件日志 by think 2023.12.2
+#define INCLUDE_FILE_LOGGING
 #endif
 
 #if (!defined NO_OS)
@@ -108,6 +116,7 @@ extern struct _EC_T_LOG_PARMS G_aLogParms[];
 #endif
 #define DEFAULT_ERR_MSG_BUFFER_SIZE   500 /* number of buffered messages */
 #define DEFAULT_DCM_MSG_BUFFER_SIZE  1000 /* number of buffered messages */
+#define DEFAULT_PRODUCER_MSG_BUFFER_SIZE 128 /* number of buffered messages per producer ring */
 
 #else
 
@@ -115,6 +124,7 @@ extern struct _EC_T_LOG_PARMS G_aLogParms[];
 #define DEFAULT_LOG_MSG_BUFFER_SIZE    30 /* number of buffered messages */
 #define DEFAULT_ERR_MSG_BUFFER_SIZE    20 /* number of buffered messages */
 #define DEFAULT_DCM_MSG_BUFFER_SIZE    20 /* number of buffered messages */
+#define DEFAULT_PRODUCER_MSG_BUFFER_SIZE 8 /* number of buffered messages per producer ring */
 
 #endif /* !(defined EC_DEMO_TINY) */
 
@@ -145,20 +155,66 @@ extern struct _EC_T_LOG_PARMS G_aLogParms[];
 
 /*-GLOBAL VARIABLES-----------------------------------------------------------*/
 #if (defined INCLUDE_FILE_LOGGING)
-extern EC_T_BOOL bLogFileEnb;
+extern EC_T_BOOL   bLogFileEnb;
+extern EC_T_UINT64 qwLogFileRotateSize;     /* [byte] start a new log file at this size, 0: off */
+extern EC_T_DWORD  dwLogFileRotateTime;     /* [s] start a new log file after this time, 0: off */
+extern EC_T_DWORD  dwLogFileRetain;         /* number of closed log files kept, 0: all */
+extern EC_T_BOOL   bLogFileCompress;        /* gzip closed log files (INCLUDE_LOG_COMPRESSION) */
 #endif
 extern EC_T_LOG_PARMS G_aLogParms[MAX_NUMOF_LOG_INSTANCES];
 
 /*-TYPEDEFS------------------------------------------------------------------*/
+#if (defined INCLUDE_FILE_LOGGING)
+/* closed log file handed over to the compression task */
+#define LOG_CLOSED_FILE_QUEUE_LEN      16
+
+typedef struct _LOG_CLOSED_FILE
+{
+    EC_T_CHAR   szBaseName[MAX_PATH_LEN];       /* log file name without index and extension */
+    EC_T_CHAR   szExt[MAX_EXT_LEN];
+    EC_T_DWORD  dwIndex;                        /* index of the closed file */
+} LOG_CLOSED_FILE;
+#endif
+
+/* per-producer message rings */
+#define LOG_MAX_PRODUCERS              16 /* threads with an own ring, further threads share the buffer's ring */
+#define LOG_NO_PRODUCER        0xFFFFFFFF
+
+/* log task wakeup and console batching */
+#define LOG_WAKEUP_WATERMARK_DEFAULT   25 /* wake up the log task if a buffer is filled by this percentage */
+#define LOG_IDLE_TIMEOUT_DEFAULT       20 /* [ms] process messages below the watermark at the latest after this time */
+#define LOG_CONSOLE_BATCH_SIZE      65536 /* console output gathered per log task pass */
+#define LOG_CONSOLE_MAX_SEGMENTS       16 /* one segment per message buffer */
+#define LOG_FILE_BATCH_SIZE         65536 /* file output of a message buffer gathered per log task pass */
+
+/* binary logging: the caller stores the raw arguments, the log task formats the message */
+#define LOG_BIN_MAX_ARGS               16 /* maximum number of arguments */
+#define LOG_BIN_MAX_SPEC               16 /* maximum length of a conversion specification */
+#define LOG_BIN_ARG_INT                 1 /* signed integer, stored as 64 bit */
+#define LOG_BIN_ARG_UINT                2 /* unsigned integer, stored as 64 bit */
+#define LOG_BIN_ARG_STR                 3 /* offset of the copied string in achStr */
+
+typedef struct _LOG_BIN_MSG
+{
+    EC_T_WORD   wArgCnt;                        /* number of stored arguments */
+    EC_T_WORD   wStrLen;                        /* bytes used in achStr */
+    EC_T_BYTE   abyType[LOG_BIN_MAX_ARGS];      /* LOG_BIN_ARG_... */
+    EC_T_UINT64 aqwArg[LOG_BIN_MAX_ARGS];       /* integer or string offset */
+    EC_T_CHAR   achStr[1];                      /* copied string arguments, up to the end of the message slot */
+} LOG_BIN_MSG;
+
 typedef struct _LOG_MSG_DESC
 {
     EC_T_BOOL  bValid;                /* entry is valid */
     EC_T_DWORD dwSeverity;            /* logging severity */
+    const
+    EC_T_CHAR* szFormat;              /* != EC_NULL: szMsg holds a LOG_BIN_MSG still to be formatted with this format */
     EC_T_CHAR* szMsg;                 /* message without timestamp, format "...\n"  */
     EC_T_DWORD dwMsgLen;              /* message without timestamp length */
     EC_T_CHAR* szMsgBuffer;           /* message with timestamp, format "%10d: ...\n" */
     EC_T_DWORD dwMsgBufferLen;        /* message with timestamp length */
     EC_T_DWORD dwMsgTimestamp;        /* timestamp values */
+    EC_T_UINT64 qwMsgOrder;           /* [ns] monotonic time, order of messages of different producers */
     EC_T_DWORD dwMsgThreadId;         /* threadId values */
     EC_T_DWORD dwMsgsDropped;         /* count of new messages denied to insert after this message, because no empty message buffer available */
 } LOG_MSG_DESC;
@@ -172,18 +228,20 @@ typedef struct _MSG_BUFFER_DESC
     EC_T_DWORD  dwNextEmptyMsgIndex;            /* index of next empty message buffer */
     EC_T_DWORD  dwNextPrintMsgIndex;            /* index of next message buffer to print */
     EC_T_DWORD  dwDropReportMsgIndex;           /* index message to report buffer full */
+    EC_T_DWORD  dwMsgsDropped;                  /* producer rings: messages denied because the ring was full, atomic, reset by the log task */
     EC_T_CHAR   szMsgLogFileName[MAX_PATH_LEN]; /* message log file name */
     EC_T_CHAR   szMsgLogFileExt[4];             /* message log file extension */
 #if (defined INCLUDE_FILE_LOGGING)
     FILE*       pfMsgFile;                      /* file pointer for message log file */
+    EC_T_UINT64 qwFileSize;                     /* bytes written to the current log file */
+    EC_T_DWORD  dwFileOpenTime;                 /* [ms] OsQueryMsecCount() when the current log file was opened */
 #endif
     EC_T_BOOL   bPrintTimestamp;                /* EC_TRUE if a timestamp shall be printed in the log file */
     EC_T_BOOL   bPrintConsole;                  /* EC_TRUE if the message shall be printed on the console */
     EC_T_BOOL   bIsInitialized;                 /* EC_TRUE if message buffer is initialized */
-    EC_T_WORD   wLogFileIndex;                  /* Index of current log file */
+    EC_T_DWORD  dwLogFileIndex;                 /* Index of current log file */
     EC_T_WORD   wEntryCounter;                  /* Entries to detect roll over */
     EC_T_WORD   wEntryCounterLimit;             /* Entries before roll over */
-    EC_T_WORD   wRes;
     /* logging into memory buffer */
     EC_T_CHAR   szLogName[MAX_PATH_LEN];        /* name of the logging buffer */
     EC_T_BYTE*  pbyLogMemory;                   /* if != EC_NULL then log into memory instead of file */
@@ -195,6 +253,9 @@ typedef struct _MSG_BUFFER_DESC
     EC_T_DWORD  dwNumDuplicates;                /* if 0, the new message is not duplicated */
     EC_T_CHAR*  pszLastMsg;                     /* pointer to last message (points into message buffer) */
     EC_T_BOOL   bNewLine;                       /* EC_TRUE if last message printed with CrLf */
+    /* per-producer rings, merged by qwMsgOrder by the log task */
+    EC_T_BOOL   bPerProducer;                   /* EC_TRUE if registered threads insert into an own ring */
+    struct _MSG_BUFFER_DESC* apProducerBuf[LOG_MAX_PRODUCERS]; /* single producer rings, allocated by InitLogging() */
 } MSG_BUFFER_DESC;
 
 /*-FORWARD DECLARATIONS------------------------------------------------------*/
@@ -217,7 +278,8 @@ public:
                                                 EC_T_DWORD              dwStackSize = DEFAULT_LOG_STACK_SIZE,
                                                 EC_T_DWORD              dwLogMsgBufferSize = DEFAULT_LOG_MSG_BUFFER_SIZE,
                                                 EC_T_DWORD              dwErrMsgBufferSize = DEFAULT_ERR_MSG_BUFFER_SIZE,
-                                                EC_T_DWORD              dwDcmMsgBufferSize = DEFAULT_DCM_MSG_BUFFER_SIZE);
+                                                EC_T_DWORD              dwDcmMsgBufferSize = DEFAULT_DCM_MSG_BUFFER_SIZE,
+                                                EC_T_DWORD              dwProducerMsgBufferSize = DEFAULT_PRODUCER_MSG_BUFFER_SIZE);
     /* depreated */
     EC_T_DWORD  InitLogging(                    EC_T_DWORD              dwInstanceId,
                                                 EC_T_DWORD              dwLogLevel,
@@ -260,6 +322,19 @@ public:
                                                 EC_T_BYTE*              pbyLogMem,
                                                 EC_T_DWORD              dwSize                      );
 
+    /* store raw arguments instead of formatting in the caller's context, format strings must be static */
+    EC_T_VOID   SetBinaryLogging(               EC_T_BOOL               bEnable                     ) { m_bBinaryLogging = bEnable; }
+
+    /* give the calling thread its own message rings (lock free insert), done implicitly by the first message */
+    EC_T_DWORD  RegisterProducer(               EC_T_VOID                                           );
+
+    /* give the rings of the calling thread back to the next registering thread, done implicitly on thread exit */
+    EC_T_VOID   UnregisterProducer(             EC_T_VOID                                           );
+
+    /* the log task is woken up by errors or if a buffer reaches dwWatermark percent, otherwise after dwIdleTimeout ms */
+    EC_T_VOID   SetWakeup(                      EC_T_DWORD              dwWatermark,
+                                                EC_T_DWORD              dwIdleTimeout               ) { m_dwWakeupWatermark = dwWatermark; m_dwIdleTimeout = dwIdleTimeout; }
+
     EC_T_DWORD  InsertNewMsgVa(                 MSG_BUFFER_DESC*        pMsgBufferDesc,
                                                 EC_T_DWORD              dwLogMsgSeverity,
                                                 const
@@ -330,13 +405,97 @@ private:
 #endif
                                                 EC_T_CHAR*              szLogName                   );
 
+    static
+    EC_T_BOOL   AllocMsgSlots(                  MSG_BUFFER_DESC*        pMsgBufferDesc,
+                                                EC_T_DWORD              dwMsgSize,
+                                                EC_T_DWORD              dwNumMsgs,
+                                                EC_T_CHAR*              szBufferName                );
+
+    EC_T_BOOL   AllocProducerRings(             MSG_BUFFER_DESC*        pMsgBufferDesc,
+                                                EC_T_DWORD              dwNumMsgs                   );
+
     EC_T_VOID   DeinitMsgBuffer(                MSG_BUFFER_DESC*        pMsgBufferDesc              );
 
+    static
+    EC_T_BOOL   IsMsgBufferEmpty(               MSG_BUFFER_DESC*        pMsgBufferDesc              );
+
+    MSG_BUFFER_DESC* GetProducerBuffer(         MSG_BUFFER_DESC*        pMsgBufferDesc              );
+
+    static
+    MSG_BUFFER_DESC* GetNextMsgSource(          MSG_BUFFER_DESC*        pMsgBufferDesc              );
+
     EC_T_VOID   ProcessMsgs(                    MSG_BUFFER_DESC*        pMsgBufferDesc              );
 
+    EC_T_BOOL   IsMsgPending(                   EC_T_VOID                                           );
+
+    EC_T_VOID   WakeupLogTask(                  EC_T_VOID                                           );
+
+    EC_T_VOID   WaitForMsgs(                    EC_T_VOID                                           );
+
+    EC_T_VOID   CloseConsoleSegment(            EC_T_VOID                                           );
+
+    EC_T_VOID   FlushConsole(                   EC_T_VOID                                           );
+
+#if (defined INCLUDE_FILE_LOGGING)
+    EC_T_VOID   PrintFile(                      FILE*                   pFileHandle,
+                                                EC_T_CHAR*              szMsgBuffer,
+                                                EC_T_DWORD              dwLen                       );
+
+    EC_T_VOID   FlushFileBatch(                 FILE*                   pFileHandle                 );
+
+    EC_T_VOID   FlushFiles(                     EC_T_VOID                                           );
+#endif
+
+    static
+    EC_T_BOOL   StoreMsgArgs(                   LOG_MSG_DESC*           pMsgDesc,
+                                                EC_T_DWORD              dwSlotSize,
+                                                const
+                                                EC_T_CHAR*              szFormat,
+                                                EC_T_VALIST             vaArgs                      );
+
+    EC_T_VOID   FormatMsgArgs(                  LOG_MSG_DESC*           pMsgDesc,
+                                                EC_T_DWORD              dwSlotSize                  );
+
     static
     EC_T_VOID   SelectNextLogMemBuffer(         MSG_BUFFER_DESC*        pMsgBufferDesc              );
 
+#if (defined INCLUDE_FILE_LOGGING)
+    static
+    EC_T_BOOL   IsLogFileRotated(               MSG_BUFFER_DESC*        pMsgBufferDesc              );
+
+    static
+    EC_T_VOID   GetLogFileName(                 EC_T_CHAR*              szFileName,
+                                                EC_T_DWORD              dwSize,
+                                                const EC_T_CHAR*        szBaseName,
+                                                const EC_T_CHAR*        szExt,
+                                                EC_T_BOOL               bIndexed,
+                                                EC_T_DWORD              dwIndex                     );
+
+    static
+    EC_T_BOOL   IsRotationDue(                  MSG_BUFFER_DESC*        pMsgBufferDesc              );
+
+    static
+    EC_T_DWORD  ScanLogFiles(                   const EC_T_CHAR*        szBaseName,
+                                                const EC_T_CHAR*        szExt,
+                                                EC_T_DWORD*             padwIndex,
+                                                EC_T_DWORD              dwMaxFiles,
+                                                EC_T_DWORD*             pdwHighest                  );
+
+    EC_T_VOID   QueueClosedFile(                MSG_BUFFER_DESC*        pMsgBufferDesc,
+                                                EC_T_DWORD              dwIndex                     );
+
+    static
+    EC_T_VOID   tCompressWrapper(               EC_T_VOID*              pvParms                     );
+
+    EC_T_VOID   tCompress(                      EC_T_VOID                                           );
+
+    static
+    EC_T_VOID   ProcessClosedFile(              LOG_CLOSED_FILE*        pClosedFile                 );
+
+    static
+    EC_T_BOOL   CompressLogFile(                const EC_T_CHAR*        szFileName                  );
+#endif
+
     static
     EC_T_VOID   tAtEmLogWrapper(                EC_T_VOID*              pvParms                     );
 
@@ -357,6 +516,22 @@ private:
     MSG_BUFFER_DESC*        m_pDcmMsgBufferDesc;            /* DCM buffer */
     MSG_BUFFER_DESC*        m_pHistMsgBufferDesc;           /* Histogram buffer */
     EC_T_CHAR*              m_pchTempbuffer;
+    EC_T_CHAR*              m_pchBinTempBuffer;             /* log task buffer to format binary messages */
+    EC_T_BOOL               m_bBinaryLogging;               /* EC_TRUE: defer formatting to the log task */
+    EC_T_INT                m_nWakeupFd;                    /* eventfd signaled by producers, -1: poll every ms */
+    volatile EC_T_BOOL      m_bWakeupPending;               /* eventfd already signaled */
+    EC_T_DWORD              m_dwWakeupWatermark;            /* [%] buffer level waking up the log task */
+    EC_T_DWORD              m_dwIdleTimeout;                /* [ms] */
+    EC_T_CHAR*              m_pchConsoleBatch;              /* console output of the current pass, written at once */
+    EC_T_DWORD              m_dwConsoleBatchLen;
+    EC_T_DWORD              m_dwConsoleSegStart;            /* start of the segment of the current message buffer */
+    EC_T_DWORD              m_dwConsoleSegCnt;
+    EC_T_DWORD              m_adwConsoleSeg[2 * LOG_CONSOLE_MAX_SEGMENTS]; /* offset, length */
+    EC_T_CHAR*              m_pchFileBatch;                 /* file output of the current message buffer, written at once */
+    EC_T_DWORD              m_dwFileBatchLen;
+    EC_T_VOID*              m_poFlushLock;                  /* lock object for the console batch */
+    volatile EC_T_DWORD     m_adwProducerUsed[LOG_MAX_PRODUCERS]; /* 1: ring index taken by a registered thread */
+    EC_T_DWORD              m_dwProducerGeneration;         /* invalidates the thread local registration on InitLogging() */
     EC_T_VOID*              m_poInsertMsgLock;              /* lock object for inserting new messages */
     EC_T_VOID*              m_poProcessMsgLock;             /* lock object for processing messages */
     EC_T_BOOL               m_bDbgMsgHookEnable;
@@ -368,6 +543,16 @@ private:
 
 #if (defined INCLUDE_FILE_LOGGING)
     EC_T_CHAR               m_pchLogDir[MAX_PATH_LEN];      /* directory for all EtherCAT logging files */
+
+    /* compression and retention of closed log files, never blocks the log task */
+    EC_T_PVOID              m_pvCompressThreadObj;
+    EC_T_VOID*              m_pvCompressEvent;
+    EC_T_VOID*              m_poClosedFileLock;
+    EC_T_BOOL               m_bCompressTaskRunning;
+    EC_T_BOOL               m_bShutdownCompressTask;
+    LOG_CLOSED_FILE         m_aClosedFile[LOG_CLOSED_FILE_QUEUE_LEN];
+    EC_T_DWORD              m_dwClosedFileRd;
+    EC_T_DWORD              m_dwClosedFileWr;
 #endif
 
     EC_T_DWORD              m_dwPerfMeasNumOf;              /* number of performance measurements */
@@ -740,24 +925,36 @@ protected:
     EC_T_CHAR*       m_szFileName;
 };
 
-typedef struct
-{
-    EC_T_DWORD  dwSize;      /*< size of the frame buffer */
-    EC_T_UINT64 qwTimestamp; /*< Send or receive time point */
-} EC_T_LINK_FRAME_BUF_ENTRY_FRAME_DESC;
-typedef struct
+/* the capture ring holds ready-to-write pcap records (pcap_pkthdr + frame), written in batches */
+#define PCAP_WRITE_BATCH_SIZE       ((EC_T_DWORD)0x40000)   /* [byte] minimum size of a file write */
+#define PCAP_WRITE_MAX_DELAY        ((EC_T_DWORD)100)       /* [ms] maximum time a frame stays in the ring */
+
+/** \brief capture statistics of CPcapFileBufferedWriter, frames are dropped if the capture ring is full */
+typedef struct _EC_T_PCAP_CAPTURE_STAT
 {
-    EC_T_LINK_FRAME_BUF_ENTRY_FRAME_DESC Desc;
-    EC_T_BYTE abyData[ETHERNET_MAX_FRAMEBUF_LEN - sizeof(EC_T_LINK_FRAME_BUF_ENTRY_FRAME_DESC)];
-} EC_T_LINK_FRAME_BUF_ENTRY;
+    EC_T_UINT64 qwFrameCnt;                 /* frames captured */
+    EC_T_UINT64 qwDropFrameCnt;             /* frames dropped */
+    EC_T_UINT64 qwDropByteCnt;              /* bytes dropped */
+    EC_T_DWORD  dwCycleCnt;                 /* cycles closed by EndCycle() */
+    EC_T_DWORD  dwLastCycleDrops;           /* frames dropped in the last cycle */
+    EC_T_DWORD  dwMaxCycleDrops;            /* maximum frames dropped in one cycle */
+    EC_T_DWORD  dwDropCycleCnt;             /* cycles with at least one dropped frame */
+    EC_T_UINT64 qwWriteCnt;                 /* file writes */
+    EC_T_UINT64 qwWriteByteCnt;             /* bytes written */
+    EC_T_DWORD  dwRingSize;                 /* [byte] size of the capture ring */
+    EC_T_DWORD  dwMaxRingLevel;             /* [byte] high water mark of the capture ring */
+} EC_T_PCAP_CAPTURE_STAT;
 
 class CPcapFileBufferedWriter : public CPcapFileWriter, public CEcThread
 {
 public:
     CPcapFileBufferedWriter(EC_T_DWORD dwBufCnt, EC_T_CPUSET cpuAffinity /* EC_CPUSET_ZERO */, EC_T_DWORD dwPrio /* LOG_THREAD_PRIO */, EC_T_DWORD dwStackSize /* DEFAULT_LOG_STACK_SIZE */)
-        : m_FrameBuffer(0 /* not used */, EC_NULL, (EC_T_CHAR*)"CPcapFileBufferedWriter"), m_cpuAffinity(cpuAffinity), m_dwPrio(dwPrio), m_dwStackSize(dwStackSize)
+        : m_pbyRing(EC_NULL), m_dwRingSize(0), m_qwRingWr(0), m_qwRingRd(0), m_poCaptureLock(EC_NULL), m_dwCycleDrops(0), m_dwLastWriteMsec(0), m_qwReportedDrops(0)
+        , m_cpuAffinity(cpuAffinity), m_dwPrio(dwPrio), m_dwStackSize(dwStackSize)
     {
         EC_UNREFPARM(dwBufCnt);
+        OsMemset(&m_oStat, 0, sizeof(EC_T_PCAP_CAPTURE_STAT));
+        m_poCaptureLock = OsCreateLock();
 #if (defined INCLUDE_PCAP_RECORDER_OS_PERF_MEAS)
         m_qwStartTimeCounterTicks = 0;
 
@@ -767,38 +964,55 @@ public:
         }
 #endif
     }
-    virtual EC_T_DWORD InitInstance(EC_T_DWORD dwBufCnt)
-    {
-        return m_FrameBuffer.InitInstance(dwBufCnt);
-    }
+    /* allocates the capture ring, dwBufCnt frames of maximum size */
+    virtual EC_T_DWORD InitInstance(EC_T_DWORD dwBufCnt);
+
     EC_T_VOID StartThread()
     {
-        Start(GetLogParms(), ThreadStep, (void*)this, "CLogThread", m_cpuAffinity, m_dwPrio, m_dwStackSize, 15000);
-    }
-    virtual ~CPcapFileBufferedWriter()
-    {
-        Close();
+        Start(GetLogParms(), ThreadStep, (void*)this, "tPcapWriter", m_cpuAffinity, m_dwPrio, m_dwStackSize, 15000);
     }
+    virtual ~CPcapFileBufferedWriter();
+
     EC_T_VOID SetFrameTimestamp(EC_T_UINT64* pqwTimestamp);
 
-    EC_T_VOID AddFrame(EC_T_DWORD dwFrameSize, EC_T_BYTE* pbyFrame);
+    /* copy a frame into the capture ring, never allocates and never waits for the writer thread or the file;
+     * concurrent frame sources are serialized by a short critical section (m_poCaptureLock) */
+    EC_T_BOOL AddFrame(EC_T_DWORD dwFrameSize, EC_T_BYTE* pbyFrame);
+
+    /* close the drop accounting of the current cycle, to be called once per bus cycle */
+    EC_T_VOID EndCycle(EC_T_VOID);
+    EC_T_VOID GetCaptureStat(EC_T_PCAP_CAPTURE_STAT* pStat);
 
     virtual EC_T_VOID Close(EC_T_VOID)
     {
         Stop(15000);
-        FlushBuffer();
+        FlushBuffer(EC_TRUE);
         CPcapFileProcessor::Close();
     }
 
     static EC_T_VOID ThreadStep(EC_T_PVOID pvParams)
     {
-        ((CPcapFileBufferedWriter*)pvParams)->FlushBuffer();
+        ((CPcapFileBufferedWriter*)pvParams)->FlushBuffer(EC_FALSE);
         OsSleep(1);
     }
-    EC_T_VOID FlushBuffer(EC_T_VOID);
+    /* write the captured records, without bForce only if a batch is complete or PCAP_WRITE_MAX_DELAY elapsed */
+    EC_T_VOID FlushBuffer(EC_T_BOOL bForce);
 
 protected:
-    CFiFoListDyn<EC_T_LINK_FRAME_BUF_ENTRY> m_FrameBuffer;
+    EC_T_VOID RingRead(EC_T_UINT64 qwPos, EC_T_VOID* pvDst, EC_T_DWORD dwLen);
+    EC_T_VOID RingWrite(EC_T_UINT64 qwPos, const EC_T_VOID* pvSrc, EC_T_DWORD dwLen);
+    EC_T_BOOL WriteRingToFile(EC_T_UINT64 qwFrom, EC_T_UINT64 qwTo);
+
+    EC_T_BYTE*              m_pbyRing;          /* pre-faulted, locked mapping */
+    EC_T_DWORD              m_dwRingSize;       /* power of 2 */
+    volatile EC_T_UINT64    m_qwRingWr;         /* byte positions, only increasing */
+    volatile EC_T_UINT64    m_qwRingRd;
+    EC_T_VOID*              m_poCaptureLock;    /* serializes frame sources (e.g. job task and receive IST) */
+    EC_T_DWORD              m_dwCycleDrops;
+    EC_T_DWORD              m_dwLastWriteMsec;
+    EC_T_UINT64             m_qwReportedDrops;
+    EC_T_PCAP_CAPTURE_STAT  m_oStat;
+
     EC_T_CPUSET m_cpuAffinity;
     EC_T_DWORD  m_dwPrio;
     EC_T_DWORD  m_dwStackSize;
@@ -846,6 +1060,76 @@ protected:
 };
 #endif /* INCLUDE_PCAP_RECORDER */
 
+#if (defined INCLUDE_FLIGHT_RECORDER)
+typedef enum _EC_T_FLIGHT_RECORDER_STATE
+{
+    eFlightRecorderState_Armed      = 0,    /* recording, the oldest frames are overwritten */
+    eFlightRecorderState_Triggered  = 1,    /* recording the post-trigger frames */
+    eFlightRecorderState_Frozen     = 2,    /* window is dumped, frames are not recorded */
+} EC_T_FLIGHT_RECORDER_STATE;
+
+/** \brief keeps the frames of the last seconds in memory and dumps them to a .pcap file when triggered */
+class CFlightRecorder : public CPcapFileProcessor, public CEcThread
+{
+public:
+    CFlightRecorder(EC_T_CPUSET cpuAffinity, EC_T_DWORD dwPrio, EC_T_DWORD dwStackSize);
+    virtual ~CFlightRecorder();
+
+    EC_T_DWORD InitInstance(EC_T_DWORD dwInstanceId, EC_T_DWORD dwRingSize, EC_T_DWORD dwPreTriggerMsec, EC_T_DWORD dwPostTriggerMsec, const EC_T_CHAR* szFilePrefix);
+    EC_T_VOID  Uninstall(EC_T_VOID);
+
+    /* freeze the window dwPostTriggerMsec after now and dump it. szReason must be a static string.
+     * Called from the job task and notification context, ignored while a window is pending or in the hold-off time. */
+    EC_T_BOOL  Trigger(const EC_T_CHAR* szReason);
+
+    EC_T_VOID  LogFrame(EC_T_DWORD dwLogFlags, EC_T_DWORD dwFrameSize, EC_T_BYTE* pbyFrame);
+    static EC_T_VOID LogFrameStatic(EC_T_VOID* pvContext, EC_T_DWORD dwLogFlags, EC_T_DWORD dwFrameSize, EC_T_BYTE* pbyFrame)
+    {
+        ((CFlightRecorder*)pvContext)->LogFrame(dwLogFlags, dwFrameSize, pbyFrame);
+    }
+    static EC_T_VOID ThreadStep(EC_T_PVOID pvParams)
+    {
+        ((CFlightRecorder*)pvParams)->ProcessTrigger();
+        OsSleep(10);
+    }
+
+    EC_INLINESTART EC_T_DWORD GetDumpCnt()      { return m_dwDumpCnt; } EC_INLINESTOP
+    EC_INLINESTART EC_T_DWORD GetTriggerCnt()   { return m_dwTriggerCnt; } EC_INLINESTOP
+    EC_INLINESTART EC_T_LOG_PARMS* GetLogParms()
+    {
+        if (m_dwInstanceId < MAX_NUMOF_MASTER_INSTANCES) return &G_aLogParms[m_dwInstanceId];
+        return &G_aLogParms[0];
+    } EC_INLINESTOP
+
+protected:
+    EC_T_VOID  ProcessTrigger(EC_T_VOID);
+    EC_T_VOID  DumpWindow(EC_T_VOID);
+
+    EC_T_BYTE*                  m_pbyRing;
+    EC_T_DWORD                  m_dwRingSize;       /* power of 2 */
+    EC_T_UINT64                 m_qwRingWr;         /* byte positions, only increasing */
+    EC_T_UINT64                 m_qwRingOldest;     /* first record still in the ring */
+    EC_T_VOID*                  m_poLock;
+    EC_T_DWORD                  m_dwInstanceId;
+    EC_T_CHAR*                  m_szFilePrefix;
+    EC_T_DWORD                  m_dwPreTriggerMsec;
+    EC_T_DWORD                  m_dwPostTriggerMsec;
+    EC_T_CPUSET                 m_cpuAffinity;
+    EC_T_DWORD                  m_dwPrio;
+    EC_T_DWORD                  m_dwStackSize;
+
+    volatile EC_T_FLIGHT_RECORDER_STATE m_eState;
+    const EC_T_CHAR*            m_szTriggerReason;
+    EC_T_UINT64                 m_qwTriggerTime;    /* [ns] frame time base */
+    EC_T_DWORD                  m_dwTriggerMsec;
+    EC_T_DWORD                  m_dwLastDumpMsec;
+    EC_T_DWORD                  m_dwTriggerCnt;     /* accepted triggers */
+    EC_T_DWORD                  m_dwSuppressedCnt;  /* triggers ignored while pending or in hold-off */
+    EC_T_DWORD                  m_dwDumpCnt;
+    EC_T_DWORD                  m_dwFrozenDropCnt;  /* frames not recorded while dumping */
+};
+#endif /* INCLUDE_FLIGHT_RECORDER */
+
 #endif /* INC_LOGGING */
 
 /*-END OF SOURCE FILE--------------------------------------------------------*/
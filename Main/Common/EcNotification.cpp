@@ -10,12 +10,25 @@
 
 /*-INCLUDES------------------------------------------------------------------*/
 #include "EcDemoApp.h"
+#include "ecat_shm.h"
+
+#include <sys/time.h>
 
 /*-DEFINES-------------------------------------------------------------------*/
 #define MAX_MSG_PER_ERROR   1 /* max. number of error messages printed */
 
 #define SB_PORT_BLOCK_TIMEOUT   2000        /* msecs to wait for invalid slave node block */
 
+/*-LOCAL FUNCTIONS-----------------------------------------------------------*/
+/* us, same clock as rocos::EcatBus::timestamp */
+static long GetTimestampUsec(EC_T_VOID)
+{
+    timeval oTime;
+
+    gettimeofday(&oTime, EC_NULL);
+    return oTime.tv_sec * 1000000 + oTime.tv_usec;
+}
+
 /*-CLASS FUNCTIONS-----------------------------------------------------------*/
 /*****************************************************************************/
 /**
@@ -38,11 +51,45 @@ CEmNotification::CEmNotification(
     m_bRasEvalExpired                   = EC_FALSE;
 
     OsMemset(&m_oSlaveJobQueue, 0, sizeof(T_SLAVEJOBQUEUE));
-
-    m_oSlaveJobQueue.pRead              = &(m_oSlaveJobQueue.Jobs[0]);
-    m_oSlaveJobQueue.pWrite             = &(m_oSlaveJobQueue.Jobs[0]);
+    for (EC_T_DWORD dwSlot = 0; dwSlot < JOB_QUEUE_LENGTH; dwSlot++)
+    {
+        m_oSlaveJobQueue.Slots[dwSlot].dwSequence = dwSlot;
+    }
 
     m_dwClientID                        = INVALID_CLIENT_ID;
+
+    /* error notifications are logged as errors, notifications raised per cycle or per frame are rate limited */
+    for (EC_T_DWORD dwIdx = 0; dwIdx < MAX_NOTIFY_CODES; dwIdx++)
+    {
+        m_abyNotifyFilter[dwIdx] = EC_LOG_LEVEL_ERROR;
+    }
+    m_abyNotifyFilter[EC_NOTIFY_CYCCMD_WKC_ERROR & 0xFFFF]         |= NOTIFY_FILTER_COALESCE;
+    m_abyNotifyFilter[EC_NOTIFY_MASTER_INITCMD_WKC_ERROR & 0xFFFF] |= NOTIFY_FILTER_COALESCE;
+    m_abyNotifyFilter[EC_NOTIFY_SLAVE_INITCMD_WKC_ERROR & 0xFFFF]  |= NOTIFY_FILTER_COALESCE;
+    m_abyNotifyFilter[EC_NOTIFY_EOE_MBXSND_WKC_ERROR & 0xFFFF]     |= NOTIFY_FILTER_COALESCE;
+    m_abyNotifyFilter[EC_NOTIFY_COE_MBXSND_WKC_ERROR & 0xFFFF]     |= NOTIFY_FILTER_COALESCE;
+    m_abyNotifyFilter[EC_NOTIFY_FOE_MBXSND_WKC_ERROR & 0xFFFF]     |= NOTIFY_FILTER_COALESCE;
+    m_abyNotifyFilter[EC_NOTIFY_SOE_MBXSND_WKC_ERROR & 0xFFFF]     |= NOTIFY_FILTER_COALESCE;
+    m_abyNotifyFilter[EC_NOTIFY_VOE_MBXSND_WKC_ERROR & 0xFFFF]     |= NOTIFY_FILTER_COALESCE;
+    m_abyNotifyFilter[EC_NOTIFY_FRAME_RESPONSE_ERROR & 0xFFFF]     |= NOTIFY_FILTER_COALESCE;
+    m_abyNotifyFilter[EC_NOTIFY_ETH_LINK_NOT_CONNECTED & 0xFFFF]   |= NOTIFY_FILTER_COALESCE;
+    m_abyNotifyFilter[EC_NOTIFY_STATUS_SLAVE_ERROR & 0xFFFF]       |= NOTIFY_FILTER_COALESCE;
+    m_abyNotifyFilter[EC_NOTIFY_MBXRCV_INVALID_DATA & 0xFFFF]      |= NOTIFY_FILTER_COALESCE;
+    m_abyNotifyFilter[EC_NOTIFY_PDIWATCHDOG & 0xFFFF]              |= NOTIFY_FILTER_COALESCE;
+    m_abyNotifyFilter[EC_NOTIFY_FRAMELOSS_AFTER_SLAVE & 0xFFFF]    |= NOTIFY_FILTER_COALESCE;
+    m_abyNotifyFilter[EC_NOTIFY_BAD_CONNECTION & 0xFFFF]           |= NOTIFY_FILTER_COALESCE;
+    m_abyNotifyFilter[EC_NOTIFY_COMMUNICATION_TIMEOUT & 0xFFFF]    |= NOTIFY_FILTER_COALESCE;
+    m_abyNotifyFilter[EC_NOTIFY_NOT_ALL_DEVICES_OPERATIONAL & 0xFFFF] |= NOTIFY_FILTER_KEEP;
+    m_abyNotifyFilter[EC_NOTIFY_ALL_DEVICES_OPERATIONAL & 0xFFFF]     |= NOTIFY_FILTER_KEEP;
+    m_abyNotifyFilter[EC_NOTIFY_CLIENTREGISTRATION_DROPPED & 0xFFFF]  |= NOTIFY_FILTER_KEEP;
+
+    m_dwNotifyRateLimitMsec             = pAppContext->AppParms.dwNotifyRateLimitMsec;
+    m_dwNextNotifyFlushMsec             = 0;
+    if (EC_E_NOERROR != SetNotifyFilter(pAppContext->AppParms.szNotifyFilter))
+    {
+        EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "Invalid notification filter \"%s\", expected <code>=<off|error|warning|info|all>,...\n",
+            pAppContext->AppParms.szNotifyFilter));
+    }
 }
 
 /*****************************************************************************/
@@ -65,7 +112,18 @@ EC_T_DWORD CEmNotification::ecatNotify(
     static EC_T_DWORD               s_dwClearErrorMsecCount = 0;
     EC_T_DWORD                      dwRetVal                = EC_E_NOERROR;
     EC_T_DWORD                      dwRes                   = EC_E_ERROR;
-    T_SLAVEJOBS                     oCurJob;
+
+    PublishEvent(dwCode, pParms);
+    UpdateDiagnostics(dwCode, pParms);
+    if (EC_NOTIFY_CYCCMD_WKC_ERROR == dwCode)
+    {
+        TRIGGER_FLIGHT_RECORDER("wkc");
+    }
+    if (!FilterNotification(dwCode, pParms))
+    {
+        /* counted only */
+        return EC_E_NOERROR;
+    }
 
     switch (dwCode)
     {
@@ -87,7 +145,7 @@ EC_T_DWORD CEmNotification::ecatNotify(
         {
             /* Hint: No error, but show error clearance in Error.log */
             EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, GetText(EC_TXT_CABLE_CONNECTED)));
-            EnqueueJob(&oCurJob, dwCode, EC_NULL, 0);
+            EnqueueJob(dwCode, EC_NULL, 0);
     } break;
     case EC_NOTIFY_SB_STATUS:   /* GEN|3 */
         {
@@ -182,6 +240,7 @@ EC_T_DWORD CEmNotification::ecatNotify(
         } break;
     case EC_NOTIFY_SLAVE_PRESENCE:      /* GEN|101 */
         {
+            pAppContext->bLayoutChanged = EC_TRUE;
             if (pNotificationDesc->desc.SlavePresenceDesc.bPresent)
             {
                 EcLogMsg(EC_LOG_LEVEL_INFO, (pEcLogContext, EC_LOG_LEVEL_INFO, GetText(EC_TXT_SLAVE_PRESENT), pNotificationDesc->desc.SlavePresenceDesc.wStationAddress));
@@ -194,6 +253,7 @@ EC_T_DWORD CEmNotification::ecatNotify(
     case EC_NOTIFY_SLAVES_PRESENCE:     /* GEN|102 */
         {
             EC_T_DWORD dwSlaveIdx = 0;
+            pAppContext->bLayoutChanged = EC_TRUE;
             for (dwSlaveIdx = 0; dwSlaveIdx < pNotificationDesc->desc.SlavesPresenceDesc.wCount; dwSlaveIdx++)
             {
                 if (pNotificationDesc->desc.SlavesPresenceDesc.SlavePresence[dwSlaveIdx].bPresent)
@@ -331,14 +391,14 @@ EC_T_DWORD CEmNotification::ecatNotify(
                     /***************************************************************************************************************************/
                 case eMbxTferType_FOE_SEG_DOWNLOAD:
                     {
-                        EnqueueJob(&oCurJob, dwCode, pMbxTfer, sizeof(EC_T_MBXTFER));
+                        EnqueueJob(dwCode, pMbxTfer, sizeof(EC_T_MBXTFER));
                     } break;
                 case eMbxTferType_FOE_SEG_UPLOAD:
                     if (eMbxTferStatus_TferWaitingForContinue == pMbxTfer->eTferStatus)
                     {
                         /* received segment size */
                         EcLogMsg(EC_LOG_LEVEL_INFO, (pEcLogContext, EC_LOG_LEVEL_INFO, "Foe segment of size %d uploaded.\n", pMbxTfer->dwDataLen));
-                        EnqueueJob(&oCurJob, dwCode, pMbxTfer, sizeof(EC_T_MBXTFER));
+                        EnqueueJob(dwCode, pMbxTfer, sizeof(EC_T_MBXTFER));
                     }
                     break;
 
@@ -559,10 +619,6 @@ EC_T_DWORD CEmNotification::ecatNotify(
         /**********************/
     case EC_NOTIFY_CYCCMD_WKC_ERROR:    /* ERR|1 */
         {
-            m_adwErrorCounter[dwCode & 0xFFFF]++;
-            if (m_adwErrorCounter[dwCode & 0xFFFF] > MAX_MSG_PER_ERROR)
-                break;
-
             EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, GetText(EC_TXT_CYCCMD_WKC_ERROR),
                 EcatCmdShortText(pErrorNotificationDesc->desc.WkcErrDesc.byCmd),
                 pErrorNotificationDesc->desc.WkcErrDesc.dwAddr,
@@ -676,9 +732,6 @@ EC_T_DWORD CEmNotification::ecatNotify(
             a)  the frame was not received (due to bus problems)
             b)  too many or too long frames are sent by the master due to a improper configuration.
             */
-            m_adwErrorCounter[dwCode & 0xFFFF]++;
-            if (m_adwErrorCounter[dwCode & 0xFFFF] > MAX_MSG_PER_ERROR)
-                break;
             {
                 const EC_T_CHAR* pszTextCause = EC_NULL;
                 switch (pErrorNotificationDesc->desc.FrameRspErrDesc.EErrorType)
@@ -802,9 +855,6 @@ EC_T_DWORD CEmNotification::ecatNotify(
         } break;
     case EC_NOTIFY_ETH_LINK_NOT_CONNECTED: /* ERR|16 */
         {
-            m_adwErrorCounter[dwCode & 0xFFFF]++;
-            if (m_adwErrorCounter[dwCode & 0xFFFF] > MAX_MSG_PER_ERROR)
-                break;
             EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, GetText(EC_TXT_CABLE_NOT_CONNECTED)));
         } break;
     case EC_NOTIFY_RED_LINEBRK:         /* ERR|18 */
@@ -815,9 +865,6 @@ EC_T_DWORD CEmNotification::ecatNotify(
         } break;
     case EC_NOTIFY_STATUS_SLAVE_ERROR:  /* ERR|19 */
         {
-            m_adwErrorCounter[dwCode & 0xFFFF]++;
-            if (m_adwErrorCounter[dwCode & 0xFFFF] > MAX_MSG_PER_ERROR)
-                break;
             EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, GetText(EC_TXT_SLVERR_DETECTED)));
         } break;
     case EC_NOTIFY_SLAVE_ERROR_STATUS_INFO:     /* ERR|20 */
@@ -1060,6 +1107,7 @@ EC_T_DWORD CEmNotification::ecatNotify(
 #endif /* INCLUDE_HOTCONNECT */
     case EC_NOTIFY_HC_TOPOCHGDONE:          /* HC| 4:  HC Topology Change done */
         {
+            pAppContext->bLayoutChanged = EC_TRUE;
             EcLogMsg(EC_LOG_LEVEL_INFO, (pEcLogContext, EC_LOG_LEVEL_INFO, GetText(EC_TXT_HC_TOPOCHGDONE), GetText(pNotificationDesc->desc.StatusCode), pNotificationDesc->desc.StatusCode));
         } break;
     case EC_NOTIFY_RELEASE_FORCED_PROCESSDATA:
@@ -1090,17 +1138,36 @@ EC_T_DWORD CEmNotification::ecatNotify(
  * \brief  Process Notification Jobs.
  *
  * This function processes the results enqueued by ecatNotify. Blocking API's can be called here.
+ * The jobs queued at entry are processed in place as one batch, jobs enqueued meanwhile are left for the next call.
  * \return EC_FALSE on error, EC_TRUE otherwise.
  */
 EC_T_BOOL CEmNotification::ProcessNotificationJobs(EC_T_VOID)
 {
-    T_SLAVEJOBS oTmpJob;
-    EC_T_BOOL   bProcessed = EC_FALSE;
+    PT_SLAVEJOBS pJob       = EC_NULL;
+    EC_T_BOOL    bProcessed = EC_FALSE;
+    EC_T_BOOL    bKnownJob  = EC_FALSE;
+    EC_T_DWORD   dwNumJobs  = __atomic_load_n(&m_oSlaveJobQueue.dwEnqueuePos, __ATOMIC_ACQUIRE) - m_oSlaveJobQueue.dwDequeuePos;
+    EC_T_DWORD   dwJobIdx   = 0;
+
+    ReportJobOverflows();
+    FlushNotifySummaries();
+    if (dwNumJobs > JOB_QUEUE_LENGTH)
+    {
+        dwNumJobs = JOB_QUEUE_LENGTH;
+    }
 
-    /* process all jobs */
-    while (DequeueJob(&oTmpJob))
+    /* process batch */
+    for (dwJobIdx = 0; dwJobIdx < dwNumJobs; dwJobIdx++)
     {
-        switch (oTmpJob.dwCode)
+        pJob = PeekJob();
+        if (EC_NULL == pJob)
+        {
+            /* claimed by a producer, but not stored yet */
+            break;
+        }
+        bKnownJob = EC_TRUE;
+
+        switch (pJob->dwCode)
         {
         case EC_NOTIFY_ETH_LINK_CONNECTED: /* GEN|2 */
         {
@@ -1113,11 +1180,11 @@ EC_T_BOOL CEmNotification::ProcessNotificationJobs(EC_T_VOID)
         case EC_NOTIFY_MBOXRCV:     /* MBOXRCV|0 */
             {
 #if (defined INCLUDE_FOE_SUPPORT)
-                switch (oTmpJob.JobData.MbxTferJob.eMbxTferType)
+                switch (pJob->JobData.MbxTferJob.eMbxTferType)
                 {
                     case eMbxTferType_FOE_SEG_DOWNLOAD:
                     {
-                        EC_T_MBXTFER* pMbxTfer = &(oTmpJob.JobData.MbxTferJob);
+                        EC_T_MBXTFER* pMbxTfer = &(pJob->JobData.MbxTferJob);
                         if (eMbxTferStatus_TferWaitingForContinue == pMbxTfer->eTferStatus)
                         {
                             /* read from file to application's buffer */
@@ -1135,11 +1202,16 @@ EC_T_BOOL CEmNotification::ProcessNotificationJobs(EC_T_VOID)
             } break;
 #endif /* INCLUDE_EC_MASTER */
         default:
-              continue; /* next job queued */
+            bKnownJob = EC_FALSE;
+            break;
         } /* switch job type */
 
-        bProcessed = EC_TRUE;
-    } /* while job queued */
+        ReleaseJob();
+        if (bKnownJob)
+        {
+            bProcessed = EC_TRUE;
+        }
+    } /* for job queued */
 
 #if (defined NO_OS)
     ((CAtEmLogging*)GetLogParms()->pLogContext)->ProcessAllMsgs();
@@ -1322,101 +1394,736 @@ EC_T_VOID CEmNotification::ResetErrorCounters(EC_T_VOID)
 
 /*****************************************************************************/
 /**
- * \brief  Increment Pointer in Queue.
+ * \brief  EnqueueJob.
  *
- * \return New Pointer.
+ * Enqueue new Job to queue, may be called concurrently from any context calling ecatNotify.
+ * Only dwSize bytes of job data are copied into the slot.
+ * \return EC_TRUE on success, EC_FALSE if the queue is full.
  */
-PT_SLAVEJOBS CEmNotification::IncrementJobPtr(PT_SLAVEJOBS pPtr)
+EC_T_BOOL CEmNotification::EnqueueJob(
+    EC_T_DWORD dwCode,      /**< [in]   Notification code */
+    EC_T_VOID* pSrc,        /**< [in]   Job data */
+    EC_T_DWORD dwSize       /**< [in]   Size of job data in bytes */
+                                     )
 {
-    PT_SLAVEJOBS pRet = EC_NULL;
+    EC_T_BOOL       bRet    = EC_FALSE;
+    T_SLAVEJOBSLOT* pSlot   = EC_NULL;
+    EC_T_DWORD      dwPos   = __atomic_load_n(&m_oSlaveJobQueue.dwEnqueuePos, __ATOMIC_RELAXED);
+    EC_T_INT        nDiff   = 0;
 
-    if (EC_NULL == pPtr)
+    if (dwSize > sizeof(T_JobData))
     {
         goto Exit;
     }
 
-    if ((EC_T_PVOID)(pPtr + 1) > (EC_T_PVOID)(&m_oSlaveJobQueue.Jobs[JOB_QUEUE_LENGTH - 1]))
+    /* claim a position */
+    for (;;)
     {
-        /* wrap */
-        pRet = &(m_oSlaveJobQueue.Jobs[0]);
+        pSlot = &m_oSlaveJobQueue.Slots[dwPos & (JOB_QUEUE_LENGTH - 1)];
+        nDiff = (EC_T_INT)(__atomic_load_n(&pSlot->dwSequence, __ATOMIC_ACQUIRE) - dwPos);
+        if (0 == nDiff)
+        {
+            if (__atomic_compare_exchange_n(&m_oSlaveJobQueue.dwEnqueuePos, &dwPos, dwPos + 1, EC_FALSE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                break;
+            }
+            /* dwPos was updated by the failed exchange */
+        }
+        else if (nDiff < 0)
+        {
+            /* no more space in queue, slot not released by the consumer yet */
+            goto Exit;
+        }
+        else
+        {
+            dwPos = __atomic_load_n(&m_oSlaveJobQueue.dwEnqueuePos, __ATOMIC_RELAXED);
+        }
     }
-    else
+
+    /* store job */
+    pSlot->Job.dwCode = dwCode;
+    if (0 != dwSize)
     {
-        pRet = (pPtr + 1);
+        OsMemcpy(&pSlot->Job.JobData, pSrc, dwSize);
     }
+
+    /* publish to the consumer */
+    __atomic_store_n(&pSlot->dwSequence, dwPos + 1, __ATOMIC_RELEASE);
+
+    bRet = EC_TRUE;
 Exit:
-    return pRet;
+    if (!bRet)
+    {
+        /* no logging here, reported by ProcessNotificationJobs */
+        CountJobOverflow(dwCode);
+    }
+
+    return bRet;
 }
 
 /*****************************************************************************/
 /**
- * \brief  EnqueueJob.
+ * \brief  PeekJob.
  *
- * Enqueue new Job to queue.
- * \return EC_TRUE on success, EC_FALSE otherwise.
+ * Get next job in place, the slot stays owned by the consumer until ReleaseJob.
+ * \return Job or EC_NULL if no job is ready.
  */
-EC_T_BOOL CEmNotification::EnqueueJob(
-    PT_SLAVEJOBS pJob,
-    EC_T_DWORD dwCode,
-    EC_T_VOID* pSrc,
-    EC_T_DWORD dwSize
-                                     )
+PT_SLAVEJOBS CEmNotification::PeekJob(EC_T_VOID)
 {
-    EC_T_BOOL    bRet      = EC_FALSE;
-    PT_SLAVEJOBS pNewWrite = EC_NULL;
+    T_SLAVEJOBSLOT* pSlot = &m_oSlaveJobQueue.Slots[m_oSlaveJobQueue.dwDequeuePos & (JOB_QUEUE_LENGTH - 1)];
 
-    pNewWrite = IncrementJobPtr(m_oSlaveJobQueue.pWrite);
+    if (__atomic_load_n(&pSlot->dwSequence, __ATOMIC_ACQUIRE) != m_oSlaveJobQueue.dwDequeuePos + 1)
+    {
+        return EC_NULL;
+    }
+    return &pSlot->Job;
+}
 
-    if (pNewWrite == m_oSlaveJobQueue.pRead)
+/*****************************************************************************/
+/**
+ * \brief  ReleaseJob.
+ *
+ * Hand the slot of the job returned by PeekJob back to the producers.
+ */
+EC_T_VOID CEmNotification::ReleaseJob(EC_T_VOID)
+{
+    T_SLAVEJOBSLOT* pSlot = &m_oSlaveJobQueue.Slots[m_oSlaveJobQueue.dwDequeuePos & (JOB_QUEUE_LENGTH - 1)];
+
+    __atomic_store_n(&pSlot->dwSequence, m_oSlaveJobQueue.dwDequeuePos + JOB_QUEUE_LENGTH, __ATOMIC_RELEASE);
+    m_oSlaveJobQueue.dwDequeuePos++;
+}
+
+/*****************************************************************************/
+/**
+ * \brief  CountJobOverflow.
+ *
+ * Count a job dropped because the queue was full. Codes beyond JOB_OVERFLOW_CODES share the last counter.
+ */
+EC_T_VOID CEmNotification::CountJobOverflow(
+    EC_T_DWORD dwCode       /**< [in]   Notification code of the dropped job */
+                                           )
+{
+    EC_T_DWORD dwKey = dwCode + 1;
+    EC_T_DWORD dwIdx = 0;
+
+    for (dwIdx = 0; dwIdx < JOB_OVERFLOW_CODES - 1; dwIdx++)
     {
-        /* no more space in queue */
-        goto Exit;
+        EC_T_DWORD dwExpected = 0;
+        T_JOBOVERFLOW* pOverflow = &m_oSlaveJobQueue.aOverflow[dwIdx];
+
+        if ((__atomic_load_n(&pOverflow->dwKey, __ATOMIC_ACQUIRE) == dwKey)
+         || __atomic_compare_exchange_n(&pOverflow->dwKey, &dwExpected, dwKey, EC_FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+         || (dwExpected == dwKey))
+        {
+            break;
+        }
     }
+    __atomic_fetch_add(&m_oSlaveJobQueue.aOverflow[dwIdx].dwCount, 1, __ATOMIC_RELAXED);
+}
 
-    /* store job */
-    pJob->dwCode = dwCode;
-    OsMemcpy(&pJob->JobData, pSrc, dwSize);
-    OsMemcpy(m_oSlaveJobQueue.pWrite, pJob, sizeof(T_SLAVEJOBS));
+/*****************************************************************************/
+/**
+ * \brief  ReportJobOverflows.
+ *
+ * Log jobs dropped since the last call, once per notification code.
+ */
+EC_T_VOID CEmNotification::ReportJobOverflows(EC_T_VOID)
+{
+    for (EC_T_DWORD dwIdx = 0; dwIdx < JOB_OVERFLOW_CODES; dwIdx++)
+    {
+        T_JOBOVERFLOW* pOverflow = &m_oSlaveJobQueue.aOverflow[dwIdx];
+        EC_T_DWORD     dwKey     = __atomic_load_n(&pOverflow->dwKey, __ATOMIC_ACQUIRE);
+        EC_T_DWORD     dwCount   = __atomic_load_n(&pOverflow->dwCount, __ATOMIC_RELAXED);
 
-    /* increment write pointer */
-    m_oSlaveJobQueue.pWrite = pNewWrite;
+        if (dwCount == pOverflow->dwReported)
+        {
+            continue;
+        }
+        if (dwIdx == JOB_OVERFLOW_CODES - 1)
+        {
+            EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "ERROR: Unable to enqueue %d jobs of other notifications! Missing calls to ProcessNotificationJobs or queue too small.\n",
+                dwCount - pOverflow->dwReported));
+        }
+        else
+        {
+            EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "ERROR: Unable to enqueue %d %s jobs! Missing calls to ProcessNotificationJobs or queue too small.\n",
+                dwCount - pOverflow->dwReported, GetNotifyText(dwKey - 1)));
+        }
+        pOverflow->dwReported = dwCount;
+    }
+}
 
-    bRet = EC_TRUE;
-Exit:
-    if (!bRet)
+/*****************************************************************************/
+/**
+ * \brief  GetJobOverflowCount.
+ *
+ * \return Number of jobs of dwCode dropped because the queue was full.
+ */
+EC_T_DWORD CEmNotification::GetJobOverflowCount(
+    EC_T_DWORD dwCode       /**< [in]   Notification code */
+                                               )
+{
+    for (EC_T_DWORD dwIdx = 0; dwIdx < JOB_OVERFLOW_CODES - 1; dwIdx++)
     {
-        EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "ERROR: Unable to enqueue %s job! Missing calls to ProcessNotificationJobs or queue too small.\n", GetNotifyText(dwCode)));
+        if (__atomic_load_n(&m_oSlaveJobQueue.aOverflow[dwIdx].dwKey, __ATOMIC_ACQUIRE) == dwCode + 1)
+        {
+            return __atomic_load_n(&m_oSlaveJobQueue.aOverflow[dwIdx].dwCount, __ATOMIC_RELAXED);
+        }
     }
+    return 0;
+}
 
-    return bRet;
+/*****************************************************************************/
+/**
+ * \brief  SetNotifyFilter.
+ *
+ * Parse "<code>=<off|error|warning|info|all>,..." for error notifications. The code is given with or
+ * without EC_NOTIFY_ERROR. error/warning/info is the lowest application log level at which the code is
+ * logged, not the severity of the message. "all" logs every notification of the code without rate limit.
+ * \return EC_E_NOERROR or EC_E_INVALIDPARM, entries before the invalid one are applied.
+ */
+EC_T_DWORD CEmNotification::SetNotifyFilter(
+    const EC_T_CHAR* szFilter   /**< [in]   Filter, EC_NULL or empty: keep the defaults */
+                                           )
+{
+    const EC_T_CHAR* pszPos = szFilter;
+    EC_T_CHAR*       pszEnd = EC_NULL;
+    EC_T_DWORD       dwCode = 0;
+    EC_T_DWORD       dwLen  = 0;
+    EC_T_BYTE        byFilter = 0;
+
+    while ((EC_NULL != pszPos) && ('\0' != *pszPos))
+    {
+        dwCode = (EC_T_DWORD)OsStrtoul(pszPos, &pszEnd, 0);
+        if ((pszEnd == pszPos) || ('=' != *pszEnd)
+            || (((dwCode & ~0xFFFF) != 0) && ((dwCode & ~0xFFFF) != EC_NOTIFY_ERROR)) || ((dwCode & 0xFFFF) >= MAX_NOTIFY_CODES))
+        {
+            return EC_E_INVALIDPARM;
+        }
+        dwCode &= 0xFFFF;
+        pszPos = pszEnd + 1;
+        for (dwLen = 0; ('\0' != pszPos[dwLen]) && (',' != pszPos[dwLen]); dwLen++);
+
+        byFilter = (EC_T_BYTE)(m_abyNotifyFilter[dwCode] & (NOTIFY_FILTER_COALESCE | NOTIFY_FILTER_KEEP));
+        if      ((3 == dwLen) && (0 == OsStrncmp(pszPos, "off", 3)))     byFilter |= NOTIFY_FILTER_DISABLED | EC_LOG_LEVEL_ERROR;
+        else if ((5 == dwLen) && (0 == OsStrncmp(pszPos, "error", 5)))   byFilter |= EC_LOG_LEVEL_ERROR;
+        else if ((7 == dwLen) && (0 == OsStrncmp(pszPos, "warning", 7))) byFilter |= EC_LOG_LEVEL_WARNING;
+        else if ((4 == dwLen) && (0 == OsStrncmp(pszPos, "info", 4)))    byFilter |= EC_LOG_LEVEL_INFO;
+        else if ((3 == dwLen) && (0 == OsStrncmp(pszPos, "all", 3)))     byFilter = (EC_T_BYTE)((byFilter & NOTIFY_FILTER_KEEP) | EC_LOG_LEVEL_ERROR);
+        else
+        {
+            return EC_E_INVALIDPARM;
+        }
+        m_abyNotifyFilter[dwCode] = byFilter;
+
+        pszPos += dwLen;
+        if (',' == *pszPos)
+        {
+            pszPos++;
+        }
+    }
+    return EC_E_NOERROR;
 }
 
 /*****************************************************************************/
 /**
- * \brief  DequeueJob.
+ * \brief  GetNotifyStat.
  *
- * Dequeue next job if possible.
- * \return EC_TRUE on success, EC_FALSE otherwise.
+ * \return Notification counts in the shared memory, local counts until it is created.
  */
-EC_T_BOOL CEmNotification::DequeueJob(
-    PT_SLAVEJOBS    pJob    /**< [out]  Dequeued Job Object */
-                                     )
+rocos::NotificationStat* CEmNotification::GetNotifyStat(EC_T_VOID)
 {
-    EC_T_BOOL bRet = EC_FALSE;
+    return (EC_NULL != pAppContext->pvNotifyStat) ? (rocos::NotificationStat*)pAppContext->pvNotifyStat : &m_oLocalNotifyStat;
+}
 
-    if ((EC_NULL == pJob) || (m_oSlaveJobQueue.pRead == m_oSlaveJobQueue.pWrite))
+/*****************************************************************************/
+/**
+ * \brief  FilterNotification.
+ *
+ * Count an error notification and decide in O(1) whether ecatNotify processes it. Disabled codes and
+ * codes whose filter level is above the application log level are dropped, coalesced codes pass at most once per
+ * dwNotifyRateLimitMsec and slave, the skipped ones are summarized with the next one that passes.
+ * \return EC_TRUE if the notification is processed.
+ */
+EC_T_BOOL CEmNotification::FilterNotification(
+    EC_T_DWORD          dwCode,     /**< [in]   Notification code */
+    EC_T_NOTIFYPARMS*   pParms      /**< [in]   Notification data */
+                                             )
+{
+    rocos::NotificationStat* pStat     = EC_NULL;
+    rocos::NotifyCount*      pCount    = EC_NULL;
+    EC_T_DWORD               dwIdx     = dwCode & 0xFFFF;
+    EC_T_BYTE                byFilter  = 0;
+    EC_T_DWORD               dwNow     = 0;
+    EC_T_DWORD               dwNextLog = 0;
+    EC_T_DWORD               dwPending = 0;
+
+    if (((dwCode & ~0xFFFF) != EC_NOTIFY_ERROR) || (dwIdx >= MAX_NOTIFY_CODES))
     {
-        goto Exit;
+        return EC_TRUE;
     }
+    pStat = GetNotifyStat();
+    __atomic_fetch_add(&pStat->error_count[dwIdx], 1, __ATOMIC_RELAXED);
 
-    OsMemcpy(pJob, m_oSlaveJobQueue.pRead, sizeof(T_SLAVEJOBS));
+    byFilter = m_abyNotifyFilter[dwIdx];
+    if (0 != (byFilter & NOTIFY_FILTER_KEEP))
+    {
+        return EC_TRUE;
+    }
+    if ((0 != (byFilter & NOTIFY_FILTER_DISABLED)) || ((EC_T_DWORD)(byFilter & NOTIFY_FILTER_LEVEL_MASK) > pAppContext->AppParms.dwAppLogLevel))
+    {
+        __atomic_fetch_add(&pStat->filtered, 1, __ATOMIC_RELAXED);
+        return EC_FALSE;
+    }
+    if ((0 == (byFilter & NOTIFY_FILTER_COALESCE)) || (0 == m_dwNotifyRateLimitMsec))
+    {
+        return EC_TRUE;
+    }
 
-    /* Increment Read Pointer */
-    m_oSlaveJobQueue.pRead = IncrementJobPtr(m_oSlaveJobQueue.pRead);
+    pCount = FindNotifyCount(pStat, dwCode, GetNotifySlaveAddress(dwCode, pParms));
+    if (EC_NULL == pCount)
+    {
+        return EC_TRUE;
+    }
+    __atomic_fetch_add(&pCount->count, 1, __ATOMIC_RELAXED);
 
-    bRet = EC_TRUE;
-Exit:
-    return bRet;
+    dwNow     = OsQueryMsecCount();
+    dwNextLog = __atomic_load_n(&pCount->next_log, __ATOMIC_RELAXED);
+    if (((EC_T_INT)(dwNow - dwNextLog) < 0)
+        || !__atomic_compare_exchange_n(&pCount->next_log, &dwNextLog, dwNow + m_dwNotifyRateLimitMsec, EC_FALSE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+        /* logged recently (by another thread) */
+        __atomic_fetch_add(&pCount->pending, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&pCount->suppressed, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&pStat->suppressed, 1, __ATOMIC_RELAXED);
+        return EC_FALSE;
+    }
+
+    dwPending = __atomic_exchange_n(&pCount->pending, 0, __ATOMIC_RELAXED);
+    if (0 != dwPending)
+    {
+        EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "%d further %s notifications from slave %d\n",
+            dwPending, GetNotifyText(dwCode), pCount->station_address));
+    }
+    return EC_TRUE;
+}
+
+/*****************************************************************************/
+/**
+ * \brief  PublishEvent.
+ *
+ * Push the notifications clients react on into the event ring of the shared memory, independent of
+ * the notification filter and the log.
+ */
+EC_T_VOID CEmNotification::PublishEvent(
+    EC_T_DWORD          dwCode,     /**< [in]   Notification code */
+    EC_T_NOTIFYPARMS*   pParms      /**< [in]   Notification data */
+                                       )
+{
+    EC_T_NOTIFICATION_DESC*       pNotificationDesc      = (EC_T_NOTIFICATION_DESC*)pParms->pbyInBuf;
+    EC_T_ERROR_NOTIFICATION_DESC* pErrorNotificationDesc = (EC_T_ERROR_NOTIFICATION_DESC*)pParms->pbyInBuf;
+    EC_T_DWORD                    dwIdx                  = 0;
+
+    if ((EC_NULL == pAppContext->pvEventRing) || (EC_NULL == pParms->pbyInBuf))
+    {
+        return;
+    }
+    switch (dwCode)
+    {
+    case EC_NOTIFY_STATECHANGED:
+        {
+            EC_T_STATECHANGE* pStateChangeParms = (EC_T_STATECHANGE*)pParms->pbyInBuf;
+            PostEvent(ECAT_EVENT_MASTER_STATE, dwCode, 0, pStateChangeParms->newState, pStateChangeParms->oldState, 0);
+        } break;
+    case EC_NOTIFY_SLAVE_STATECHANGED:
+        PostEvent(ECAT_EVENT_SLAVE_STATE, dwCode, pNotificationDesc->desc.SlaveStateChangedDesc.SlaveProp.wStationAddress,
+            pNotificationDesc->desc.SlaveStateChangedDesc.newState, 0, 0);
+        break;
+    case EC_NOTIFY_SLAVES_STATECHANGED:
+        for (dwIdx = 0; dwIdx < pNotificationDesc->desc.SlavesStateChangedDesc.wCount; dwIdx++)
+        {
+            PostEvent(ECAT_EVENT_SLAVE_STATE, dwCode, pNotificationDesc->desc.SlavesStateChangedDesc.SlaveStates[dwIdx].wStationAddress,
+                pNotificationDesc->desc.SlavesStateChangedDesc.SlaveStates[dwIdx].byState, 0, 0);
+        }
+        break;
+    case EC_NOTIFY_SLAVE_UNEXPECTED_STATE:
+        PostEvent(ECAT_EVENT_UNEXPECTED_STATE, dwCode, pErrorNotificationDesc->desc.SlaveUnexpectedStateDesc.SlaveProp.wStationAddress,
+            pErrorNotificationDesc->desc.SlaveUnexpectedStateDesc.curState, pErrorNotificationDesc->desc.SlaveUnexpectedStateDesc.expState, 0);
+        break;
+    case EC_NOTIFY_SLAVES_UNEXPECTED_STATE:
+        for (dwIdx = 0; dwIdx < pErrorNotificationDesc->desc.SlavesUnexpectedStateDesc.wCount; dwIdx++)
+        {
+            PostEvent(ECAT_EVENT_UNEXPECTED_STATE, dwCode, pErrorNotificationDesc->desc.SlavesUnexpectedStateDesc.SlaveStates[dwIdx].wStationAddress,
+                pErrorNotificationDesc->desc.SlavesUnexpectedStateDesc.SlaveStates[dwIdx].curState,
+                pErrorNotificationDesc->desc.SlavesUnexpectedStateDesc.SlaveStates[dwIdx].expState, 0);
+        }
+        break;
+    case EC_NOTIFY_SLAVE_ERROR_STATUS_INFO:
+        PostEvent(ECAT_EVENT_AL_STATUS_ERROR, dwCode, pErrorNotificationDesc->desc.SlaveErrInfoDesc.SlaveProp.wStationAddress,
+            pErrorNotificationDesc->desc.SlaveErrInfoDesc.wStatus, pErrorNotificationDesc->desc.SlaveErrInfoDesc.wStatusCode, 0);
+        break;
+    case EC_NOTIFY_SLAVES_ERROR_STATUS:
+        for (dwIdx = 0; dwIdx < pErrorNotificationDesc->desc.SlavesErrDesc.wCount; dwIdx++)
+        {
+            PostEvent(ECAT_EVENT_AL_STATUS_ERROR, dwCode, pErrorNotificationDesc->desc.SlavesErrDesc.SlaveError[dwIdx].wStationAddress,
+                pErrorNotificationDesc->desc.SlavesErrDesc.SlaveError[dwIdx].wStatus,
+                pErrorNotificationDesc->desc.SlavesErrDesc.SlaveError[dwIdx].wStatusCode, 0);
+        }
+        break;
+    case EC_NOTIFY_CYCCMD_WKC_ERROR:
+        PostEvent(ECAT_EVENT_WKC_ERROR, dwCode, 0, 0,
+            pErrorNotificationDesc->desc.WkcErrDesc.wWkcAct, pErrorNotificationDesc->desc.WkcErrDesc.wWkcSet);
+        break;
+    case EC_NOTIFY_FRAME_RESPONSE_ERROR:
+        PostEvent(ECAT_EVENT_FRAME_LOSS, dwCode, 0, 0, pErrorNotificationDesc->desc.FrameRspErrDesc.bIsCyclicFrame ? 1 : 0, 0);
+        break;
+    case EC_NOTIFY_FRAMELOSS_AFTER_SLAVE:
+        PostEvent(ECAT_EVENT_FRAME_LOSS, dwCode, pErrorNotificationDesc->desc.FramelossAfterSlaveDesc.SlaveProp.wStationAddress, 0,
+            1, pErrorNotificationDesc->desc.FramelossAfterSlaveDesc.wPort);
+        break;
+    case EC_NOTIFY_DC_SLV_SYNC:
+        PostEvent(ECAT_EVENT_DC_SYNC, dwCode, pNotificationDesc->desc.SyncNtfyDesc.IsInSync ? 0 : pNotificationDesc->desc.SyncNtfyDesc.SlaveProp.wStationAddress, 0,
+            pNotificationDesc->desc.SyncNtfyDesc.IsInSync ? 1 : 0,
+            pNotificationDesc->desc.SyncNtfyDesc.IsNegative ? -(EC_T_INT)pNotificationDesc->desc.SyncNtfyDesc.dwDeviation : (EC_T_INT)pNotificationDesc->desc.SyncNtfyDesc.dwDeviation);
+        break;
+    case EC_NOTIFY_DCM_SYNC:
+        PostEvent(ECAT_EVENT_DC_SYNC, dwCode, 0, 0,
+            pNotificationDesc->desc.DcmInSyncDesc.IsInSync ? 1 : 0, pNotificationDesc->desc.DcmInSyncDesc.nCtlErrorNsecCur);
+        break;
+    case EC_NOTIFY_ETH_LINK_CONNECTED:
+    case EC_NOTIFY_ETH_LINK_NOT_CONNECTED:
+        PostEvent(ECAT_EVENT_LINK, dwCode, 0, 0, (EC_NOTIFY_ETH_LINK_CONNECTED == dwCode) ? 1 : 0, 0);
+        break;
+    case EC_NOTIFY_ALL_DEVICES_OPERATIONAL:
+    case EC_NOTIFY_NOT_ALL_DEVICES_OPERATIONAL:
+        PostEvent(ECAT_EVENT_ALL_OPERATIONAL, dwCode, 0, 0, (EC_NOTIFY_ALL_DEVICES_OPERATIONAL == dwCode) ? 1 : 0, 0);
+        break;
+    case EC_NOTIFY_PDIWATCHDOG:
+        PostEvent(ECAT_EVENT_PDI_WATCHDOG, dwCode, pErrorNotificationDesc->desc.PdiWatchdogDesc.SlaveProp.wStationAddress, 0, 0, 0);
+        break;
+    default:
+        break;
+    }
+}
+
+/*****************************************************************************/
+/**
+ * \brief  PostEvent.
+ */
+EC_T_VOID CEmNotification::PostEvent(
+    EC_T_INT            nType,              /**< [in]   ECAT_EVENT_... */
+    EC_T_DWORD          dwCode,             /**< [in]   Notification code */
+    EC_T_WORD           wStationAddress,    /**< [in]   Station address, 0: not slave specific */
+    EC_T_INT            nState,             /**< [in]   State, see ECAT_EVENT_... */
+    EC_T_INT            nValue0,            /**< [in]   Value, see ECAT_EVENT_... */
+    EC_T_INT            nValue1             /**< [in]   Value, see ECAT_EVENT_... */
+                                    )
+{
+    rocos::EcatEvent oEvent;
+
+    oEvent.type            = nType;
+    oEvent.code            = dwCode;
+    oEvent.timestamp       = GetTimestampUsec();
+    oEvent.station_address = wStationAddress;
+    oEvent.state           = nState;
+    oEvent.value[0]        = nValue0;
+    oEvent.value[1]        = nValue1;
+    rocos::postEvent((rocos::EventRing*)pAppContext->pvEventRing, oEvent);
+}
+
+/*****************************************************************************/
+/**
+ * \brief  GetSlaveDiagnostics.
+ *
+ * \return Diagnostics counters of the slave, EC_NULL if it is not configured.
+ */
+rocos::SlaveDiagnostics* CEmNotification::GetSlaveDiagnostics(
+    EC_T_WORD           wStationAddress     /**< [in]   Station address */
+                                                             )
+{
+    rocos::EcatDiagnostics* pDiagnostics = (rocos::EcatDiagnostics*)pAppContext->pvDiagnostics;
+    EC_T_DWORD              dwSlaveIdx   = (EC_T_DWORD)(wStationAddress - EC_STATION_ADDRESS_BASE);
+
+    if ((EC_NULL == pDiagnostics) || (0 == wStationAddress))
+    {
+        return EC_NULL;
+    }
+    /* slave i has station address EC_STATION_ADDRESS_BASE + i with ENIs of EC-Engineer */
+    if ((dwSlaveIdx < MAX_SLAVE_NUM) && (pDiagnostics->slaves[dwSlaveIdx].station_address == wStationAddress))
+    {
+        return &pDiagnostics->slaves[dwSlaveIdx];
+    }
+    for (dwSlaveIdx = 0; dwSlaveIdx < MAX_SLAVE_NUM; dwSlaveIdx++)
+    {
+        if (pDiagnostics->slaves[dwSlaveIdx].station_address == wStationAddress)
+        {
+            return &pDiagnostics->slaves[dwSlaveIdx];
+        }
+    }
+    return EC_NULL;
+}
+
+/*****************************************************************************/
+/**
+ * \brief  UpdateDiagnostics.
+ *
+ * Count the error notifications per slave in the diagnostics of the shared memory, independent of the
+ * notification filter and the log. The per slave WKC errors are counted by the job task.
+ */
+EC_T_VOID CEmNotification::UpdateDiagnostics(
+    EC_T_DWORD          dwCode,     /**< [in]   Notification code */
+    EC_T_NOTIFYPARMS*   pParms      /**< [in]   Notification data */
+                                            )
+{
+    rocos::EcatDiagnostics*       pDiagnostics           = (rocos::EcatDiagnostics*)pAppContext->pvDiagnostics;
+    EC_T_NOTIFICATION_DESC*       pNotificationDesc      = (EC_T_NOTIFICATION_DESC*)pParms->pbyInBuf;
+    EC_T_ERROR_NOTIFICATION_DESC* pErrorNotificationDesc = (EC_T_ERROR_NOTIFICATION_DESC*)pParms->pbyInBuf;
+    rocos::SlaveDiagnostics*      pSlave                 = EC_NULL;
+    EC_T_DWORD                    dwIdx                  = 0;
+
+    if ((EC_NULL == pDiagnostics) || (EC_NULL == pParms->pbyInBuf))
+    {
+        return;
+    }
+    switch (dwCode)
+    {
+    case EC_NOTIFY_CYCCMD_WKC_ERROR:
+        __atomic_fetch_add(&pDiagnostics->cyclic_wkc_errors, 1, __ATOMIC_RELAXED);
+        break;
+    case EC_NOTIFY_FRAME_RESPONSE_ERROR:
+        if (pErrorNotificationDesc->desc.FrameRspErrDesc.bIsCyclicFrame)
+        {
+            __atomic_fetch_add(&pDiagnostics->cyclic_frame_losses, 1, __ATOMIC_RELAXED);
+        }
+        break;
+    case EC_NOTIFY_FRAMELOSS_AFTER_SLAVE:
+        pSlave = GetSlaveDiagnostics(pErrorNotificationDesc->desc.FramelossAfterSlaveDesc.SlaveProp.wStationAddress);
+        if (EC_NULL != pSlave)
+        {
+            __atomic_fetch_add(&pSlave->frame_losses, 1, __ATOMIC_RELAXED);
+        }
+        break;
+    case EC_NOTIFY_SLAVE_ERROR_STATUS_INFO:
+        pSlave = GetSlaveDiagnostics(pErrorNotificationDesc->desc.SlaveErrInfoDesc.SlaveProp.wStationAddress);
+        if (EC_NULL != pSlave)
+        {
+            pSlave->al_status      = pErrorNotificationDesc->desc.SlaveErrInfoDesc.wStatus;
+            pSlave->al_status_code = pErrorNotificationDesc->desc.SlaveErrInfoDesc.wStatusCode;
+            __atomic_fetch_add(&pSlave->al_status_errors, 1, __ATOMIC_RELAXED);
+        }
+        break;
+    case EC_NOTIFY_SLAVES_ERROR_STATUS:
+        for (dwIdx = 0; dwIdx < pErrorNotificationDesc->desc.SlavesErrDesc.wCount; dwIdx++)
+        {
+            pSlave = GetSlaveDiagnostics(pErrorNotificationDesc->desc.SlavesErrDesc.SlaveError[dwIdx].wStationAddress);
+            if (EC_NULL != pSlave)
+            {
+                pSlave->al_status      = pErrorNotificationDesc->desc.SlavesErrDesc.SlaveError[dwIdx].wStatus;
+                pSlave->al_status_code = pErrorNotificationDesc->desc.SlavesErrDesc.SlaveError[dwIdx].wStatusCode;
+                __atomic_fetch_add(&pSlave->al_status_errors, 1, __ATOMIC_RELAXED);
+            }
+        }
+        break;
+    case EC_NOTIFY_SLAVE_STATECHANGED:
+        pSlave = GetSlaveDiagnostics(pNotificationDesc->desc.SlaveStateChangedDesc.SlaveProp.wStationAddress);
+        if (EC_NULL != pSlave)
+        {
+            pSlave->state             = pNotificationDesc->desc.SlaveStateChangedDesc.newState;
+            pSlave->last_state_change = GetTimestampUsec();
+            __atomic_fetch_add(&pSlave->state_changes, 1, __ATOMIC_RELAXED);
+        }
+        break;
+    case EC_NOTIFY_SLAVES_STATECHANGED:
+        for (dwIdx = 0; dwIdx < pNotificationDesc->desc.SlavesStateChangedDesc.wCount; dwIdx++)
+        {
+            pSlave = GetSlaveDiagnostics(pNotificationDesc->desc.SlavesStateChangedDesc.SlaveStates[dwIdx].wStationAddress);
+            if (EC_NULL != pSlave)
+            {
+                pSlave->state             = pNotificationDesc->desc.SlavesStateChangedDesc.SlaveStates[dwIdx].byState;
+                pSlave->last_state_change = GetTimestampUsec();
+                __atomic_fetch_add(&pSlave->state_changes, 1, __ATOMIC_RELAXED);
+            }
+        }
+        break;
+    case EC_NOTIFY_SLAVE_UNEXPECTED_STATE:
+        pSlave = GetSlaveDiagnostics(pErrorNotificationDesc->desc.SlaveUnexpectedStateDesc.SlaveProp.wStationAddress);
+        if (EC_NULL != pSlave)
+        {
+            pSlave->state = pErrorNotificationDesc->desc.SlaveUnexpectedStateDesc.curState;
+            __atomic_fetch_add(&pSlave->unexpected_states, 1, __ATOMIC_RELAXED);
+        }
+        break;
+    case EC_NOTIFY_SLAVES_UNEXPECTED_STATE:
+        for (dwIdx = 0; dwIdx < pErrorNotificationDesc->desc.SlavesUnexpectedStateDesc.wCount; dwIdx++)
+        {
+            pSlave = GetSlaveDiagnostics(pErrorNotificationDesc->desc.SlavesUnexpectedStateDesc.SlaveStates[dwIdx].wStationAddress);
+            if (EC_NULL != pSlave)
+            {
+                pSlave->state = pErrorNotificationDesc->desc.SlavesUnexpectedStateDesc.SlaveStates[dwIdx].curState;
+                __atomic_fetch_add(&pSlave->unexpected_states, 1, __ATOMIC_RELAXED);
+            }
+        }
+        break;
+    case EC_NOTIFY_EOE_MBXSND_WKC_ERROR:
+    case EC_NOTIFY_COE_MBXSND_WKC_ERROR:
+    case EC_NOTIFY_FOE_MBXSND_WKC_ERROR:
+    case EC_NOTIFY_SOE_MBXSND_WKC_ERROR:
+    case EC_NOTIFY_VOE_MBXSND_WKC_ERROR:
+    case EC_NOTIFY_MBSLAVE_COE_SDO_ABORT:
+    case EC_NOTIFY_FOE_MBSLAVE_ERROR:
+    case EC_NOTIFY_MBXRCV_INVALID_DATA:
+    case EC_NOTIFY_SOE_WRITE_ERROR:
+        switch (dwCode)
+        {
+        case EC_NOTIFY_MBSLAVE_COE_SDO_ABORT: pSlave = GetSlaveDiagnostics(pErrorNotificationDesc->desc.SdoAbortDesc.SlaveProp.wStationAddress);          break;
+        case EC_NOTIFY_FOE_MBSLAVE_ERROR:     pSlave = GetSlaveDiagnostics(pErrorNotificationDesc->desc.FoeErrorDesc.SlaveProp.wStationAddress);          break;
+        case EC_NOTIFY_MBXRCV_INVALID_DATA:   pSlave = GetSlaveDiagnostics(pErrorNotificationDesc->desc.MbxRcvInvalidDataDesc.SlaveProp.wStationAddress); break;
+        case EC_NOTIFY_SOE_WRITE_ERROR:       pSlave = GetSlaveDiagnostics(pErrorNotificationDesc->desc.InitCmdErrDesc.SlaveProp.wStationAddress);        break;
+        default:                              pSlave = GetSlaveDiagnostics(pErrorNotificationDesc->desc.WkcErrDesc.SlaveProp.wStationAddress);            break;
+        }
+        if (EC_NULL != pSlave)
+        {
+            __atomic_fetch_add(&pSlave->mailbox_errors, 1, __ATOMIC_RELAXED);
+        }
+        break;
+    case EC_NOTIFY_PDIWATCHDOG:
+        pSlave = GetSlaveDiagnostics(pErrorNotificationDesc->desc.PdiWatchdogDesc.SlaveProp.wStationAddress);
+        if (EC_NULL != pSlave)
+        {
+            __atomic_fetch_add(&pSlave->pdi_watchdogs, 1, __ATOMIC_RELAXED);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/*****************************************************************************/
+/**
+ * \brief  GetNotifySlaveAddress.
+ *
+ * \return Station address of the slave the error notification is about, 0 if not slave specific.
+ */
+EC_T_WORD CEmNotification::GetNotifySlaveAddress(
+    EC_T_DWORD          dwCode,     /**< [in]   Notification code */
+    EC_T_NOTIFYPARMS*   pParms      /**< [in]   Notification data */
+                                                )
+{
+    EC_T_ERROR_NOTIFICATION_DESC* pErrorNotificationDesc = (EC_T_ERROR_NOTIFICATION_DESC*)pParms->pbyInBuf;
+
+    if ((EC_NULL == pErrorNotificationDesc) || (pParms->dwInBufSize < sizeof(EC_T_DWORD)))
+    {
+        return 0;
+    }
+    switch (dwCode)
+    {
+    case EC_NOTIFY_SLAVE_INITCMD_WKC_ERROR:
+    case EC_NOTIFY_EOE_MBXSND_WKC_ERROR:
+    case EC_NOTIFY_COE_MBXSND_WKC_ERROR:
+    case EC_NOTIFY_FOE_MBXSND_WKC_ERROR:
+    case EC_NOTIFY_SOE_MBXSND_WKC_ERROR:
+    case EC_NOTIFY_VOE_MBXSND_WKC_ERROR:
+    case EC_NOTIFY_SLAVE_NOT_ADDRESSABLE:
+        return pErrorNotificationDesc->desc.WkcErrDesc.SlaveProp.wStationAddress;
+    case EC_NOTIFY_SLAVE_ERROR_STATUS_INFO:
+        return pErrorNotificationDesc->desc.SlaveErrInfoDesc.SlaveProp.wStationAddress;
+    case EC_NOTIFY_FRAMELOSS_AFTER_SLAVE:
+        return pErrorNotificationDesc->desc.FramelossAfterSlaveDesc.SlaveProp.wStationAddress;
+    case EC_NOTIFY_SLAVE_UNEXPECTED_STATE:
+        return pErrorNotificationDesc->desc.SlaveUnexpectedStateDesc.SlaveProp.wStationAddress;
+    case EC_NOTIFY_PDIWATCHDOG:
+        return pErrorNotificationDesc->desc.PdiWatchdogDesc.SlaveProp.wStationAddress;
+    case EC_NOTIFY_BAD_CONNECTION:
+        return pErrorNotificationDesc->desc.BadConnectionDesc.SlavePropParent.wStationAddress;
+    default:
+        /* cyclic commands and frames are not slave specific */
+        return 0;
+    }
+}
+
+/*****************************************************************************/
+/**
+ * \brief  FindNotifyCount.
+ *
+ * Find or claim the entry of (dwCode, wStationAddress), probing at most NOTIFY_ENTRY_PROBES entries.
+ * \return Entry, EC_NULL if all probed entries are used by other pairs.
+ */
+rocos::NotifyCount* CEmNotification::FindNotifyCount(
+    rocos::NotificationStat* pStat,             /**< [in]   Notification counts */
+    EC_T_DWORD              dwCode,             /**< [in]   Notification code */
+    EC_T_WORD               wStationAddress     /**< [in]   Station address, 0: not slave specific */
+                                                    )
+{
+    uint64_t   qwKey  = ((((uint64_t)dwCode & 0xFFFF) << 16) | wStationAddress) + 1;
+    uint64_t   qwFree = 0;
+    EC_T_DWORD dwHash = (EC_T_DWORD)(qwKey * 2654435761u);
+
+    for (EC_T_DWORD dwProbe = 0; dwProbe < NOTIFY_ENTRY_PROBES; dwProbe++)
+    {
+        rocos::NotifyCount* pCount = &pStat->entries[(dwHash + dwProbe) % MAX_NOTIFY_ENTRIES];
+        uint64_t            qwEntryKey = __atomic_load_n(&pCount->key, __ATOMIC_ACQUIRE);
+
+        if (qwEntryKey == qwKey)
+        {
+            return pCount;
+        }
+        qwFree = 0;
+        if ((0 == qwEntryKey) && __atomic_compare_exchange_n(&pCount->key, &qwFree, qwKey, EC_FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            pCount->code            = dwCode;
+            pCount->station_address = wStationAddress;
+            return pCount;
+        }
+        if (qwFree == qwKey)
+        {
+            /* claimed by another thread meanwhile */
+            return pCount;
+        }
+    }
+    __atomic_fetch_add(&pStat->entries_full, 1, __ATOMIC_RELAXED);
+    return EC_NULL;
+}
+
+/*****************************************************************************/
+/**
+ * \brief  FlushNotifySummaries.
+ *
+ * Log the notifications suppressed by the rate limit once the interval elapsed without a further one.
+ */
+EC_T_VOID CEmNotification::FlushNotifySummaries(EC_T_VOID)
+{
+    rocos::NotificationStat* pStat     = GetNotifyStat();
+    EC_T_DWORD               dwNow     = OsQueryMsecCount();
+    EC_T_DWORD               dwNextLog = 0;
+    EC_T_DWORD               dwPending = 0;
+
+    if ((0 == m_dwNotifyRateLimitMsec) || ((EC_T_INT)(dwNow - m_dwNextNotifyFlushMsec) < 0))
+    {
+        return;
+    }
+    m_dwNextNotifyFlushMsec = dwNow + NOTIFY_FLUSH_INTERVAL;
+
+    for (EC_T_DWORD dwIdx = 0; dwIdx < MAX_NOTIFY_ENTRIES; dwIdx++)
+    {
+        rocos::NotifyCount* pCount = &pStat->entries[dwIdx];
+
+        if ((0 == __atomic_load_n(&pCount->key, __ATOMIC_ACQUIRE)) || (0 == __atomic_load_n(&pCount->pending, __ATOMIC_RELAXED)))
+        {
+            continue;
+        }
+        dwNextLog = __atomic_load_n(&pCount->next_log, __ATOMIC_RELAXED);
+        if (((EC_T_INT)(dwNow - dwNextLog) < 0)
+            || !__atomic_compare_exchange_n(&pCount->next_log, &dwNextLog, dwNow + m_dwNotifyRateLimitMsec, EC_FALSE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        {
+            continue;
+        }
+        dwPending = __atomic_exchange_n(&pCount->pending, 0, __ATOMIC_RELAXED);
+        if (0 != dwPending)
+        {
+            EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "%d further %s notifications from slave %d\n",
+                dwPending, GetNotifyText(pCount->code | EC_NOTIFY_ERROR), pCount->station_address));
+        }
+    }
 }
 
 #if (defined INCLUDE_EC_MASTER)
@@ -15,13 +15,24 @@
 #ifndef INC_ECINTERFACECOMMON
 #include "EcInterfaceCommon.h"
 #endif
+#include "ecat_type.h"
 
 /*-DEFINES-------------------------------------------------------------------*/
 #if !(defined EC_DEMO_TINY)
-#define JOB_QUEUE_LENGTH     20
+#define JOB_QUEUE_LENGTH     32             /* power of 2 */
 #else
 #define JOB_QUEUE_LENGTH     1
 #endif /* !(defined EC_DEMO_TINY) */
+#define JOB_OVERFLOW_CODES   16             /* notification codes with own overflow counter */
+
+/* error notification filter, one byte per code (dwCode & 0xFFFF), checked before the notification is processed */
+#define NOTIFY_FILTER_LEVEL_MASK    0x0F    /* lowest app log level (EC_LOG_LEVEL_...) the notification is logged at,
+                                               the message itself keeps its own severity */
+#define NOTIFY_FILTER_DISABLED      0x10    /* only counted */
+#define NOTIFY_FILTER_COALESCE      0x20    /* rate limited per slave, see T_EC_DEMO_APP_PARMS::dwNotifyRateLimitMsec */
+#define NOTIFY_FILTER_KEEP          0x40    /* always processed, notification changes the application state */
+#define NOTIFY_ENTRY_PROBES         8       /* max. entries of NotificationStat probed per notification */
+#define NOTIFY_FLUSH_INTERVAL       100     /* msecs between two checks for pending summaries */
 
 /*-TYPEDEFS------------------------------------------------------------------*/
 struct _T_SLAVEJOBS;
@@ -55,13 +66,32 @@ typedef struct _T_SLAVEJOBS
     T_JobData       JobData;
 } T_SLAVEJOBS, *PT_SLAVEJOBS;
 
-typedef struct _T_SLAVEJOBQUEUE
+typedef struct _T_SLAVEJOBSLOT
 {
-    T_SLAVEJOBS     Jobs[JOB_QUEUE_LENGTH];     /* single job is at least size of largest union element,
+    volatile EC_T_DWORD dwSequence;             /* == position: free for the producer of this position,
+                                                 * == position + 1: job stored, ready for the consumer
+                                                 */
+    T_SLAVEJOBS         Job;                    /* single job is at least size of largest union element,
                                                  * which in case (default) is 1500 byte (MAX_EC_DATA_LEN)
                                                  */
-    PT_SLAVEJOBS    pWrite;
-    PT_SLAVEJOBS    pRead;
+} T_SLAVEJOBSLOT;
+
+typedef struct _T_JOBOVERFLOW
+{
+    volatile EC_T_DWORD dwKey;                  /* notification code + 1, 0: unused */
+    volatile EC_T_DWORD dwCount;                /* jobs dropped because the queue was full */
+    EC_T_DWORD          dwReported;             /* dwCount at the last report of ProcessNotificationJobs */
+} T_JOBOVERFLOW;
+
+/* bounded multi-producer single-consumer queue: ecatNotify may be called from the job task,
+ * the RAS thread and the link layer, ProcessNotificationJobs is the only consumer
+ */
+typedef struct _T_SLAVEJOBQUEUE
+{
+    T_SLAVEJOBSLOT      Slots[JOB_QUEUE_LENGTH];
+    volatile EC_T_DWORD dwEnqueuePos;           /* next position claimed by a producer */
+    EC_T_DWORD          dwDequeuePos;           /* next position read by the consumer */
+    T_JOBOVERFLOW       aOverflow[JOB_OVERFLOW_CODES];
 } T_SLAVEJOBQUEUE, *PT_SLAVEJOBQUEUE;
 
 /*-CLASS---------------------------------------------------------------------*/
@@ -114,6 +144,10 @@ public:
     EC_T_BOOL   RasEvalExpired(EC_T_VOID)
                     { return m_bRasEvalExpired; }
 
+    EC_T_DWORD  GetJobOverflowCount(        EC_T_DWORD                      dwCode                      );
+
+    EC_T_DWORD  SetNotifyFilter(            const EC_T_CHAR*                szFilter                    );
+
     struct _T_EC_DEMO_APP_CONTEXT* pAppContext;
 
 private:
@@ -123,6 +157,11 @@ private:
 
     T_SLAVEJOBQUEUE                 m_oSlaveJobQueue;
 
+    EC_T_BYTE                       m_abyNotifyFilter[MAX_NOTIFY_CODES];    /* NOTIFY_FILTER_... by dwCode & 0xFFFF */
+    EC_T_DWORD                      m_dwNotifyRateLimitMsec;                /* 0: coalescing off */
+    EC_T_DWORD                      m_dwNextNotifyFlushMsec;
+    rocos::NotificationStat         m_oLocalNotifyStat;                     /* used until the shared memory is created */
+
     EC_T_BOOL                       m_bAllDevsOperational;
 
     EC_T_DWORD                      m_dwClientID;                           /* ID of registered client */
@@ -141,10 +180,22 @@ private:
         EC_T_DWORD                  dwDataLen;
     } m_SegmentedFoeDownload;
 
-    PT_SLAVEJOBS IncrementJobPtr(   PT_SLAVEJOBS pPtr                                                           );
-
-    EC_T_BOOL   EnqueueJob(         PT_SLAVEJOBS pJob, EC_T_DWORD dwCode, EC_T_VOID* pSrc, EC_T_DWORD dwSize    );
-    EC_T_BOOL   DequeueJob(         PT_SLAVEJOBS pJob                                                           );
+    EC_T_BOOL   EnqueueJob(         EC_T_DWORD dwCode, EC_T_VOID* pSrc, EC_T_DWORD dwSize                       );
+    PT_SLAVEJOBS PeekJob(           EC_T_VOID                                                                   );
+    EC_T_VOID   ReleaseJob(         EC_T_VOID                                                                   );
+    EC_T_VOID   CountJobOverflow(   EC_T_DWORD dwCode                                                           );
+    EC_T_VOID   ReportJobOverflows( EC_T_VOID                                                                   );
+
+    EC_T_BOOL   FilterNotification( EC_T_DWORD dwCode, EC_T_NOTIFYPARMS* pParms                                     );
+    EC_T_WORD   GetNotifySlaveAddress(EC_T_DWORD dwCode, EC_T_NOTIFYPARMS* pParms                                   );
+    rocos::NotifyCount* FindNotifyCount(rocos::NotificationStat* pStat, EC_T_DWORD dwCode, EC_T_WORD wStationAddress);
+    EC_T_VOID   FlushNotifySummaries(EC_T_VOID                                                                  );
+    rocos::NotificationStat* GetNotifyStat(EC_T_VOID                                                            );
+    EC_T_VOID   PublishEvent(       EC_T_DWORD dwCode, EC_T_NOTIFYPARMS* pParms                                     );
+    EC_T_VOID   UpdateDiagnostics(  EC_T_DWORD dwCode, EC_T_NOTIFYPARMS* pParms                                     );
+    rocos::SlaveDiagnostics* GetSlaveDiagnostics(EC_T_WORD wStationAddress                                      );
+    EC_T_VOID   PostEvent(          EC_T_INT nType, EC_T_DWORD dwCode, EC_T_WORD wStationAddress, EC_T_INT nState,
+                                    EC_T_INT nValue0, EC_T_INT nValue1                                          );
 
     const EC_T_CHAR* GetText(EC_T_DWORD dwTextId)
     {
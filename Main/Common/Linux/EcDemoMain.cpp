@@ -15,6 +15,7 @@
 /*-INCLUDES------------------------------------------------------------------*/
 #include "EcDemoApp.h"
 #include "EcDemoTimingTaskPlatform.h"
+#include "EcPlacement.h"
 
 #include <sys/mman.h>
 #include <sys/utsname.h>
@@ -66,6 +67,8 @@ EC_T_DWORD PrepareFlags(int nArgc, char* ppArgv[]) // Add by think 2024.03.02
               << termcolor::reset << std::endl;
     std::cout << termcolor::blue << "== CPU index: " << termcolor::reset << termcolor::bold << FLAGS_cpuidx
               << termcolor::reset << std::endl;
+    std::cout << termcolor::blue << "== Thread placement: " << termcolor::reset << termcolor::bold
+              << (FLAGS_placement.empty() ? "default" : FLAGS_placement) << termcolor::reset << std::endl;
     std::cout << termcolor::blue << "== Remote API server port: " << termcolor::reset << termcolor::bold << FLAGS_sp
               << termcolor::reset << std::endl;
     std::cout << termcolor::blue << "== link layer: " << termcolor::reset << termcolor::bold << FLAGS_link
@@ -136,6 +139,30 @@ EC_T_DWORD SetAppParmsFromFlags(T_EC_DEMO_APP_CONTEXT* pAppContext, T_EC_DEMO_AP
     // -log
     OsSnprintf(pAppParms->szLogFileprefix, sizeof(pAppParms->szLogFileprefix) - 1, "%s", FLAGS_log.c_str()); // 将prefix保存到szLogFilePrefix中
 
+    // -pcap
+#if (defined INCLUDE_PCAP_RECORDER)
+    if (!FLAGS_pcap.empty()) {
+        pAppParms->bPcapRecorder = EC_TRUE;
+        OsSnprintf(pAppParms->szPcapRecorderFileprefix, sizeof(pAppParms->szPcapRecorderFileprefix) - 1, "%s", FLAGS_pcap.c_str());
+        pAppParms->dwPcapRecorderBufferFrameCnt = (EC_T_DWORD)FLAGS_pcapbuf;
+    }
+#endif
+
+    // -flightrec
+#if (defined INCLUDE_FLIGHT_RECORDER)
+    if (!FLAGS_flightrec.empty()) {
+        pAppParms->bFlightRecorder = EC_TRUE;
+        OsSnprintf(pAppParms->szFlightRecorderFileprefix, sizeof(pAppParms->szFlightRecorderFileprefix) - 1, "%s", FLAGS_flightrec.c_str());
+        pAppParms->dwFlightRecorderBufferSize = (EC_T_DWORD)FLAGS_flightbuf * 1024 * 1024;
+        pAppParms->dwFlightRecorderPreTriggerMsec = (EC_T_DWORD)FLAGS_flightpre;
+        pAppParms->dwFlightRecorderPostTriggerMsec = (EC_T_DWORD)FLAGS_flightpost;
+    }
+#endif
+
+    // -notifyrate, -notifyfilter
+    pAppParms->dwNotifyRateLimitMsec = (EC_T_DWORD)FLAGS_notifyrate;
+    OsSnprintf(pAppParms->szNotifyFilter, sizeof(pAppParms->szNotifyFilter) - 1, "%s", FLAGS_notifyfilter.c_str());
+
     // -flash
     if(GetCommandLineFlagInfo("flash" ,&info) && !info.is_default) {
         pAppParms->bFlash = EC_TRUE;
@@ -202,6 +229,12 @@ EC_T_DWORD SetAppParmsFromFlags(T_EC_DEMO_APP_CONTEXT* pAppContext, T_EC_DEMO_AP
     }
     pAppParms->dwNumLinkLayer++;
 
+    // -placement
+    if (EC_E_NOERROR != EcPlacementParse(FLAGS_placement.c_str())) {
+        dwRetVal = EC_E_INVALIDPARM;
+        goto Exit;
+    }
+
 //    if (pAppParms->dwNumLinkLayer > 1) {
 //        dwRetVal = EC_E_INVALIDPARM;
 //        goto Exit;
@@ -456,12 +489,29 @@ int main(int nArgc, char* ppArgv[])
     if ((EC_LOG_LEVEL_SILENT != AppContext.AppParms.dwAppLogLevel) || (EC_LOG_LEVEL_SILENT != AppContext.AppParms.dwMasterLogLevel))
     {
 #if (defined INCLUDE_EC_LOGGING)
-        dwRes = oLogging.InitLogging(INSTANCE_MASTER_DEFAULT, LOG_ROLLOVER, LOG_THREAD_PRIO, AppContext.AppParms.CpuSet, AppContext.AppParms.szLogFileprefix, LOG_THREAD_STACKSIZE, AppContext.AppParms.dwLogBufferMaxMsgCnt);
+        EC_T_WORD wRollOver = LOG_ROLLOVER;
+#if (defined INCLUDE_FILE_LOGGING)
+        /* log files are only written if a prefix is given */
+        bLogFileEnb = !FLAGS_log.empty();
+        qwLogFileRotateSize = (EC_T_UINT64)FLAGS_logsize * 1024 * 1024;
+        dwLogFileRotateTime = (EC_T_DWORD)FLAGS_logtime;
+        dwLogFileRetain = (EC_T_DWORD)FLAGS_logretain;
+        bLogFileCompress = FLAGS_logcompress;
+        if ((0 != qwLogFileRotateSize) || (0 != dwLogFileRotateTime))
+        {
+            /* size / time based rotation replaces the message count based one */
+            wRollOver = 0;
+        }
+#endif
+        dwRes = oLogging.InitLogging(INSTANCE_MASTER_DEFAULT, wRollOver,
+            EcPlacementGetPrio(ePlacementThread_Log, LOG_THREAD_PRIO), EcPlacementGetCpuSet(ePlacementThread_Log, AppContext.AppParms.CpuSet), AppContext.AppParms.szLogFileprefix, LOG_THREAD_STACKSIZE, AppContext.AppParms.dwLogBufferMaxMsgCnt);
         if (EC_E_NOERROR != dwRes)
         {
             dwRetVal = dwRes;
             goto Exit;
         }
+        oLogging.SetBinaryLogging(FLAGS_binlog);
+        oLogging.SetWakeup((EC_T_DWORD)FLAGS_logwatermark, (EC_T_DWORD)FLAGS_logidle);
         AppContext.LogParms.pfLogMsg = CAtEmLogging::LogMsg;
         AppContext.LogParms.pLogContext = (struct _EC_T_LOG_CONTEXT*)&oLogging;
         bLogInitialized = EC_TRUE;
@@ -490,7 +540,8 @@ int main(int nArgc, char* ppArgv[])
         {
             EC_CPUSET_SET(pLinkParms->cpuIstCpuAffinityMask, AppContext.AppParms.dwCpuIndex);
         }
-        pLinkParms->dwIstPriority = RECV_THREAD_PRIO;
+        pLinkParms->cpuIstCpuAffinityMask = EcPlacementGetCpuSet(ePlacementThread_Recv, pLinkParms->cpuIstCpuAffinityMask);
+        pLinkParms->dwIstPriority = EcPlacementGetPrio(ePlacementThread_Recv, RECV_THREAD_PRIO);
 
         OsMemcpy(&pLinkParms->LogParms, &AppContext.LogParms, sizeof(EC_T_LOG_PARMS));
         pLinkParms->LogParms.dwLogLevel = AppContext.AppParms.dwMasterLogLevel;
@@ -511,6 +562,13 @@ int main(int nArgc, char* ppArgv[])
             goto Exit;
         }
     }
+    dwRes = EcPlacementApplyThread(ePlacementThread_Main);
+    if (EC_E_NOERROR != dwRes)
+    {
+        dwRetVal = dwRes;
+        goto Exit;
+    }
+    EcPlacementValidate(AppContext.AppParms.CpuSet, FLAGS_shmnode);
 
     //! 这里就是进入主程序循环了 by think 2024.03.02
     if (EXECUTE_DEMOTIMINGTASK && IsLinkLayerTimingSet(AppContext.AppParms.apLinkParms))
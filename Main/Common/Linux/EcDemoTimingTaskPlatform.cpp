@@ -9,6 +9,7 @@
 #include "EcType.h"
 #include "EcLogging.h"
 #include "EcDemoPlatform.h"
+#include "EcPlacement.h"
 
 #define NSEC_PER_SEC                (1000000000)
 
@@ -32,6 +33,7 @@ EC_T_VOID CDemoTimingTaskPlatform::TimingTask()
     EC_CPUSET_ZERO(CpuSet);
     EC_CPUSET_SET(CpuSet, this->m_dwCpuIndex);
     OsSetThreadAffinity(EC_NULL, CpuSet);
+    EcPlacementApplyThread(ePlacementThread_Timing);
 
     /* get current time */
     clock_gettime(CLOCK_MONOTONIC, &t);
@@ -0,0 +1,516 @@
+/*-----------------------------------------------------------------------------
+ * EcPlacement.cpp
+ * Description              CPU / scheduling placement of the master threads
+ *                          and NUMA placement of the shared memory regions
+ *---------------------------------------------------------------------------*/
+
+/*-LOGGING-------------------------------------------------------------------*/
+#ifndef pEcLogParms
+#define pEcLogParms G_pEcLogParms
+#endif
+
+/*-INCLUDES------------------------------------------------------------------*/
+#include "EcPlacement.h"
+#include "EcLogging.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+#include <cctype>
+
+/*-DEFINES-------------------------------------------------------------------*/
+/* EC_T_CPUSET is an int bit mask on Linux and is handed to the EC-Master OS layer as is,
+   so only CPUs 0..31 can be placed */
+#define PLACEMENT_MAX_CPU           ((EC_T_DWORD)(sizeof(EC_T_CPUSET) * 8))
+#define PLACEMENT_CPU_BIT(dwCpu)    ((EC_T_CPUSET)(1u << (dwCpu)))
+#define PLACEMENT_SYSFS_ISOLATED    "/sys/devices/system/cpu/isolated"
+#define PLACEMENT_SYSFS_NOHZ_FULL   "/sys/devices/system/cpu/nohz_full"
+#define PLACEMENT_PROCFS_IRQ        "/proc/irq"
+
+/*-LOCAL VARIABLES-----------------------------------------------------------*/
+static EC_T_PLACEMENT S_aPlacement[ePlacementThread_COUNT];
+
+static const EC_T_CHAR* S_aszPlacementThreadName[ePlacementThread_COUNT] =
+{
+    "job", "timing", "recv", "log", "main", "ras", "pcap"
+};
+
+/*-LOCAL FUNCTIONS-----------------------------------------------------------*/
+static EC_T_BOOL PlacementIsRealtime(EC_T_PLACEMENT_THREAD eThread)
+{
+    return (ePlacementThread_Job == eThread) || (ePlacementThread_Timing == eThread) || (ePlacementThread_Recv == eThread);
+}
+
+static EC_T_BOOL PlacementParseCpuList(const EC_T_CHAR* szCpuList, EC_T_CPUSET* pCpuSet, EC_T_BOOL bClip);
+
+/* reads a kernel cpulist file, an empty or missing file returns an empty set.
+   CPUs beyond PLACEMENT_MAX_CPU are left out, they can not be placed anyway. */
+static EC_T_BOOL PlacementReadCpuListFile(const EC_T_CHAR* szFileName, EC_T_CPUSET* pCpuSet)
+{
+    EC_T_CHAR szLine[256] = {0};
+    FILE*     pFile       = fopen(szFileName, "r");
+
+    EC_CPUSET_ZERO(*pCpuSet);
+    if (EC_NULL == pFile)
+    {
+        return EC_FALSE;
+    }
+    if (EC_NULL == fgets(szLine, sizeof(szLine), pFile))
+    {
+        szLine[0] = '\0';
+    }
+    fclose(pFile);
+
+    /* strip line feed */
+    szLine[strcspn(szLine, "\r\n")] = '\0';
+    if ('\0' == szLine[0])
+    {
+        return EC_TRUE;
+    }
+    return PlacementParseCpuList(szLine, pCpuSet, EC_TRUE);
+}
+
+static EC_T_BOOL PlacementParsePolicy(const EC_T_CHAR* szPolicy, EC_T_INT* pnPolicy)
+{
+    if (0 == strcasecmp(szPolicy, "fifo"))
+    {
+        *pnPolicy = SCHED_FIFO;
+    }
+    else if (0 == strcasecmp(szPolicy, "rr"))
+    {
+        *pnPolicy = SCHED_RR;
+    }
+    else if (0 == strcasecmp(szPolicy, "other"))
+    {
+        *pnPolicy = SCHED_OTHER;
+    }
+    else
+    {
+        return EC_FALSE;
+    }
+    return EC_TRUE;
+}
+
+/* parses "<cpulist>[:<policy>[:<prio>]]" */
+static EC_T_BOOL PlacementParseEntry(EC_T_CHAR* szEntry, EC_T_PLACEMENT* pPlacement)
+{
+    EC_T_CHAR* szPolicy = strchr(szEntry, ':');
+    EC_T_CHAR* szPrio   = EC_NULL;
+    EC_T_CHAR* szEnd    = EC_NULL;
+
+    if (EC_NULL != szPolicy)
+    {
+        *szPolicy++ = '\0';
+        szPrio = strchr(szPolicy, ':');
+        if (EC_NULL != szPrio)
+        {
+            *szPrio++ = '\0';
+        }
+    }
+    if ('\0' != szEntry[0])
+    {
+        if (!EcPlacementParseCpuList(szEntry, &pPlacement->CpuSet))
+        {
+            return EC_FALSE;
+        }
+        pPlacement->bCpuSet = EC_TRUE;
+    }
+    if ((EC_NULL != szPolicy) && ('\0' != szPolicy[0]))
+    {
+        if (!PlacementParsePolicy(szPolicy, &pPlacement->nPolicy))
+        {
+            return EC_FALSE;
+        }
+        pPlacement->bPrio = EC_TRUE;
+    }
+    if ((EC_NULL != szPrio) && ('\0' != szPrio[0]))
+    {
+        long lPrio = strtol(szPrio, &szEnd, 10);
+        if (('\0' != *szEnd) || (lPrio < 0) || (lPrio > 99))
+        {
+            return EC_FALSE;
+        }
+        pPlacement->dwPrio = (EC_T_DWORD)lPrio;
+        pPlacement->bPrio  = EC_TRUE;
+    }
+    /* SCHED_OTHER only accepts priority 0 */
+    if (pPlacement->bPrio && (SCHED_OTHER == pPlacement->nPolicy))
+    {
+        pPlacement->dwPrio = 0;
+    }
+    return EC_TRUE;
+}
+
+/*-FUNCTION DEFINITIONS------------------------------------------------------*/
+
+static EC_T_BOOL PlacementParseCpuList(const EC_T_CHAR* szCpuList, EC_T_CPUSET* pCpuSet, EC_T_BOOL bClip)
+{
+    const EC_T_CHAR* szPos = szCpuList;
+    EC_T_CHAR*       szEnd = EC_NULL;
+
+    EC_CPUSET_ZERO(*pCpuSet);
+    while ('\0' != *szPos)
+    {
+        long lFirst = strtol(szPos, &szEnd, 10);
+        long lLast  = lFirst;
+
+        if (szEnd == szPos)
+        {
+            return EC_FALSE;
+        }
+        szPos = szEnd;
+        if ('-' == *szPos)
+        {
+            szPos++;
+            lLast = strtol(szPos, &szEnd, 10);
+            if (szEnd == szPos)
+            {
+                return EC_FALSE;
+            }
+            szPos = szEnd;
+        }
+        if ((lFirst < 0) || (lLast < lFirst))
+        {
+            return EC_FALSE;
+        }
+        if ((EC_T_DWORD)lLast >= PLACEMENT_MAX_CPU)
+        {
+            if (!bClip)
+            {
+                EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "Placement: CPU %ld is not supported, only CPUs 0..%d can be placed\n",
+                    lLast, PLACEMENT_MAX_CPU - 1));
+                return EC_FALSE;
+            }
+            lLast = (long)PLACEMENT_MAX_CPU - 1;
+        }
+        for (long lCpu = lFirst; lCpu <= lLast; lCpu++)
+        {
+            /* EC_CPUSET_SET() replaces the set, so OR the bits in */
+            *pCpuSet |= PLACEMENT_CPU_BIT(lCpu);
+        }
+        if (',' == *szPos)
+        {
+            szPos++;
+        }
+        else if ('\0' != *szPos)
+        {
+            return EC_FALSE;
+        }
+    }
+    return EC_TRUE;
+}
+
+/***************************************************************************************************/
+/**
+\brief  Parse a kernel style CPU list, e.g. "2", "2-3" or "2-3,5".
+
+Only CPUs 0..31 fit into EC_T_CPUSET, a list with a higher CPU is rejected with an error.
+
+\return EC_TRUE on success, EC_FALSE if the list is malformed or exceeds the CPU set.
+*/
+EC_T_BOOL EcPlacementParseCpuList(const EC_T_CHAR* szCpuList, EC_T_CPUSET* pCpuSet)
+{
+    return PlacementParseCpuList(szCpuList, pCpuSet, EC_FALSE);
+}
+
+/***************************************************************************************************/
+/**
+\brief  Parse the placement configuration "<thread>=<cpulist>[:<policy>[:<prio>]];...".
+
+Thread names are job, timing, recv, log, main, ras and pcap. Policy is fifo, rr or other.
+Threads not listed keep the legacy placement (CPU of --id, priorities of EcDemoPlatform.h).
+
+\return EC_E_NOERROR on success, EC_E_INVALIDPARM otherwise.
+*/
+EC_T_DWORD EcPlacementParse(const EC_T_CHAR* szPlacement)
+{
+    EC_T_DWORD dwRetVal = EC_E_INVALIDPARM;
+    EC_T_CHAR  szBuffer[512];
+    EC_T_CHAR* szSave   = EC_NULL;
+    EC_T_CHAR* szToken  = EC_NULL;
+
+    OsMemset(S_aPlacement, 0, sizeof(S_aPlacement));
+    for (EC_T_DWORD dwIdx = 0; dwIdx < ePlacementThread_COUNT; dwIdx++)
+    {
+        S_aPlacement[dwIdx].nPolicy = PLACEMENT_POLICY_DEFAULT;
+    }
+    if ((EC_NULL == szPlacement) || ('\0' == szPlacement[0]))
+    {
+        dwRetVal = EC_E_NOERROR;
+        goto Exit;
+    }
+    if (OsStrlen(szPlacement) >= sizeof(szBuffer))
+    {
+        EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "Placement configuration too long\n"));
+        goto Exit;
+    }
+    OsStrncpy(szBuffer, szPlacement, sizeof(szBuffer) - 1);
+    szBuffer[sizeof(szBuffer) - 1] = '\0';
+
+    for (szToken = strtok_r(szBuffer, "; ", &szSave); EC_NULL != szToken; szToken = strtok_r(EC_NULL, "; ", &szSave))
+    {
+        EC_T_CHAR* szValue = strchr(szToken, '=');
+        EC_T_DWORD dwThread = ePlacementThread_COUNT;
+
+        if (EC_NULL == szValue)
+        {
+            EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "Invalid placement entry '%s', expected <thread>=<cpulist>[:<policy>[:<prio>]]\n", szToken));
+            goto Exit;
+        }
+        *szValue++ = '\0';
+        for (dwThread = 0; dwThread < ePlacementThread_COUNT; dwThread++)
+        {
+            if (0 == strcasecmp(szToken, S_aszPlacementThreadName[dwThread]))
+            {
+                break;
+            }
+        }
+        if (ePlacementThread_COUNT == dwThread)
+        {
+            EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "Unknown placement thread '%s'\n", szToken));
+            goto Exit;
+        }
+        if (!PlacementParseEntry(szValue, &S_aPlacement[dwThread]))
+        {
+            EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "Invalid placement for thread '%s'\n", szToken));
+            goto Exit;
+        }
+    }
+    dwRetVal = EC_E_NOERROR;
+
+Exit:
+    return dwRetVal;
+}
+
+EC_T_BOOL EcPlacementIsSet(EC_T_PLACEMENT_THREAD eThread)
+{
+    return S_aPlacement[eThread].bCpuSet || S_aPlacement[eThread].bPrio;
+}
+
+EC_T_CPUSET EcPlacementGetCpuSet(EC_T_PLACEMENT_THREAD eThread, EC_T_CPUSET DefaultCpuSet)
+{
+    return S_aPlacement[eThread].bCpuSet ? S_aPlacement[eThread].CpuSet : DefaultCpuSet;
+}
+
+EC_T_DWORD EcPlacementGetPrio(EC_T_PLACEMENT_THREAD eThread, EC_T_DWORD dwDefaultPrio)
+{
+    return S_aPlacement[eThread].bPrio ? S_aPlacement[eThread].dwPrio : dwDefaultPrio;
+}
+
+/***************************************************************************************************/
+/**
+\brief  Apply the configured CPU set and scheduling parameters to the calling thread.
+
+\return EC_E_NOERROR on success, error code otherwise.
+*/
+EC_T_DWORD EcPlacementApplyThread(EC_T_PLACEMENT_THREAD eThread)
+{
+    EC_T_DWORD      dwRetVal   = EC_E_NOERROR;
+    EC_T_PLACEMENT* pPlacement = &S_aPlacement[eThread];
+
+    if (pPlacement->bCpuSet)
+    {
+        dwRetVal = OsSetThreadAffinity(EC_NULL, pPlacement->CpuSet);
+        if (EC_E_NOERROR != dwRetVal)
+        {
+            EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "Placement: cannot set affinity of %s thread (0x%lx)\n",
+                S_aszPlacementThreadName[eThread], dwRetVal));
+            goto Exit;
+        }
+    }
+    if (pPlacement->bPrio)
+    {
+        struct sched_param SchedParam;
+        EC_T_INT           nPolicy = 0;
+        EC_T_INT           nRes    = 0;
+
+        OsMemset(&SchedParam, 0, sizeof(struct sched_param));
+        pthread_getschedparam(pthread_self(), &nPolicy, &SchedParam);
+        if (PLACEMENT_POLICY_DEFAULT != pPlacement->nPolicy)
+        {
+            nPolicy = pPlacement->nPolicy;
+        }
+        SchedParam.sched_priority = (SCHED_OTHER == nPolicy) ? 0 : (EC_T_INT)pPlacement->dwPrio;
+        nRes = pthread_setschedparam(pthread_self(), nPolicy, &SchedParam);
+        if (0 != nRes)
+        {
+            EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "Placement: cannot set scheduling of %s thread: %s\n",
+                S_aszPlacementThreadName[eThread], strerror(nRes)));
+            dwRetVal = EC_E_ERROR;
+            goto Exit;
+        }
+    }
+
+Exit:
+    return dwRetVal;
+}
+
+/***************************************************************************************************/
+/**
+\brief  Return the NUMA node of a CPU, -1 if unknown (no NUMA or sysfs not available).
+*/
+EC_T_INT EcPlacementGetCpuNode(EC_T_DWORD dwCpuIndex)
+{
+    EC_T_CHAR      szPath[64];
+    DIR*           pDir     = EC_NULL;
+    struct dirent* pEntry   = EC_NULL;
+    EC_T_INT       nNode    = -1;
+
+    OsSnprintf(szPath, sizeof(szPath), "/sys/devices/system/cpu/cpu%d", dwCpuIndex);
+    pDir = opendir(szPath);
+    if (EC_NULL == pDir)
+    {
+        return -1;
+    }
+    while (EC_NULL != (pEntry = readdir(pDir)))
+    {
+        if ((0 == strncmp(pEntry->d_name, "node", 4)) && (0 != isdigit((unsigned char)pEntry->d_name[4])))
+        {
+            nNode = atoi(&pEntry->d_name[4]);
+            break;
+        }
+    }
+    closedir(pDir);
+    return nNode;
+}
+
+/***************************************************************************************************/
+/**
+\brief  Check the effective placement and log a warning for every setting which is known to cause jitter.
+
+Real-time threads are job, timing and recv.
+*/
+EC_T_VOID EcPlacementValidate(EC_T_CPUSET DefaultCpuSet, EC_T_INT nShmNode)
+{
+    EC_T_CPUSET    aCpuSet[ePlacementThread_COUNT];
+    EC_T_CPUSET    RtCpuSet       = 0;
+    EC_T_CPUSET    IsolatedCpuSet = 0;
+    EC_T_CPUSET    NohzCpuSet     = 0;
+    EC_T_CPUSET    OnlineCpuSet   = 0;
+    long      lOnlineCpus    = sysconf(_SC_NPROCESSORS_ONLN);
+    EC_T_BOOL      bIsolated      = PlacementReadCpuListFile(PLACEMENT_SYSFS_ISOLATED, &IsolatedCpuSet);
+    EC_T_BOOL      bNohz          = PlacementReadCpuListFile(PLACEMENT_SYSFS_NOHZ_FULL, &NohzCpuSet);
+    DIR*           pDir           = EC_NULL;
+    struct dirent* pEntry         = EC_NULL;
+
+    for (long lCpu = 0; (lCpu < lOnlineCpus) && ((EC_T_DWORD)lCpu < PLACEMENT_MAX_CPU); lCpu++)
+    {
+        OnlineCpuSet |= PLACEMENT_CPU_BIT(lCpu);
+    }
+    for (EC_T_DWORD dwIdx = 0; dwIdx < ePlacementThread_COUNT; dwIdx++)
+    {
+        aCpuSet[dwIdx] = EcPlacementGetCpuSet((EC_T_PLACEMENT_THREAD)dwIdx, DefaultCpuSet);
+        if (PlacementIsRealtime((EC_T_PLACEMENT_THREAD)dwIdx))
+        {
+            RtCpuSet |= aCpuSet[dwIdx];
+        }
+    }
+
+    for (EC_T_DWORD dwIdx = 0; dwIdx < ePlacementThread_COUNT; dwIdx++)
+    {
+        EC_T_PLACEMENT_THREAD eThread = (EC_T_PLACEMENT_THREAD)dwIdx;
+        const EC_T_CHAR*      szName  = S_aszPlacementThreadName[dwIdx];
+
+        if (EC_CPUSET_IS_ZERO(aCpuSet[dwIdx]))
+        {
+            if (PlacementIsRealtime(eThread))
+            {
+                EcLogMsg(EC_LOG_LEVEL_WARNING, (pEcLogContext, EC_LOG_LEVEL_WARNING, "Placement: %s thread is not pinned and may migrate between CPUs\n", szName));
+            }
+            continue;
+        }
+        if (0 != (aCpuSet[dwIdx] & ~OnlineCpuSet))
+        {
+            EcLogMsg(EC_LOG_LEVEL_WARNING, (pEcLogContext, EC_LOG_LEVEL_WARNING, "Placement: %s thread CPU set 0x%x contains offline CPUs (%ld online)\n",
+                szName, aCpuSet[dwIdx], lOnlineCpus));
+        }
+        if (PlacementIsRealtime(eThread))
+        {
+            if (bIsolated && (0 != (aCpuSet[dwIdx] & ~IsolatedCpuSet)))
+            {
+                EcLogMsg(EC_LOG_LEVEL_WARNING, (pEcLogContext, EC_LOG_LEVEL_WARNING, "Placement: %s thread CPU set 0x%x is not isolated (isolcpus=0x%x)\n",
+                    szName, aCpuSet[dwIdx], IsolatedCpuSet));
+            }
+            if (bNohz && (0 != (aCpuSet[dwIdx] & ~NohzCpuSet)))
+            {
+                EcLogMsg(EC_LOG_LEVEL_WARNING, (pEcLogContext, EC_LOG_LEVEL_WARNING, "Placement: %s thread CPU set 0x%x is not tickless (nohz_full=0x%x)\n",
+                    szName, aCpuSet[dwIdx], NohzCpuSet));
+            }
+        }
+        else if (EcPlacementIsSet(eThread) && (0 != (aCpuSet[dwIdx] & RtCpuSet)))
+        {
+            EcLogMsg(EC_LOG_LEVEL_WARNING, (pEcLogContext, EC_LOG_LEVEL_WARNING, "Placement: %s thread shares CPU set 0x%x with the real-time threads\n",
+                szName, aCpuSet[dwIdx] & RtCpuSet));
+        }
+    }
+
+    /* device interrupts routed to the real-time CPUs */
+    pDir = opendir(PLACEMENT_PROCFS_IRQ);
+    if ((EC_NULL != pDir) && !EC_CPUSET_IS_ZERO(RtCpuSet))
+    {
+        EC_T_DWORD dwIrqCnt = 0;
+        EC_T_CHAR  szIrqList[128] = {0};
+
+        while (EC_NULL != (pEntry = readdir(pDir)))
+        {
+            EC_T_CHAR   szPath[300];
+            EC_T_CPUSET IrqCpuSet = 0;
+
+            if (0 == isdigit((unsigned char)pEntry->d_name[0]))
+            {
+                continue;
+            }
+            OsSnprintf(szPath, sizeof(szPath), PLACEMENT_PROCFS_IRQ "/%s/smp_affinity_list", pEntry->d_name);
+            if (!PlacementReadCpuListFile(szPath, &IrqCpuSet))
+            {
+                continue;
+            }
+            /* IRQs allowed on all CPUs are balanced away from isolated CPUs by the kernel */
+            if ((0 != (IrqCpuSet & RtCpuSet)) && ((IrqCpuSet & OnlineCpuSet) != OnlineCpuSet))
+            {
+                EC_T_DWORD dwLen = (EC_T_DWORD)OsStrlen(szIrqList);
+                if (dwLen + OsStrlen(pEntry->d_name) + 2 < sizeof(szIrqList))
+                {
+                    OsSnprintf(&szIrqList[dwLen], sizeof(szIrqList) - dwLen, "%s%s", (0 == dwLen) ? "" : ",", pEntry->d_name);
+                }
+                dwIrqCnt++;
+            }
+        }
+        if (0 != dwIrqCnt)
+        {
+            EcLogMsg(EC_LOG_LEVEL_WARNING, (pEcLogContext, EC_LOG_LEVEL_WARNING, "Placement: %d IRQs are routed to the real-time CPUs 0x%x (%s)\n",
+                dwIrqCnt, RtCpuSet, szIrqList));
+        }
+    }
+    if (EC_NULL != pDir)
+    {
+        closedir(pDir);
+    }
+
+    /* shared memory should live next to the job task */
+    if ((nShmNode >= 0) && !EC_CPUSET_IS_ZERO(aCpuSet[ePlacementThread_Job]))
+    {
+        for (EC_T_DWORD dwCpu = 0; dwCpu < PLACEMENT_MAX_CPU; dwCpu++)
+        {
+            EC_T_INT nNode = -1;
+
+            if (0 == (aCpuSet[ePlacementThread_Job] & PLACEMENT_CPU_BIT(dwCpu)))
+            {
+                continue;
+            }
+            nNode = EcPlacementGetCpuNode(dwCpu);
+            if ((nNode >= 0) && (nNode != nShmNode))
+            {
+                EcLogMsg(EC_LOG_LEVEL_WARNING, (pEcLogContext, EC_LOG_LEVEL_WARNING, "Placement: shared memory is bound to NUMA node %d but job thread CPU %d is on node %d\n",
+                    nShmNode, dwCpu, nNode));
+            }
+        }
+    }
+}
+
+/*-END OF SOURCE FILE--------------------------------------------------------*/
@@ -0,0 +1,59 @@
+/*-----------------------------------------------------------------------------
+ * EcPlacement.h
+ * Description              CPU / scheduling placement of the master threads
+ *                          and NUMA placement of the shared memory regions
+ *---------------------------------------------------------------------------*/
+
+#ifndef INC_ECPLACEMENT_H
+#define INC_ECPLACEMENT_H 1
+
+/*-INCLUDES------------------------------------------------------------------*/
+#ifndef INC_ECOS
+#include "EcOs.h"
+#endif
+
+/*-TYPEDEFS------------------------------------------------------------------*/
+typedef enum _EC_T_PLACEMENT_THREAD
+{
+    ePlacementThread_Job    = 0,    /* EcMasterJobTask (cyclic jobs, notifications) */
+    ePlacementThread_Timing = 1,    /* timing task triggering the job task */
+    ePlacementThread_Recv   = 2,    /* link layer receive IST (interrupt mode) */
+    ePlacementThread_Log    = 3,    /* tAtEmLog */
+    ePlacementThread_Main   = 4,    /* main thread (diagnosis, state requests) */
+    ePlacementThread_Ras    = 5,    /* RAS server acceptor and client workers */
+    ePlacementThread_Pcap   = 6,    /* pcap recorder */
+
+    ePlacementThread_COUNT
+} EC_T_PLACEMENT_THREAD;
+
+/* scheduling policy, PLACEMENT_POLICY_DEFAULT keeps the policy chosen by the thread creator */
+#define PLACEMENT_POLICY_DEFAULT    ((EC_T_INT)-1)
+
+typedef struct _EC_T_PLACEMENT
+{
+    EC_T_BOOL   bCpuSet;            /* CPU set configured */
+    EC_T_CPUSET CpuSet;
+    EC_T_BOOL   bPrio;              /* policy / priority configured */
+    EC_T_INT    nPolicy;            /* SCHED_FIFO, SCHED_RR, SCHED_OTHER or PLACEMENT_POLICY_DEFAULT */
+    EC_T_DWORD  dwPrio;
+} EC_T_PLACEMENT;
+
+/*-FUNCTION DECLARATIONS-----------------------------------------------------*/
+/* parse "<thread>=<cpulist>[:<policy>[:<prio>]];..." e.g. "job=2:fifo:98;timing=2;log=3,5:other:0",
+   CPUs 0..31 only since EC_T_CPUSET is a 32 bit mask */
+EC_T_DWORD  EcPlacementParse(const EC_T_CHAR* szPlacement);
+EC_T_BOOL   EcPlacementIsSet(EC_T_PLACEMENT_THREAD eThread);
+EC_T_CPUSET EcPlacementGetCpuSet(EC_T_PLACEMENT_THREAD eThread, EC_T_CPUSET DefaultCpuSet);
+EC_T_DWORD  EcPlacementGetPrio(EC_T_PLACEMENT_THREAD eThread, EC_T_DWORD dwDefaultPrio);
+
+/* apply the configured placement to the calling thread, no-op if nothing is configured */
+EC_T_DWORD  EcPlacementApplyThread(EC_T_PLACEMENT_THREAD eThread);
+
+/* check the placement against online CPUs, isolcpus, nohz_full, IRQ affinity and the shm NUMA node */
+EC_T_VOID   EcPlacementValidate(EC_T_CPUSET DefaultCpuSet, EC_T_INT nShmNode);
+
+/* helpers */
+EC_T_BOOL   EcPlacementParseCpuList(const EC_T_CHAR* szCpuList, EC_T_CPUSET* pCpuSet);
+EC_T_INT    EcPlacementGetCpuNode(EC_T_DWORD dwCpuIndex);
+
+#endif /* INC_ECPLACEMENT_H */
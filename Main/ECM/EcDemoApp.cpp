@@ -8,6 +8,7 @@
 /*-INCLUDES------------------------------------------------------------------*/
 #include "EcDemoApp.h"
 #include "EcDemoTimingTaskPlatform.h"
+#include "EcPlacement.h"
 
 #include <cmath>                      //! by think 2024.03.03
 #include <cstring>                    //! by think 2024.03.03
@@ -60,9 +61,14 @@ typedef struct _T_MY_APP_DESC
 static EC_T_DWORD myAppInit(T_EC_DEMO_APP_CONTEXT* pAppContext);
 static EC_T_DWORD myAppPrepare(T_EC_DEMO_APP_CONTEXT* pAppContext);
 static EC_T_DWORD myAppSetup(T_EC_DEMO_APP_CONTEXT* pAppContext);
+static EC_T_DWORD myAppFastStart(T_EC_DEMO_APP_CONTEXT* pAppContext, EC_T_STATE eReqState);
+static EC_T_VOID  myAppTraceStartup(T_EC_DEMO_APP_CONTEXT* pAppContext);
+static EC_T_DWORD myAppReadSlave(T_EC_DEMO_APP_CONTEXT* pAppContext, int i, rocos::Slave* pSlave);
+static EC_T_VOID  myAppUpdateLayout(T_EC_DEMO_APP_CONTEXT* pAppContext);
 static EC_T_DWORD myAppWorkpd(T_EC_DEMO_APP_CONTEXT* pAppContext);
 static EC_T_DWORD myAppDiagnosis(T_EC_DEMO_APP_CONTEXT* pAppContext);
 static EC_T_DWORD myAppNotify(EC_T_DWORD dwCode, EC_T_NOTIFYPARMS* pParms);
+static EC_T_INT   ParseSafeOutput(const std::string& szSafeOutput);
 
 /*-FORWARD DECLARATIONS  ------------------------------------------------------*/
 
@@ -90,6 +96,8 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
     CEcTimer               oAppDuration;
     EC_T_BOOL              bFirstDcmStatus   = EC_TRUE;
     CEcTimer               oDcmStatusTimer;
+    EC_T_INT               nStartupPhase     = -1;
+    long                   lAppBegin         = EcatConfigMaster::getProcessUptime(); /* before the shared memory exists */
 
 #if (defined INCLUDE_RAS_SERVER)
     EC_T_VOID*             pvRasServerHandle = EC_NULL;
@@ -98,6 +106,9 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
 #if (defined INCLUDE_PCAP_RECORDER)
     CPcapRecorder*         pPcapRecorder     = EC_NULL;
 #endif
+#if (defined INCLUDE_FLIGHT_RECORDER)
+    CFlightRecorder*       pFlightRecorder   = EC_NULL;
+#endif
 
     /* check link layer parameter */
     if (EC_NULL == pAppParms->apLinkParms[0])
@@ -139,6 +150,9 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
         EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "ERROR: myAppInit failed: %s (0x%lx))\n", ecatGetText(dwRes), dwRes));
         goto Exit;
     }
+    /* process start up to here: loader, flags, logging */
+    pEcatConfig->addStartupPhase("main", 0, lAppBegin);
+    pEcatConfig->addStartupPhase("myAppInit", lAppBegin, EcatConfigMaster::getProcessUptime());
 
 #ifdef INCLUDE_RAS_SERVER
     /* start RAS server if enabled */
@@ -153,11 +167,11 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
         oRemoteApiConfig.wPort              = pAppParms->wRasServerPort;
         oRemoteApiConfig.dwCycleTime        = ECMASTERRAS_CYCLE_TIME;
         oRemoteApiConfig.dwCommunicationTimeout = ECMASTERRAS_MAX_WATCHDOG_TIMEOUT;
-        oRemoteApiConfig.oAcceptorThreadCpuAffinityMask = pAppParms->CpuSet;
-        oRemoteApiConfig.dwAcceptorThreadPrio           = MAIN_THREAD_PRIO;
+        oRemoteApiConfig.oAcceptorThreadCpuAffinityMask = EcPlacementGetCpuSet(ePlacementThread_Ras, pAppParms->CpuSet);
+        oRemoteApiConfig.dwAcceptorThreadPrio           = EcPlacementGetPrio(ePlacementThread_Ras, MAIN_THREAD_PRIO);
         oRemoteApiConfig.dwAcceptorThreadStackSize      = JOBS_THREAD_STACKSIZE;
-        oRemoteApiConfig.oClientWorkerThreadCpuAffinityMask = pAppParms->CpuSet;
-        oRemoteApiConfig.dwClientWorkerThreadPrio           = MAIN_THREAD_PRIO;
+        oRemoteApiConfig.oClientWorkerThreadCpuAffinityMask = EcPlacementGetCpuSet(ePlacementThread_Ras, pAppParms->CpuSet);
+        oRemoteApiConfig.dwClientWorkerThreadPrio           = EcPlacementGetPrio(ePlacementThread_Ras, MAIN_THREAD_PRIO);
         oRemoteApiConfig.dwClientWorkerThreadStackSize      = JOBS_THREAD_STACKSIZE;
         oRemoteApiConfig.pfnRasNotify    = RasNotifyCallback;                       /* RAS notification callback function */
         oRemoteApiConfig.pvRasNotifyCtxt = pAppContext->pNotificationHandler;       /* RAS notification callback function context */
@@ -171,7 +185,9 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
             oRemoteApiConfig.LogParms.dwLogLevel = EC_LOG_LEVEL_ERROR;
         }
         EcLogMsg(EC_LOG_LEVEL_INFO, (pEcLogContext, EC_LOG_LEVEL_INFO, "Start Remote API Server now\n"));
+        nStartupPhase = pEcatConfig->beginStartupPhase("emRasSrvStart");
         dwRes = emRasSrvStart(&oRemoteApiConfig, &pvRasServerHandle);
+        pEcatConfig->endStartupPhase(nStartupPhase);
         if (EC_E_NOERROR != dwRes)
         {
             EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "ERROR: Cannot spawn Remote API Server\n"));
@@ -227,7 +243,9 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
 
 
 
+        nStartupPhase = pEcatConfig->beginStartupPhase("ecatInitMaster"); /* opens the link layer */
         dwRes = ecatInitMaster(&oInitParms);
+        pEcatConfig->endStartupPhase(nStartupPhase);
         if (dwRes != EC_E_NOERROR)
         {
             dwRetVal = dwRes;
@@ -298,7 +316,7 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
 #if (defined INCLUDE_PCAP_RECORDER)
     if (pAppParms->bPcapRecorder)
     {
-        pPcapRecorder = EC_NEW(CPcapRecorder());
+        pPcapRecorder = EC_NEW(CPcapRecorder(EcPlacementGetCpuSet(ePlacementThread_Pcap, 0), EcPlacementGetPrio(ePlacementThread_Pcap, LOG_THREAD_PRIO), DEFAULT_LOG_STACK_SIZE));
         if (EC_NULL == pPcapRecorder)
         {
             dwRetVal = EC_E_NOMEMORY;
@@ -312,8 +330,32 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
             EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "ERROR: %d: Initialize PcapRecorder failed: %s (0x%lx)\n", pAppContext->dwInstanceId, ecatGetText(dwRes), dwRes));
             goto Exit;
         }
+        pAppContext->pvPcapRecorder = pPcapRecorder;
     }
 #endif /* INCLUDE_PCAP_RECORDER */
+#if (defined INCLUDE_FLIGHT_RECORDER)
+    if (pAppParms->bFlightRecorder)
+    {
+        pFlightRecorder = EC_NEW(CFlightRecorder(EcPlacementGetCpuSet(ePlacementThread_Pcap, 0), EcPlacementGetPrio(ePlacementThread_Pcap, LOG_THREAD_PRIO), DEFAULT_LOG_STACK_SIZE));
+        if (EC_NULL == pFlightRecorder)
+        {
+            dwRetVal = EC_E_NOMEMORY;
+            EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "ERROR: %d: Creating FlightRecorder failed: %s (0x%lx)\n", pAppContext->dwInstanceId, ecatGetText(dwRetVal), dwRetVal));
+            goto Exit;
+        }
+        nStartupPhase = pEcatConfig->beginStartupPhase("flight recorder");
+        dwRes = pFlightRecorder->InitInstance(pAppContext->dwInstanceId, pAppParms->dwFlightRecorderBufferSize,
+            pAppParms->dwFlightRecorderPreTriggerMsec, pAppParms->dwFlightRecorderPostTriggerMsec, pAppParms->szFlightRecorderFileprefix);
+        pEcatConfig->endStartupPhase(nStartupPhase);
+        if (dwRes != EC_E_NOERROR)
+        {
+            dwRetVal = dwRes;
+            EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "ERROR: %d: Initialize FlightRecorder failed: %s (0x%lx)\n", pAppContext->dwInstanceId, ecatGetText(dwRes), dwRes));
+            goto Exit;
+        }
+        pAppContext->pvFlightRecorder = pFlightRecorder;
+    }
+#endif /* INCLUDE_FLIGHT_RECORDER */
 
 #if (defined INCLUDE_SLAVE_STATISTICS)
     /* Slave statistics polling for error diagnostic */
@@ -339,16 +381,18 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
     {
         CEcTimer oTimeout(2000);
 
+        nStartupPhase = pEcatConfig->beginStartupPhase("job task");
         pAppContext->bJobTaskRunning  = EC_FALSE;
         pAppContext->bJobTaskShutdown = EC_FALSE;
-        pvJobTaskHandle = OsCreateThread((EC_T_CHAR*)"EcMasterJobTask", EcMasterJobTask, pAppParms->CpuSet,
-            JOBS_THREAD_PRIO, JOBS_THREAD_STACKSIZE, (EC_T_VOID*)pAppContext);
+        pvJobTaskHandle = OsCreateThread((EC_T_CHAR*)"EcMasterJobTask", EcMasterJobTask, EcPlacementGetCpuSet(ePlacementThread_Job, pAppParms->CpuSet),
+            EcPlacementGetPrio(ePlacementThread_Job, JOBS_THREAD_PRIO), JOBS_THREAD_STACKSIZE, (EC_T_VOID*)pAppContext);
 
         /* wait until thread is running */
         while (!oTimeout.IsElapsed() && !pAppContext->bJobTaskRunning)
         {
             OsSleep(10);
         }
+        pEcatConfig->endStartupPhase(nStartupPhase);
         if (!pAppContext->bJobTaskRunning)
         {
             dwRetVal = EC_E_TIMEOUT;
@@ -371,7 +415,9 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
 
     /* configure network */
     //! v3.0版本是ecatConfigureMaster by think 2024.03.03
+    nStartupPhase = pEcatConfig->beginStartupPhase("ecatConfigureNetwork"); /* reads and parses the ENI */
     dwRes = ecatConfigureNetwork(pAppParms->eCnfType, pAppParms->pbyCnfData, pAppParms->dwCnfDataLen);
+    pEcatConfig->endStartupPhase(nStartupPhase);
     if (dwRes != EC_E_NOERROR)
     {
         dwRetVal = dwRes;
@@ -380,7 +426,9 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
     }
 
     /* register client */
+    nStartupPhase = pEcatConfig->beginStartupPhase("ecatRegisterClient");
     dwRes = ecatRegisterClient(EcMasterNotifyCallback, pAppContext, &RegisterClientResults);
+    pEcatConfig->endStartupPhase(nStartupPhase);
     if (dwRes != EC_E_NOERROR)
     {
         dwRetVal = dwRes;
@@ -388,6 +436,8 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
         goto Exit;
     }
     pAppContext->pNotificationHandler->SetClientID(RegisterClientResults.dwClntId);
+    /* slave state changes for the event ring and the diagnostics counters */
+    pAppContext->pNotificationHandler->SetNotificationEnabled(EC_NOTIFY_SLAVES_STATECHANGED, EC_NOTIFICATION_ENABLED);
 
     /* configure DC/DCM master is started with ENI */
     if (EC_NULL != pAppParms->pbyCnfData)
@@ -431,7 +481,9 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
             oDcConfigure.bAcycDistributionDisabled = EC_TRUE;
 #endif
 
+            nStartupPhase = pEcatConfig->beginStartupPhase("ecatDcConfigure");
             dwRes = ecatDcConfigure(&oDcConfigure);
+            pEcatConfig->endStartupPhase(nStartupPhase);
             if (dwRes != EC_E_NOERROR )
             {
                 dwRetVal = dwRes;
@@ -542,7 +594,9 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
                 goto Exit;
 
             }
+            nStartupPhase = pEcatConfig->beginStartupPhase("ecatDcmConfigure");
             dwRes = ecatDcmConfigure(&oDcmConfig, 0);
+            pEcatConfig->endStartupPhase(nStartupPhase);
             switch (dwRes)
             {
             case EC_E_NOERROR:
@@ -560,13 +614,17 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
                 dwRetVal = dwRes;
                 goto Exit;
             }
+            pEcatConfig->dcTimeSeries->dcm_mode = pAppParms->eDcmMode;
+            pEcatConfig->dcTimeSeries->sample_cycles = FLAGS_dcsample;
         }
     }
 
     /* print found slaves */
     if (pAppParms->dwAppLogLevel >= EC_LOG_LEVEL_VERBOSE)
     {
+        nStartupPhase = pEcatConfig->beginStartupPhase("ecatScanBus");
         dwRes = ecatScanBus(ETHERCAT_SCANBUS_TIMEOUT);
+        pEcatConfig->endStartupPhase(nStartupPhase);
         pAppContext->pNotificationHandler->ProcessNotificationJobs();
         switch (dwRes)
         {
@@ -593,6 +651,7 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
     }
 
     //////////// MY OWN CODE by think/////////////////
+    nStartupPhase = pEcatConfig->beginStartupPhase("pd memory");
     {
         // 在ecatConfigureMaster之后，ecatStart之前处理共享内存映射
         /* 获取Process Data Memory Size */
@@ -625,6 +684,8 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
 
         /* 创建PD Memory */
         pEcatConfig->createPdDataMemoryProvider(MemReqDesc.dwPDInSize, MemReqDesc.dwPDOutSize);
+        pEcatConfig->bindNumaNode(FLAGS_shmnode);
+        pEcatConfig->publishGeneration(); /* clients of a previous run remap on their next wait() */
 
 
         /* 配置Memory Provider */
@@ -662,6 +723,7 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
                      (pEcLogContext, EC_LOG_LEVEL_INFO, "\033[32m\033[1mRegister process data memory provider successfully\033[0m\n"));
         }
     }
+    pEcatConfig->endStartupPhase(nStartupPhase);
 
     EcLogMsg(EC_LOG_LEVEL_INFO, (pEcLogContext, EC_LOG_LEVEL_INFO, "=====================\n"));
     EcLogMsg(EC_LOG_LEVEL_INFO, (pEcLogContext, EC_LOG_LEVEL_INFO, "Start EtherCAT Master\n"));
@@ -669,6 +731,7 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
 
 
     //////////// WHILE LOOP by think ///////////////
+    pEcatConfig->startup->fast_start = FLAGS_faststart;
     while (bRun) { //while process
         pEcatConfig->ecatBus->current_state = ecatGetMasterState(); // Get Ec Master State
         //! Process EtherCAT state machine
@@ -716,6 +779,7 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
                     case eEcatState_PREOP:
                         pEcatConfig->ecatBus->next_expected_state = eEcatState_SAFEOP;
                     case eEcatState_SAFEOP:
+                    case eEcatState_OP:
                         pEcatConfig->ecatBus->next_expected_state = eEcatState_OP;
                         break;
                     default:
@@ -734,7 +798,9 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
         // Dive into state switch
         if (pEcatConfig->ecatBus->next_expected_state == eEcatState_INIT) { // set state to INIT
             /* set master to INIT */
+            nStartupPhase = pEcatConfig->beginStartupPhase("init");
             dwRes = ecatSetMasterState(ETHERCAT_STATE_CHANGE_TIMEOUT, eEcatState_INIT); // 切换到Init状态  by think
+            pEcatConfig->endStartupPhase(nStartupPhase);
             pAppContext->pNotificationHandler->ProcessNotificationJobs();
             if (dwRes != EC_E_NOERROR) {
                 EcLogMsg(EC_LOG_LEVEL_ERROR,
@@ -747,7 +813,9 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
 
             //////////////    MY OWN CODE     /////////////////
             ///////////// Prepare Application /////////////////
+            nStartupPhase = pEcatConfig->beginStartupPhase("prepare");
             dwRes = myAppPrepare(pAppContext); // 判断ecat_config.yaml中的slave数量与eni.xml中的是否相同 by think
+            pEcatConfig->endStartupPhase(nStartupPhase);
             if (EC_E_NOERROR != dwRes) {
                 EcLogMsg(EC_LOG_LEVEL_ERROR,
                          (pEcLogContext, EC_LOG_LEVEL_ERROR, (EC_T_CHAR *) "myAppPrepare failed: %s (0x%lx))\n", ecatGetText(
@@ -758,8 +826,24 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
 
         }
         else if (pEcatConfig->ecatBus->next_expected_state == eEcatState_PREOP) { // set state to PREOP
+            /* no stop in PREOP and SAFEOP on the way to the requested state */
+            if (FLAGS_faststart && (pEcatConfig->ecatBus->current_state == eEcatState_INIT) &&
+                ((pEcatConfig->ecatBus->request_state == eEcatState_SAFEOP) ||
+                 (pEcatConfig->ecatBus->request_state == eEcatState_OP))) {
+                dwRes = myAppFastStart(pAppContext, (EC_T_STATE) pEcatConfig->ecatBus->request_state);
+                if (EC_E_NOERROR != dwRes) {
+                    dwRetVal = dwRes;
+                    goto Exit;
+                }
+                /* already in the requested state, the next pass enters its branch (while op) without a transition */
+                pEcatConfig->ecatBus->next_expected_state = pEcatConfig->ecatBus->request_state;
+                continue;
+            }
+
             /* set master and bus state to PREOP */
+            nStartupPhase = pEcatConfig->beginStartupPhase("preop");
             dwRes = ecatSetMasterState(ETHERCAT_STATE_CHANGE_TIMEOUT, eEcatState_PREOP); // 切换到Preop状态  by think
+            pEcatConfig->endStartupPhase(nStartupPhase);
             pAppContext->pNotificationHandler->ProcessNotificationJobs();
             if (dwRes != EC_E_NOERROR) {
                 EcLogMsg(EC_LOG_LEVEL_ERROR,
@@ -772,7 +856,9 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
 
             /////////////    MY OWN CODE     /////////////////
             ///////////// Setup Application /////////////////
+            nStartupPhase = pEcatConfig->beginStartupPhase("setup");
             dwRes = myAppSetup(pAppContext); // mapping相应的变量指针到PDO by think
+            pEcatConfig->endStartupPhase(nStartupPhase);
             if (EC_E_NOERROR != dwRes) {
                 EcLogMsg(EC_LOG_LEVEL_ERROR,
                          (pEcLogContext, EC_LOG_LEVEL_ERROR, (EC_T_CHAR *) "myAppSetup failed: %s (0x%lx))\n", ecatGetText(
@@ -784,7 +870,9 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
         }
         else if (pEcatConfig->ecatBus->next_expected_state == eEcatState_SAFEOP) { // set state to SAFEOP
             /* set master and bus state to SAFEOP */
+            nStartupPhase = pEcatConfig->beginStartupPhase("safeop");
             dwRes = ecatSetMasterState(ETHERCAT_STATE_CHANGE_TIMEOUT, eEcatState_SAFEOP); // 切换到Safeop状态  by think
+            pEcatConfig->endStartupPhase(nStartupPhase);
             pAppContext->pNotificationHandler->ProcessNotificationJobs();
             if (dwRes != EC_E_NOERROR) {
                 EcLogMsg(EC_LOG_LEVEL_ERROR,
@@ -817,7 +905,9 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
         }
         else if (pEcatConfig->ecatBus->next_expected_state == eEcatState_OP) { // set state to OP
             /* set master and bus state to OP */
+            nStartupPhase = pEcatConfig->beginStartupPhase("op");
             dwRes = ecatSetMasterState(ETHERCAT_STATE_CHANGE_TIMEOUT, eEcatState_OP); // 切换到Op状态 by think
+            pEcatConfig->endStartupPhase(nStartupPhase);
             pAppContext->pNotificationHandler->ProcessNotificationJobs();
             if (dwRes != EC_E_NOERROR) {
                 EcLogMsg(EC_LOG_LEVEL_ERROR,
@@ -827,6 +917,10 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
                 goto Exit;
             }
             pEcatConfig->ecatBus->current_state = ecatGetMasterState(); // Get Ec Master State
+            if (pEcatConfig->setStartupReached(pEcatConfig->ecatBus->current_state))
+            {
+                myAppTraceStartup(pAppContext);
+            }
 
             if (pAppContext->dwPerfMeasLevel > 0)
             {
@@ -953,6 +1047,12 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
                     /* process notification jobs */
                     pAppContext->pNotificationHandler->ProcessNotificationJobs();
 
+                    /* hot connect group appeared or disappeared */
+                    if (pAppContext->bLayoutChanged)
+                    {
+                        myAppUpdateLayout(pAppContext);
+                    }
+
                     OsSleep(5);
                 } // end while op
 
@@ -960,7 +1060,24 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
 
         }
 
-        OsSleep(50);
+        /* no pause between the steps to a valid requested state, each step blocks in ecatSetMasterState() */
+        {
+            const int nReqState = pEcatConfig->ecatBus->request_state;
+            if (pEcatConfig->ecatBus->current_state == nReqState)
+            {
+                if (pEcatConfig->setStartupReached(nReqState))
+                {
+                    myAppTraceStartup(pAppContext);
+                }
+            }
+            EC_T_BOOL bStepping = ((nReqState == eEcatState_INIT) || (nReqState == eEcatState_PREOP) ||
+                                   (nReqState == eEcatState_SAFEOP) || (nReqState == eEcatState_OP)) &&
+                                  (pEcatConfig->ecatBus->current_state != nReqState);
+            if (!bStepping)
+            {
+                OsSleep(50);
+            }
+        }
     } // end while process
 
 
@@ -991,6 +1108,12 @@ EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext)
     }
 
 Exit:
+    /* start-up failed or was interrupted: report how far it got */
+    if ((EC_NULL != pEcatConfig) && (EC_NULL != pEcatConfig->startup) && (pEcatConfig->startup->reached < 0))
+    {
+        myAppTraceStartup(pAppContext);
+    }
+
     EcLogMsg(EC_LOG_LEVEL_INFO, (pEcLogContext, EC_LOG_LEVEL_INFO, "========================\n"));
     EcLogMsg(EC_LOG_LEVEL_INFO, (pEcLogContext, EC_LOG_LEVEL_INFO, "Shutdown EtherCAT Master\n"));
     EcLogMsg(EC_LOG_LEVEL_INFO, (pEcLogContext, EC_LOG_LEVEL_INFO, "========================\n"));
@@ -1016,10 +1139,6 @@ Exit:
         }
     }
 
-#if (defined INCLUDE_PCAP_RECORDER)
-    SafeDelete(pPcapRecorder);
-#endif /* INCLUDE_PCAP_RECORDER */
-
     /* unregister client */
     if (0 != RegisterClientResults.dwClntId)
     {
@@ -1066,6 +1185,31 @@ Exit:
         }
     }
 
+#if (defined INCLUDE_PCAP_RECORDER)
+    /* deleted after the job task, which closes the drop accounting of each cycle */
+    pAppContext->pvPcapRecorder = EC_NULL;
+    if (EC_NULL != pPcapRecorder)
+    {
+        EC_T_PCAP_CAPTURE_STAT oPcapStat;
+
+        pPcapRecorder->Uninstall();
+        pPcapRecorder->GetCaptureStat(&oPcapStat);
+        EcLogMsg(EC_LOG_LEVEL_INFO, (pEcLogContext, EC_LOG_LEVEL_INFO, "PcapRecorder: %llu frames, %llu dropped (%llu bytes) in %u of %u cycles, max %u per cycle, %llu writes, ring %u/%u bytes\n",
+            oPcapStat.qwFrameCnt, oPcapStat.qwDropFrameCnt, oPcapStat.qwDropByteCnt, oPcapStat.dwDropCycleCnt, oPcapStat.dwCycleCnt,
+            oPcapStat.dwMaxCycleDrops, oPcapStat.qwWriteCnt, oPcapStat.dwMaxRingLevel, oPcapStat.dwRingSize));
+    }
+    SafeDelete(pPcapRecorder);
+#endif /* INCLUDE_PCAP_RECORDER */
+#if (defined INCLUDE_FLIGHT_RECORDER)
+    pAppContext->pvFlightRecorder = EC_NULL;
+    if (EC_NULL != pFlightRecorder)
+    {
+        pFlightRecorder->Uninstall();
+        EcLogMsg(EC_LOG_LEVEL_INFO, (pEcLogContext, EC_LOG_LEVEL_INFO, "FlightRecorder: %d triggers, %d dumps\n", pFlightRecorder->GetTriggerCnt(), pFlightRecorder->GetDumpCnt()));
+    }
+    SafeDelete(pFlightRecorder);
+#endif /* INCLUDE_FLIGHT_RECORDER */
+
     /* deinitialize master */
     dwRes = ecatDeinitMaster();
     if (EC_E_NOERROR != dwRes)
@@ -1098,6 +1242,17 @@ static EC_T_VOID EcMasterJobTask(EC_T_VOID* pvAppContext)
     EC_T_USER_JOB_PARMS oJobParms;
     OsMemset(&oJobParms, 0, sizeof(EC_T_USER_JOB_PARMS));
 
+    /* scheduling policy is not covered by OsCreateThread() */
+    EcPlacementApplyThread(ePlacementThread_Job);
+
+#if (defined INCLUDE_EC_LOGGING)
+    /* allocate the log ring of the job task before the first cycle */
+    if ((pLogMsgCallback == CAtEmLogging::LogMsg) && (EC_NULL != pEcLogContext))
+    {
+        ((CAtEmLogging*)pEcLogContext)->RegisterProducer();
+    }
+#endif
+
     /* demo loop */
     pAppContext->bJobTaskRunning = EC_TRUE;
 
@@ -1122,6 +1277,10 @@ static EC_T_VOID EcMasterJobTask(EC_T_VOID* pvAppContext)
     EcLogMsg(EC_LOG_LEVEL_INFO, (pEcLogContext, EC_LOG_LEVEL_INFO, "Cycle Time Frequency: %ld\n", perfMeasInfo.qwFrequency));
     EC_T_UINT64 qwFrequency = RoundedDivisionMiddle(perfMeasInfo.qwFrequency, (EC_T_UINT64)10000); /* 1/10 usec */
 
+    /* flight recorder triggers seen by the job task */
+    EC_T_STATE   eLastMasterState   = eEcatState_UNKNOWN;
+    unsigned int uLastCaptureRequest = pEcatConfig->ecatBus->capture_request;
+
 
     do
     {
@@ -1139,6 +1298,7 @@ static EC_T_VOID EcMasterJobTask(EC_T_VOID* pvAppContext)
         // 更新时间戳 by think
         gettimeofday(&tv, nullptr);
         pEcatConfig->ecatBus->timestamp = tv.tv_sec * 1000000 + tv.tv_usec; // us
+        pEcatConfig->ecatBus->cycle_count++;
 
 
         EC_T_PERF_MEAS_VAL perfMeasVal;
@@ -1178,6 +1338,7 @@ static EC_T_VOID EcMasterJobTask(EC_T_VOID* pvAppContext)
             {
                 /* it is not reasonable, that more than 5 continuous frames are lost */
                 nOverloadCounter += 10;
+                TRIGGER_FLIGHT_RECORDER((nOverloadCounter >= 50) ? "overload" : "frameloss");
                 if (nOverloadCounter >= 50)
                 {
                     if ((pAppContext->dwPerfMeasLevel > 0) && (nOverloadCounter < 60))
@@ -1229,9 +1390,28 @@ static EC_T_VOID EcMasterJobTask(EC_T_VOID* pvAppContext)
             /***********Record Ec-Master State by think**************/
             pEcatConfig->ecatBus->current_state = eMasterState;
 
+            /* a state drop nobody requested */
+            if ((eMasterState < eLastMasterState) && (pEcatConfig->ecatBus->request_state > (int)eMasterState))
+            {
+                TRIGGER_FLIGHT_RECORDER("state");
+            }
+            eLastMasterState = eMasterState;
+
+            if (pEcatConfig->ecatBus->capture_request != uLastCaptureRequest)
+            {
+                uLastCaptureRequest = pEcatConfig->ecatBus->capture_request;
+                TRIGGER_FLIGHT_RECORDER("client");
+            }
+
             if ((eEcatState_SAFEOP == eMasterState) || (eEcatState_OP == eMasterState))
             {
                 myAppWorkpd(pAppContext);
+
+                /* merge outputs of clients owning pd_output ranges */
+                pEcatConfig->mergeOutputs();
+
+                /* replace stale client commands by safe outputs before they are sent */
+                pEcatConfig->checkWatchdog();
             }
         }
         if (pAppContext->dwPerfMeasLevel > 0)
@@ -1246,6 +1426,27 @@ static EC_T_VOID EcMasterJobTask(EC_T_VOID* pvAppContext)
             EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "ecatExecJob( eUsrJob_SendAllCycFrames,    EC_NULL ): %s (0x%lx)\n", ecatGetText(dwRes), dwRes));
         }
 
+        /* per slave WKC errors, outside of the cyclic path: frames are already sent */
+        if ((eEcatState_SAFEOP == eLastMasterState) || (eEcatState_OP == eLastMasterState))
+        {
+            pEcatConfig->updateDiagnostics(ecatGetDiagnosisImagePtr());
+        }
+
+        /* DCM deviation time series, bus shift and master shift are controlled by the DCM */
+        if (((eEcatState_SAFEOP == eLastMasterState) || (eEcatState_OP == eLastMasterState))
+            && pAppParms->bDcmConfigure && (FLAGS_dcsample > 0)
+            && ((eDcmMode_BusShift == pAppParms->eDcmMode) || (eDcmMode_MasterShift == pAppParms->eDcmMode))
+            && (pEcatConfig->ecatBus->cycle_count % FLAGS_dcsample == 0))
+        {
+            EC_T_DWORD dwDcmStatus = 0;
+            EC_T_INT   nDiffCur = 0, nDiffAvg = 0, nDiffMax = 0;
+
+            if (EC_E_NOERROR == ecatDcmGetStatus(&dwDcmStatus, &nDiffCur, &nDiffAvg, &nDiffMax))
+            {
+                pEcatConfig->sampleDc((int)dwDcmStatus, nDiffCur, nDiffAvg, nDiffMax);
+            }
+        }
+
         /* remove this code when using licensed version */
         if (EC_E_EVAL_EXPIRED == dwRes)
         {
@@ -1273,6 +1474,16 @@ static EC_T_VOID EcMasterJobTask(EC_T_VOID* pvAppContext)
             EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "ERROR: ecatExecJob(eUsrJob_StopTask): %s (0x%lx)\n", ecatGetText(dwRes), dwRes));
         }
 
+#if (defined INCLUDE_PCAP_RECORDER)
+        if (EC_NULL != pAppContext->pvPcapRecorder)
+        {
+            ((CPcapRecorder*)pAppContext->pvPcapRecorder)->EndCycle();
+        }
+#endif
+
+        /* hot connect: rebuilt slave descriptors become visible at this cycle boundary */
+        pEcatConfig->switchLayout();
+
         ////============== semphore update by think =================////
         // 通知其他进程可以更新这个周期的数据了 by think
         for (auto &sem: pEcatConfig->sem_mutex) {
@@ -1373,8 +1584,14 @@ static EC_T_DWORD myAppInit(T_EC_DEMO_APP_CONTEXT* pAppContext)
 
     ////////===========My Own Code============/////////
     pEcatConfig = new EcatConfigMaster(FLAGS_id);
+    if (FLAGS_hugepages)
+        pEcatConfig->enableHugePages();
     if (!pEcatConfig->createSharedMemory()) // 创建共享内存 by think
         goto Exit;
+    pEcatConfig->bindNumaNode(FLAGS_shmnode);
+    pAppContext->pvNotifyStat = pEcatConfig->notificationStat;
+    pAppContext->pvEventRing = pEcatConfig->eventRing;
+    pAppContext->pvDiagnostics = pEcatConfig->diagnostics;
 
     // Parse request state from command arguments --state
     if (strcasecmp(FLAGS_state.c_str(), "init") == 0)
@@ -1483,22 +1700,16 @@ Exit:
 
 /***************************************************************************************************/
 /**
-\brief  Setup slave parameters (normally done in PREOP state)
-
-  - SDO up- and Downloads
-  - Read Object Dictionary
+\brief  Read the descriptor (name, process data variables) of configured slave i from the master.
 
 \return EC_E_NOERROR on success, error code otherwise.
 */
-static EC_T_DWORD myAppSetup(T_EC_DEMO_APP_CONTEXT* pAppContext)
+static EC_T_DWORD myAppReadSlave(T_EC_DEMO_APP_CONTEXT* pAppContext, int i, rocos::Slave* pSlave)
 {
-    EC_UNREFPARM(pAppContext);
-
-    ////============== MY OWN CODE =================////
-    for (int i = 0; i < pEcatConfig->ecatBus->slave_num; ++i) {
-        EC_T_CFG_SLAVE_INFO SlaveInfo;
-
-        EC_T_WORD slave_addr = i + 1001;
+    EC_T_DWORD dwRetVal = EC_E_ERROR;
+    EC_T_CFG_SLAVE_INFO SlaveInfo;
+    {
+        EC_T_WORD slave_addr = i + EC_STATION_ADDRESS_BASE;
 
         if (ecatGetCfgSlaveInfo(EC_TRUE, slave_addr, &SlaveInfo) != EC_E_NOERROR) {
             EcLogMsg(EC_LOG_LEVEL_ERROR,
@@ -1506,7 +1717,11 @@ static EC_T_DWORD myAppSetup(T_EC_DEMO_APP_CONTEXT* pAppContext)
             goto Exit;
         }
 
-        rocos::Slave* pSlave = &pEcatConfig->ecatBus->slaves[i];
+        /* slave of the diagnostics counters, see CEmNotification::UpdateDiagnostics() */
+        rocos::SlaveDiagnostics* pDiag = &pEcatConfig->diagnostics->slaves[i];
+        pDiag->station_address   = SlaveInfo.wStationAddress;
+        pDiag->wkc_state_bit_in  = (SlaveInfo.dwPdSizeIn != 0) ? SlaveInfo.wWkcStateDiagOffsIn[0] : -1;
+        pDiag->wkc_state_bit_out = (SlaveInfo.dwPdSizeOut != 0) ? SlaveInfo.wWkcStateDiagOffsOut[0] : -1;
 
         EcLogMsg(EC_LOG_LEVEL_INFO,
                  (pEcLogContext, EC_LOG_LEVEL_INFO, "******************************************************************************\n"));
@@ -1615,8 +1830,183 @@ static EC_T_DWORD myAppSetup(T_EC_DEMO_APP_CONTEXT* pAppContext)
 
         EcLogMsg(EC_LOG_LEVEL_INFO,
                  (pEcLogContext, EC_LOG_LEVEL_INFO, "******************************************************************************\n"));
+    }
+    dwRetVal = EC_E_NOERROR;
+
+Exit:
+    return dwRetVal;
+}
+
+/***************************************************************************************************/
+/**
+\brief  Rebuild the descriptors of hot connect slaves that appeared and the presence of all slaves.
+
+  The job task switches to the new layout at the next cycle boundary, see EcatConfigMaster::switchLayout().
+*/
+static EC_T_VOID myAppUpdateLayout(T_EC_DEMO_APP_CONTEXT* pAppContext)
+{
+    EC_T_UINT64 qwPresentMask = 0;
+
+    /* previous layout not switched to yet, try again later */
+    if (pEcatConfig->isLayoutPending())
+    {
+        return;
+    }
+    pAppContext->bLayoutChanged = EC_FALSE;
 
+    for (int i = 0; i < pEcatConfig->ecatBus->slave_num; ++i)
+    {
+        EC_T_BOOL   bPresent  = EC_FALSE;
+        EC_T_UINT64 qwSlaveBit = (EC_T_UINT64)1 << i;
+
+        ecatIsSlavePresent(ecatGetSlaveId((EC_T_WORD)(i + EC_STATION_ADDRESS_BASE)), &bPresent);
+        if (!bPresent)
+        {
+            continue; /* descriptor stays, the process data of the slave is just not valid */
+        }
+        qwPresentMask |= qwSlaveBit;
+
+        if ((pEcatConfig->layout->present_mask & qwSlaveBit) == 0)
+        {
+            rocos::Slave oSlave;
+            if (EC_E_NOERROR == myAppReadSlave(pAppContext, i, &oSlave))
+            {
+                pEcatConfig->stageSlave(i, oSlave);
+            }
+        }
+    }
+    pEcatConfig->commitLayout(qwPresentMask);
+}
+
+/***************************************************************************************************/
+/**
+\brief  Bring the bus from INIT to SAFEOP or OP in as few steps as possible (--faststart).
+
+  The slave table is set up while EC-Master goes to PREOP in the background, it only depends on the ENI.
+  SAFEOP and OP are then requested with a single ecatSetMasterState(), EC-Master passes through SAFEOP itself.
+
+\return EC_E_NOERROR on success, error code otherwise.
+*/
+static EC_T_DWORD myAppFastStart(T_EC_DEMO_APP_CONTEXT* pAppContext, EC_T_STATE eReqState)
+{
+    EC_T_DWORD dwRetVal    = EC_E_NOERROR;
+    EC_T_DWORD dwRes       = EC_E_NOERROR;
+    EC_T_INT   nPreopPhase = -1;
+    EC_T_INT   nPhase      = -1;
+    CEcTimer   oTimeout;
+
+    nPreopPhase = pEcatConfig->beginStartupPhase("preop");
+    dwRes = ecatSetMasterState(EC_NOWAIT, eEcatState_PREOP);
+    if ((EC_E_NOERROR != dwRes) && (EC_E_BUSY != dwRes))
+    {
+        EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "Cannot start set master state to PREOP: %s (0x%lx))\n", ecatGetText(dwRes), dwRes));
+        dwRetVal = dwRes;
+        goto Exit;
+    }
+
+    nPhase = pEcatConfig->beginStartupPhase("setup");
+    dwRes = myAppSetup(pAppContext);
+    pEcatConfig->endStartupPhase(nPhase);
+    if (EC_E_NOERROR != dwRes)
+    {
+        EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "myAppSetup failed: %s (0x%lx))\n", ecatGetText(dwRes), dwRes));
+        dwRetVal = dwRes;
+        goto Exit;
+    }
+
+    /* the transition to PREOP may still be running */
+    oTimeout.Start(ETHERCAT_STATE_CHANGE_TIMEOUT);
+    while ((eEcatState_PREOP != ecatGetMasterState()) && !oTimeout.IsElapsed() && !OsTerminateAppRequest())
+    {
+        pAppContext->pNotificationHandler->ProcessNotificationJobs();
+        OsSleep(1);
     }
+    pEcatConfig->endStartupPhase(nPreopPhase);
+    pAppContext->pNotificationHandler->ProcessNotificationJobs();
+    if (eEcatState_PREOP != ecatGetMasterState())
+    {
+        EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "Cannot start set master state to PREOP: %s\n", ecatStateToStr(ecatGetMasterState())));
+        dwRetVal = EC_E_TIMEOUT;
+        goto Exit;
+    }
+
+    nPhase = pEcatConfig->beginStartupPhase((eEcatState_OP == eReqState) ? "safeop+op" : "safeop");
+    dwRes = ecatSetMasterState(ETHERCAT_STATE_CHANGE_TIMEOUT, eReqState);
+    pEcatConfig->endStartupPhase(nPhase);
+    pAppContext->pNotificationHandler->ProcessNotificationJobs();
+    if (EC_E_NOERROR != dwRes)
+    {
+        EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "Cannot start set master state to %s: %s (0x%lx))\n", ecatStateToStr(eReqState), ecatGetText(dwRes), dwRes));
+        dwRetVal = dwRes;
+        goto Exit;
+    }
+    if (pEcatConfig->setStartupReached(ecatGetMasterState()))
+    {
+        myAppTraceStartup(pAppContext);
+    }
+
+Exit:
+    return dwRetVal;
+}
+
+/***************************************************************************************************/
+/**
+\brief  Log the start-up phases in one line and write them as Chrome trace (--starttrace).
+
+  Called once, when the bus reached the requested state for the first time, or at shutdown with the
+  unfinished phases marked if it never did.
+*/
+static EC_T_VOID myAppTraceStartup(T_EC_DEMO_APP_CONTEXT* pAppContext)
+{
+    std::string szTrace = pEcatConfig->getStartupTraceName(FLAGS_starttrace);
+
+    EcLogMsg(EC_LOG_LEVEL_INFO, (pEcLogContext, EC_LOG_LEVEL_INFO, "%s\n", pEcatConfig->getStartupSummary().c_str()));
+
+    if (!szTrace.empty() && !pEcatConfig->writeStartupTrace(szTrace))
+    {
+        EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "Cannot write start-up trace %s\n", szTrace.c_str()));
+    }
+}
+
+/***************************************************************************************************/
+/**
+\brief  Setup slave parameters (normally done in PREOP state)
+
+  - SDO up- and Downloads
+  - Read Object Dictionary
+
+\return EC_E_NOERROR on success, error code otherwise.
+*/
+static EC_T_DWORD myAppSetup(T_EC_DEMO_APP_CONTEXT* pAppContext)
+{
+    EC_T_INT nSafeOutput = ParseSafeOutput(FLAGS_safeoutput);
+
+    EC_UNREFPARM(pAppContext);
+
+    ////============== MY OWN CODE =================////
+    /* the reaction to a stale client must not change because of a typo */
+    if (nSafeOutput < 0)
+    {
+        EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR, "Invalid --safeoutput %s, must be none/quickstop/zerotorque/hold\n", FLAGS_safeoutput.c_str()));
+        goto Exit;
+    }
+
+    for (int i = 0; i < pEcatConfig->ecatBus->slave_num; ++i) {
+        if (EC_E_NOERROR != myAppReadSlave(pAppContext, i, &pEcatConfig->ecatBus->slaves[i]))
+        {
+            goto Exit;
+        }
+    }
+
+    /* all configured slaves are connected, see myAppUpdateLayout() for hot connect groups.
+       A pending layout is published by the job task in the next cycle. */
+    while (!pEcatConfig->commitLayout(rocos::allSlavesMask(pEcatConfig->ecatBus->slave_num)))
+    {
+        OsSleep(1);
+    }
+
+    /* resolve safe output variables for stale command detection */
+    pEcatConfig->setupWatchdog(FLAGS_wdcycles, nSafeOutput);
 
     ecatPerfMeasReset(EC_PERF_MEAS_ALL); /* clear job times of startup phase */
 
@@ -1665,7 +2055,22 @@ static EC_T_DWORD myAppWorkpd(T_EC_DEMO_APP_CONTEXT* pAppContext)
 */
 static EC_T_DWORD myAppDiagnosis(T_EC_DEMO_APP_CONTEXT* pAppContext)
 {
+    static EC_T_INT s_anTripCount[MAX_CLIENT_NUM] = {0};
+
     EC_UNREFPARM(pAppContext);
+
+    /* report stale clients outside of the job task */
+    for (EC_T_INT i = 0; i < MAX_CLIENT_NUM; i++)
+    {
+        rocos::ClientWatchdog* pClient = &pEcatConfig->watchdog->clients[i];
+        if (pClient->trip_count != s_anTripCount[i])
+        {
+            s_anTripCount[i] = pClient->trip_count;
+            EcLogMsg(EC_LOG_LEVEL_ERROR, (pEcLogContext, EC_LOG_LEVEL_ERROR,
+                "Watchdog: client %d (pid %d) missed %d cycles, safe outputs applied to slave mask 0x%llx in %.1f us\n",
+                i, pClient->pid, pClient->missed_cycles, (unsigned long long)pClient->slave_mask, pClient->reaction_time));
+        }
+    }
     return EC_E_NOERROR;
 }
 
@@ -1687,6 +2092,25 @@ static EC_T_DWORD myAppNotify(
     return dwRetVal;
 }
 
+/********************************************************************************/
+/** \brief  Convert --safeoutput flag to SAFE_OUTPUT_xxx template
+ *
+ * \return safe output template, -1 if unknown
+ */
+static EC_T_INT ParseSafeOutput(const std::string& szSafeOutput)
+{
+    if (strcasecmp(szSafeOutput.c_str(), "none") == 0)
+        return SAFE_OUTPUT_NONE;
+    else if (strcasecmp(szSafeOutput.c_str(), "quickstop") == 0)
+        return SAFE_OUTPUT_QUICK_STOP;
+    else if (strcasecmp(szSafeOutput.c_str(), "zerotorque") == 0)
+        return SAFE_OUTPUT_ZERO_TORQUE;
+    else if (strcasecmp(szSafeOutput.c_str(), "hold") == 0)
+        return SAFE_OUTPUT_HOLD;
+
+    return -1;
+}
+
 EC_T_VOID ShowSyntaxAppUsage(T_EC_DEMO_APP_CONTEXT* pAppContext)
 {
     const EC_T_CHAR* szAppUsage = "<LinkLayer> [-f ENI-FileName] [-t time] [-b cycle time] [-a affinity] [-v lvl] [-perf [level]] [-log prefix [msg cnt]] [-lic key] [-oem key] [-maxbusslaves cnt]  [-flash address]"
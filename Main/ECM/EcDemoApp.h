@@ -55,6 +55,11 @@ EC_T_VOID  ShowSyntaxLinkLayer(EC_T_VOID);
 EC_T_DWORD EcDemoApp(T_EC_DEMO_APP_CONTEXT* pAppContext);
 
 #define PRINT_PERF_MEAS() ((EC_NULL != pEcLogContext)?((CAtEmLogging*)pEcLogContext)->PrintPerfMeas(pAppContext->dwInstanceId, 0, pEcLogContext) : 0)
+#if (defined INCLUDE_FLIGHT_RECORDER)
+#define TRIGGER_FLIGHT_RECORDER(szReason) ((EC_NULL != pAppContext->pvFlightRecorder)?((CFlightRecorder*)pAppContext->pvFlightRecorder)->Trigger(szReason) : EC_FALSE)
+#else
+#define TRIGGER_FLIGHT_RECORDER(szReason) EC_FALSE
+#endif
 #define PRINT_HISTOGRAM() ((EC_NULL != pEcLogContext)?((CAtEmLogging*)pEcLogContext)->PrintHistogramAsCsv(pAppContext->dwInstanceId, pAppContext->pvPerfMeas) : 0)
 
 #endif /* INC_ECDEMOAPP_H */
@@ -3,35 +3,138 @@
 //
 
 #include <ecat_config.h>
+#include <ecat_shm.h>
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
 
 
 using namespace rocos;
 
-EcatConfig::EcatConfig(int id) {
+EcatConfig::EcatConfig(int id, bool readOnly) : readOnly(readOnly) {
     ecmName = EC_SHM + std::to_string(id);
     mutexName = EC_SEM_MUTEX + std::to_string(id) + "_";
     pdInputName = "pd_input" + std::to_string(id);
     pdOutputName = "pd_output" + std::to_string(id);
+    pdStagingName = "pd_staging" + std::to_string(id);
+    controlName = EC_SHM_CONTROL + std::to_string(id);
 
-    init();
+    if (!readOnly)
+        init(); // read-only instances are attached by getReadOnlyInstance(), they must not exit the process
 }
 
 EcatConfig::~EcatConfig() {
+    delete pdStagingRegion;
+    delete pdOutputRegion;
+    delete pdInputRegion;
+    delete managedSharedMemory;
+    delete controlRegion;
+    for (auto *region: retiredRegions)
+        delete region;
+    for (auto *segment: retiredSegments)
+        delete segment;
+    for (int i = 0; i < EC_SEM_NUM; i++) {
+        if (staleSem[i])
+            sem_close(staleSem[i]);
+        if (sem_mutex[i] && sem_mutex[i] != SEM_FAILED)
+            sem_close(sem_mutex[i]);
+    }
+}
+
+bool EcatConfig::openControlBlock() {
+    if (control == nullptr) {
+        try {
+            controlRegion = rocos::openControlBlock(controlName, readOnly);
+        } catch (boost::interprocess::interprocess_exception &e) {
+            return false; // master without generations, no reattach
+        }
+        control = static_cast<EcatControl *>(controlRegion->get_address());
+    }
+    // before the regions are mapped: a master starting meanwhile is seen as new generation by wait()
+    generation = __atomic_load_n(&control->generation, __ATOMIC_ACQUIRE);
+    return true;
+}
 
+bool EcatConfig::findControlBlock() {
+    if (control != nullptr || !openControlBlock())
+        return false;
+    generation = 0;
+    return true;
+}
+
+void EcatConfig::closeStaleSemaphore(int id) {
+    sem_t *stale = __atomic_exchange_n(&staleSem[id], nullptr, __ATOMIC_ACQ_REL);
+    if (stale)
+        sem_close(stale);
+}
+
+bool EcatConfig::reattach() {
+    std::lock_guard<std::mutex> lock(reattachMutex);
+    if (!isNewGeneration())
+        return true; // done by another thread
+
+    const bool watchdogActive = clientWatchdog && clientWatchdog->active;
+    std::vector<OutputRange> ranges;
+    ranges.swap(claimedRanges);
+
+    if (managedSharedMemory)
+        retiredSegments.push_back(managedSharedMemory);
+    for (auto *region: {pdInputRegion, pdOutputRegion, pdStagingRegion})
+        if (region)
+            retiredRegions.push_back(region);
+    managedSharedMemory = nullptr;
+    pdInputRegion = pdOutputRegion = pdStagingRegion = nullptr;
+
+    // getSharedMemory() opens the semaphores again. The handle of a slot another thread may be blocked on
+    // right now is closed by that thread (closeStaleSemaphore()), all others here.
+    for (int i = 0; i < EC_SEM_NUM; i++) {
+        if (sem_mutex[i] == nullptr || sem_mutex[i] == SEM_FAILED)
+            continue;
+        sem_t *expected = nullptr;
+        if (i >= (int) threadId.size() || threadId[i] == std::this_thread::get_id() ||
+            !__atomic_compare_exchange_n(&staleSem[i], &expected, sem_mutex[i], false, __ATOMIC_ACQ_REL,
+                                         __ATOMIC_ACQUIRE))
+            sem_close(sem_mutex[i]); // CAS failed: the thread did not pick up the older handle yet, it can not wait on this one
+    }
+    pdStagingPtr = nullptr;
+    pdOwnStagingPtr = nullptr;
+    clientWatchdog = nullptr;
+    clientIndex = -1;
+
+    if (!(readOnly ? getSharedMemoryReadOnly() : getSharedMemory())) {
+        print_message("[SHM] Can not attach to the restarted master.", MessageLevel::ERROR);
+        return false;
+    }
+    reattachCount++;
+
+    if (watchdogActive)
+        registerWatchdog(watchdogTimeoutCycles, watchdogSlaveMask);
+    for (const OutputRange &range: ranges)
+        claimOutputRange(range.offset, range.size);
+
+    print_message("[SHM] Master restarted, generation " + std::to_string(generation) + " attached.");
+    return true;
 }
 
 bool EcatConfig::getSharedMemory() {
     mode_t mask = umask(0); // 取消屏蔽的权限位
 
+    openControlBlock();
 
     getPdDataMemoryProvider();
 
 
     using namespace boost::interprocess;
-    managedSharedMemory = new managed_shared_memory{open_or_create, ecmName.c_str(), EC_SHM_MAX_SIZE};
+    std::size_t pageSize = 0;
+    managedSharedMemory = openSegment(ecmName, EC_SHM_MAX_SIZE, pageSize);
 //    managedSharedMemory = new managed_shared_memory{open_only, EC_SHM};
+    print_message(rocos::to_string(ecmName, prefaultRegion(managedSharedMemory->get_address(),
+                                                           managedSharedMemory->get_size(), pageSize)));
 
     std::pair<EcatBus *, std::size_t> p1 = managedSharedMemory->find<EcatBus>("ecat");
     if (p1.first) {
@@ -40,6 +143,15 @@ bool EcatConfig::getSharedMemory() {
         print_message("[SHM] Ec-Master is not running.", MessageLevel::WARNING);
         ecatBus = managedSharedMemory->construct<EcatBus>("ecat")();
     }
+    watchdog = managedSharedMemory->find_or_construct<Watchdog>("watchdog")();
+    ownership = managedSharedMemory->find_or_construct<OutputOwnership>("ownership")();
+    notificationStat = managedSharedMemory->find_or_construct<NotificationStat>("notifications")();
+    eventRing = managedSharedMemory->find_or_construct<EventRing>("events")();
+    diagnostics = managedSharedMemory->find_or_construct<EcatDiagnostics>("diagnostics")();
+    dcTimeSeries = managedSharedMemory->find_or_construct<DcTimeSeries>("dc")();
+    layout = managedSharedMemory->find_or_construct<EcatLayout>("layout")();
+    startup = managedSharedMemory->find_or_construct<StartupTimings>("startup")();
+    eventCursor = __atomic_load_n(&eventRing->write_pos, __ATOMIC_ACQUIRE); // only events from now on
 
     for (int i = 0; i < EC_SEM_NUM; i++) {
         sem_mutex[i] = sem_open((mutexName + std::to_string(i)).c_str(), O_CREAT, 0777, 1);
@@ -55,15 +167,61 @@ bool EcatConfig::getSharedMemory() {
     return true;
 }
 
-bool EcatConfig::getPdDataMemoryProvider() {
+bool EcatConfig::getSharedMemoryReadOnly() {
     using namespace boost::interprocess;
 
-    pdInputShm = new shared_memory_object(open_or_create, pdInputName.c_str(), read_write);
-    pdOutputShm = new shared_memory_object(open_or_create, pdOutputName.c_str(), read_write);
+    std::size_t pageSize = 0;
+    openControlBlock();
+    try {
+        managedSharedMemory = openSegmentReadOnly(ecmName);
+        ecatBus = managedSharedMemory->get_segment_manager()->find_no_lock<EcatBus>("ecat").first;
+        if (ecatBus == nullptr) {
+            print_message("[SHM] Ec-Master is not running.", MessageLevel::WARNING);
+            return false;
+        }
+
+        pdInputRegion = openRegionReadOnly(pdInputName, pageSize);
+        pdOutputRegion = openRegionReadOnly(pdOutputName, pageSize);
+    } catch (interprocess_exception &e) {
+        print_message("[SHM] Ec-Master is not running: " + std::string(e.what()), MessageLevel::WARNING);
+        return false;
+    }
+    pdInputPtr = pdInputRegion->get_address();
+    pdOutputPtr = pdOutputRegion->get_address();
+
+    // objects of an older master may be missing, the accessors handle nullptr
+    auto *segmentManager = managedSharedMemory->get_segment_manager();
+    watchdog = segmentManager->find_no_lock<Watchdog>("watchdog").first;
+    ownership = segmentManager->find_no_lock<OutputOwnership>("ownership").first;
+    notificationStat = segmentManager->find_no_lock<NotificationStat>("notifications").first;
+    eventRing = segmentManager->find_no_lock<EventRing>("events").first;
+    diagnostics = segmentManager->find_no_lock<EcatDiagnostics>("diagnostics").first;
+    dcTimeSeries = segmentManager->find_no_lock<DcTimeSeries>("dc").first;
+    layout = segmentManager->find_no_lock<EcatLayout>("layout").first;
+    startup = segmentManager->find_no_lock<StartupTimings>("startup").first;
+    eventCursor = eventRing ? __atomic_load_n(&eventRing->write_pos, __ATOMIC_ACQUIRE) : 0;
+    lastCycle = __atomic_load_n(&ecatBus->cycle_count, __ATOMIC_ACQUIRE);
+
+    print_message("[SHM] " + ecmName + " attached read-only.");
+    return true;
+}
+
+bool EcatConfig::checkWritable(const char *what) {
+    if (readOnly)
+        print_message(std::string("[SHM] ") + what + " is not possible on a read-only instance.", MessageLevel::ERROR);
+    return !readOnly;
+}
 
-    pdInputRegion = new mapped_region(*pdInputShm, read_write);
-    pdOutputRegion = new mapped_region(*pdOutputShm, read_write);
+bool EcatConfig::getPdDataMemoryProvider() {
+    using namespace boost::interprocess;
 
+    std::size_t pageSize = 0;
+    pdInputRegion = openRegion(pdInputName, true, pageSize);
+    print_message(rocos::to_string(pdInputName, prefaultRegion(pdInputRegion->get_address(),
+                                                               pdInputRegion->get_size(), pageSize)));
+    pdOutputRegion = openRegion(pdOutputName, true, pageSize);
+    print_message(rocos::to_string(pdOutputName, prefaultRegion(pdOutputRegion->get_address(),
+                                                                pdOutputRegion->get_size(), pageSize)));
 
     pdInputPtr = static_cast<char *>(pdInputRegion->get_address());
     pdOutputPtr = static_cast<char *>(pdOutputRegion->get_address());
@@ -72,10 +230,50 @@ bool EcatConfig::getPdDataMemoryProvider() {
 }
 
 void EcatConfig::waitForSignal(int id) {
-    sem_wait(sem_mutex[id]);
+    if (readOnly) {
+        wait();
+        return;
+    }
+
+    // a restarted master may have replaced the semaphores, do not block on an orphaned one forever. Without
+    // control block (attached before the master started) it is looked for on every timeout.
+    timespec deadline{};
+    while (true) {
+        closeStaleSemaphore(id);
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += EC_REATTACH_POLL_MSEC * 1000000L;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        if (sem_timedwait(__atomic_load_n(&sem_mutex[id], __ATOMIC_ACQUIRE), &deadline) == 0)
+            break;
+        if (errno == ETIMEDOUT && (isNewGeneration() || findControlBlock()))
+            reattach(); // and wait on the semaphore of the new master
+        else if (errno != ETIMEDOUT && errno != EINTR)
+            break;
+    }
+    closeStaleSemaphore(id);
+    if (isNewGeneration())
+        reattach();
 }
 
 void EcatConfig::wait() {
+    if (readOnly) { // no semaphore slot is taken, poll the cycle counter instead
+        long cycle;
+        int polls = 0;
+        while ((cycle = __atomic_load_n(&ecatBus->cycle_count, __ATOMIC_ACQUIRE)) == lastCycle) {
+            if (control == nullptr && ++polls % (EC_REATTACH_POLL_MSEC * 10) == 0)
+                findControlBlock();
+            if (isNewGeneration() && reattach())
+                continue;
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        lastCycle = cycle;
+        return;
+    }
+
+    if (clientWatchdog)
+        clientWatchdog->heartbeat++;
+
     auto id = std::this_thread::get_id();
     auto it = std::find(threadId.begin(), threadId.end(), id);
     if(it != threadId.end()) { // thread is already in the list
@@ -96,8 +294,6 @@ void EcatConfig::init() {
         print_message("[INIT] Can not get shared memory.", MessageLevel::ERROR);
         exit(1);
     }
-
-    getPdDataMemoryProvider();
 }
 
 void EcatConfig::print_message(const std::string &msg, EcatConfig::MessageLevel msgLvl) {
@@ -148,17 +344,17 @@ int EcatConfig::getSlaveNum() const {
 }
 
 std::string EcatConfig::getSlaveName(int slaveId) {
-    return ecatBus->slaves[slaveId].name;
+    return slaves()[slaveId].name;
 }
 
 Slave EcatConfig::getSlave(int slaveId) {
-    return ecatBus->slaves[slaveId];
+    return slaves()[slaveId];
 }
 
 Slave EcatConfig::findSlaveByName(const std::string &slaveName) {
     for (int i = 0; i < ecatBus->slave_num; ++i) {
-        if(ecatBus->slaves[i].name == slaveName.c_str()) {
-            return ecatBus->slaves[i];
+        if(slaves()[i].name == slaveName.c_str()) {
+            return slaves()[i];
         }
     }
 
@@ -167,7 +363,7 @@ Slave EcatConfig::findSlaveByName(const std::string &slaveName) {
 
 int EcatConfig::findSlaveIdByName(const std::string &slaveName) {
     for (int i = 0; i < ecatBus->slave_num; ++i) {
-        if(ecatBus->slaves[i].name == slaveName.c_str()) {
+        if(slaves()[i].name == slaveName.c_str()) {
             return i;
         }
     }
@@ -176,26 +372,26 @@ int EcatConfig::findSlaveIdByName(const std::string &slaveName) {
 }
 
 std::string EcatConfig::getInputVarName(int slaveId, int varId) const {
-    return ecatBus->slaves[slaveId].input_vars[varId].name;
+    return slaves()[slaveId].input_vars[varId].name;
 }
 
 std::string EcatConfig::getOutputVarName(int slaveId, int varId) const {
-    return ecatBus->slaves[slaveId].output_vars[varId].name;
+    return slaves()[slaveId].output_vars[varId].name;
 }
 
 PdVar EcatConfig::getSlaveOutputVar(int slaveId, int varId) {
-    return ecatBus->slaves[slaveId].output_vars[varId];
+    return slaves()[slaveId].output_vars[varId];
 }
 
 
 PdVar EcatConfig::getSlaveInputVar(int slaveId, int varId) {
-    return ecatBus->slaves[slaveId].input_vars[varId];
+    return slaves()[slaveId].input_vars[varId];
 }
 
 PdVar EcatConfig::findSlaveInputVarByName(int slaveId, const std::string &varName) {
-    for (int i = 0; i < ecatBus->slaves[slaveId].input_var_num; ++i) {
-        if(ecatBus->slaves[slaveId].input_vars[i].name == varName.c_str()) {
-            return ecatBus->slaves[slaveId].input_vars[i];
+    for (int i = 0; i < slaves()[slaveId].input_var_num; ++i) {
+        if(slaves()[slaveId].input_vars[i].name == varName.c_str()) {
+            return slaves()[slaveId].input_vars[i];
         }
     }
 
@@ -203,8 +399,8 @@ PdVar EcatConfig::findSlaveInputVarByName(int slaveId, const std::string &varNam
 }
 
 int EcatConfig::findSlaveInputVarIdByName(int slaveId, const std::string &varName) {
-    for (int i = 0; i < ecatBus->slaves[slaveId].input_var_num; ++i) {
-        if(ecatBus->slaves[slaveId].input_vars[i].name == varName.c_str()) {
+    for (int i = 0; i < slaves()[slaveId].input_var_num; ++i) {
+        if(slaves()[slaveId].input_vars[i].name == varName.c_str()) {
             return i;
         }
     }
@@ -213,10 +409,20 @@ int EcatConfig::findSlaveInputVarIdByName(int slaveId, const std::string &varNam
 }
 
 void EcatConfig::resetCycleTime() {
+    if (!checkWritable("resetCycleTime"))
+        return;
     ecatBus->resetCycleTime = true;
 }
 
+void EcatConfig::requestCapture() {
+    if (!checkWritable("requestCapture"))
+        return;
+    __sync_fetch_and_add(&ecatBus->capture_request, 1);
+}
+
 void EcatConfig::setBusRequestState(int state) {
+    if (!checkWritable("setBusRequestState"))
+        return;
     ecatBus->request_state = state;
 }
 
@@ -224,6 +430,365 @@ int EcatConfig::getBusCurrentState() const {
     return ecatBus->current_state;
 }
 
+bool EcatConfig::acquireClientSlot() {
+    if (clientWatchdog)
+        return true;
+    if (!checkWritable("Registering a client"))
+        return false;
+
+    int pid = getpid();
+    for (int i = 0; i < MAX_CLIENT_NUM; ++i) {
+        ClientWatchdog &client = watchdog->clients[i];
+
+        // reclaim slots of processes that died without unregistering
+        int owner = client.pid;
+        if (owner != 0 && kill(owner, 0) != 0 && errno == ESRCH) {
+            client.active = false;
+            removeOutputRanges(i);
+            __sync_bool_compare_and_swap(&client.pid, owner, 0);
+        }
+
+        if (__sync_bool_compare_and_swap(&client.pid, 0, pid)) {
+            clientIndex = i;
+            clientWatchdog = &client;
+            return true;
+        }
+    }
+
+    print_message("[SHM] Too many clients.", MessageLevel::ERROR);
+    return false;
+}
+
+void EcatConfig::releaseClientSlot() {
+    if (!clientWatchdog || clientWatchdog->active || !claimedRanges.empty())
+        return; // slot is still used by watchdog or output ownership
+
+    __sync_synchronize();
+    clientWatchdog->pid = 0;
+    clientWatchdog = nullptr;
+    clientIndex = -1;
+}
+
+bool EcatConfig::registerWatchdog(int timeoutCycles, uint64_t slaveMask) {
+    if (!acquireClientSlot())
+        return false;
+
+    watchdogTimeoutCycles = timeoutCycles;
+    watchdogSlaveMask = slaveMask;
+
+    if (clientWatchdog->active)
+        return true;
+
+    clientWatchdog->timeout_cycles = timeoutCycles > 0 ? timeoutCycles : watchdog->default_timeout_cycles;
+    clientWatchdog->slave_mask = slaveMask;
+    clientWatchdog->heartbeat = 0;
+    clientWatchdog->rearm = false;
+    __sync_synchronize();
+    clientWatchdog->active = true;
+    return true;
+}
+
+void EcatConfig::unregisterWatchdog() {
+    if (!clientWatchdog)
+        return;
+
+    clientWatchdog->active = false;
+    releaseClientSlot();
+}
+
+void EcatConfig::commit() {
+    if (clientWatchdog)
+        clientWatchdog->commit++;
+}
+
+bool EcatConfig::isWatchdogTripped() const {
+    return clientWatchdog && clientWatchdog->active && clientWatchdog->tripped;
+}
+
+void EcatConfig::rearmWatchdog() {
+    if (clientWatchdog)
+        clientWatchdog->rearm = true;
+}
+
+void EcatConfig::setSlaveSafeOutput(int slaveId, int safeOutput) {
+    if (!checkWritable("setSlaveSafeOutput"))
+        return;
+    watchdog->safe_output[slaveId] = safeOutput;
+}
+
+ClientWatchdog EcatConfig::getWatchdog() const {
+    return clientWatchdog ? *clientWatchdog : ClientWatchdog();
+}
+
+SlaveDiagnostics EcatConfig::getSlaveDiagnostics(int slaveId) const {
+    if (diagnostics == nullptr || slaveId < 0 || slaveId >= MAX_SLAVE_NUM)
+        return SlaveDiagnostics();
+    return diagnostics->slaves[slaveId];
+}
+
+EcatDiagnostics EcatConfig::getDiagnostics() const {
+    return diagnostics ? *diagnostics : EcatDiagnostics();
+}
+
+std::vector<DcSample> EcatConfig::getDcSamples(int num) const {
+    std::vector<DcSample> samples;
+    if (dcTimeSeries == nullptr || num <= 0)
+        return samples;
+
+    const uint64_t writePos = __atomic_load_n(&dcTimeSeries->write_pos, __ATOMIC_ACQUIRE);
+    const uint64_t count = std::min<uint64_t>({(uint64_t) num, writePos, MAX_DC_SAMPLES});
+    samples.reserve(count);
+    for (uint64_t pos = writePos - count; pos < writePos; ++pos) {
+        const DcSample &slot = dcTimeSeries->samples[pos % MAX_DC_SAMPLES];
+        DcSample sample;
+        const uint64_t sequence = __atomic_load_n(&slot.sequence, __ATOMIC_ACQUIRE);
+        std::memcpy(&sample, &slot, sizeof(DcSample));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (sequence != pos + 1 || __atomic_load_n(&slot.sequence, __ATOMIC_RELAXED) != sequence)
+            continue; // overwritten by the master meanwhile
+        samples.push_back(sample);
+    }
+    return samples;
+}
+
+double EcatConfig::getDcPercentile(double percentile) const {
+    if (dcTimeSeries == nullptr)
+        return -1.0;
+
+    uint64_t histogram[DC_HISTOGRAM_BUCKETS];
+    std::memcpy(histogram, dcTimeSeries->histogram, sizeof(histogram));
+    uint64_t total = 0;
+    for (uint64_t n: histogram)
+        total += n;
+    if (total == 0)
+        return -1.0;
+
+    const double rank = std::max(0.0, std::min(percentile, 100.0)) / 100.0 * (double) total;
+    uint64_t sum = 0;
+    for (int i = 0; i < DC_HISTOGRAM_BUCKETS - 1; ++i) {
+        sum += histogram[i];
+        if ((double) sum >= rank)
+            return (double) (i + 1) * DC_HISTOGRAM_RESOLUTION; // upper edge of the bucket
+    }
+    return std::max(std::abs(dcTimeSeries->min_diff), std::abs(dcTimeSeries->max_diff));
+}
+
+uint64_t EcatConfig::getDcSampleCount() const {
+    return dcTimeSeries ? __atomic_load_n(&dcTimeSeries->write_pos, __ATOMIC_ACQUIRE) : 0;
+}
+
+uint64_t EcatConfig::getLayoutVersion() const {
+    return layout ? __atomic_load_n(&layout->version, __ATOMIC_ACQUIRE) : 0;
+}
+
+bool EcatConfig::isSlavePresent(int slaveId) const {
+    if (slaveId < 0 || slaveId >= ecatBus->slave_num)
+        return false;
+    return layout == nullptr || (__atomic_load_n(&layout->present_mask, __ATOMIC_ACQUIRE) & ((uint64_t) 1 << slaveId)) != 0;
+}
+
+StartupTimings EcatConfig::getStartupTimings() const {
+    StartupTimings timings;
+    if (startup == nullptr)
+        return timings;
+
+    // phases are appended by the master, a phase is complete once phase_num covers it
+    timings.reached = __atomic_load_n(&startup->reached, __ATOMIC_ACQUIRE);
+    timings.reached_state = startup->reached_state;
+    timings.phase_num = __atomic_load_n(&startup->phase_num, __ATOMIC_ACQUIRE);
+    timings.fast_start = startup->fast_start;
+    for (int i = 0; i < timings.phase_num && i < MAX_STARTUP_PHASES; ++i) {
+        std::memcpy(timings.phases[i].name, startup->phases[i].name, MAX_STARTUP_PHASE_NAME);
+        timings.phases[i].begin = startup->phases[i].begin;
+        timings.phases[i].end = __atomic_load_n(&startup->phases[i].end, __ATOMIC_ACQUIRE);
+    }
+    return timings;
+}
+
+NotificationStat EcatConfig::getNotificationStat() const {
+    return notificationStat ? *notificationStat : NotificationStat();
+}
+
+uint64_t EcatConfig::getNotificationCount(uint32_t code, int stationAddress) const {
+    if (notificationStat == nullptr)
+        return 0;
+
+    if (stationAddress < 0) {
+        if ((code & 0xFFFF0000) == 0x00010000 && (code & 0xFFFF) < MAX_NOTIFY_CODES) // EC_NOTIFY_ERROR
+            return notificationStat->error_count[code & 0xFFFF];
+        return 0;
+    }
+
+    for (auto &entry: notificationStat->entries) {
+        if (entry.key != 0 && entry.code == code && entry.station_address == stationAddress)
+            return entry.count;
+    }
+    return 0;
+}
+
+bool EcatConfig::pollEvent(EcatEvent &event) {
+    return readEvent(eventRing, eventCursor, event, lostEvents);
+}
+
+bool EcatConfig::getPdStagingMemory() {
+    if (pdStagingPtr)
+        return true;
+
+    using namespace boost::interprocess;
+    std::size_t pageSize = 0;
+    try {
+        pdStagingRegion = openRegion(pdStagingName, false, pageSize);
+    } catch (interprocess_exception &e) {
+        print_message("[SHM] Can not open output staging memory " + pdStagingName + ": " + e.what(),
+                      MessageLevel::ERROR);
+        return false;
+    }
+
+    pdStagingPtr = static_cast<char *>(pdStagingRegion->get_address());
+    print_message(rocos::to_string(pdStagingName, prefaultRegion(pdStagingPtr, pdStagingRegion->get_size(), pageSize)));
+    return true;
+}
+
+void EcatConfig::lockOwnership() {
+    while (__sync_lock_test_and_set(&ownership->lock, 1))
+        std::this_thread::yield();
+    ownership->version++; // odd: table is being modified
+    __sync_synchronize();
+}
+
+void EcatConfig::unlockOwnership() {
+    __sync_synchronize();
+    ownership->version++;
+    __sync_lock_release(&ownership->lock);
+}
+
+void EcatConfig::removeOutputRanges(int client) {
+    lockOwnership();
+    int n = 0;
+    for (int i = 0; i < ownership->range_num; ++i) {
+        if (ownership->ranges[i].client != client)
+            ownership->ranges[n++] = ownership->ranges[i];
+    }
+    ownership->range_num = n;
+    unlockOwnership();
+}
+
+bool EcatConfig::claimOutputRange(int offset, int size) {
+    if (!checkWritable("claimOutputRange"))
+        return false;
+    if (offset < 0 || size <= 0 || offset + size > (int) pdOutputRegion->get_size()) {
+        print_message("[OWNERSHIP] Output range is out of process image.", MessageLevel::ERROR);
+        return false;
+    }
+
+    if (!getPdStagingMemory() || !acquireClientSlot())
+        return false;
+
+    if (ownership->staging_stride < offset + size ||
+        (clientIndex + 1) * (size_t) ownership->staging_stride > pdStagingRegion->get_size()) {
+        print_message("[OWNERSHIP] Output staging memory does not match the process image.", MessageLevel::ERROR);
+        releaseClientSlot();
+        return false;
+    }
+
+    char *staging = (char *) pdStagingPtr + clientIndex * ownership->staging_stride;
+
+    lockOwnership();
+    std::vector<OutputRange> own; // overlapping ranges of this client, merged into one
+    for (int i = 0; i < ownership->range_num; ++i) {
+        const OutputRange &range = ownership->ranges[i];
+        if (offset >= range.offset + range.size || range.offset >= offset + size)
+            continue;
+        if (range.client == clientIndex) {
+            if (range.offset <= offset && offset + size <= range.offset + range.size) {
+                unlockOwnership();
+                return true; // claimed already
+            }
+            own.push_back(range);
+            continue;
+        }
+        unlockOwnership();
+        print_message("[OWNERSHIP] Output range is already owned by client " + std::to_string(range.client) + ".",
+                      MessageLevel::ERROR);
+        releaseClientSlot(); // kept if ranges are claimed already
+        return false;
+    }
+
+    if (own.empty() && ownership->range_num >= MAX_OWNERSHIP_NUM) {
+        unlockOwnership();
+        print_message("[OWNERSHIP] Too many output ranges.", MessageLevel::ERROR);
+        releaseClientSlot();
+        return false;
+    }
+
+    // start from the current outputs, the first merge must not produce a jump. Bytes claimed already keep
+    // the values the client wrote.
+    std::sort(own.begin(), own.end(), [](const OutputRange &a, const OutputRange &b) { return a.offset < b.offset; });
+    int begin = offset;
+    int end = offset + size;
+    int pos = offset;
+    for (const OutputRange &range: own) {
+        if (range.offset > pos)
+            memcpy(staging + pos, (char *) pdOutputPtr + pos, range.offset - pos);
+        pos = std::max(pos, range.offset + range.size);
+        begin = std::min(begin, range.offset);
+        end = std::max(end, range.offset + range.size);
+    }
+    if (pos < offset + size)
+        memcpy(staging + pos, (char *) pdOutputPtr + pos, offset + size - pos);
+
+    auto isMerged = [&own](const OutputRange &range) {
+        for (const OutputRange &o: own)
+            if (o.client == range.client && o.offset == range.offset && o.size == range.size)
+                return true;
+        return false;
+    };
+    ownership->range_num = (int) (std::remove_if(ownership->ranges, ownership->ranges + ownership->range_num, isMerged)
+                                  - ownership->ranges);
+    OutputRange &range = ownership->ranges[ownership->range_num];
+    range.client = clientIndex;
+    range.offset = begin;
+    range.size = end - begin;
+    ownership->range_num++;
+    unlockOwnership();
+    pdOwnStagingPtr = staging;
+    claimedRanges.erase(std::remove_if(claimedRanges.begin(), claimedRanges.end(), isMerged), claimedRanges.end());
+    claimedRanges.push_back(range); // output accessors write this range into the staging area from now on
+
+    return true;
+}
+
+bool EcatConfig::claimSlaveOutputs(int slaveId) {
+    const Slave &slave = slaves()[slaveId];
+
+    int begin = -1;
+    int end = -1;
+    for (int i = 0; i < slave.output_var_num; ++i) {
+        const PdVar &var = slave.output_vars[i];
+        if (begin < 0 || var.offset < begin)
+            begin = var.offset;
+        if (var.offset + var.size > end)
+            end = var.offset + var.size;
+    }
+
+    if (begin < 0 || end <= begin) {
+        print_message("[OWNERSHIP] Slave " + std::to_string(slaveId) + " has no outputs.", MessageLevel::WARNING);
+        return false;
+    }
+
+    return claimOutputRange(begin, end - begin);
+}
+
+void EcatConfig::releaseOutputs() {
+    if (clientIndex < 0)
+        return;
+
+    removeOutputRanges(clientIndex);
+    claimedRanges.clear();
+    pdOwnStagingPtr = nullptr;
+    releaseClientSlot();
+}
+
 EcatConfig *EcatConfig::getInstance(int id) {
     if(instances.find(id) == instances.end()) {
         std::cout << "Create New Ecat Config Instance: " << id << std::endl;
@@ -234,5 +799,20 @@ EcatConfig *EcatConfig::getInstance(int id) {
 }
 
 
+EcatConfig *EcatConfig::getReadOnlyInstance(int id) {
+    if (readOnlyInstances.find(id) == readOnlyInstances.end()) {
+        auto *instance = new EcatConfig(id, true);
+        if (!instance->getSharedMemoryReadOnly()) {
+            delete instance;
+            return nullptr;
+        }
+        readOnlyInstances[id] = instance;
+    }
+
+    return readOnlyInstances[id];
+}
+
+
 std::map<int, EcatConfig*> EcatConfig::instances;
+std::map<int, EcatConfig*> EcatConfig::readOnlyInstances;
 
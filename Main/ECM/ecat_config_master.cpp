@@ -3,15 +3,28 @@
 //
 
 #include <ecat_config_master.h>
+#include <ecat_shm.h>
+#include <sys/time.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <fstream>
+#include <iomanip>
 
 
 using namespace rocos;
 
 EcatConfigMaster::EcatConfigMaster(int id) {
+    masterId = id;
     ecmName = EC_SHM + std::to_string(id);
     mutexName = EC_SEM_MUTEX + std::to_string(id) + "_";
     pdInputName = "pd_input" + std::to_string(id);
     pdOutputName = "pd_output" + std::to_string(id);
+    pdStagingName = "pd_staging" + std::to_string(id);
+    controlName = EC_SHM_CONTROL + std::to_string(id);
 
 }
 
@@ -24,12 +37,23 @@ bool EcatConfigMaster::createSharedMemory() {
 
     //////////////////// Shared Memory Object //////////////////////////
     using namespace boost::interprocess;
-    shared_memory_object::remove(ecmName.c_str());
-
-    managedSharedMemory = new managed_shared_memory{open_or_create, ecmName.c_str(), EC_SHM_MAX_SIZE};
+    std::size_t pageSize = 0;
+    std::string warning;
+    managedSharedMemory = createSegment(ecmName, EC_SHM_MAX_SIZE, hugePageSize, pageSize, warning);
+    if (!warning.empty())
+        print_message(warning, MessageLevel::WARNING);
+    print_message(rocos::to_string(ecmName, prefaultRegion(managedSharedMemory->get_address(),
+                                                           managedSharedMemory->get_size(), pageSize)));
 
     ecatBus = managedSharedMemory->find_or_construct<EcatBus>("ecat")();
-
+    watchdog = managedSharedMemory->find_or_construct<Watchdog>("watchdog")();
+    ownership = managedSharedMemory->find_or_construct<OutputOwnership>("ownership")();
+    notificationStat = managedSharedMemory->find_or_construct<NotificationStat>("notifications")();
+    eventRing = managedSharedMemory->find_or_construct<EventRing>("events")();
+    diagnostics = managedSharedMemory->find_or_construct<EcatDiagnostics>("diagnostics")();
+    dcTimeSeries = managedSharedMemory->find_or_construct<DcTimeSeries>("dc")();
+    layout = managedSharedMemory->find_or_construct<EcatLayout>("layout")();
+    startup = managedSharedMemory->find_or_construct<StartupTimings>("startup")();
 
 
     //////////////////// Semaphore //////////////////////////
@@ -81,7 +105,9 @@ bool EcatConfigMaster::getSharedMemory() {
     }
 
     using namespace boost::interprocess;
-    managedSharedMemory = new managed_shared_memory{open_or_create, ecmName.c_str(), EC_SHM_MAX_SIZE};
+    std::size_t pageSize = 0;
+    managedSharedMemory = openSegment(ecmName, EC_SHM_MAX_SIZE, pageSize);
+    prefaultRegion(managedSharedMemory->get_address(), managedSharedMemory->get_size(), pageSize);
 
     std::pair<EcatBus *, std::size_t> p1 = managedSharedMemory->find<EcatBus>("ecat");
     if (p1.first) {
@@ -90,6 +116,14 @@ bool EcatConfigMaster::getSharedMemory() {
         print_message("[SHM] Ec-Master is not running.", MessageLevel::WARNING);
         ecatBus = managedSharedMemory->construct<EcatBus>("ecat")();
     }
+    watchdog = managedSharedMemory->find_or_construct<Watchdog>("watchdog")();
+    ownership = managedSharedMemory->find_or_construct<OutputOwnership>("ownership")();
+    notificationStat = managedSharedMemory->find_or_construct<NotificationStat>("notifications")();
+    eventRing = managedSharedMemory->find_or_construct<EventRing>("events")();
+    diagnostics = managedSharedMemory->find_or_construct<EcatDiagnostics>("diagnostics")();
+    dcTimeSeries = managedSharedMemory->find_or_construct<DcTimeSeries>("dc")();
+    layout = managedSharedMemory->find_or_construct<EcatLayout>("layout")();
+    startup = managedSharedMemory->find_or_construct<StartupTimings>("startup")();
 
     umask(mask); // 恢复umask的值
 
@@ -151,32 +185,57 @@ void EcatConfigMaster::init() {
 bool EcatConfigMaster::createPdDataMemoryProvider(int pdInputSize, int pdOutputSize) {
     using namespace boost::interprocess;
 
-    shared_memory_object::remove(pdInputName.c_str());
-    shared_memory_object::remove(pdOutputName.c_str());
+    pdInputRegion = createPdRegion(pdInputName, pdInputSize);
+    pdOutputRegion = createPdRegion(pdOutputName, pdOutputSize);
 
-    pdInputShm = new shared_memory_object(open_or_create, pdInputName.c_str(), read_write);
-    pdOutputShm = new shared_memory_object(open_or_create, pdOutputName.c_str(), read_write);
+    pdInputPtr = static_cast<char *>(pdInputRegion->get_address());
+    pdOutputPtr = static_cast<char *>(pdOutputRegion->get_address());
 
-    pdInputShm->truncate(pdInputSize);
-    pdOutputShm->truncate(pdOutputSize);
+    /// Staging areas for clients owning output ranges
+    int stride = (pdOutputSize + EC_CACHE_LINE_SIZE - 1) / EC_CACHE_LINE_SIZE * EC_CACHE_LINE_SIZE;
+    if (stride == 0)
+        stride = EC_CACHE_LINE_SIZE;
 
-    pdInputRegion = new mapped_region(*pdInputShm, read_write);
-    pdOutputRegion = new mapped_region(*pdOutputShm, read_write);
+    pdStagingRegion = createPdRegion(pdStagingName, stride * MAX_CLIENT_NUM);
+    pdStagingPtr = static_cast<char *>(pdStagingRegion->get_address());
 
-    pdInputPtr = static_cast<char *>(pdInputRegion->get_address());
-    pdOutputPtr = static_cast<char *>(pdOutputRegion->get_address());
+    ownership->staging_stride = stride;
+    mergeRunNum = 0;
+    mergeVersion = 0;
+
+    return true;
+}
 
+boost::interprocess::mapped_region *EcatConfigMaster::createPdRegion(const std::string &name, std::size_t size) {
+    std::size_t pageSize = 0;
+    std::string warning;
+    auto *region = createRegion(name, size, hugePageSize, pageSize, warning);
+    if (!warning.empty())
+        print_message(warning, MessageLevel::WARNING);
+    print_message(rocos::to_string(name, prefaultRegion(region->get_address(), region->get_size(), pageSize)));
+    return region;
+}
+
+bool EcatConfigMaster::enableHugePages() {
+    hugePageSize = rocos::hugePageSize(EC_HUGEPAGE_DIR);
+    if (hugePageSize == 0) {
+        print_message(std::string("[SHM] ") + EC_HUGEPAGE_DIR + " is not a hugetlbfs mount, using POSIX shm.",
+                      MessageLevel::WARNING);
+        return false;
+    }
+    print_message((boost::format("[SHM] Shared memory is backed by %d KiB huge pages in %s.")
+                   % (hugePageSize / 1024) % EC_HUGEPAGE_DIR).str());
     return true;
 }
 
 bool EcatConfigMaster::getPdDataMemoryProvider() {
     using namespace boost::interprocess;
 
-    pdInputShm = new shared_memory_object(open_or_create, pdInputName.c_str(), read_write);
-    pdOutputShm = new shared_memory_object(open_or_create, pdOutputName.c_str(), read_write);
-
-    pdInputRegion = new mapped_region(*pdInputShm, read_write);
-    pdOutputRegion = new mapped_region(*pdOutputShm, read_write);
+    std::size_t pageSize = 0;
+    pdInputRegion = openRegion(pdInputName, true, pageSize);
+    prefaultRegion(pdInputRegion->get_address(), pdInputRegion->get_size(), pageSize);
+    pdOutputRegion = openRegion(pdOutputName, true, pageSize);
+    prefaultRegion(pdOutputRegion->get_address(), pdOutputRegion->get_size(), pageSize);
 
 
     pdInputPtr = static_cast<char *>(pdInputRegion->get_address());
@@ -196,3 +255,562 @@ void EcatConfigMaster::updateSempahore() {
     }
 }
 
+namespace {
+
+    //! mbind() a mapping to a preferred NUMA node and migrate the pages already faulted in
+    bool bindRegion(void *addr, std::size_t size, int node) {
+        if (addr == nullptr || size == 0)
+            return true;
+
+        long pageSize = sysconf(_SC_PAGESIZE);
+        auto begin = reinterpret_cast<std::uintptr_t>(addr) & ~(static_cast<std::uintptr_t>(pageSize) - 1);
+        auto end = reinterpret_cast<std::uintptr_t>(addr) + size;
+        unsigned long nodeMask[4] = {0};
+        nodeMask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+
+        return syscall(SYS_mbind, begin, end - begin, MPOL_PREFERRED, nodeMask,
+                       sizeof(nodeMask) * 8, MPOL_MF_MOVE) == 0;
+    }
+
+}
+
+bool EcatConfigMaster::publishGeneration() {
+    if (control == nullptr) {
+        mode_t mask = umask(0);
+        try {
+            controlRegion = openControlBlock(controlName, false);
+        } catch (boost::interprocess::interprocess_exception &e) {
+            umask(mask);
+            print_message("[SHM] Can not open control block " + controlName + ": " + e.what(), MessageLevel::ERROR);
+            return false;
+        }
+        umask(mask);
+        control = static_cast<rocos::EcatControl *>(controlRegion->get_address());
+    }
+
+    struct timeval tv{};
+    gettimeofday(&tv, nullptr);
+    control->master_pid = getpid();
+    control->start_timestamp = tv.tv_sec * 1000000 + tv.tv_usec; // us
+    uint64_t generation = __atomic_add_fetch(&control->generation, 1, __ATOMIC_RELEASE);
+    print_message("[SHM] Generation " + std::to_string(generation) + " published.");
+    return true;
+}
+
+bool EcatConfigMaster::bindNumaNode(int node) {
+    if (node < 0)
+        return true;
+    if (node >= 256) {
+        print_message("[SHM] NUMA node out of range.", MessageLevel::ERROR);
+        return false;
+    }
+
+    bool ok = true;
+    if (managedSharedMemory != nullptr)
+        ok &= bindRegion(managedSharedMemory->get_address(), managedSharedMemory->get_size(), node);
+    if (pdInputRegion != nullptr)
+        ok &= bindRegion(pdInputRegion->get_address(), pdInputRegion->get_size(), node);
+    if (pdOutputRegion != nullptr)
+        ok &= bindRegion(pdOutputRegion->get_address(), pdOutputRegion->get_size(), node);
+    if (pdStagingRegion != nullptr)
+        ok &= bindRegion(pdStagingRegion->get_address(), pdStagingRegion->get_size(), node);
+
+    if (!ok)
+        print_message((boost::format("[SHM] Can not bind shared memory to NUMA node %d: %s.") % node % strerror(errno)).str(),
+                      MessageLevel::WARNING);
+    return ok;
+}
+
+
+
+namespace {
+    // compare PD variable names ignoring case, blanks and underscores, e.g. "Control word" == "Controlword"
+    bool isSameVarName(const char *name, const char *key) {
+        while (*name != '\0' || *key != '\0') {
+            if (*name == ' ' || *name == '_') {
+                ++name;
+                continue;
+            }
+            if (std::tolower(*name) != std::tolower(*key))
+                return false;
+            ++name;
+            ++key;
+        }
+        return true;
+    }
+
+    void writeVar(void *base, int offset, int size, int64_t value) {
+        if (offset < 0 || size <= 0 || size > (int) sizeof(value))
+            return;
+        memcpy((char *) base + offset, &value, size); // little endian, same as EtherCAT
+    }
+
+    int64_t readVar(const void *base, int offset, int size) {
+        int64_t value = 0;
+        if (offset < 0 || size <= 0 || size > (int) sizeof(value))
+            return 0;
+        memcpy(&value, (const char *) base + offset, size);
+        if (size < (int) sizeof(value) && (value >> (size * 8 - 1)) & 1) // sign extension
+            value |= -((int64_t) 1 << (size * 8));
+        return value;
+    }
+
+    long currentTimestamp() {
+        timeval tv{};
+        gettimeofday(&tv, nullptr);
+        return tv.tv_sec * 1000000 + tv.tv_usec; // us, same clock as EcatBus::timestamp
+    }
+}
+
+void EcatConfigMaster::setupWatchdog(int defaultTimeoutCycles, int defaultSafeOutput) {
+    watchdog->default_timeout_cycles = defaultTimeoutCycles;
+
+    for (int i = 0; i < MAX_SLAVE_NUM; ++i) {
+        watchdog->safe_output[i] = defaultSafeOutput;
+        watchdog->safe_output_active[i] = false;
+        safeOutputVars[i] = SafeOutputVar();
+    }
+
+    for (int i = 0; i < ecatBus->slave_num && i < MAX_SLAVE_NUM; ++i)
+        resolveSafeOutputVars(i);
+}
+
+void EcatConfigMaster::resolveSafeOutputVars(int slaveId) {
+    const Slave &slave = slaves()[slaveId];
+    SafeOutputVar &var = safeOutputVars[slaveId];
+    var = SafeOutputVar();
+
+    for (int j = 0; j < slave.output_var_num; ++j) {
+        const PdVar &pd = slave.output_vars[j];
+        if (isSameVarName(pd.name, "controlword")) {
+            var.control_word = pd.offset;
+        } else if (isSameVarName(pd.name, "targetposition")) {
+            var.target_position = pd.offset;
+            var.size_target_position = pd.size;
+        } else if (isSameVarName(pd.name, "targetvelocity")) {
+            var.target_velocity = pd.offset;
+            var.size_target_velocity = pd.size;
+        } else if (isSameVarName(pd.name, "targettorque")) {
+            var.target_torque = pd.offset;
+            var.size_target_torque = pd.size;
+        }
+    }
+
+    for (int j = 0; j < slave.input_var_num; ++j) {
+        const PdVar &pd = slave.input_vars[j];
+        if (isSameVarName(pd.name, "positionactualvalue")) {
+            var.position_actual = pd.offset;
+            var.size_position_actual = pd.size;
+        }
+    }
+}
+
+bool EcatConfigMaster::stageSlave(int slaveId, const Slave &slave) {
+    if (slaveId < 0 || slaveId >= MAX_SLAVE_NUM || isLayoutPending())
+        return false;
+    ecatBus->slaves[slaveId] = slave;
+    return true;
+}
+
+bool EcatConfigMaster::commitLayout(uint64_t presentMask) {
+    if (isLayoutPending())
+        return false; // the job task may publish the back table any time
+
+    // the back table is not published, the previous one may still be read by clients
+    const uint64_t table = __atomic_load_n(&layout->table, __ATOMIC_ACQUIRE);
+    Slave *back = layout->tables[table == 1 ? 1 : 0];
+    std::copy(ecatBus->slaves, ecatBus->slaves + MAX_SLAVE_NUM, back);
+    layout->pending_present = presentMask;
+    __atomic_store_n(&layout->pending, 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool EcatConfigMaster::isLayoutPending() const {
+    return __atomic_load_n(&layout->pending, __ATOMIC_ACQUIRE) != 0;
+}
+
+bool EcatConfigMaster::switchLayout() {
+    if (layout == nullptr || !isLayoutPending())
+        return false;
+
+    // publish the back table, no descriptor is copied in the job task
+    const uint64_t table = __atomic_load_n(&layout->table, __ATOMIC_RELAXED) == 1 ? 2 : 1;
+    __atomic_store_n(&layout->table, table, __ATOMIC_RELEASE);
+    for (int i = 0; i < ecatBus->slave_num && i < MAX_SLAVE_NUM; ++i)
+        resolveSafeOutputVars(i);
+    layout->present_mask = layout->pending_present & allSlavesMask(ecatBus->slave_num);
+    const uint64_t version = __atomic_add_fetch(&layout->version, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&layout->pending, 0, __ATOMIC_RELEASE);
+
+    EcatEvent event;
+    event.type = ECAT_EVENT_LAYOUT;
+    event.timestamp = ecatBus->timestamp;
+    event.value[0] = (int) version;
+    event.value[1] = __builtin_popcountll(layout->present_mask);
+    postEvent(eventRing, event);
+    return true;
+}
+
+void EcatConfigMaster::applySafeOutput(int slaveId) {
+    const SafeOutputVar &var = safeOutputVars[slaveId];
+
+    switch (watchdog->safe_output[slaveId]) {
+        case SAFE_OUTPUT_QUICK_STOP:
+            writeVar(pdOutputPtr, var.control_word, 2, 0x0002); // Enable voltage, Quick stop (active low)
+            break;
+        case SAFE_OUTPUT_ZERO_TORQUE:
+            writeVar(pdOutputPtr, var.target_torque, var.size_target_torque, 0);
+            break;
+        case SAFE_OUTPUT_HOLD:
+            // latched once at the trip, following the actual position would let a drifting axis run away
+            if (var.position_actual >= 0) {
+                if (!watchdog->safe_output_active[slaveId])
+                    watchdog->hold_position[slaveId] = readVar(pdInputPtr, var.position_actual,
+                                                               var.size_position_actual);
+                writeVar(pdOutputPtr, var.target_position, var.size_target_position, watchdog->hold_position[slaveId]);
+            }
+            writeVar(pdOutputPtr, var.target_velocity, var.size_target_velocity, 0);
+            writeVar(pdOutputPtr, var.target_torque, var.size_target_torque, 0);
+            break;
+        case SAFE_OUTPUT_NONE:
+        default:
+            return;
+    }
+
+    watchdog->safe_output_active[slaveId] = true;
+}
+
+void EcatConfigMaster::reclaimDeadClient(int i) {
+    ClientWatchdog &client = watchdog->clients[i];
+    const int owner = client.pid;
+    if (owner == 0 || kill(owner, 0) == 0 || errno != ESRCH)
+        return;
+
+    // never spin in the job task, a client is modifying the table: try again in the next round
+    if (__sync_lock_test_and_set(&ownership->lock, 1))
+        return;
+    ownership->version++; // odd: table is being modified
+    __sync_synchronize();
+    int n = 0;
+    for (int j = 0; j < ownership->range_num; ++j) {
+        if (ownership->ranges[j].client != i)
+            ownership->ranges[n++] = ownership->ranges[j];
+    }
+    ownership->range_num = n;
+    __sync_synchronize();
+    ownership->version++;
+    __sync_lock_release(&ownership->lock);
+
+    client.active = false;
+    __sync_bool_compare_and_swap(&client.pid, owner, 0);
+}
+
+void EcatConfigMaster::checkWatchdog() {
+    const long cycle = ecatBus->cycle_count;
+    uint64_t staleMask = 0;
+
+    // one slot per CLIENT_CHECK_CYCLES, the merge picks up the new ownership table in the next cycle
+    if (cycle % CLIENT_CHECK_CYCLES == 0)
+        reclaimDeadClient((int) (cycle / CLIENT_CHECK_CYCLES % MAX_CLIENT_NUM));
+
+    for (auto &client: watchdog->clients) {
+        if (!client.active) {
+            if (client.armed) { // client unregistered
+                client.armed = false;
+                client.tripped = false;
+            }
+            continue;
+        }
+
+        if (!client.armed || client.rearm) { // newly registered or recovering client
+            client.armed = true;
+            client.rearm = false;
+            client.tripped = false;
+            client.last_commit = client.commit;
+            client.last_commit_cycle = cycle;
+            client.last_commit_timestamp = ecatBus->timestamp;
+        }
+
+        if (client.commit != client.last_commit) {
+            client.last_commit = client.commit;
+            client.last_commit_cycle = cycle;
+            client.last_commit_timestamp = ecatBus->timestamp;
+        }
+
+        client.missed_cycles = (int) (cycle - client.last_commit_cycle);
+
+        if (!client.tripped && client.timeout_cycles > 0 && client.missed_cycles >= client.timeout_cycles) {
+            client.tripped = true;
+            client.trip_count++;
+            client.trip_cycle = cycle;
+            client.trip_timestamp = ecatBus->timestamp;
+        }
+
+        if (client.tripped)
+            staleMask |= client.slave_mask;
+    }
+
+    for (int i = 0; i < ecatBus->slave_num && i < MAX_SLAVE_NUM; ++i) {
+        if (staleMask & ((uint64_t) 1 << i))
+            applySafeOutput(i);
+        else
+            watchdog->safe_output_active[i] = false;
+    }
+
+    if (staleMask == 0)
+        return;
+
+    // reaction time within the cycle that detected the stale command
+    double reaction = (double) (currentTimestamp() - ecatBus->timestamp);
+    for (auto &client: watchdog->clients) {
+        if (client.active && client.tripped && client.trip_cycle == cycle) {
+            client.reaction_time = reaction;
+            if (reaction > client.max_reaction_time)
+                client.max_reaction_time = reaction;
+        }
+    }
+}
+
+void EcatConfigMaster::compileMergeRuns(const OutputRange *ranges, int rangeNum) {
+    OutputRange sorted[MAX_OWNERSHIP_NUM];
+    int n = 0;
+
+    // insertion sort by offset, the table is small and rarely changes
+    for (int i = 0; i < rangeNum; ++i) {
+        const OutputRange &range = ranges[i];
+        if (range.client < 0 || range.client >= MAX_CLIENT_NUM || range.offset < 0 || range.size <= 0 ||
+            range.offset + range.size > (int) pdOutputRegion->get_size())
+            continue;
+
+        int j = n++;
+        while (j > 0 && sorted[j - 1].offset > range.offset) {
+            sorted[j] = sorted[j - 1];
+            --j;
+        }
+        sorted[j] = range;
+    }
+
+    // adjacent ranges of the same client become one copy
+    mergeRunNum = 0;
+    for (int i = 0; i < n; ++i) {
+        const OutputRange &range = sorted[i];
+        int source = range.client * ownership->staging_stride + range.offset;
+
+        if (mergeRunNum > 0) {
+            MergeRun &last = mergeRuns[mergeRunNum - 1];
+            if (last.offset + last.size == range.offset && last.source + last.size == source) {
+                last.size += range.size;
+                continue;
+            }
+        }
+
+        MergeRun &run = mergeRuns[mergeRunNum++];
+        run.source = source;
+        run.offset = range.offset;
+        run.size = range.size;
+    }
+}
+
+void EcatConfigMaster::updateDiagnostics(const uint8_t *diagnosisImage) {
+    if (diagnosisImage == nullptr)
+        return;
+
+    // every cycle with invalid process data raises EC_NOTIFY_CYCCMD_WKC_ERROR, no scan in good cycles
+    const uint64_t cyclicWkcErrors = __atomic_load_n(&diagnostics->cyclic_wkc_errors, __ATOMIC_RELAXED);
+    if (cyclicWkcErrors == lastCyclicWkcErrors)
+        return;
+    lastCyclicWkcErrors = cyclicWkcErrors;
+
+    for (int i = 0; i < ecatBus->slave_num; ++i) {
+        SlaveDiagnostics &slave = diagnostics->slaves[i];
+        if (isWkcStateSet(diagnosisImage, slave.wkc_state_bit_in) ||
+            isWkcStateSet(diagnosisImage, slave.wkc_state_bit_out)) // 1: data invalid
+            __atomic_fetch_add(&slave.wkc_errors, 1, __ATOMIC_RELAXED);
+    }
+}
+
+void EcatConfigMaster::sampleDc(int status, int diffCur, int diffAvg, int diffMax) {
+    const uint64_t pos = dcTimeSeries->write_pos;
+    DcSample &sample = dcTimeSeries->samples[pos % MAX_DC_SAMPLES];
+
+    // single writer, seqlock against the readers of getDcSamples()
+    __atomic_store_n(&sample.sequence, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    sample.cycle = ecatBus->cycle_count;
+    sample.timestamp = ecatBus->timestamp;
+    sample.status = status;
+    sample.diff_cur = diffCur;
+    sample.diff_avg = diffAvg;
+    sample.diff_max = diffMax;
+    __atomic_store_n(&sample.sequence, pos + 1, __ATOMIC_RELEASE);
+
+    if (pos == 0 || diffCur < dcTimeSeries->min_diff)
+        dcTimeSeries->min_diff = diffCur;
+    if (pos == 0 || diffCur > dcTimeSeries->max_diff)
+        dcTimeSeries->max_diff = diffCur;
+    if (status != 0)
+        dcTimeSeries->out_of_sync++;
+    const unsigned int bucket = (unsigned int) std::abs(diffCur) / DC_HISTOGRAM_RESOLUTION;
+    dcTimeSeries->histogram[bucket < DC_HISTOGRAM_BUCKETS ? bucket : DC_HISTOGRAM_BUCKETS - 1]++;
+
+    __atomic_store_n(&dcTimeSeries->write_pos, pos + 1, __ATOMIC_RELEASE);
+}
+
+int EcatConfigMaster::beginStartupPhase(const char *name) {
+    return addStartupPhase(name, getProcessUptime(), -1);
+}
+
+int EcatConfigMaster::addStartupPhase(const char *name, long begin, long end) {
+    if (startup == nullptr || startup->reached >= 0 || startup->phase_num >= MAX_STARTUP_PHASES)
+        return -1;
+
+    const int phase = startup->phase_num;
+    StartupPhase &p = startup->phases[phase];
+    std::strncpy(p.name, name, MAX_STARTUP_PHASE_NAME - 1);
+    p.name[MAX_STARTUP_PHASE_NAME - 1] = '\0';
+    p.begin = begin;
+    p.end = end;
+    __atomic_store_n(&startup->phase_num, phase + 1, __ATOMIC_RELEASE);
+    return phase;
+}
+
+void EcatConfigMaster::endStartupPhase(int phase) {
+    if (startup == nullptr || phase < 0 || phase >= startup->phase_num)
+        return;
+    __atomic_store_n(&startup->phases[phase].end, getProcessUptime(), __ATOMIC_RELEASE);
+}
+
+bool EcatConfigMaster::setStartupReached(int state) {
+    if (startup == nullptr || startup->reached >= 0)
+        return false;
+
+    startup->reached_state = state;
+    __atomic_store_n(&startup->reached, getProcessUptime(), __ATOMIC_RELEASE);
+    return true;
+}
+
+std::string EcatConfigMaster::getStartupSummary() const {
+    if (startup == nullptr)
+        return std::string();
+
+    static const std::unordered_map<int, const char *> stateNames = {
+            {ECAT_STATE_INIT, "INIT"}, {ECAT_STATE_PREOP, "PREOP"}, {ECAT_STATE_SAFEOP, "SAFEOP"}, {ECAT_STATE_OP, "OP"}};
+    auto state = stateNames.find(startup->reached_state);
+
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(1) << "[STARTUP] ";
+    if (startup->reached >= 0)
+        ss << (state != stateNames.end() ? state->second : "requested state") << " after "
+           << startup->reached / 1000.0 << " ms";
+    else
+        ss << "requested state not reached, aborted after " << getProcessUptime() / 1000.0 << " ms";
+    ss << (startup->fast_start ? " (fast start)" : "") << ":";
+    for (int i = 0; i < startup->phase_num; ++i) {
+        const StartupPhase &p = startup->phases[i];
+        ss << (i == 0 ? " " : ", ") << p.name << " ";
+        if (p.end >= 0)
+            ss << (p.end - p.begin) / 1000.0;
+        else
+            ss << "unfinished";
+        if (startup->reached < 0 && i == startup->phase_num - 1)
+            ss << " (aborted)"; // the phase the start-up failed in
+    }
+    ss << " ms";
+    return ss.str();
+}
+
+bool EcatConfigMaster::writeStartupTrace(const std::string &fileName) const {
+    if (startup == nullptr)
+        return false;
+
+    std::ofstream trace(fileName, std::ios::trunc);
+    if (!trace)
+        return false;
+
+    // complete events ("X") of one thread, Perfetto nests them by their time ranges
+    const int pid = getpid();
+    const long now = getProcessUptime();
+    trace << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    trace << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":0,\"args\":{\"name\":\""
+          << program_invocation_short_name << " " << ecmName << "\"}}";
+    for (int i = 0; i < startup->phase_num; ++i) {
+        const StartupPhase &p = startup->phases[i];
+        if (p.end < 0 && startup->reached >= 0)
+            continue; // completed without this phase
+        const bool aborted = startup->reached < 0 && i == startup->phase_num - 1;
+        std::string name;
+        for (const char *c = p.name; *c != '\0'; ++c) {
+            if (*c == '"' || *c == '\\')
+                name += '\\';
+            name += *c;
+        }
+        trace << ",\n{\"name\":\"" << name << "\",\"cat\":\"startup\",\"ph\":\"X\",\"pid\":" << pid
+              << ",\"tid\":0,\"ts\":" << p.begin << ",\"dur\":" << (p.end >= 0 ? p.end : now) - p.begin
+              << ",\"args\":{\"unfinished\":" << (p.end < 0) << ",\"aborted\":" << aborted << "}}";
+    }
+    if (startup->reached >= 0)
+        trace << ",\n{\"name\":\"reached\",\"cat\":\"startup\",\"ph\":\"i\",\"s\":\"p\",\"pid\":" << pid
+              << ",\"tid\":0,\"ts\":" << startup->reached << ",\"args\":{\"state\":" << startup->reached_state
+              << ",\"fast_start\":" << startup->fast_start << "}}";
+    else
+        trace << ",\n{\"name\":\"aborted\",\"cat\":\"startup\",\"ph\":\"i\",\"s\":\"p\",\"pid\":" << pid
+              << ",\"tid\":0,\"ts\":" << now << ",\"args\":{\"fast_start\":" << startup->fast_start << "}}";
+    trace << "\n]}\n";
+    return (bool) trace;
+}
+
+std::string EcatConfigMaster::getStartupTraceName(const std::string &pattern) const {
+    std::string fileName = pattern;
+    const std::string::size_type pos = fileName.find("%d");
+    if (pos != std::string::npos)
+        fileName.replace(pos, 2, std::to_string(masterId));
+    return fileName;
+}
+
+long EcatConfigMaster::getProcessUptime() {
+    static long startTime = -1; // us since boot
+
+    if (startTime < 0) {
+        // field 22 of /proc/self/stat, counted after the command name which may contain blanks
+        unsigned long long ticks = 0;
+        std::ifstream stat("/proc/self/stat");
+        std::string line;
+        std::getline(stat, line);
+        const std::size_t pos = line.rfind(')');
+        std::istringstream fields(pos == std::string::npos ? std::string() : line.substr(pos + 1));
+        std::string field;
+        for (int i = 3; i < 22 && fields >> field; ++i);
+        fields >> ticks;
+        startTime = (long) (ticks * 1000000 / sysconf(_SC_CLK_TCK));
+    }
+
+    struct timespec ts{};
+    clock_gettime(CLOCK_BOOTTIME, &ts); // same clock as the start time, includes suspend
+    return ts.tv_sec * 1000000 + ts.tv_nsec / 1000 - startTime;
+}
+
+void EcatConfigMaster::mergeOutputs() {
+    if (!pdStagingPtr)
+        return;
+
+    // pick up a new ownership table, seqlock against the writing client
+    unsigned int version = ownership->version;
+    if (version != mergeVersion && (version & 1) == 0) {
+        OutputRange ranges[MAX_OWNERSHIP_NUM];
+        __sync_synchronize();
+        int rangeNum = ownership->range_num;
+        if (rangeNum > MAX_OWNERSHIP_NUM)
+            rangeNum = MAX_OWNERSHIP_NUM;
+        memcpy(ranges, ownership->ranges, rangeNum * sizeof(OutputRange));
+        __sync_synchronize();
+        if (ownership->version == version) {
+            compileMergeRuns(ranges, rangeNum);
+            mergeVersion = version;
+        }
+    }
+
+    for (int i = 0; i < mergeRunNum; ++i) {
+        const MergeRun &run = mergeRuns[i];
+        memcpy((char *) pdOutputPtr + run.offset, (const char *) pdStagingPtr + run.source, run.size);
+    }
+}
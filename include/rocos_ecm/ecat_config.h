@@ -8,20 +8,38 @@
 #include <ecat_type.h>
 #include <thread>
 #include <boost/interprocess/managed_shared_memory.hpp>
+#include <boost/interprocess/managed_mapped_file.hpp>
 #include <boost/interprocess/shared_memory_object.hpp>
 #include <boost/interprocess/mapped_region.hpp>
 #include <boost/format.hpp>
 #include <map>
+#include <mutex>
+#include <vector>
 
 namespace rocos {
     class EcatConfig {
     private:
-        EcatConfig(int id = 0);
+        EcatConfig(int id = 0, bool readOnly = false);
         ~EcatConfig();
 
     public:
         static EcatConfig* getInstance(int id = 0);
 
+        //! Attach without any effect on the master, for monitors and dashboards: the shared memory is mapped
+        //! with PROT_READ, no semaphore is created and nothing is constructed if the master is not running
+        //! (nullptr is returned then). wait() polls the cycle counter instead of taking a semaphore slot.
+        //! All setters are refused, the set*VarValue templates must not be used on this instance.
+        static EcatConfig* getReadOnlyInstance(int id = 0);
+
+        bool isReadOnly() const { return readOnly; }
+
+        //! Master start this instance is attached to. When the master restarts, wait() remaps the new
+        //! shared memory and registers the watchdog and output ranges of this process again.
+        uint64_t getGeneration() const { return generation; }
+
+        //! Times the shared memory of a restarted master was remapped
+        uint64_t getReattachCount() const { return reattachCount; }
+
         void wait();
 
         double getBusMinCycleTime() const;
@@ -40,6 +58,9 @@ namespace rocos {
 
         void resetCycleTime();
 
+        //! Ask the master to dump the frames of the last seconds (flight recorder, --flightrec)
+        void requestCapture();
+
         void setBusRequestState(int state);
         int  getBusCurrentState() const;
         void waitForSignal(int id = 0); // compact code, not recommended use. use wait() instead
@@ -65,46 +86,119 @@ namespace rocos {
 
         int findSlaveInputVarIdByName(int slaveId, const std::string &varName);
 
+        //! Register this process at the master watchdog. timeoutCycles = 0 uses the master default (--wdcycles)
+        bool registerWatchdog(int timeoutCycles = 0, uint64_t slaveMask = ~(uint64_t) 0);
+
+        void unregisterWatchdog();
+
+        //! Signal that the outputs of the current cycle are written
+        void commit();
+
+        bool isWatchdogTripped() const;
+
+        //! Leave the tripped state, the master releases the safe outputs in the next cycle
+        void rearmWatchdog();
+
+        void setSlaveSafeOutput(int slaveId, int safeOutput);
+
+        ClientWatchdog getWatchdog() const;
+
+        //! Take over a byte range of pd_output. Output accessors of this process then write the range into a
+        //! cache-line-aligned staging area, the master merges owned ranges before sending the frames.
+        //! Outputs outside the claimed ranges are still written to pd_output directly.
+        bool claimOutputRange(int offset, int size);
+
+        bool claimSlaveOutputs(int slaveId);
+
+        void releaseOutputs();
+
+        //! Error counters and state of slave slaveId (WKC errors, lost frames, AL status, mailbox errors, ...)
+        SlaveDiagnostics getSlaveDiagnostics(int slaveId) const;
+
+        //! Diagnostics of the whole bus, including the counters not attributed to a slave
+        EcatDiagnostics getDiagnostics() const;
+
+        //! The last num DCM deviation samples of the master (--dcsample), oldest first
+        std::vector<DcSample> getDcSamples(int num) const;
+
+        //! Percentile (e.g. 99.0) of the absolute DCM deviation in ns over all samples,
+        //! resolution DC_HISTOGRAM_RESOLUTION. -1 if there are no samples.
+        double getDcPercentile(double percentile) const;
+
+        uint64_t getDcSampleCount() const;
+
+        //! Incremented whenever the master switched to a new slave table (hot connect groups), see ECAT_EVENT_LAYOUT
+        uint64_t getLayoutVersion() const;
+
+        //! Slave table currently published by the master, read it again after ECAT_EVENT_LAYOUT
+        const Slave *slaves() const { return activeSlaves(ecatBus, layout); }
+
+        //! false while the hot connect group of the slave is disconnected, its process data is not valid then
+        bool isSlavePresent(int slaveId) const;
+
+        //! Phases of the master start-up (state transitions, application setup) and when the bus reached the
+        //! requested state
+        StartupTimings getStartupTimings() const;
+
+        //! Raw error notification counts of the master, also those filtered or rate limited in its log
+        NotificationStat getNotificationStat() const;
+
+        //! Error notifications of code (e.g. 0x10001 = EC_NOTIFY_CYCCMD_WKC_ERROR) from the slave with this
+        //! station address (e.g. 1001), -1 = all
+        uint64_t getNotificationCount(uint32_t code, int stationAddress = -1) const;
+
+        //! Next master event (state changes, AL status errors, WKC errors, DC sync, ...) since the last call,
+        //! every EcatConfig instance has its own cursor. Call it after wait() to react in the same cycle.
+        //! \return false if there is no new event
+        bool pollEvent(EcatEvent &event);
+
+        //! Events overwritten before pollEvent() read them
+        uint64_t getLostEventCount() const { return lostEvents; }
+
         template<typename T>
         T getSlaveInputVarValue(int slaveId, int varId) {
-            if (sizeof(T) != ecatBus->slaves[slaveId].input_vars[varId].size) {
+            if (sizeof(T) != slaves()[slaveId].input_vars[varId].size) {
                 print_message("Size of Var is not equal", MessageLevel::WARNING);
             }
-            return *(T *) ((char *) pdInputPtr + ecatBus->slaves[slaveId].input_vars[varId].offset);
+            return *(T *) ((char *) pdInputPtr + slaves()[slaveId].input_vars[varId].offset);
         }
 
         template<typename T>
         void setSlaveInputVarValue(int slaveId, int varId, T value) {
-            if (sizeof(T) != ecatBus->slaves[slaveId].input_vars[varId].size) {
+            if (!checkWritable("setSlaveInputVarValue"))
+                return;
+            if (sizeof(T) != slaves()[slaveId].input_vars[varId].size) {
                 print_message("Size of Var is not equal", MessageLevel::WARNING);
             }
-            *(T *) ((char *) pdInputPtr + ecatBus->slaves[slaveId].input_vars[varId].offset) = value;
+            *(T *) ((char *) pdInputPtr + slaves()[slaveId].input_vars[varId].offset) = value;
         }
 
         template<typename T>
         T getSlaveOutputVarValue(int slaveId, int varId) {
-            if (sizeof(T) != ecatBus->slaves[slaveId].output_vars[varId].size) {
+            if (sizeof(T) != slaves()[slaveId].output_vars[varId].size) {
                 print_message("Size of Var is not equal", MessageLevel::WARNING);
             }
-            return *(T *) ((char *) pdOutputPtr + ecatBus->slaves[slaveId].output_vars[varId].offset);
+            return *(T *) (outputAddress(slaves()[slaveId].output_vars[varId].offset));
         }
 
         template<typename T>
         void setSlaveOutputVarValue(int slaveId, int varId, T value) {
-            if (sizeof(T) != ecatBus->slaves[slaveId].output_vars[varId].size) {
+            if (!checkWritable("setSlaveOutputVarValue"))
+                return;
+            if (sizeof(T) != slaves()[slaveId].output_vars[varId].size) {
                 print_message("Size of Var is not equal", MessageLevel::WARNING);
             }
-            *(T *) ((char *) pdOutputPtr + ecatBus->slaves[slaveId].output_vars[varId].offset) = value;
+            *(T *) (outputAddress(slaves()[slaveId].output_vars[varId].offset)) = value;
         }
 
         template<typename T>
         T getSlaveInputVarValueByName(int slaveId, const std::string &varName) {
-            for (int i = 0; i < ecatBus->slaves[slaveId].input_var_num; ++i) {
-                if (strcmp(ecatBus->slaves[slaveId].input_vars[i].name, varName.c_str()) == 0) {
-                    if (sizeof(T) != ecatBus->slaves[slaveId].input_vars[i].size) {
+            for (int i = 0; i < slaves()[slaveId].input_var_num; ++i) {
+                if (strcmp(slaves()[slaveId].input_vars[i].name, varName.c_str()) == 0) {
+                    if (sizeof(T) != slaves()[slaveId].input_vars[i].size) {
                         print_message("Size of Var is not equal", MessageLevel::WARNING);
                     }
-                    return *(T *) ((char *) pdInputPtr + ecatBus->slaves[slaveId].input_vars[i].offset);
+                    return *(T *) ((char *) pdInputPtr + slaves()[slaveId].input_vars[i].offset);
                 }
             }
             return std::numeric_limits<T>::max();
@@ -112,24 +206,26 @@ namespace rocos {
 
         template<typename T>
         void setSlaveInputVarValueByName(int slaveId, const std::string &varName, T value) {
-            for (int i = 0; i < ecatBus->slaves[slaveId].input_var_num; ++i) {
-                if (strcmp(ecatBus->slaves[slaveId].input_vars[i].name, varName.c_str()) == 0) {
-                    if (sizeof(T) != ecatBus->slaves[slaveId].input_vars[i].size) {
+            if (!checkWritable("setSlaveInputVarValueByName"))
+                return;
+            for (int i = 0; i < slaves()[slaveId].input_var_num; ++i) {
+                if (strcmp(slaves()[slaveId].input_vars[i].name, varName.c_str()) == 0) {
+                    if (sizeof(T) != slaves()[slaveId].input_vars[i].size) {
                         print_message("Size of Var is not equal", MessageLevel::WARNING);
                     }
-                    *(T *) ((char *) pdInputPtr + ecatBus->slaves[slaveId].input_vars[i].offset) = value;
+                    *(T *) ((char *) pdInputPtr + slaves()[slaveId].input_vars[i].offset) = value;
                 }
             }
         }
 
         template<typename T>
         T getSlaveOutputVarValueByName(int slaveId, const std::string &varName) {
-            for (int i = 0; i < ecatBus->slaves[slaveId].output_var_num; ++i) {
-                if (strcmp(ecatBus->slaves[slaveId].output_vars[i].name, varName.c_str()) == 0) {
-                    if (sizeof(T) != ecatBus->slaves[slaveId].output_vars[i].size) {
+            for (int i = 0; i < slaves()[slaveId].output_var_num; ++i) {
+                if (strcmp(slaves()[slaveId].output_vars[i].name, varName.c_str()) == 0) {
+                    if (sizeof(T) != slaves()[slaveId].output_vars[i].size) {
                         print_message("Size of Var is not equal", MessageLevel::WARNING);
                     }
-                    return *(T *) ((char *) pdOutputPtr + ecatBus->slaves[slaveId].output_vars[i].offset);
+                    return *(T *) (outputAddress(slaves()[slaveId].output_vars[i].offset));
                 }
             }
             return std::numeric_limits<T>::max();
@@ -137,40 +233,42 @@ namespace rocos {
 
         template<typename T>
         void setSlaveOutputVarValueByName(int slaveId, const std::string &varName, T value) {
-            for (int i = 0; i < ecatBus->slaves[slaveId].output_var_num; ++i) {
-                if (strcmp(ecatBus->slaves[slaveId].output_vars[i].name, varName.c_str()) == 0) {
-                    if (sizeof(T) != ecatBus->slaves[slaveId].output_vars[i].size) {
+            if (!checkWritable("setSlaveOutputVarValueByName"))
+                return;
+            for (int i = 0; i < slaves()[slaveId].output_var_num; ++i) {
+                if (strcmp(slaves()[slaveId].output_vars[i].name, varName.c_str()) == 0) {
+                    if (sizeof(T) != slaves()[slaveId].output_vars[i].size) {
                         print_message("Size of Var is not equal", MessageLevel::WARNING);
                     }
-                    *(T *) ((char *) pdOutputPtr + ecatBus->slaves[slaveId].output_vars[i].offset) = value;
+                    *(T *) (outputAddress(slaves()[slaveId].output_vars[i].offset)) = value;
                 }
             }
         }
 
         template<typename T>
         T* getSlaveInputVarPtr(int slaveId, int varId) {
-            if (sizeof(T) != ecatBus->slaves[slaveId].input_vars[varId].size) {
+            if (sizeof(T) != slaves()[slaveId].input_vars[varId].size) {
                 print_message("Size of Var is not equal", MessageLevel::WARNING);
             }
-            return (T *) ((char *) pdInputPtr + ecatBus->slaves[slaveId].input_vars[varId].offset);
+            return (T *) ((char *) pdInputPtr + slaves()[slaveId].input_vars[varId].offset);
         }
 
         template<typename T>
         T* getSlaveOutputVarPtr(int slaveId, int varId) {
-            if (sizeof(T) != ecatBus->slaves[slaveId].output_vars[varId].size) {
+            if (sizeof(T) != slaves()[slaveId].output_vars[varId].size) {
                 print_message("Size of Var is not equal", MessageLevel::WARNING);
             }
-            return (T *) ((char *) pdOutputPtr + ecatBus->slaves[slaveId].output_vars[varId].offset);
+            return (T *) (outputAddress(slaves()[slaveId].output_vars[varId].offset));
         }
 
         template<typename T>
         T* findSlaveInputVarPtrByName(int slaveId, const std::string &varName) {
-            for (int i = 0; i < ecatBus->slaves[slaveId].input_var_num; ++i) {
-                if (strcmp(ecatBus->slaves[slaveId].input_vars[i].name, varName.c_str()) == 0) {
-                    if (sizeof(T) != ecatBus->slaves[slaveId].input_vars[i].size) {
+            for (int i = 0; i < slaves()[slaveId].input_var_num; ++i) {
+                if (strcmp(slaves()[slaveId].input_vars[i].name, varName.c_str()) == 0) {
+                    if (sizeof(T) != slaves()[slaveId].input_vars[i].size) {
                         print_message("Size of Var is not equal", MessageLevel::WARNING);
                     }
-                    return (T *) ((char *) pdInputPtr + ecatBus->slaves[slaveId].input_vars[i].offset);
+                    return (T *) ((char *) pdInputPtr + slaves()[slaveId].input_vars[i].offset);
                 }
             }
             return nullptr;
@@ -178,12 +276,12 @@ namespace rocos {
 
         template<typename T>
         T* findSlaveOutputVarPtrByName(int slaveId, const std::string &varName) {
-            for (int i = 0; i < ecatBus->slaves[slaveId].output_var_num; ++i) {
-                if (strcmp(ecatBus->slaves[slaveId].output_vars[i].name, varName.c_str()) == 0) {
-                    if (sizeof(T) != ecatBus->slaves[slaveId].output_vars[i].size) {
+            for (int i = 0; i < slaves()[slaveId].output_var_num; ++i) {
+                if (strcmp(slaves()[slaveId].output_vars[i].name, varName.c_str()) == 0) {
+                    if (sizeof(T) != slaves()[slaveId].output_vars[i].size) {
                         print_message("Size of Var is not equal", MessageLevel::WARNING);
                     }
-                    return (T *) ((char *) pdOutputPtr + ecatBus->slaves[slaveId].output_vars[i].offset);
+                    return (T *) (outputAddress(slaves()[slaveId].output_vars[i].offset));
                 }
             }
             return nullptr;
@@ -192,36 +290,121 @@ namespace rocos {
 
     private:
         static std::map<int, EcatConfig*> instances;
+        static std::map<int, EcatConfig*> readOnlyInstances;
 
         void init();
 
         bool getSharedMemory();
 
+        bool getSharedMemoryReadOnly();
+
+        bool checkWritable(const char *what);
+
+        bool openControlBlock();
+
+        //! Look for the control block again if it did not exist when this client attached, a master found now
+        //! started later: generation 0 makes the next wait() reattach to it
+        bool findControlBlock();
+
+        //! Close the semaphore handle of slot id replaced by reattach(), call from the thread waiting on the slot
+        void closeStaleSemaphore(int id);
+
+        bool isNewGeneration() const {
+            return control && __atomic_load_n(&control->generation, __ATOMIC_ACQUIRE) != generation;
+        }
+
+        bool reattach();
+
         bool getPdDataMemoryProvider();
 
+        bool getPdStagingMemory();
+
+        bool acquireClientSlot();
+
+        void releaseClientSlot();
+
+        void lockOwnership();
+
+        void unlockOwnership();
+
+        void removeOutputRanges(int client);
+
+        //! Own staging area for offsets in a claimed output range, pd_output otherwise
+        char *outputAddress(int offset) const {
+            for (const OutputRange &range: claimedRanges) {
+                if (offset >= range.offset && offset < range.offset + range.size)
+                    return pdOwnStagingPtr + offset;
+            }
+            return (char *) pdOutputPtr + offset;
+        }
+
 
         std::vector<std::thread::id> threadId;
 
+        bool readOnly = false;
+        long lastCycle = -1; // read-only wait()
+
         std::string ecmName {EC_SHM};
         std::string mutexName {EC_SEM_MUTEX};
         std::string pdInputName {"pd_input"};
         std::string pdOutputName {"pd_output"};
+        std::string pdStagingName {"pd_staging"};
+        std::string controlName {EC_SHM_CONTROL};
 
-        boost::interprocess::managed_shared_memory *managedSharedMemory = nullptr;
+        boost::interprocess::managed_mapped_file *managedSharedMemory = nullptr; // POSIX shm or hugetlbfs file
 
-        // PD Input and Output memory
-        boost::interprocess::shared_memory_object *pdInputShm = nullptr;
-        boost::interprocess::shared_memory_object *pdOutputShm = nullptr;
+        // PD Input and Output memory, pre-faulted and locked on attach
         boost::interprocess::mapped_region *pdInputRegion = nullptr;
         boost::interprocess::mapped_region *pdOutputRegion = nullptr;
 
         void *pdInputPtr = nullptr;
         void *pdOutputPtr = nullptr;
 
+        // Output staging memory
+        boost::interprocess::mapped_region *pdStagingRegion = nullptr;
+        void *pdStagingPtr = nullptr;
+        char *pdOwnStagingPtr = nullptr; // staging area of this client, set once an output range is claimed
+
         EcatBus *ecatBus = nullptr;
 
+        // Generation of the master start, mappings of earlier starts are kept until destruction since
+        // other threads of this process may still use pointers into them
+        boost::interprocess::mapped_region *controlRegion = nullptr;
+        EcatControl *control = nullptr;
+        uint64_t generation = 0;
+        uint64_t reattachCount = 0;
+        std::mutex reattachMutex;
+        std::vector<boost::interprocess::managed_mapped_file *> retiredSegments;
+        std::vector<boost::interprocess::mapped_region *> retiredRegions;
+
+        // Registrations restored after a reattach
+        int watchdogTimeoutCycles = 0;
+        uint64_t watchdogSlaveMask = ~(uint64_t) 0;
+        std::vector<OutputRange> claimedRanges;
+
+        Watchdog *watchdog = nullptr;
+        ClientWatchdog *clientWatchdog = nullptr;
+        int clientIndex = -1;
+
+        OutputOwnership *ownership = nullptr;
+
+        NotificationStat *notificationStat = nullptr;
+
+        EcatDiagnostics *diagnostics = nullptr;
+
+        DcTimeSeries *dcTimeSeries = nullptr;
+
+        EcatLayout *layout = nullptr;
+
+        StartupTimings *startup = nullptr;
+
+        EventRing *eventRing = nullptr;
+        uint64_t eventCursor = 0;
+        uint64_t lostEvents = 0;
+
 
-        sem_t *sem_mutex[EC_SEM_NUM];
+        sem_t *sem_mutex[EC_SEM_NUM] {};
+        sem_t *staleSem[EC_SEM_NUM] {}; // handles of the previous master, the slot's thread may still wait on them
 
         //////////// OUTPUT FORMAT SETTINGS ////////////////////
         //Terminal Color Show
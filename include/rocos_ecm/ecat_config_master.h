@@ -38,6 +38,7 @@ Yang Luo, PHD
 #include <boost/timer/timer.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/interprocess/managed_shared_memory.hpp>
+#include <boost/interprocess/managed_mapped_file.hpp>
 #include <boost/interprocess/shared_memory_object.hpp>
 #include <boost/interprocess/mapped_region.hpp>
 
@@ -70,6 +71,9 @@ public:
 
 public:
 
+    //! Back the shared memory created afterwards with huge pages from EC_HUGEPAGE_DIR, false if not available
+    bool enableHugePages();
+
     bool createSharedMemory();
 
     bool getSharedMemory();
@@ -78,6 +82,10 @@ public:
 
     bool getPdDataMemoryProvider();
 
+    //! Tell attached clients that all regions were recreated, they remap them on their next wait().
+    //! Call once after createSharedMemory() and createPdDataMemoryProvider().
+    bool publishGeneration();
+
     void init();
 
     void waitForSignal(int id = 0); // compact code, not recommended use. use wait() instead
@@ -86,46 +94,107 @@ public:
 
     void updateSempahore();
 
+    //! Prefer NUMA node for all shared memory mapped so far and migrate its pages, node < 0 does nothing
+    bool bindNumaNode(int node);
+
+    //! Resolve the safe output variables of all slaves, call after slave table is filled
+    void setupWatchdog(int defaultTimeoutCycles, int defaultSafeOutput);
+
+    //! Hot connect: put a rebuilt slave descriptor into EcatBus::slaves, false while a layout is pending
+    bool stageSlave(int slaveId, const rocos::Slave &slave);
+
+    //! Copy EcatBus::slaves into the back table and hand it with the presence of all slaves (bit i: slave i)
+    //! to the job task, false while a layout is pending
+    bool commitLayout(uint64_t presentMask);
+
+    bool isLayoutPending() const;
+
+    //! Publish a committed layout, call from the job task at the cycle boundary before the clients are woken up
+    bool switchLayout();
+
+    //! Check clients' commit counters and apply safe outputs, call every cycle before SendAllCycFrames
+    void checkWatchdog();
+
+    //! Copy the owned pd_output ranges from the clients' staging areas, call every cycle before checkWatchdog
+    void mergeOutputs();
+
+    //! Count the slaves with invalid process data (WkcState bit of the inputs or outputs set in the diagnosis
+    //! image of EC-Master), call after the cyclic frames are sent. Only scans after a cyclic WKC error.
+    void updateDiagnostics(const uint8_t *diagnosisImage);
+
+    //! Append a DCM deviation sample to the time series, call from the job task after the cyclic frames are sent
+    void sampleDc(int status, int diffCur, int diffAvg, int diffMax);
+
+    //! Start a phase of the start-up, returns its index for endStartupPhase(). -1 once the start-up is
+    //! complete or the table is full, endStartupPhase(-1) does nothing.
+    int beginStartupPhase(const char *name);
+
+    void endStartupPhase(int phase);
+
+    //! Add a phase that was measured with getProcessUptime() before the shared memory existed
+    int addStartupPhase(const char *name, long begin, long end);
+
+    //! The bus reached the requested state for the first time, completes the start-up.
+    //! \return true for this first call, later calls do nothing
+    bool setStartupReached(int state);
+
+    //! One line with the duration of every start-up phase. Before setStartupReached() (the master shuts down
+    //! without reaching the requested state) the last phase is marked aborted, phases still running unfinished.
+    std::string getStartupSummary() const;
+
+    //! Write the start-up phases as Chrome trace event JSON (chrome://tracing, ui.perfetto.dev), unfinished
+    //! phases end at the time of the call
+    bool writeStartupTrace(const std::string &fileName) const;
+
+    //! File name of --starttrace, "%d" is replaced by the master id
+    std::string getStartupTraceName(const std::string &pattern) const;
+
+    //! us since this process was started (resolution of /proc/self/stat, 1/_SC_CLK_TCK s)
+    static long getProcessUptime();
+
+    //! Slave table published to the clients, EcatBus::slaves is the table the application works on
+    const rocos::Slave *slaves() const { return rocos::activeSlaves(ecatBus, layout); }
+
     template<typename T>
     T getSlaveInputVarValue(int slaveId, int varId) {
-        if (sizeof(T) != ecatBus->slaves[slaveId].input_vars[varId].size) {
+        if (sizeof(T) != slaves()[slaveId].input_vars[varId].size) {
             print_message("Size of Var is not equal", MessageLevel::WARNING);
         }
-        return *(T *) ((char *) pdInputPtr + ecatBus->slaves[slaveId].input_vars[varId].offset);
+        return *(T *) ((char *) pdInputPtr + slaves()[slaveId].input_vars[varId].offset);
     }
 
     template<typename T>
     void setSlaveInputVarValue(int slaveId, int varId, T value) {
-        if (sizeof(T) != ecatBus->slaves[slaveId].input_vars[varId].size) {
+        if (sizeof(T) != slaves()[slaveId].input_vars[varId].size) {
             print_message("Size of Var is not equal", MessageLevel::WARNING);
         }
-        *(T *) ((char *) pdInputPtr + ecatBus->slaves[slaveId].input_vars[varId].offset) = value;
+        *(T *) ((char *) pdInputPtr + slaves()[slaveId].input_vars[varId].offset) = value;
     }
 
     template<typename T>
     T getSlaveOutputVarValue(int slaveId, int varId) {
-        if (sizeof(T) != ecatBus->slaves[slaveId].output_vars[varId].size) {
+        if (sizeof(T) != slaves()[slaveId].output_vars[varId].size) {
             print_message("Size of Var is not equal", MessageLevel::WARNING);
         }
-        return *(T *) ((char *) pdOutputPtr + ecatBus->slaves[slaveId].output_vars[varId].offset);
+        return *(T *) ((char *) pdOutputPtr + slaves()[slaveId].output_vars[varId].offset);
     }
 
     template<typename T>
     void setSlaveOutputVarValue(int slaveId, int varId, T value) {
-        if (sizeof(T) != ecatBus->slaves[slaveId].output_vars[varId].size) {
+        if (sizeof(T) != slaves()[slaveId].output_vars[varId].size) {
             print_message("Size of Var is not equal", MessageLevel::WARNING);
         }
-        *(T *) ((char *) pdOutputPtr + ecatBus->slaves[slaveId].output_vars[varId].offset) = value;
+        *(T *) ((char *) pdOutputPtr + slaves()[slaveId].output_vars[varId].offset) = value;
     }
 
     template<typename T>
     T getSlaveInputVarValueByName(int slaveId, const std::string &varName) {
-        for (int i = 0; i < ecatBus->slaves[slaveId].input_var_num; ++i) {
-            if (strcmp(ecatBus->slaves[slaveId].input_vars[i].name, varName.c_str()) == 0) {
-                if (sizeof(T) != ecatBus->slaves[slaveId].input_vars[i].size) {
+        for (int i = 0; i < slaves()[slaveId].input_var_num; ++i) {
+            if (strcmp(slaves()[slaveId].input_vars[i].name, varName.c_str()) == 0) {
+                if (sizeof(T) != slaves()[slaveId].input_vars[i].size) {
                     print_message("Size of Var is not equal", MessageLevel::WARNING);
                 }
-                return *(T *) ((char *) pdInputPtr + ecatBus->slaves[slaveId].input_vars[i].offset);
+                return *(T *) ((char *) pdInputPtr + slaves()[slaveId].input_vars[i].offset);
             }
         }
         return std::numeric_limits<T>::max();
@@ -133,24 +202,24 @@ public:
 
     template<typename T>
     void setSlaveInputVarValueByName(int slaveId, const std::string &varName, T value) {
-        for (int i = 0; i < ecatBus->slaves[slaveId].input_var_num; ++i) {
-            if (strcmp(ecatBus->slaves[slaveId].input_vars[i].name, varName.c_str()) == 0) {
-                if (sizeof(T) != ecatBus->slaves[slaveId].input_vars[i].size) {
+        for (int i = 0; i < slaves()[slaveId].input_var_num; ++i) {
+            if (strcmp(slaves()[slaveId].input_vars[i].name, varName.c_str()) == 0) {
+                if (sizeof(T) != slaves()[slaveId].input_vars[i].size) {
                     print_message("Size of Var is not equal", MessageLevel::WARNING);
                 }
-                *(T *) ((char *) pdInputPtr + ecatBus->slaves[slaveId].input_vars[i].offset) = value;
+                *(T *) ((char *) pdInputPtr + slaves()[slaveId].input_vars[i].offset) = value;
             }
         }
     }
 
     template<typename T>
     T getSlaveOutputVarValueByName(int slaveId, const std::string &varName) {
-        for (int i = 0; i < ecatBus->slaves[slaveId].output_var_num; ++i) {
-            if (strcmp(ecatBus->slaves[slaveId].output_vars[i].name, varName.c_str()) == 0) {
-                if (sizeof(T) != ecatBus->slaves[slaveId].output_vars[i].size) {
+        for (int i = 0; i < slaves()[slaveId].output_var_num; ++i) {
+            if (strcmp(slaves()[slaveId].output_vars[i].name, varName.c_str()) == 0) {
+                if (sizeof(T) != slaves()[slaveId].output_vars[i].size) {
                     print_message("Size of Var is not equal", MessageLevel::WARNING);
                 }
-                return *(T *) ((char *) pdOutputPtr + ecatBus->slaves[slaveId].output_vars[i].offset);
+                return *(T *) ((char *) pdOutputPtr + slaves()[slaveId].output_vars[i].offset);
             }
         }
         return std::numeric_limits<T>::max();
@@ -158,40 +227,40 @@ public:
 
     template<typename T>
     void setSlaveOutputVarValueByName(int slaveId, const std::string &varName, T value) {
-        for (int i = 0; i < ecatBus->slaves[slaveId].output_var_num; ++i) {
-            if (strcmp(ecatBus->slaves[slaveId].output_vars[i].name, varName.c_str()) == 0) {
-                if (sizeof(T) != ecatBus->slaves[slaveId].output_vars[i].size) {
+        for (int i = 0; i < slaves()[slaveId].output_var_num; ++i) {
+            if (strcmp(slaves()[slaveId].output_vars[i].name, varName.c_str()) == 0) {
+                if (sizeof(T) != slaves()[slaveId].output_vars[i].size) {
                     print_message("Size of Var is not equal", MessageLevel::WARNING);
                 }
-                *(T *) ((char *) pdOutputPtr + ecatBus->slaves[slaveId].output_vars[i].offset) = value;
+                *(T *) ((char *) pdOutputPtr + slaves()[slaveId].output_vars[i].offset) = value;
             }
         }
     }
 
     template<typename T>
     T *getSlaveInputVarPtr(int slaveId, int varId) {
-        if (sizeof(T) != ecatBus->slaves[slaveId].input_vars[varId].size) {
+        if (sizeof(T) != slaves()[slaveId].input_vars[varId].size) {
             print_message("Size of Var is not equal", MessageLevel::WARNING);
         }
-        return (T *) ((char *) pdInputPtr + ecatBus->slaves[slaveId].input_vars[varId].offset);
+        return (T *) ((char *) pdInputPtr + slaves()[slaveId].input_vars[varId].offset);
     }
 
     template<typename T>
     T *getSlaveOutputVarPtr(int slaveId, int varId) {
-        if (sizeof(T) != ecatBus->slaves[slaveId].output_vars[varId].size) {
+        if (sizeof(T) != slaves()[slaveId].output_vars[varId].size) {
             print_message("Size of Var is not equal", MessageLevel::WARNING);
         }
-        return (T *) ((char *) pdOutputPtr + ecatBus->slaves[slaveId].output_vars[varId].offset);
+        return (T *) ((char *) pdOutputPtr + slaves()[slaveId].output_vars[varId].offset);
     }
 
     template<typename T>
     T *findSlaveInputVarPtrByName(int slaveId, const std::string &varName) {
-        for (int i = 0; i < ecatBus->slaves[slaveId].input_var_num; ++i) {
-            if (strcmp(ecatBus->slaves[slaveId].input_vars[i].name, varName.c_str()) == 0) {
-                if (sizeof(T) != ecatBus->slaves[slaveId].input_vars[i].size) {
+        for (int i = 0; i < slaves()[slaveId].input_var_num; ++i) {
+            if (strcmp(slaves()[slaveId].input_vars[i].name, varName.c_str()) == 0) {
+                if (sizeof(T) != slaves()[slaveId].input_vars[i].size) {
                     print_message("Size of Var is not equal", MessageLevel::WARNING);
                 }
-                return (T *) ((char *) pdInputPtr + ecatBus->slaves[slaveId].input_vars[i].offset);
+                return (T *) ((char *) pdInputPtr + slaves()[slaveId].input_vars[i].offset);
             }
         }
         return nullptr;
@@ -199,12 +268,12 @@ public:
 
     template<typename T>
     T *findSlaveOutputVarPtrByName(int slaveId, const std::string &varName) {
-        for (int i = 0; i < ecatBus->slaves[slaveId].output_var_num; ++i) {
-            if (strcmp(ecatBus->slaves[slaveId].output_vars[i].name, varName.c_str()) == 0) {
-                if (sizeof(T) != ecatBus->slaves[slaveId].output_vars[i].size) {
+        for (int i = 0; i < slaves()[slaveId].output_var_num; ++i) {
+            if (strcmp(slaves()[slaveId].output_vars[i].name, varName.c_str()) == 0) {
+                if (sizeof(T) != slaves()[slaveId].output_vars[i].size) {
                     print_message("Size of Var is not equal", MessageLevel::WARNING);
                 }
-                return (T *) ((char *) pdOutputPtr + ecatBus->slaves[slaveId].output_vars[i].offset);
+                return (T *) ((char *) pdOutputPtr + slaves()[slaveId].output_vars[i].offset);
             }
         }
         return nullptr;
@@ -217,11 +286,9 @@ public:
 public:
     rocos::EcatBus *ecatBus = nullptr;
 
-    boost::interprocess::managed_shared_memory *managedSharedMemory = nullptr;
+    boost::interprocess::managed_mapped_file *managedSharedMemory = nullptr; // POSIX shm or hugetlbfs file
 
     // PD Input and Output memory
-    boost::interprocess::shared_memory_object *pdInputShm = nullptr;
-    boost::interprocess::shared_memory_object *pdOutputShm = nullptr;
     boost::interprocess::mapped_region *pdInputRegion = nullptr;
     boost::interprocess::mapped_region *pdOutputRegion = nullptr;
     void *pdInputPtr = nullptr;
@@ -230,13 +297,86 @@ public:
 
     sem_t *sem_mutex[EC_SEM_NUM];
 
+    rocos::Watchdog *watchdog = nullptr;
+
+    rocos::OutputOwnership *ownership = nullptr;
+
+    rocos::NotificationStat *notificationStat = nullptr; // written by the notification handler
+
+    rocos::EventRing *eventRing = nullptr; // written by the notification handler, see rocos::postEvent()
+
+    rocos::EcatDiagnostics *diagnostics = nullptr; // written by the notification handler and updateDiagnostics()
+
+    rocos::DcTimeSeries *dcTimeSeries = nullptr; // written by sampleDc()
+
+    rocos::EcatLayout *layout = nullptr; // staged by the application, switched by the job task
+
+    rocos::StartupTimings *startup = nullptr; // written by beginStartupPhase() until the bus reached OP
+
+    // Control block with the generation, outlives the other regions
+    boost::interprocess::mapped_region *controlRegion = nullptr;
+    rocos::EcatControl *control = nullptr;
+
+    // Output staging memory, one cache-line-aligned area per client
+    boost::interprocess::mapped_region *pdStagingRegion = nullptr;
+    void *pdStagingPtr = nullptr;
+
 protected:
 
+    //! Offsets (-1 if not available) of the PD variables touched by safe output templates
+    struct SafeOutputVar {
+        int control_word {-1};
+        int target_position {-1};
+        int target_velocity {-1};
+        int target_torque {-1};
+        int position_actual {-1};
+        int size_target_position {0};
+        int size_target_velocity {0};
+        int size_target_torque {0};
+        int size_position_actual {0};
+    };
+
+    SafeOutputVar safeOutputVars[MAX_SLAVE_NUM];
+
+    void applySafeOutput(int slaveId);
+
+    void resolveSafeOutputVars(int slaveId);
+
+    //! Free the slot and the output ranges of client i if its process died without unregistering
+    void reclaimDeadClient(int i);
+
+    //! Contiguous copy from a client's staging area, compiled from the ownership table
+    struct MergeRun {
+        int source {0}; // byte offset in staging memory
+        int offset {0}; // byte offset in pd_output
+        int size {0};
+    };
+
+    MergeRun mergeRuns[MAX_OWNERSHIP_NUM];
+    int mergeRunNum {0};
+    unsigned int mergeVersion {0};
+
+    void compileMergeRuns(const rocos::OutputRange *ranges, int rangeNum);
+
+    uint64_t lastCyclicWkcErrors {0}; // EcatDiagnostics::cyclic_wkc_errors at the last updateDiagnostics()
+
+    static bool isWkcStateSet(const uint8_t *diagnosisImage, int bit) {
+        return bit >= 0 && ((diagnosisImage[bit / 8] >> (bit % 8)) & 1) != 0;
+    }
+
+    //! Create, pre-fault and lock a process data region
+    boost::interprocess::mapped_region *createPdRegion(const std::string &name, std::size_t size);
+
+    std::size_t hugePageSize {0}; // 0: POSIX shm with base pages
+
     std::vector<std::thread::id> threadId;
+    int masterId{0};
     std::string ecmName{EC_SHM};
     std::string mutexName{EC_SEM_MUTEX};
     std::string pdInputName{"pd_input"};
     std::string pdOutputName{"pd_output"};
+    std::string pdStagingName{"pd_staging"};
+    std::string controlName{EC_SHM_CONTROL};
 
 
     //////////// OUTPUT FORMAT SETTINGS ////////////////////
@@ -0,0 +1,299 @@
+//
+// Shared memory backing helpers used by EcatConfig and EcatConfigMaster
+//
+
+#ifndef ECAT_SHM_H_INCLUDED
+#define ECAT_SHM_H_INCLUDED
+
+#include <ecat_type.h>
+
+#include <string>
+#include <cstddef>
+#include <stdexcept>
+
+#include <boost/format.hpp>
+#include <boost/interprocess/managed_mapped_file.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <sys/resource.h>
+#include <linux/magic.h>
+#include <cerrno>
+#include <cstring>
+
+namespace rocos {
+
+    //! Result of pre-faulting a mapped region
+    struct PrefaultStat {
+        std::size_t size        {0};
+        std::size_t page_size   {0};
+        std::size_t pages       {0};
+        long        minor_faults{0}; // faults taken at attach instead of in the first cycles
+        long        major_faults{0};
+        bool        locked      {false};
+    };
+
+    //! Page size of the hugetlbfs mounted at dir, 0 if dir is not a hugetlbfs mount
+    inline std::size_t hugePageSize(const std::string &dir) {
+        struct statfs st{};
+        if (statfs(dir.c_str(), &st) != 0 || st.f_type != HUGETLBFS_MAGIC)
+            return 0;
+        return st.f_bsize;
+    }
+
+    inline std::size_t roundUpToPage(std::size_t size, std::size_t pageSize) {
+        if (size == 0)
+            size = 1;
+        return (size + pageSize - 1) / pageSize * pageSize;
+    }
+
+    inline bool fileExists(const std::string &path) {
+        struct stat st{};
+        return stat(path.c_str(), &st) == 0;
+    }
+
+    //! Create (or resize) a file in hugetlbfs, size must be a multiple of the huge page size
+    inline bool createHugeFile(const std::string &path, std::size_t size) {
+        int fd = open(path.c_str(), O_CREAT | O_RDWR, 0666);
+        if (fd < 0)
+            return false;
+        bool ok = ftruncate(fd, (off_t) size) == 0;
+        close(fd);
+        return ok;
+    }
+
+    //! Lock the region and touch every page so that no page fault happens in the cyclic path.
+    //! Pages are only read, the content is left untouched.
+    inline PrefaultStat prefaultRegion(void *addr, std::size_t size, std::size_t pageSize) {
+        PrefaultStat stat;
+        stat.size = size;
+        stat.page_size = pageSize != 0 ? pageSize : (std::size_t) sysconf(_SC_PAGESIZE);
+        if (addr == nullptr || size == 0)
+            return stat;
+
+        struct rusage before{}, after{};
+        getrusage(RUSAGE_SELF, &before);
+
+        stat.locked = mlock(addr, size) == 0;
+
+        volatile const char *p = static_cast<const char *>(addr);
+        for (std::size_t off = 0; off < size; off += stat.page_size) {
+            (void) p[off];
+            stat.pages++;
+        }
+
+        getrusage(RUSAGE_SELF, &after);
+        stat.minor_faults = after.ru_minflt - before.ru_minflt;
+        stat.major_faults = after.ru_majflt - before.ru_majflt;
+        return stat;
+    }
+
+    inline std::string shmPath(const std::string &name) {
+        return std::string(EC_SHM_DIR) + "/" + name;
+    }
+
+    inline std::string hugePagePath(const std::string &name) {
+        return std::string(EC_HUGEPAGE_DIR) + "/" + name;
+    }
+
+    //! Remove a region from both backings
+    inline void removeRegion(const std::string &name) {
+        boost::interprocess::shared_memory_object::remove(name.c_str());
+        unlink(hugePagePath(name).c_str());
+    }
+
+    //! Create a region of size bytes. With hugePageSize != 0 it is placed in hugetlbfs, if that fails
+    //! (no free huge pages, no permission) POSIX shm is used and the reason is returned in warning.
+    inline boost::interprocess::mapped_region *createRegion(const std::string &name, std::size_t size,
+                                                            std::size_t hugePageSize, std::size_t &pageSize,
+                                                            std::string &warning) {
+        using namespace boost::interprocess;
+        removeRegion(name);
+
+        if (hugePageSize != 0) {
+            std::string path = hugePagePath(name);
+            try {
+                if (!createHugeFile(path, roundUpToPage(size, hugePageSize)))
+                    throw std::runtime_error(std::strerror(errno));
+                file_mapping file(path.c_str(), read_write);
+                auto *region = new mapped_region(file, read_write);
+                pageSize = hugePageSize;
+                return region;
+            } catch (std::exception &e) {
+                unlink(path.c_str());
+                warning = "[SHM] Can not place " + name + " in huge pages (" + e.what() + "), using POSIX shm.";
+            }
+        }
+
+        shared_memory_object shm(open_or_create, name.c_str(), read_write);
+        shm.truncate((offset_t) size);
+        pageSize = (std::size_t) sysconf(_SC_PAGESIZE);
+        return new mapped_region(shm, read_write);
+    }
+
+    //! Map a region created by the master, from hugetlbfs if it was placed there
+    inline boost::interprocess::mapped_region *openRegion(const std::string &name, bool create, std::size_t &pageSize) {
+        using namespace boost::interprocess;
+
+        std::string path = hugePagePath(name);
+        if (fileExists(path)) {
+            file_mapping file(path.c_str(), read_write);
+            pageSize = hugePageSize(EC_HUGEPAGE_DIR);
+            return new mapped_region(file, read_write);
+        }
+
+        pageSize = (std::size_t) sysconf(_SC_PAGESIZE);
+        if (create) {
+            shared_memory_object shm(open_or_create, name.c_str(), read_write);
+            return new mapped_region(shm, read_write);
+        }
+        shared_memory_object shm(open_only, name.c_str(), read_write);
+        return new mapped_region(shm, read_write);
+    }
+
+    //! Map a region created by the master with PROT_READ, throws if it does not exist
+    inline boost::interprocess::mapped_region *openRegionReadOnly(const std::string &name, std::size_t &pageSize) {
+        using namespace boost::interprocess;
+
+        std::string path = hugePagePath(name);
+        if (fileExists(path)) {
+            file_mapping file(path.c_str(), read_only);
+            pageSize = hugePageSize(EC_HUGEPAGE_DIR);
+            return new mapped_region(file, read_only);
+        }
+
+        pageSize = (std::size_t) sysconf(_SC_PAGESIZE);
+        shared_memory_object shm(open_only, name.c_str(), read_only);
+        return new mapped_region(shm, read_only);
+    }
+
+    //! Map the control block (EcatControl) of a master, POSIX shm only. A new block is zero filled,
+    //! which is generation 0. Throws if readOnly and the block does not exist.
+    inline boost::interprocess::mapped_region *openControlBlock(const std::string &name, bool readOnly) {
+        using namespace boost::interprocess;
+
+        if (readOnly) {
+            shared_memory_object shm(open_only, name.c_str(), read_only);
+            return new mapped_region(shm, read_only, 0, sizeof(EcatControl));
+        }
+        shared_memory_object shm(open_or_create, name.c_str(), read_write);
+        offset_t size = 0;
+        if (!shm.get_size(size) || size < (offset_t) sizeof(EcatControl))
+            shm.truncate((offset_t) sizeof(EcatControl));
+        return new mapped_region(shm, read_write, 0, sizeof(EcatControl));
+    }
+
+    //! Create the managed bus segment, see createRegion() for the huge page fallback.
+    //! The POSIX shm variant is the file boost::interprocess::managed_shared_memory would use.
+    inline boost::interprocess::managed_mapped_file *createSegment(const std::string &name, std::size_t size,
+                                                                   std::size_t hugePageSize, std::size_t &pageSize,
+                                                                   std::string &warning) {
+        using namespace boost::interprocess;
+        removeRegion(name);
+
+        if (hugePageSize != 0) {
+            std::string path = hugePagePath(name);
+            try {
+                auto *segment = new managed_mapped_file{create_only, path.c_str(), roundUpToPage(size, hugePageSize)};
+                pageSize = hugePageSize;
+                return segment;
+            } catch (std::exception &e) {
+                unlink(path.c_str());
+                warning = "[SHM] Can not place " + name + " in huge pages (" + e.what() + "), using POSIX shm.";
+            }
+        }
+
+        pageSize = (std::size_t) sysconf(_SC_PAGESIZE);
+        return new managed_mapped_file{open_or_create, shmPath(name).c_str(), size};
+    }
+
+    inline boost::interprocess::managed_mapped_file *openSegment(const std::string &name, std::size_t size,
+                                                                 std::size_t &pageSize) {
+        using namespace boost::interprocess;
+
+        std::string path = hugePagePath(name);
+        if (fileExists(path)) {
+            pageSize = hugePageSize(EC_HUGEPAGE_DIR);
+            return new managed_mapped_file{open_only, path.c_str()};
+        }
+
+        pageSize = (std::size_t) sysconf(_SC_PAGESIZE);
+        return new managed_mapped_file{open_or_create, shmPath(name).c_str(), size};
+    }
+
+    //! Map the bus segment of a running master without write access. Objects in it can only be looked up
+    //! with find_no_lock() of the segment manager, find() would take the segment mutex.
+    //! Throws boost::interprocess::interprocess_exception if the master has not created it.
+    inline boost::interprocess::managed_mapped_file *openSegmentReadOnly(const std::string &name) {
+        using namespace boost::interprocess;
+
+        std::string path = hugePagePath(name);
+        if (!fileExists(path))
+            path = shmPath(name);
+        return new managed_mapped_file{open_read_only, path.c_str()};
+    }
+
+    //! Append an event to the ring, safe to call from several threads of the master
+    inline void postEvent(EventRing *ring, const EcatEvent &event) {
+        if (ring == nullptr)
+            return;
+        const uint64_t pos = __atomic_fetch_add(&ring->write_pos, 1, __ATOMIC_RELAXED);
+        EcatEvent &slot = ring->events[pos % MAX_EVENT_NUM];
+
+        // seqlock, readers that see sequence != pos + 1 before or after copying retry
+        __atomic_store_n(&slot.sequence, 0, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        std::memcpy((char *) &slot + sizeof(slot.sequence), (const char *) &event + sizeof(event.sequence),
+                    sizeof(EcatEvent) - sizeof(event.sequence));
+        __atomic_store_n(&slot.sequence, pos + 1, __ATOMIC_RELEASE);
+    }
+
+    //! Copy the event at cursor and advance the cursor. Events overwritten before they were read are
+    //! skipped and added to lost.
+    //! \return false if there is no complete event at cursor yet
+    inline bool readEvent(const EventRing *ring, uint64_t &cursor, EcatEvent &event, uint64_t &lost) {
+        if (ring == nullptr)
+            return false;
+        while (true) {
+            const uint64_t writePos = __atomic_load_n(&ring->write_pos, __ATOMIC_ACQUIRE);
+            if (cursor >= writePos)
+                return false;
+            if (writePos - cursor > MAX_EVENT_NUM) {
+                lost += writePos - MAX_EVENT_NUM - cursor;
+                cursor = writePos - MAX_EVENT_NUM;
+            }
+
+            const EcatEvent &slot = ring->events[cursor % MAX_EVENT_NUM];
+            const uint64_t sequence = __atomic_load_n(&slot.sequence, __ATOMIC_ACQUIRE);
+            if (sequence > cursor + 1)
+                continue; // overwritten meanwhile, skipped by the check above
+            if (sequence != cursor + 1)
+                return false; // claimed, but not written yet
+
+            std::memcpy(&event, &slot, sizeof(EcatEvent));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&slot.sequence, __ATOMIC_RELAXED) != sequence)
+                continue;
+            cursor++;
+            return true;
+        }
+    }
+
+    inline std::string to_string(const std::string &name, const PrefaultStat &stat) {
+        std::size_t basePages = (stat.size + sysconf(_SC_PAGESIZE) - 1) / sysconf(_SC_PAGESIZE);
+        return (boost::format("[SHM] %s: %d KiB in %d page(s) of %d KiB, %s, %d minor / %d major faults taken at attach, "
+                              "%d TLB entries instead of %d")
+                % name % (stat.size / 1024) % stat.pages % (stat.page_size / 1024)
+                % (stat.locked ? "locked" : "NOT locked") % stat.minor_faults % stat.major_faults
+                % stat.pages % basePages).str();
+    }
+
+}
+
+#endif //ECAT_SHM_H_INCLUDED
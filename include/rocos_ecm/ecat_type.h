@@ -47,6 +47,24 @@ Yang Luo, PHD
 
 #define EC_SHM "ecm"
 #define EC_SHM_MAX_SIZE 5242880 // 5MB
+#define EC_SHM_DIR "/dev/shm"             // where POSIX shm objects live on Linux
+#define EC_HUGEPAGE_DIR "/dev/hugepages" // hugetlbfs mount used when huge pages are enabled
+
+#define MAX_CLIENT_NUM 16    // Maximal number of client processes supervised by the watchdog
+#define MAX_OWNERSHIP_NUM 256 // Maximal number of owned pd_output ranges
+#define CLIENT_CHECK_CYCLES 64 // The master checks one client slot for a dead process every this many cycles
+#define MAX_NOTIFY_CODES 64   // Error notifications (EC_NOTIFY_ERROR | n) counted per code
+#define MAX_NOTIFY_ENTRIES 256 // (notification code, slave) pairs counted
+#define MAX_EVENT_NUM 1024     // Events kept in the event ring, power of 2
+#define EC_STATION_ADDRESS_BASE 1001 // Station address of slave 0, slave i has EC_STATION_ADDRESS_BASE + i
+#define MAX_DC_SAMPLES 4096    // DC/DCM deviation samples kept in the time series, power of 2
+#define DC_HISTOGRAM_BUCKETS 256    // Histogram of the absolute deviation for the percentiles
+#define DC_HISTOGRAM_RESOLUTION 20  // ns per histogram bucket, the last bucket takes all larger deviations
+#define EC_CACHE_LINE_SIZE 64
+#define EC_SHM_CONTROL "ecm_ctl"  // Control block of master ID n is EC_SHM_CONTROL + n, never removed by the master
+#define EC_REATTACH_POLL_MSEC 100 // Blocked clients check for a restarted master this often
+#define MAX_STARTUP_PHASES 32     // Start-up phases of the master kept in the shared memory
+#define MAX_STARTUP_PHASE_NAME 24 // Maximal length of a start-up phase name
 
 
 #define ECAT_STATE_INIT 1
@@ -55,6 +73,25 @@ Yang Luo, PHD
 #define ECAT_STATE_OP 8
 #define ECAT_STATE_BOOTSTRAP 3
 
+// Safe output templates applied to a slave when its commanding client goes stale
+#define SAFE_OUTPUT_NONE 0        // keep the last written outputs
+#define SAFE_OUTPUT_QUICK_STOP 1  // DS402 Control word = Quick stop
+#define SAFE_OUTPUT_ZERO_TORQUE 2 // Target Torque = 0
+#define SAFE_OUTPUT_HOLD 3        // Target Position = Position actual value at the trip, Target Velocity/Torque = 0
+
+// Types of the events in the event ring
+#define ECAT_EVENT_MASTER_STATE 1      // state: new master state, value[0]: old master state
+#define ECAT_EVENT_SLAVE_STATE 2       // state: new slave state
+#define ECAT_EVENT_UNEXPECTED_STATE 3  // state: current slave state, value[0]: expected state
+#define ECAT_EVENT_AL_STATUS_ERROR 4   // state: AL status, value[0]: AL status code
+#define ECAT_EVENT_WKC_ERROR 5         // value[0]: actual, value[1]: expected working counter
+#define ECAT_EVENT_FRAME_LOSS 6        // value[0]: 1 cyclic frame, value[1]: port the frame got lost after
+#define ECAT_EVENT_DC_SYNC 7           // value[0]: 1 in sync, value[1]: deviation in ns
+#define ECAT_EVENT_LINK 8              // value[0]: 1 connected
+#define ECAT_EVENT_ALL_OPERATIONAL 9   // value[0]: 1 all slaves in OP
+#define ECAT_EVENT_PDI_WATCHDOG 10
+#define ECAT_EVENT_LAYOUT 11           // value[0]: layout version, value[1]: slaves present
+
 
 namespace rocos {
     struct PdVar {
@@ -76,6 +113,32 @@ namespace rocos {
         PdVar output_vars[MAX_PDOUTPUT_NUM];
     };
 
+    //! Slave table updates of hot connect groups. The master rebuilds the descriptors of the affected slaves in
+    //! EcatBus::slaves and copies them into the back table, the job task publishes it at a cycle boundary by
+    //! switching table and incrementing version. A published table is never written, see activeSlaves().
+    struct EcatLayout {
+        uint64_t version               {0};  // layouts switched to since master start
+        uint64_t present_mask          {~(uint64_t) 0}; // bit i: slave i is connected
+        uint64_t table                 {0};  // published slave table: 0 = EcatBus::slaves, n = tables[n - 1]
+        uint64_t pending               {0};  // internal: 1 while a committed layout waits for the job task
+        uint64_t pending_present       {0};  // internal: present_mask of the committed layout
+        Slave    tables[2][MAX_SLAVE_NUM];   // published and back table, used after the first switch
+    };
+
+    static_assert(MAX_SLAVE_NUM <= 64, "EcatLayout masks hold 64 slaves");
+
+    //! EcatLayout::present_mask with all of the first slaveNum slaves connected
+    inline uint64_t allSlavesMask(int slaveNum) {
+        return slaveNum >= 64 ? ~(uint64_t) 0 : slaveNum <= 0 ? 0 : ((uint64_t) 1 << slaveNum) - 1;
+    }
+
+    //! Stable across master restarts: unlike the other regions it is not removed and recreated
+    struct EcatControl {
+        uint64_t generation            {0};  // incremented once all regions of a master start are created
+        int      master_pid            {0};
+        long     start_timestamp       {0};  // us
+    };
+
     struct EcatBus {
         long timestamp               {0};
 
@@ -93,8 +156,167 @@ namespace rocos {
         bool is_authorized           {false};
 
         int slave_num                 {0};
-        Slave slaves[MAX_SLAVE_NUM];
+        Slave slaves[MAX_SLAVE_NUM]; // filled at start-up, then the master publishes the tables of EcatLayout
+
+        // appended only, clients built against an older header keep the offsets of the fields above
+        long cycle_count             {0}; // number of bus cycles since master start
+        unsigned int capture_request {0}; // incremented by clients to trigger a flight recorder dump
+    };
+
+    //! Slave table currently published by the master, layout is nullptr for an older master. A table stays
+    //! unchanged until the layout after the next one is committed.
+    inline const Slave *activeSlaves(const EcatBus *bus, const EcatLayout *layout) {
+        const uint64_t table = layout ? __atomic_load_n(&layout->table, __ATOMIC_ACQUIRE) : 0;
+        return table == 0 ? bus->slaves : layout->tables[table - 1];
+    }
+
+    //! Per-client heartbeat/commit counters, written by the client and checked by the master every cycle
+    struct ClientWatchdog {
+        // written by client
+        int      pid                   {0};     // owner process, 0 means slot is free
+        bool     active                {false}; // client is supervised
+        bool     rearm                 {false}; // client requests to leave the tripped state
+        int      timeout_cycles        {0};     // missed cycles before safe outputs are applied
+        uint64_t slave_mask            {0};     // bit i set: client commands slave i
+        uint64_t heartbeat             {0};     // incremented on every wait()
+        uint64_t commit                {0};     // incremented after outputs of a cycle are written
+
+        // written by master
+        bool     armed                 {false};
+        bool     tripped               {false};
+        uint64_t last_commit           {0};
+        long     last_commit_cycle     {0};
+        long     last_commit_timestamp {0};     // us
+        int      missed_cycles         {0};
+        int      trip_count            {0};
+        long     trip_cycle            {0};
+        long     trip_timestamp        {0};     // us
+        double   reaction_time         {0.0};   // us, from cycle start to safe outputs written
+        double   max_reaction_time     {0.0};   // us
+    };
+
+    struct Watchdog {
+        int default_timeout_cycles     {10};
+        int safe_output[MAX_SLAVE_NUM] {};      // SAFE_OUTPUT_xxx template per slave
+        bool safe_output_active[MAX_SLAVE_NUM] {};
+        int64_t hold_position[MAX_SLAVE_NUM] {}; // Position actual value latched at the trip (SAFE_OUTPUT_HOLD)
+        ClientWatchdog clients[MAX_CLIENT_NUM];
+    };
+
+    //! pd_output byte range written by one client only
+    struct OutputRange {
+        int client                     {-1}; // index of the client slot
+        int offset                     {0};  // byte offset in pd_output
+        int size                       {0};  // bytes
+    };
+
+    struct OutputOwnership {
+        int lock                       {0};  // taken by clients while modifying the table
+        unsigned int version           {0};  // odd while the table is modified
+        int staging_stride             {0};  // bytes per client staging area, multiple of EC_CACHE_LINE_SIZE
+        int range_num                  {0};
+        OutputRange ranges[MAX_OWNERSHIP_NUM];
+    };
+
+    //! Error notifications of one code from one slave (station address 0: not slave specific)
+    struct NotifyCount {
+        uint64_t key                   {0};  // ((code << 16) | station address) + 1, 0 means entry is free
+        uint32_t code                  {0};
+        uint16_t station_address       {0};
+        uint64_t count                 {0};  // all notifications that passed the filter
+        uint64_t suppressed            {0};  // not logged because of the rate limit (--notifyrate)
+        uint32_t pending               {0};  // internal: suppressed since the last summary line
+        uint32_t next_log              {0};  // internal: msec count the next line is allowed at
+    };
+
+    //! Raw counts of the error notifications, including those filtered or coalesced in the log
+    struct NotificationStat {
+        uint64_t error_count[MAX_NOTIFY_CODES] {}; // by code & 0xFFFF
+        uint64_t filtered              {0};  // disabled or below the log level (--notifyfilter), not processed
+        uint64_t suppressed            {0};  // processed but not logged because of the rate limit
+        uint64_t entries_full          {0};  // not counted per slave, entries are all in use
+        NotifyCount entries[MAX_NOTIFY_ENTRIES];
+    };
+
+    //! Error counters and state of one slave, written by the notification handler and the job task
+    struct SlaveDiagnostics {
+        int      station_address       {0};
+        uint64_t wkc_errors            {0};  // cycles the process data of this slave was invalid (WkcState)
+        uint64_t frame_losses          {0};  // frames lost behind this slave
+        uint64_t al_status_errors      {0};
+        int      al_status             {0};  // last AL status reported with an error
+        int      al_status_code        {0};  // last AL status code
+        int      state                 {0};  // ECAT_STATE_xxx
+        uint64_t state_changes         {0};
+        long     last_state_change     {0};  // us, same clock as EcatBus::timestamp
+        uint64_t unexpected_states     {0};  // slave left the state requested by the master
+        uint64_t mailbox_errors        {0};  // mailbox WKC errors, SDO/FoE aborts, SoE write errors, invalid mailbox data
+        uint64_t pdi_watchdogs         {0};
+        int      wkc_state_bit_in      {-1}; // internal: bit offset of the WkcState in the diagnosis image
+        int      wkc_state_bit_out     {-1};
+    };
+
+    struct EcatDiagnostics {
+        uint64_t cyclic_wkc_errors     {0};  // cyclic commands with a wrong working counter
+        uint64_t cyclic_frame_losses   {0};  // cyclic frames without response
+        SlaveDiagnostics slaves[MAX_SLAVE_NUM];
+    };
+
+    //! DCM controller deviation of one bus cycle, see ecatDcmGetStatus()
+    struct DcSample {
+        uint64_t sequence              {0};  // position in the time series + 1, 0 while the sample is written
+        long     cycle                 {0};  // EcatBus::cycle_count
+        long     timestamp             {0};  // us, same clock as EcatBus::timestamp
+        int      status                {0};  // DCM status, 0: in sync
+        int      diff_cur              {0};  // ns, current deviation between set value and actual value of the controller
+        int      diff_avg              {0};  // ns
+        int      diff_max              {0};  // ns
+    };
+
+    //! DC/DCM synchronization quality, written by the job task every --dcsample cycles
+    struct DcTimeSeries {
+        int      dcm_mode              {0};  // --dcmmode: 1 bus shift, 2 master shift, ...
+        int      sample_cycles         {0};  // bus cycles between two samples, 0: sampling off
+        uint64_t write_pos             {0};  // samples written
+        uint64_t out_of_sync           {0};  // samples with status != 0
+        int      min_diff              {0};  // ns, of all samples
+        int      max_diff              {0};  // ns
+        uint64_t histogram[DC_HISTOGRAM_BUCKETS] {}; // |diff_cur| / DC_HISTOGRAM_RESOLUTION
+        DcSample samples[MAX_DC_SAMPLES];
+    };
+
+    //! One step of the master start-up, times in us since the master process was started
+    struct StartupPhase {
+        char     name[MAX_STARTUP_PHASE_NAME] {'\0'};
+        long     begin                 {0};
+        long     end                   {-1}; // -1 while running
+    };
+
+    //! Where the start-up of the master went until the bus reached the requested state for the first time
+    struct StartupTimings {
+        int      fast_start            {0};  // --faststart
+        int      reached_state         {0};  // ECAT_STATE_xxx requested at start-up
+        long     reached               {-1}; // us since process start, -1 before the bus reached the requested state
+        int      phase_num             {0};  // phases begun, at most MAX_STARTUP_PHASES
+        StartupPhase phases[MAX_STARTUP_PHASES];
+    };
+
+    //! Master notification pushed to the clients
+    struct EcatEvent {
+        uint64_t sequence              {0};  // position in the ring + 1, 0 while the event is written
+        int      type                  {0};  // ECAT_EVENT_xxx
+        uint32_t code                  {0};  // notification code of the master (EC_NOTIFY_xxx)
+        long     timestamp             {0};  // us, same clock as EcatBus::timestamp
+        int      station_address       {0};  // 0: not slave specific
+        int      state                 {0};  // ECAT_STATE_xxx or AL status, see ECAT_EVENT_xxx
+        int      value[2]              {};   // see ECAT_EVENT_xxx
+    };
 
+    //! Single ring written by the master, every client reads it with its own cursor and never writes it.
+    //! A client that falls behind by more than MAX_EVENT_NUM events loses the oldest ones.
+    struct EventRing {
+        uint64_t write_pos             {0};  // events claimed by writers
+        EcatEvent events[MAX_EVENT_NUM];
     };
 
 }
@@ -0,0 +1,440 @@
+/*-----------------------------------------------------------------------------
+ * ecat_bench.cpp
+ * Description              Client latency and throughput benchmark
+ *
+ * A stand-in cycle publisher (EcatConfigMaster with the slave table of --eni)
+ * posts the semaphores at every rate of --rates while --clients processes wait
+ * for it with EcatConfig::wait(). Measured per (clients, rate) point:
+ *   - wake latency: time from the post of the publisher to the return of wait()
+ *   - missed cycles: cycles a client did not wake up for
+ *   - accessor cost: by ID, by name, via pointer (read and write) and the cost
+ *     of a snapshot of the whole input image, measured by the first client
+ * Results are written as JSON to --json.
+ *---------------------------------------------------------------------------*/
+
+#include <gflags/gflags.h>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/xml_parser.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define private public
+#define protected public
+
+#include <ecat_config_master.h>
+#include <rocos_ecm/ecat_config.h>
+#include "ecat_eni.h"
+
+DEFINE_int32(id, 7, "Ec-Master ID of the stand-in publisher, use one no running master has.");
+DEFINE_string(eni, "/opt/rocos/ecm/config/eni.xml", "ENI the slave table and process image sizes are taken from.");
+DEFINE_string(clients, "1,2,4,8,16,32", "Comma separated client process counts to sweep.");
+DEFINE_string(rates, "1000,2000,4000,8000", "Comma separated cycle rates in Hz to sweep.");
+DEFINE_int32(duration, 1000, "Time in msec each (clients, rate) point is measured.");
+DEFINE_int32(batch, 32, "Accessor calls per kind and cycle, timed together.");
+DEFINE_int32(rtprio, 0, "SCHED_FIFO priority of publisher and clients, 0 = normal scheduling.");
+DEFINE_string(json, "ecat_bench.json", "Output file of the results.");
+
+namespace {
+
+    const int MAX_CLIENTS = 32;
+    const int PUBLISH_SLOTS = 64;
+
+    enum AccessorKind {
+        GET_BY_ID, GET_BY_NAME, GET_PTR, SET_BY_ID, SET_BY_NAME, SET_PTR, SNAPSHOT, ACCESSOR_KINDS
+    };
+
+    const char *accessorName[ACCESSOR_KINDS] = {
+            "get_by_id", "get_by_name", "get_ptr", "set_by_id", "set_by_name", "set_ptr", "snapshot"
+    };
+
+    struct ClientResult {
+        uint64_t wakes   {0};
+        uint64_t missed  {0};
+        uint64_t samples {0};
+    };
+
+    //! Anonymous shared mapping, inherited by the client processes
+    struct BenchShared {
+        std::atomic<int>     ready      {0};
+        std::atomic<bool>    stop       {false};
+        std::atomic<int64_t> cycle      {0};
+        std::atomic<int64_t> publish_ns[PUBLISH_SLOTS] {}; // post time of cycle c in slot c % PUBLISH_SLOTS
+
+        uint64_t     accessor_ns[ACCESSOR_KINDS] {};
+        uint64_t     accessor_calls {0};
+        ClientResult clients[MAX_CLIENTS];
+        // followed by MAX_CLIENTS latency arrays of maxSamples uint32_t (ns)
+    };
+
+    struct LatencyStat {
+        double min {0}, mean {0}, p50 {0}, p99 {0}, p999 {0}, max {0};
+    };
+
+    struct PointResult {
+        int         clients        {0};
+        int         rate           {0};
+        uint64_t    cycles         {0};
+        uint64_t    wakes          {0};
+        uint64_t    missed         {0};
+        double      wakes_per_sec  {0};
+        LatencyStat latency;                       // us
+        double      accessor_ns[ACCESSOR_KINDS] {}; // per call
+    };
+
+    int64_t nowNs() {
+        timespec ts{};
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+    }
+
+    std::vector<int> parseList(const std::string &list) {
+        std::vector<int> values;
+        std::stringstream ss(list);
+        std::string item;
+        while (std::getline(ss, item, ','))
+            if (!item.empty())
+                values.push_back(std::stoi(item));
+        return values;
+    }
+
+    void setRealtime() {
+        if (FLAGS_rtprio <= 0)
+            return;
+        sched_param param{};
+        param.sched_priority = FLAGS_rtprio;
+        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0)
+            std::cerr << "[BENCH] Can not set SCHED_FIFO, running with normal scheduling." << std::endl;
+    }
+
+    //! Accessors of the first 4 byte input and output variable of slave 0
+    class AccessorBench {
+    public:
+        explicit AccessorBench(rocos::EcatConfig *config) : config(config) {
+            const rocos::Slave &slave = config->slaves()[0];
+            for (int i = 0; i < slave.input_var_num && inputVar < 0; ++i)
+                if (slave.input_vars[i].size == sizeof(int32_t))
+                    inputVar = i;
+            for (int i = 0; i < slave.output_var_num && outputVar < 0; ++i)
+                if (slave.output_vars[i].size == sizeof(int32_t))
+                    outputVar = i;
+            if (inputVar >= 0)
+                inputName = slave.input_vars[inputVar].name;
+            if (outputVar >= 0)
+                outputName = slave.output_vars[outputVar].name;
+            snapshot.resize(config->pdInputRegion->get_size());
+        }
+
+        bool isValid() const {
+            return inputVar >= 0 && outputVar >= 0;
+        }
+
+        //! Time FLAGS_batch calls of every kind, accumulated in shared
+        void run(BenchShared *shared) {
+            int64_t t[ACCESSOR_KINDS + 1];
+            int32_t sum = 0;
+            const int n = FLAGS_batch;
+
+            t[0] = nowNs();
+            for (int i = 0; i < n; ++i)
+                sum += config->getSlaveInputVarValue<int32_t>(0, inputVar);
+            t[1] = nowNs();
+            for (int i = 0; i < n; ++i)
+                sum += config->getSlaveInputVarValueByName<int32_t>(0, inputName);
+            t[2] = nowNs();
+            int32_t *inputPtr = config->getSlaveInputVarPtr<int32_t>(0, inputVar);
+            for (int i = 0; i < n; ++i)
+                sum += *(volatile int32_t *) inputPtr;
+            t[3] = nowNs();
+            for (int i = 0; i < n; ++i)
+                config->setSlaveOutputVarValue<int32_t>(0, outputVar, sum + i);
+            t[4] = nowNs();
+            for (int i = 0; i < n; ++i)
+                config->setSlaveOutputVarValueByName<int32_t>(0, outputName, sum + i);
+            t[5] = nowNs();
+            int32_t *outputPtr = config->getSlaveOutputVarPtr<int32_t>(0, outputVar);
+            for (int i = 0; i < n; ++i)
+                *(volatile int32_t *) outputPtr = sum + i;
+            t[6] = nowNs();
+            for (int i = 0; i < n; ++i) {
+                std::memcpy(snapshot.data(), config->pdInputPtr, snapshot.size());
+                asm volatile("" : : "r"(snapshot.data()) : "memory");
+            }
+            t[7] = nowNs();
+
+            for (int k = 0; k < ACCESSOR_KINDS; ++k)
+                shared->accessor_ns[k] += t[k + 1] - t[k];
+            shared->accessor_calls += n;
+        }
+
+    protected:
+        rocos::EcatConfig   *config;
+        int                  inputVar  {-1};
+        int                  outputVar {-1};
+        std::string          inputName;
+        std::string          outputName;
+        std::vector<uint8_t> snapshot;
+    };
+
+    //! Client process, never returns
+    void runClient(int index, BenchShared *shared, uint32_t *latency, uint64_t maxSamples) {
+        setRealtime();
+        rocos::EcatConfig *config = rocos::EcatConfig::getInstance(FLAGS_id);
+        AccessorBench accessors(config);
+
+        ClientResult &result = shared->clients[index];
+        int64_t lastCycle = -1;
+        shared->ready++;
+
+        while (!shared->stop) {
+            config->wait();
+            const int64_t wakeNs = nowNs();
+            if (shared->stop)
+                break;
+
+            const int64_t cycle = shared->cycle;
+            const int64_t publishNs = shared->publish_ns[cycle % PUBLISH_SLOTS];
+            if (cycle == 0 || cycle == lastCycle) // semaphore left posted from before the measurement
+                continue;
+
+            if (lastCycle > 0 && cycle > lastCycle + 1)
+                result.missed += cycle - lastCycle - 1;
+            lastCycle = cycle;
+            result.wakes++;
+            if (result.samples < maxSamples && wakeNs >= publishNs) // else woken by a post of an earlier cycle
+                latency[result.samples++] = (uint32_t) std::min<int64_t>(wakeNs - publishNs, UINT32_MAX);
+
+            if (index == 0 && accessors.isValid())
+                accessors.run(shared);
+        }
+        _exit(0);
+    }
+
+    LatencyStat latencyStat(std::vector<uint32_t> &samples) {
+        LatencyStat stat;
+        if (samples.empty())
+            return stat;
+        std::sort(samples.begin(), samples.end());
+        auto at = [&](double q) {
+            return samples[std::min(samples.size() - 1, (std::size_t) (q * samples.size()))] / 1000.0;
+        };
+        double sum = 0;
+        for (auto s: samples)
+            sum += s;
+        stat.min = samples.front() / 1000.0;
+        stat.mean = sum / samples.size() / 1000.0;
+        stat.p50 = at(0.5);
+        stat.p99 = at(0.99);
+        stat.p999 = at(0.999);
+        stat.max = samples.back() / 1000.0;
+        return stat;
+    }
+
+    //! Stand-in for the job task, absolute period, bus timestamp and cycle count as the master sets them
+    uint64_t publish(EcatConfigMaster &master, BenchShared *shared, int rate) {
+        setRealtime();
+        const long periodNs = 1000000000L / rate;
+        const int64_t end = nowNs() + (int64_t) FLAGS_duration * 1000000;
+        uint64_t cycles = 0;
+        timespec next{};
+        clock_gettime(CLOCK_MONOTONIC, &next);
+
+        while (true) {
+            next.tv_nsec += periodNs;
+            while (next.tv_nsec >= 1000000000) {
+                next.tv_nsec -= 1000000000;
+                next.tv_sec++;
+            }
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr);
+            if (nowNs() >= end)
+                break;
+
+            timeval tv{};
+            gettimeofday(&tv, nullptr);
+            master.ecatBus->timestamp = tv.tv_sec * 1000000 + tv.tv_usec;
+            master.ecatBus->cycle_count++;
+            cycles++;
+
+            shared->publish_ns[cycles % PUBLISH_SLOTS] = nowNs();
+            shared->cycle = (int64_t) cycles;
+            master.updateSempahore();
+        }
+        return cycles;
+    }
+
+    PointResult runPoint(EcatConfigMaster &master, BenchShared *shared, uint32_t *latency, uint64_t maxSamples,
+                         int clients, int rate) {
+        std::memset(shared->accessor_ns, 0, sizeof(shared->accessor_ns));
+        shared->accessor_calls = 0;
+        for (auto &c: shared->clients)
+            c = ClientResult();
+        shared->ready = 0;
+        shared->stop = false;
+        shared->cycle = 0;
+
+        std::vector<pid_t> pids;
+        for (int i = 0; i < clients; ++i) {
+            pid_t pid = fork();
+            if (pid == 0)
+                runClient(i, shared, latency + i * maxSamples, maxSamples);
+            if (pid > 0)
+                pids.push_back(pid);
+        }
+
+        for (int i = 0; i < 5000 && shared->ready < (int) pids.size(); ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::this_thread::sleep_for(std::chrono::milliseconds(10)); // all clients blocked in wait()
+
+        PointResult result;
+        result.clients = clients;
+        result.rate = rate;
+        std::thread publisher([&]() { result.cycles = publish(master, shared, rate); });
+        publisher.join();
+
+        /* release the clients, a post wakes one waiter of a semaphore */
+        shared->stop = true;
+        std::size_t exited = 0;
+        while (exited < pids.size()) {
+            master.updateSempahore();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            for (auto &pid: pids) {
+                if (pid > 0 && waitpid(pid, nullptr, WNOHANG) == pid) {
+                    pid = 0;
+                    exited++;
+                }
+            }
+        }
+
+        std::vector<uint32_t> samples;
+        for (int i = 0; i < clients; ++i) {
+            const ClientResult &c = shared->clients[i];
+            result.wakes += c.wakes;
+            result.missed += c.missed;
+            samples.insert(samples.end(), latency + i * maxSamples, latency + i * maxSamples + c.samples);
+        }
+        result.wakes_per_sec = result.wakes * 1000.0 / FLAGS_duration;
+        result.latency = latencyStat(samples);
+        for (int k = 0; k < ACCESSOR_KINDS; ++k)
+            result.accessor_ns[k] = shared->accessor_calls ? (double) shared->accessor_ns[k] / shared->accessor_calls : 0.0;
+        return result;
+    }
+
+    void writeJson(std::ostream &os, const rocos::EcatBus *bus, int inputSize, const std::vector<PointResult> &results) {
+        os << "{\n";
+        os << boost::format("  \"config\": {\"eni\": \"%s\", \"slaves\": %d, \"input_size\": %d, \"duration_ms\": %d, "
+                            "\"batch\": %d, \"rtprio\": %d, \"cpus\": %d},\n")
+              % FLAGS_eni % bus->slave_num % inputSize % FLAGS_duration % FLAGS_batch % FLAGS_rtprio
+              % std::thread::hardware_concurrency();
+        os << "  \"results\": [\n";
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            const PointResult &r = results[i];
+            os << boost::format("    {\"clients\": %d, \"rate_hz\": %d, \"cycles\": %d, \"wakes\": %d, \"missed\": %d, "
+                                "\"wakes_per_sec\": %.1f,\n")
+                  % r.clients % r.rate % r.cycles % r.wakes % r.missed % r.wakes_per_sec;
+            os << boost::format("     \"latency_us\": {\"min\": %.3f, \"mean\": %.3f, \"p50\": %.3f, \"p99\": %.3f, "
+                                "\"p999\": %.3f, \"max\": %.3f},\n")
+                  % r.latency.min % r.latency.mean % r.latency.p50 % r.latency.p99 % r.latency.p999 % r.latency.max;
+            os << "     \"accessor_ns\": {";
+            for (int k = 0; k < ACCESSOR_KINDS; ++k)
+                os << boost::format("%s\"%s\": %.2f") % (k ? ", " : "") % accessorName[k] % r.accessor_ns[k];
+            os << "}}" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        os << "  ]\n}\n";
+    }
+
+}
+
+int main(int argc, char *argv[]) {
+    gflags::SetUsageMessage("Client wake latency, throughput and accessor cost against a stand-in cycle publisher");
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+    using namespace rocos::eni;
+
+    std::vector<int> clientCounts = parseList(FLAGS_clients);
+    std::vector<int> rates = parseList(FLAGS_rates);
+    for (int c: clientCounts) {
+        if (c < 1 || c > MAX_CLIENTS) {
+            std::cerr << "[ERROR] Client count must be between 1 and " << MAX_CLIENTS << "." << std::endl;
+            return 1;
+        }
+    }
+    for (int r: rates) {
+        if (r < 1 || r > 100000) {
+            std::cerr << "[ERROR] Rate must be between 1 and 100000 Hz." << std::endl;
+            return 1;
+        }
+    }
+
+    ////////////// Stand-in master with the slave table of the ENI //////////////
+    boost::property_tree::ptree eni;
+    try {
+        boost::property_tree::read_xml(FLAGS_eni, eni);
+    } catch (std::exception &e) {
+        std::cerr << "[ERROR] Can not read ENI " << FLAGS_eni << ": " << e.what() << std::endl;
+        return 1;
+    }
+    const auto &config = eni.get_child("EtherCATConfig.Config");
+    BusLayout layout;
+    parseBusLayout(config, layout);
+
+    EcatConfigMaster master(FLAGS_id);
+    if (!master.createSharedMemory())
+        return 1;
+    master.createPdDataMemoryProvider(layout.input_size, layout.output_size);
+    parseSlaves(config, master.ecatBus);
+    master.ecatBus->current_state = ECAT_STATE_OP;
+    master.ecatBus->is_authorized = true;
+    if (master.ecatBus->slave_num == 0) {
+        std::cerr << "[ERROR] No slaves in " << FLAGS_eni << "." << std::endl;
+        return 1;
+    }
+
+    ////////////// Results shared with the client processes //////////////
+    const int maxRate = *std::max_element(rates.begin(), rates.end());
+    const uint64_t maxSamples = (uint64_t) maxRate * FLAGS_duration / 1000 + 16;
+    const std::size_t sharedSize = sizeof(BenchShared) + MAX_CLIENTS * maxSamples * sizeof(uint32_t);
+    void *mem = mmap(nullptr, sharedSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        std::cerr << "[ERROR] Can not map " << sharedSize << " bytes for the results." << std::endl;
+        return 1;
+    }
+    auto *shared = new(mem) BenchShared();
+    auto *latency = reinterpret_cast<uint32_t *>((char *) mem + sizeof(BenchShared));
+
+    std::vector<PointResult> results;
+    for (int clients: clientCounts) {
+        for (int rate: rates) {
+            PointResult r = runPoint(master, shared, latency, maxSamples, clients, rate);
+            std::cout << boost::format("[BENCH] %2d clients %5d Hz: latency p50 %7.1f p99 %7.1f max %8.1f us, "
+                                       "%8.0f wakes/s, %d missed, by id %.1f by name %.1f ptr %.1f snapshot %.1f ns")
+                         % r.clients % r.rate % r.latency.p50 % r.latency.p99 % r.latency.max % r.wakes_per_sec
+                         % r.missed % r.accessor_ns[GET_BY_ID] % r.accessor_ns[GET_BY_NAME] % r.accessor_ns[GET_PTR]
+                         % r.accessor_ns[SNAPSHOT] << std::endl;
+            results.push_back(r);
+        }
+    }
+
+    std::ofstream json(FLAGS_json);
+    if (!json) {
+        std::cerr << "[ERROR] Can not write " << FLAGS_json << "." << std::endl;
+        return 1;
+    }
+    writeJson(json, master.ecatBus, layout.input_size, results);
+    std::cout << "[BENCH] Results written to " << FLAGS_json << std::endl;
+
+    munmap(mem, sharedSize);
+    return 0;
+}
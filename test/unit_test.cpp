@@ -29,7 +29,15 @@ Shenyang Institute of Automation, Chinese Academy of Sciences.
 #define protected public
 
 #include <rocos_ecm/ecat_config.h>
+#include <rocos_ecm/ecat_shm.h>
 #include <iostream>
+#include <chrono>
+#include <thread>
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 TEST_CASE("info") {
     auto ecatConfig = rocos::EcatConfig::getInstance(0);
@@ -293,6 +301,411 @@ TEST_CASE("Cycling Time Print") {
 
 }
 
+TEST_CASE("watchdog") {
+    auto ecatConfig = rocos::EcatConfig::getInstance();
+
+    REQUIRE(ecatConfig->registerWatchdog(5));
+
+    for (int i = 0; i < 100; i++) {
+        ecatConfig->wait();
+        ecatConfig->commit();
+    }
+    CHECK_FALSE(ecatConfig->isWatchdogTripped());
+
+    usleep(100000); // stop committing for 100 cycles
+    CHECK(ecatConfig->isWatchdogTripped());
+
+    auto watchdog = ecatConfig->getWatchdog();
+    std::cout << "Missed cycles: " << watchdog.missed_cycles << std::endl;
+    std::cout << "Reaction time(us): " << watchdog.reaction_time << std::endl;
+
+    ecatConfig->rearmWatchdog();
+    ecatConfig->unregisterWatchdog();
+}
+
+TEST_CASE("watchdog hold position") {
+    auto ecatConfig = rocos::EcatConfig::getInstance();
+
+    ecatConfig->setSlaveSafeOutput(0, SAFE_OUTPUT_HOLD);
+    REQUIRE(ecatConfig->registerWatchdog(5, 1));
+    ecatConfig->wait();
+    ecatConfig->commit();
+
+    usleep(100000); // stop committing
+    REQUIRE(ecatConfig->isWatchdogTripped());
+    ecatConfig->wait();
+
+    // latched at the trip, not following the actual position
+    const int64_t hold = ecatConfig->watchdog->hold_position[0];
+    for (int i = 0; i < 50; i++) {
+        ecatConfig->wait();
+        CHECK(ecatConfig->watchdog->hold_position[0] == hold);
+        CHECK(ecatConfig->getSlaveOutputVarValueByName<int32_t>(0, "Target Position") == (int32_t) hold);
+    }
+
+    ecatConfig->rearmWatchdog();
+    ecatConfig->unregisterWatchdog();
+    ecatConfig->setSlaveSafeOutput(0, SAFE_OUTPUT_QUICK_STOP);
+}
+
+TEST_CASE("output ownership") {
+    auto ecatConfig = rocos::EcatConfig::getInstance();
+
+    REQUIRE(ecatConfig->claimSlaveOutputs(0));
+    CHECK(ecatConfig->pdOwnStagingPtr != nullptr);
+
+    ecatConfig->setSlaveOutputVarValueByName<int16_t>(0, "Target Torque", 0);
+    ecatConfig->wait();
+    ecatConfig->wait(); // merged by master
+
+    for (int i = 0; i < ecatConfig->slaves()[0].output_var_num; i++) {
+        auto var = ecatConfig->getSlaveOutputVar(0, i);
+        CHECK(ecatConfig->outputAddress(var.offset) != (char *) ecatConfig->pdOutputPtr + var.offset);
+        if (strcmp(var.name, "Target Torque") == 0)
+            CHECK(*(int16_t *) ((char *) ecatConfig->pdOutputPtr + var.offset) == 0);
+    }
+
+    // outputs of other slaves are not claimed and still go to pd_output directly
+    if (ecatConfig->ecatBus->slave_num > 1 && ecatConfig->slaves()[1].output_var_num > 0) {
+        auto var = ecatConfig->getSlaveOutputVar(1, 0);
+        CHECK(ecatConfig->outputAddress(var.offset) == (char *) ecatConfig->pdOutputPtr + var.offset);
+    }
+
+    // claiming again adds no range, a partly overlapping claim extends the existing one
+    const int rangeNum = ecatConfig->ownership->range_num;
+    CHECK(ecatConfig->claimSlaveOutputs(0));
+    CHECK(ecatConfig->ownership->range_num == rangeNum);
+    REQUIRE(ecatConfig->claimedRanges.size() == 1);
+    const rocos::OutputRange first = ecatConfig->claimedRanges[0];
+    CHECK(ecatConfig->claimOutputRange(first.offset + first.size - 1, 2));
+    CHECK(ecatConfig->ownership->range_num == rangeNum);
+    REQUIRE(ecatConfig->claimedRanges.size() == 1);
+    CHECK(ecatConfig->claimedRanges[0].offset == first.offset);
+    CHECK(ecatConfig->claimedRanges[0].size == first.size + 1);
+
+    ecatConfig->releaseOutputs();
+    CHECK(ecatConfig->pdOwnStagingPtr == nullptr);
+    auto var = ecatConfig->getSlaveOutputVar(0, 0);
+    CHECK(ecatConfig->outputAddress(var.offset) == (char *) ecatConfig->pdOutputPtr + var.offset);
+}
+
+TEST_CASE("refused output claim") {
+    auto ecatConfig = rocos::EcatConfig::getInstance();
+    const bool hadSlot = ecatConfig->clientWatchdog != nullptr;
+
+    int ready[2], done[2];
+    REQUIRE(pipe(ready) == 0);
+    REQUIRE(pipe(done) == 0);
+    pid_t pid = fork();
+    if (pid == 0) { // owns the outputs of slave 0 until the parent is done
+        char c = ecatConfig->claimSlaveOutputs(0) ? 1 : 0;
+        if (write(ready[1], &c, 1) != 1 || read(done[0], &c, 1) != 1)
+            _exit(1);
+        ecatConfig->releaseOutputs();
+        _exit(0);
+    }
+    char c = 0;
+    REQUIRE(read(ready[0], &c, 1) == 1);
+    REQUIRE(c == 1);
+
+    CHECK_FALSE(ecatConfig->claimSlaveOutputs(0));
+    CHECK((ecatConfig->clientWatchdog != nullptr) == hadSlot); // a refused claim does not keep the slot
+
+    CHECK(write(done[1], &c, 1) == 1);
+    waitpid(pid, nullptr, 0);
+    for (int fd: {ready[0], ready[1], done[0], done[1]})
+        close(fd);
+}
+
+TEST_CASE("output ownership of a dead client") {
+    auto ecatConfig = rocos::EcatConfig::getInstance();
+    const int rangeNum = ecatConfig->ownership->range_num;
+
+    pid_t pid = fork();
+    if (pid == 0) // claims and dies without releasing
+        _exit(ecatConfig->claimSlaveOutputs(0) ? 0 : 1);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    REQUIRE(WIFEXITED(status));
+    REQUIRE(WEXITSTATUS(status) == 0);
+    CHECK(ecatConfig->ownership->range_num == rangeNum + 1);
+
+    // reclaimed by the master, no other client has to register
+    bool reclaimed = false;
+    for (int i = 0; i < 300 && !reclaimed; i++) {
+        usleep(10000);
+        reclaimed = ecatConfig->ownership->range_num == rangeNum;
+        for (const auto &client: ecatConfig->watchdog->clients)
+            reclaimed = reclaimed && client.pid != pid;
+    }
+    CHECK(reclaimed);
+}
+
+TEST_CASE("flight recorder request") {
+    auto ecatConfig = rocos::EcatConfig::getInstance();
+
+    unsigned int request = ecatConfig->ecatBus->capture_request;
+    ecatConfig->requestCapture();
+    CHECK(ecatConfig->ecatBus->capture_request == request + 1);
+    ecatConfig->wait(); // seen by the master, the dump follows after --flightpost ms
+}
+
+TEST_CASE("pre-faulted shared memory") {
+    auto ecatConfig = rocos::EcatConfig::getInstance();
+
+    // attach has already touched every page, no fault is left for the first cycles
+    auto stat = rocos::prefaultRegion(ecatConfig->pdInputRegion->get_address(),
+                                      ecatConfig->pdInputRegion->get_size(), 0);
+    CHECK(stat.pages > 0);
+    CHECK(stat.minor_faults == 0);
+    std::cout << rocos::to_string(ecatConfig->pdInputName, stat) << std::endl;
+}
+
+TEST_CASE("notification counts") {
+    auto ecatConfig = rocos::EcatConfig::getInstance();
+
+    // counted by the master even when --notifyrate / --notifyfilter keep them out of the log
+    auto stat = ecatConfig->getNotificationStat();
+    CHECK(ecatConfig->getNotificationCount(0x10001) >= stat.error_count[1]); // EC_NOTIFY_CYCCMD_WKC_ERROR
+    CHECK(ecatConfig->getNotificationCount(0x10001, 0xFFFF) == 0);
+    std::cout << "WKC errors: " << stat.error_count[1] << ", frame response errors: " << stat.error_count[10]
+              << ", filtered: " << stat.filtered << ", rate limited: " << stat.suppressed << std::endl;
+}
+
+TEST_CASE("event stream") {
+    auto ecatConfig = rocos::EcatConfig::getInstance();
+
+    // events posted before this point were skipped at attach, read whatever arrives within 100 cycles
+    rocos::EcatEvent event;
+    for (int i = 0; i < 100; i++) {
+        ecatConfig->wait();
+        while (ecatConfig->pollEvent(event)) {
+            CHECK(event.type >= ECAT_EVENT_MASTER_STATE);
+            CHECK(event.type <= ECAT_EVENT_PDI_WATCHDOG);
+            std::cout << "Event " << event.type << " code 0x" << std::hex << event.code << std::dec
+                      << " slave " << event.station_address << " state " << event.state << std::endl;
+        }
+    }
+    CHECK(ecatConfig->getLostEventCount() == 0);
+}
+
+TEST_CASE("slave diagnostics") {
+    auto ecatConfig = rocos::EcatConfig::getInstance();
+
+    auto bus = ecatConfig->getDiagnostics();
+    std::cout << "Cyclic WKC errors: " << bus.cyclic_wkc_errors << ", lost cyclic frames: " << bus.cyclic_frame_losses << std::endl;
+    for (int i = 0; i < ecatConfig->ecatBus->slave_num; i++) {
+        auto slave = ecatConfig->getSlaveDiagnostics(i);
+        CHECK(slave.station_address == EC_STATION_ADDRESS_BASE + i);
+        std::cout << "Slave " << i << " (" << slave.station_address << "): state " << slave.state
+                  << ", WKC errors " << slave.wkc_errors << ", lost frames " << slave.frame_losses
+                  << ", AL status code 0x" << std::hex << slave.al_status_code << std::dec
+                  << ", mailbox errors " << slave.mailbox_errors << std::endl;
+    }
+    CHECK(ecatConfig->getSlaveDiagnostics(MAX_SLAVE_NUM).station_address == 0);
+}
+
+TEST_CASE("read-only attach") {
+    auto monitor = rocos::EcatConfig::getReadOnlyInstance(0);
+    REQUIRE(monitor != nullptr);
+    CHECK(monitor->isReadOnly());
+    CHECK(monitor == rocos::EcatConfig::getReadOnlyInstance(0));
+    CHECK(rocos::EcatConfig::getReadOnlyInstance(99) == nullptr); // no master, nothing is created
+
+    long cycle = monitor->ecatBus->cycle_count;
+    monitor->wait();
+    CHECK(monitor->ecatBus->cycle_count > cycle);
+    CHECK(monitor->getSlaveNum() == rocos::EcatConfig::getInstance()->getSlaveNum());
+
+    int state = monitor->ecatBus->request_state;
+    monitor->setBusRequestState(ECAT_STATE_INIT); // refused
+    CHECK(monitor->ecatBus->request_state == state);
+    CHECK_FALSE(monitor->registerWatchdog());
+
+    // refused instead of writing into the read-only mapping
+    monitor->setSlaveOutputVarValueByName<int16_t>(0, "Target Torque", 0);
+    monitor->setSlaveInputVarValue<char>(0, 0, 0);
+    CHECK_FALSE(monitor->claimSlaveOutputs(0));
+    CHECK(monitor->pdStagingRegion == nullptr);
+}
+
+TEST_CASE("generation") {
+    auto ecatConfig = rocos::EcatConfig::getInstance();
+    CHECK(ecatConfig->getGeneration() > 0); // published by the running master
+    ecatConfig->wait();
+    CHECK(ecatConfig->getReattachCount() == 0);
+}
+
+TEST_CASE("slave layout") {
+    auto ecatConfig = rocos::EcatConfig::getInstance();
+    ecatConfig->wait();
+    CHECK(ecatConfig->getLayoutVersion() >= 1); // switched to after the slave table was set up
+    // clients read a published table, the master keeps working on EcatBus::slaves
+    CHECK(ecatConfig->slaves() != ecatConfig->ecatBus->slaves);
+    for (int i = 0; i < ecatConfig->getSlaveNum(); i++) {
+        CHECK(ecatConfig->isSlavePresent(i));
+        CHECK(strcmp(ecatConfig->slaves()[i].name, ecatConfig->ecatBus->slaves[i].name) == 0);
+    }
+    CHECK_FALSE(ecatConfig->isSlavePresent(ecatConfig->getSlaveNum()));
+}
+
+TEST_CASE("initial layout event") {
+    auto ecatConfig = rocos::EcatConfig::getInstance();
+    ecatConfig->wait();
+    const int slaveNum = ecatConfig->getSlaveNum();
+    CHECK(__builtin_popcountll(ecatConfig->layout->present_mask) == slaveNum);
+
+    // replay the ring from the master start, the first layout reports the configured slaves only
+    uint64_t cursor = 0, lost = 0;
+    rocos::EcatEvent event;
+    bool found = false;
+    while (!found && rocos::readEvent(ecatConfig->eventRing, cursor, event, lost))
+        found = event.type == ECAT_EVENT_LAYOUT && event.value[0] == 1;
+    if (lost == 0) {
+        REQUIRE(found);
+        CHECK(event.value[1] == slaveNum);
+    }
+}
+
+TEST_CASE("dc time series") {
+    auto ecatConfig = rocos::EcatConfig::getInstance();
+
+    auto samples = ecatConfig->getDcSamples(100);
+    std::cout << "DC samples: " << ecatConfig->getDcSampleCount() << ", p50 " << ecatConfig->getDcPercentile(50.0)
+              << " ns, p99 " << ecatConfig->getDcPercentile(99.0) << " ns" << std::endl;
+    CHECK(samples.size() <= 100);
+    for (std::size_t i = 1; i < samples.size(); i++)
+        CHECK(samples[i].sequence > samples[i - 1].sequence);
+}
+
+TEST_CASE("startup timings") {
+    auto ecatConfig = rocos::EcatConfig::getInstance();
+    ecatConfig->wait();
+
+    auto timings = ecatConfig->getStartupTimings();
+    std::cout << "Start-up" << (timings.fast_start ? " (fast)" : "") << ": state " << timings.reached_state
+              << " after " << timings.reached / 1000 << " ms" << std::endl;
+    for (int i = 0; i < timings.phase_num; i++)
+        std::cout << "  " << timings.phases[i].name << ": " << timings.phases[i].begin / 1000 << " ms + "
+                  << (timings.phases[i].end - timings.phases[i].begin) / 1000 << " ms" << std::endl;
+
+    CHECK(timings.reached > 0);
+    CHECK(timings.phase_num > 0);
+    CHECK(timings.phase_num <= MAX_STARTUP_PHASES);
+    CHECK(timings.phases[0].begin == 0); // "main", from process start until the master set up its shared memory
+    for (int i = 0; i < timings.phase_num; i++) {
+        CHECK(timings.phases[i].end >= timings.phases[i].begin);
+        CHECK(timings.phases[i].end <= timings.reached);
+    }
+}
+
+#if defined(ROCOS_ECM_SIM) && defined(ROCOS_ECM_ENI)
+TEST_CASE("fast start stays in OP") {
+    // own simulator, monitored from its start: the bus must not leave OP once it reached it
+    const int id = 7;
+    for (const char *name: {"ecm7", "pd_input7", "pd_output7", "pd_staging7"})
+        shm_unlink(name); // leftovers of an earlier run
+    pid_t pid = fork();
+    REQUIRE(pid >= 0);
+    if (pid == 0) {
+        execl(ROCOS_ECM_SIM, ROCOS_ECM_SIM, "--id=7", "--eni=" ROCOS_ECM_ENI, "--faststart", "--simstatedelay=40",
+              "--state=op", "--duration=5000", "--starttrace=", (char *) nullptr);
+        _exit(127);
+    }
+
+    using clock = std::chrono::steady_clock;
+    rocos::EcatConfig *ecatConfig = nullptr;
+    auto until = clock::now() + std::chrono::seconds(2);
+    while (ecatConfig == nullptr && clock::now() < until) {
+        ecatConfig = rocos::EcatConfig::getReadOnlyInstance(id);
+        if (ecatConfig == nullptr)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    bool reached = false;
+    long cyclesInOp = 0;
+    long cyclesLeftOp = 0;
+    while (ecatConfig != nullptr && clock::now() < until) {
+        ecatConfig->wait();
+        if (!reached && ecatConfig->getStartupTimings().reached >= 0) {
+            reached = true;
+            until = clock::now() + std::chrono::milliseconds(500);
+        }
+        if (reached)
+            (ecatConfig->ecatBus->current_state == ECAT_STATE_OP ? cyclesInOp : cyclesLeftOp)++;
+    }
+    kill(pid, SIGTERM);
+    waitpid(pid, nullptr, 0);
+
+    REQUIRE(ecatConfig != nullptr);
+    CHECK(reached);
+    CHECK(ecatConfig->getStartupTimings().fast_start == 1);
+    CHECK(cyclesInOp > 0);
+    CHECK(cyclesLeftOp == 0);
+}
+
+TEST_CASE("master restart") {
+    // clients remap on the generation of the restarted master, the read-only one although it attached before
+    // the control block existed
+    const int id = 6;
+    for (const char *name: {"ecm6", "ecm_ctl6", "pd_input6", "pd_output6", "pd_staging6"})
+        shm_unlink(name); // leftovers of an earlier run
+    auto startMaster = []() {
+        pid_t pid = fork();
+        if (pid == 0) {
+            execl(ROCOS_ECM_SIM, ROCOS_ECM_SIM, "--id=6", "--eni=" ROCOS_ECM_ENI, "--simstatedelay=40",
+                  "--state=op", "--duration=5000", "--starttrace=", (char *) nullptr);
+            _exit(127);
+        }
+        return pid;
+    };
+    pid_t pid = startMaster();
+    REQUIRE(pid >= 0);
+
+    using clock = std::chrono::steady_clock;
+    rocos::EcatConfig *monitor = nullptr;
+    auto until = clock::now() + std::chrono::seconds(2);
+    while (monitor == nullptr && clock::now() < until) {
+        monitor = rocos::EcatConfig::getReadOnlyInstance(id);
+        if (monitor == nullptr)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    REQUIRE(monitor != nullptr);
+    auto client = rocos::EcatConfig::getInstance(id);
+    client->wait(); // takes semaphore slot 0
+    monitor->wait();
+
+    delete monitor->controlRegion; // as if attached before the master published its first generation
+    monitor->controlRegion = nullptr;
+    monitor->control = nullptr;
+
+    kill(pid, SIGTERM);
+    waitpid(pid, nullptr, 0);
+    pid = startMaster();
+    REQUIRE(pid >= 0);
+
+    // both block while no master cycles
+    until = clock::now() + std::chrono::seconds(3);
+    while ((client->getReattachCount() == 0 || monitor->getReattachCount() == 0) && clock::now() < until) {
+        client->wait();
+        monitor->wait();
+    }
+    const long cycle = client->ecatBus->cycle_count;
+    for (int i = 0; i < 100; i++)
+        client->wait();
+    const bool cycling = client->ecatBus->cycle_count > cycle;
+    kill(pid, SIGTERM);
+    waitpid(pid, nullptr, 0);
+
+    CHECK(client->getReattachCount() == 1);
+    CHECK(monitor->getReattachCount() == 1);
+    CHECK(monitor->control != nullptr);
+    CHECK(cycling);
+    for (int i = 0; i < EC_SEM_NUM; i++)
+        CHECK(client->staleSem[i] == nullptr); // closed by the waiting thread
+}
+#endif
+
 #undef private 
 #undef protected
 
@@ -0,0 +1,532 @@
+/*-----------------------------------------------------------------------------
+ * ecat_analyze.cpp
+ * Description              Offline analysis of large EtherCAT captures
+ *
+ * Splits a pcap file (--pcap of rocos_ecm, flight recorder dumps, Wireshark)
+ * into chunks, decodes the datagrams of all chunks in parallel and reports per
+ * bus cycle the working counter status, lost frames and the cycle period, plus
+ * per-slave error statistics. The per-cycle table can be written as CSV or as
+ * compact binary records for further processing.
+ *---------------------------------------------------------------------------*/
+
+#include "ecat_capture.h"
+
+#include <gflags/gflags.h>
+#include <boost/format.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/xml_parser.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+DEFINE_string(pcap, "", "Capture to analyze (pcap file).");
+DEFINE_string(eni, "", "ENI the capture was recorded with, enables the working counter check against the expected values.");
+DEFINE_int32(cycle, 0, "Nominal bus cycle time in μsec, 0 = from the ENI or estimated from the capture.");
+DEFINE_int32(threads, 0, "Number of decoding threads, 0 = all cores.");
+DEFINE_double(gap, 1.5, "A cycle period longer than gap * nominal cycle time is reported as gap.");
+DEFINE_string(csv, "", "Write one line per bus cycle to this CSV file.");
+DEFINE_string(bin, "", "Write one CycleRecord per bus cycle to this binary file.");
+
+namespace {
+
+    using namespace rocos::capture;
+
+    const int SYNC_RECORDS = 8;              // consecutive valid records needed to resync at a chunk start
+    const std::size_t MIN_CHUNK_SIZE = 1 << 20;
+
+    enum CycleStatus {
+        CYCLE_WKC_ERROR  = 0x01, // received cyclic datagram with unexpected working counter
+        CYCLE_FRAME_LOST = 0x02, // less frames received than sent
+        CYCLE_GAP        = 0x04, // period longer than --gap * nominal cycle time
+        CYCLE_PARTIAL    = 0x08  // first cycle of the capture, may have started before it
+    };
+
+    //! Cycle start detection without ENI, a chunk starts in the middle of an unknown cycle
+    enum RxSync {
+        SYNC_UNKNOWN = 0, // nothing sent or received in this chunk yet
+        SYNC_RX_SEEN,     // a frame came back, the next sent process data frame starts a cycle
+        SYNC_TX_SENT      // cycle started, waiting for a frame to come back
+    };
+
+#pragma pack(push, 1)
+    //! Binary output, one record per bus cycle, the record index is the cycle number
+    struct CycleRecord {
+        uint64_t time_ns      {0}; // capture time of the frame starting the cycle
+        int64_t  period_ns    {0}; // to the previous cycle, 0 for the first one
+        uint16_t tx_frames    {0};
+        uint16_t rx_frames    {0};
+        uint32_t status       {0}; // CYCLE_xxx
+        uint32_t datagrams    {0}; // received datagrams
+        uint32_t wkc_errors   {0};
+    };
+    static_assert(sizeof(CycleRecord) == 32, "CycleRecord is part of the --bin file format");
+
+    struct CycleFileHeader {
+        char     magic[4]         {'E', 'C', 'A', 'N'};
+        uint32_t version          {1};
+        uint32_t record_size      {sizeof(CycleRecord)};
+        uint32_t reserved         {0};
+        uint64_t record_num       {0};
+        uint64_t nominal_cycle_ns {0};
+    };
+#pragma pack(pop)
+
+    //! Datagrams with configured station address (FPxx) received from one slave
+    struct SlaveStat {
+        uint64_t datagrams       {0};
+        uint64_t no_response     {0}; // working counter 0
+        uint64_t al_errors       {0}; // AL status read with the error indication set
+        uint16_t al_status_code  {0}; // last non-zero AL status code read
+        uint32_t rx_errors       {0}; // highest sum of the ESC port error counters read (0x300..0x30B)
+    };
+
+    struct ChunkResult {
+        std::size_t begin          {0};
+        std::size_t end            {0};
+        std::size_t stop           {0}; // offset decoding stopped at, == end if the chunk is aligned
+        bool        head           {false}; // cycles[0] collects frames before the first cycle start
+        bool        tentative      {false}; // without ENI the first cycle start depends on the end of the previous chunk
+        RxSync      sync           {SYNC_UNKNOWN}; // at the end of the chunk
+        std::vector<CycleRecord> cycles;
+        std::map<uint16_t, SlaveStat> slaves;
+        uint64_t frames            {0};
+        uint64_t ethercat_frames   {0};
+        uint64_t datagrams         {0};
+        uint64_t wkc_errors        {0};
+    };
+
+    struct Capture {
+        const uint8_t *data  {nullptr};
+        std::size_t    size  {0};
+        bool           nsec  {false};
+        uint32_t       first_sec {0};
+    };
+
+    //! Check of a record header, strict also checks the timestamp to find record boundaries in the middle of the file
+    bool isRecordAt(const Capture &cap, std::size_t pos, std::size_t &next, bool strict = true) {
+        if (pos + sizeof(PcapPacketHeader) > cap.size)
+            return false;
+        PcapPacketHeader hdr;
+        std::memcpy(&hdr, cap.data + pos, sizeof(hdr));
+        if (hdr.caplen > 0xffff || hdr.len < hdr.caplen)
+            return false;
+        if (!strict)
+            return (next = pos + sizeof(hdr) + hdr.caplen) <= cap.size;
+        if (hdr.caplen < 14)
+            return false;
+        if (hdr.usec >= (cap.nsec ? 1000000000u : 1000000u))
+            return false;
+        if (hdr.sec < cap.first_sec || hdr.sec - cap.first_sec > 30 * 24 * 3600)
+            return false;
+        next = pos + sizeof(hdr) + hdr.caplen;
+        return next <= cap.size;
+    }
+
+    //! First record boundary at or after pos, confirmed by SYNC_RECORDS records following each other
+    std::size_t syncRecord(const Capture &cap, std::size_t pos) {
+        for (; pos + sizeof(PcapPacketHeader) <= cap.size; ++pos) {
+            std::size_t p = pos, next = 0;
+            int n = 0;
+            while (n < SYNC_RECORDS && isRecordAt(cap, p, next)) {
+                ++n;
+                p = next;
+                if (p == cap.size)
+                    return pos;
+            }
+            if (n == SYNC_RECORDS)
+                return pos;
+        }
+        return cap.size;
+    }
+
+    struct Decoder {
+        const Capture &cap;
+        const BusLayout &layout;
+        ChunkResult &result;
+
+        Decoder(const Capture &c, const BusLayout &l, ChunkResult &r) : cap(c), layout(l), result(r) {}
+
+        CycleRecord &current(uint64_t timeNs) {
+            if (result.cycles.empty()) { // frames before the first cycle start of this chunk
+                result.head = true;
+                result.cycles.emplace_back();
+                result.cycles.back().time_ns = timeNs;
+            }
+            return result.cycles.back();
+        }
+
+        void slaveDatagram(const Datagram &dg) {
+            SlaveStat &slave = result.slaves[(uint16_t) (dg.addr & 0xffff)];
+            slave.datagrams++;
+            if (dg.wkc == 0) {
+                slave.no_response++;
+                return;
+            }
+            if (!isReadCommand(dg.cmd))
+                return;
+
+            const uint32_t ado = dg.addr >> 16;
+            auto contains = [&](uint32_t reg, uint32_t size) {
+                return ado <= reg && reg + size <= ado + (uint32_t) dg.length;
+            };
+            if (contains(AL_STATUS_REGISTER, 2) && (getWord(dg.data + AL_STATUS_REGISTER - ado) & 0x10))
+                slave.al_errors++;
+            if (contains(0x134, 2)) {
+                uint16_t code = getWord(dg.data + 0x134 - ado);
+                if (code != 0)
+                    slave.al_status_code = code;
+            }
+            if (contains(0x300, 12)) {
+                uint32_t sum = 0;
+                for (uint32_t i = 0; i < 12; ++i) // invalid frame, RX error and forwarded RX error counters
+                    sum += dg.data[0x300 - ado + i];
+                slave.rx_errors = std::max(slave.rx_errors, sum);
+            }
+        }
+
+        void frame(const uint8_t *data, uint32_t size, uint64_t timeNs) {
+            result.frames++;
+
+            // cycle start: sent frame with the first cyclic command of the ENI, without ENI the first
+            // sent frame with process data after a frame came back. Before the first frame of a chunk
+            // came back that is only known at the merge, so the first start is tentative.
+            bool received = false;
+            bool cycleStart = false;
+            bool first = true;
+            bool isEtherCAT = forEachDatagram(data, size, received, [&](const Datagram &dg) {
+                if (!received) {
+                    if (layout.cmds.empty() ? (isLogicalCommand(dg.cmd) && result.sync != SYNC_TX_SENT)
+                                            : (first && findCyclicCmd(layout, dg) == 0))
+                        cycleStart = true;
+                    first = false;
+                }
+            });
+            if (!isEtherCAT)
+                return;
+            result.ethercat_frames++;
+
+            if (cycleStart) {
+                if (layout.cmds.empty()) {
+                    if (result.sync == SYNC_UNKNOWN)
+                        result.tentative = true;
+                    result.sync = SYNC_TX_SENT;
+                }
+                result.cycles.emplace_back();
+                result.cycles.back().time_ns = timeNs;
+            }
+
+            CycleRecord &cycle = current(timeNs);
+            if (!received) {
+                cycle.tx_frames++;
+                return;
+            }
+            cycle.rx_frames++;
+            result.sync = SYNC_RX_SEEN;
+
+            forEachDatagram(data, size, received, [&](const Datagram &dg) {
+                if (dg.cmd == NOP)
+                    return;
+                cycle.datagrams++;
+                result.datagrams++;
+
+                bool wkcError;
+                if (layout.cmds.empty()) {
+                    wkcError = dg.wkc == 0;
+                } else {
+                    int i = findCyclicCmd(layout, dg);
+                    wkcError = i >= 0 && layout.cmds[i].expected_wkc >= 0 && dg.wkc != layout.cmds[i].expected_wkc;
+                }
+                if (wkcError) {
+                    cycle.wkc_errors++;
+                    cycle.status |= CYCLE_WKC_ERROR;
+                    result.wkc_errors++;
+                }
+
+                if (isConfiguredAddressCommand(dg.cmd))
+                    slaveDatagram(dg);
+            });
+        }
+
+        void run() {
+            std::size_t pos = result.begin;
+            std::size_t next = 0;
+            while (pos < result.end && isRecordAt(cap, pos, next, false)) {
+                PcapPacketHeader hdr;
+                std::memcpy(&hdr, cap.data + pos, sizeof(hdr));
+                uint64_t timeNs = (uint64_t) hdr.sec * 1000000000ull + (cap.nsec ? hdr.usec : (uint64_t) hdr.usec * 1000);
+                frame(cap.data + pos + sizeof(hdr), hdr.caplen, timeNs);
+                pos = next;
+            }
+            result.stop = pos;
+        }
+    };
+
+    void mergeCycle(CycleRecord &into, const CycleRecord &from) {
+        into.tx_frames += from.tx_frames;
+        into.rx_frames += from.rx_frames;
+        into.datagrams += from.datagrams;
+        into.wkc_errors += from.wkc_errors;
+        into.status |= from.status;
+    }
+
+    void decodeChunks(const Capture &cap, const BusLayout &layout, std::vector<ChunkResult> &chunks, int threadNum) {
+        std::atomic<std::size_t> nextChunk{0};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < threadNum; ++t) {
+            threads.emplace_back([&]() {
+                for (std::size_t i = nextChunk++; i < chunks.size(); i = nextChunk++)
+                    Decoder(cap, layout, chunks[i]).run();
+            });
+        }
+        for (auto &t: threads)
+            t.join();
+    }
+
+}
+
+int main(int argc, char *argv[]) {
+    gflags::SetUsageMessage("Analyze working counters, frame loss and cycle jitter of an EtherCAT capture");
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+    if (FLAGS_pcap.empty()) {
+        std::cerr << "[ERROR] No capture given, use --pcap=<file>." << std::endl;
+        return 1;
+    }
+
+    ////////////// Bus layout from the ENI, optional //////////////
+    BusLayout layout;
+    std::map<uint16_t, std::string> slaveNames;
+    if (!FLAGS_eni.empty()) {
+        boost::property_tree::ptree eni;
+        try {
+            boost::property_tree::read_xml(FLAGS_eni, eni);
+        } catch (std::exception &e) {
+            std::cerr << "[ERROR] Can not read ENI " << FLAGS_eni << ": " << e.what() << std::endl;
+            return 1;
+        }
+        const auto &config = eni.get_child("EtherCATConfig.Config");
+        parseBusLayout(config, layout);
+        for (auto &node: config)
+            if (node.first == "Slave")
+                slaveNames[(uint16_t) parseNumber(node.second.get<std::string>("Info.PhysAddr", "0"))] =
+                        node.second.get<std::string>("Info.Name", "");
+    }
+
+    ////////////// Map the capture //////////////
+    int fd = open(FLAGS_pcap.c_str(), O_RDONLY);
+    struct stat st{};
+    if (fd < 0 || fstat(fd, &st) != 0 || (std::size_t) st.st_size < sizeof(PcapFileHeader)) {
+        std::cerr << "[ERROR] Can not open " << FLAGS_pcap << "." << std::endl;
+        if (fd >= 0)
+            close(fd);
+        return 1;
+    }
+
+    Capture cap;
+    cap.size = (std::size_t) st.st_size;
+    void *map = mmap(nullptr, cap.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        std::cerr << "[ERROR] Can not map " << FLAGS_pcap << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    cap.data = static_cast<const uint8_t *>(map);
+
+    PcapFileHeader fileHeader;
+    std::memcpy(&fileHeader, cap.data, sizeof(fileHeader));
+    if (fileHeader.magic != PCAP_MAGIC_USEC && fileHeader.magic != PCAP_MAGIC_NSEC) {
+        std::cerr << "[ERROR] " << FLAGS_pcap << " is not a pcap file." << std::endl;
+        munmap(map, cap.size);
+        return 1;
+    }
+    cap.nsec = fileHeader.magic == PCAP_MAGIC_NSEC;
+    if (cap.size >= sizeof(PcapFileHeader) + sizeof(PcapPacketHeader))
+        cap.first_sec = reinterpret_cast<const PcapPacketHeader *>(cap.data + sizeof(PcapFileHeader))->sec;
+
+    ////////////// Split into chunks at record boundaries, decode in parallel //////////////
+    auto start = std::chrono::steady_clock::now();
+
+    int threadNum = FLAGS_threads > 0 ? FLAGS_threads : (int) std::max(1u, std::thread::hardware_concurrency());
+    std::size_t payload = cap.size - sizeof(PcapFileHeader);
+    std::size_t chunkNum = std::max<std::size_t>(1, std::min<std::size_t>((std::size_t) threadNum * 4,
+                                                                          payload / MIN_CHUNK_SIZE));
+
+    std::vector<ChunkResult> chunks(chunkNum);
+    {
+        std::vector<std::thread> threads;
+        for (std::size_t i = 0; i < chunkNum; ++i) {
+            chunks[i].begin = sizeof(PcapFileHeader) + payload / chunkNum * i;
+            if (i > 0)
+                threads.emplace_back([&cap, &chunks, i]() { chunks[i].begin = syncRecord(cap, chunks[i].begin); });
+        }
+        for (auto &t: threads)
+            t.join();
+        for (std::size_t i = 0; i < chunkNum; ++i)
+            chunks[i].end = i + 1 < chunkNum ? chunks[i + 1].begin : cap.size;
+    }
+
+    decodeChunks(cap, layout, chunks, threadNum);
+
+    bool aligned = true;
+    for (std::size_t i = 0; i + 1 < chunkNum; ++i)
+        aligned &= chunks[i].stop == chunks[i].end;
+    if (!aligned) { // a resync point was not a record boundary, decode in one piece
+        std::cerr << "[WARNING] Chunk boundaries do not match the record boundaries, decoding sequentially." << std::endl;
+        chunks.assign(1, ChunkResult());
+        chunks[0].begin = sizeof(PcapFileHeader);
+        chunks[0].end = cap.size;
+        decodeChunks(cap, layout, chunks, 1);
+    }
+    if (chunks.back().stop != cap.size)
+        std::cerr << boost::format("[WARNING] Capture truncated or corrupt at offset %d, the rest is ignored.")
+                     % chunks.back().stop << std::endl;
+
+    ////////////// Merge //////////////
+    std::vector<CycleRecord> cycles;
+    std::map<uint16_t, SlaveStat> slaves;
+    uint64_t frames = 0, ethercatFrames = 0, datagrams = 0, wkcErrors = 0;
+    RxSync sync = SYNC_RX_SEEN; // the capture starts like a frame came back
+    for (auto &chunk: chunks) {
+        auto it = chunk.cycles.begin();
+        if (chunk.head && it != chunk.cycles.end()) {
+            if (!cycles.empty())
+                mergeCycle(cycles.back(), *it);
+            else
+                cycles.push_back(*it);
+            ++it;
+        }
+        // the previous chunk ended waiting for a frame to come back, no cycle start
+        if (chunk.tentative && sync == SYNC_TX_SENT && it != chunk.cycles.end() && !cycles.empty()) {
+            mergeCycle(cycles.back(), *it);
+            ++it;
+        }
+        if (chunk.sync != SYNC_UNKNOWN)
+            sync = chunk.sync;
+        cycles.insert(cycles.end(), it, chunk.cycles.end());
+        std::vector<CycleRecord>().swap(chunk.cycles);
+
+        for (auto &s: chunk.slaves) {
+            SlaveStat &slave = slaves[s.first];
+            slave.datagrams += s.second.datagrams;
+            slave.no_response += s.second.no_response;
+            slave.al_errors += s.second.al_errors;
+            if (s.second.al_status_code != 0)
+                slave.al_status_code = s.second.al_status_code;
+            slave.rx_errors = std::max(slave.rx_errors, s.second.rx_errors);
+        }
+        frames += chunk.frames;
+        ethercatFrames += chunk.ethercat_frames;
+        datagrams += chunk.datagrams;
+        wkcErrors += chunk.wkc_errors;
+    }
+    munmap(map, cap.size);
+
+    double decodeSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    ////////////// Per-cycle status, period and jitter //////////////
+    int64_t nominalNs = (int64_t) (FLAGS_cycle > 0 ? FLAGS_cycle : layout.cycle_time_us) * 1000;
+    if (nominalNs == 0 && cycles.size() > 2) { // median period
+        std::vector<int64_t> periods;
+        periods.reserve(cycles.size() - 1);
+        for (std::size_t i = 1; i < cycles.size(); ++i)
+            periods.push_back((int64_t) (cycles[i].time_ns - cycles[i - 1].time_ns));
+        std::nth_element(periods.begin(), periods.begin() + periods.size() / 2, periods.end());
+        nominalNs = periods[periods.size() / 2];
+    }
+
+    uint64_t lostCycles = 0, wkcCycles = 0, gapCycles = 0;
+    int64_t minPeriod = 0, maxPeriod = 0, maxJitter = 0, maxGap = 0;
+    double sumPeriod = 0.0, sumSqJitter = 0.0;
+    for (std::size_t i = 0; i < cycles.size(); ++i) {
+        CycleRecord &c = cycles[i];
+        if (c.rx_frames < c.tx_frames) {
+            c.status |= CYCLE_FRAME_LOST;
+            lostCycles++;
+        }
+        if (c.status & CYCLE_WKC_ERROR)
+            wkcCycles++;
+        if (i == 0) {
+            c.status |= CYCLE_PARTIAL;
+            continue;
+        }
+
+        c.period_ns = (int64_t) (c.time_ns - cycles[i - 1].time_ns);
+        if (i == 1 || c.period_ns < minPeriod)
+            minPeriod = c.period_ns;
+        maxPeriod = std::max(maxPeriod, c.period_ns);
+        sumPeriod += (double) c.period_ns;
+
+        int64_t jitter = c.period_ns - nominalNs;
+        maxJitter = std::max(maxJitter, std::abs(jitter));
+        sumSqJitter += (double) jitter * (double) jitter;
+        if (nominalNs > 0 && (double) c.period_ns > FLAGS_gap * (double) nominalNs) {
+            c.status |= CYCLE_GAP;
+            gapCycles++;
+            maxGap = std::max(maxGap, c.period_ns);
+        }
+    }
+    std::size_t periodNum = cycles.size() > 1 ? cycles.size() - 1 : 1;
+
+    ////////////// Output //////////////
+    std::cout << boost::format("[ANALYZE] %s: %d MiB in %.2f s (%.0f MiB/s), %d chunks on %d threads")
+                 % FLAGS_pcap % (cap.size >> 20) % decodeSec % ((double) cap.size / 1048576.0 / std::max(decodeSec, 1e-6))
+                 % chunks.size() % threadNum << std::endl;
+    std::cout << boost::format("[ANALYZE] %d frames (%d EtherCAT), %d datagrams received, %d with working counter error")
+                 % frames % ethercatFrames % datagrams % wkcErrors << std::endl;
+    std::cout << boost::format("[ANALYZE] %d cycles, %d with working counter error, %d with lost frames, %d gaps (max %.1f us)")
+                 % cycles.size() % wkcCycles % lostCycles % gapCycles % (maxGap / 1000.0) << std::endl;
+    std::cout << boost::format("[ANALYZE] period nominal %.1f us, min %.1f / avg %.1f / max %.1f us, "
+                               "jitter max %.1f us, std dev %.1f us")
+                 % (nominalNs / 1000.0) % (minPeriod / 1000.0) % (sumPeriod / periodNum / 1000.0) % (maxPeriod / 1000.0)
+                 % (maxJitter / 1000.0) % (std::sqrt(sumSqJitter / periodNum) / 1000.0) << std::endl;
+
+    for (auto &s: slaves) {
+        auto name = slaveNames.find(s.first);
+        std::cout << boost::format("[ANALYZE] slave %4d %-32s %10d datagrams, %8d no response, %6d AL errors, "
+                                   "AL status code 0x%04x, %5d port errors")
+                     % s.first % (name != slaveNames.end() ? name->second : std::string("-"))
+                     % s.second.datagrams % s.second.no_response % s.second.al_errors
+                     % s.second.al_status_code % s.second.rx_errors << std::endl;
+    }
+
+    if (!FLAGS_csv.empty()) {
+        std::ofstream csv(FLAGS_csv);
+        csv << "cycle,time_ns,period_ns,tx_frames,rx_frames,datagrams,wkc_errors,status\n";
+        for (std::size_t i = 0; i < cycles.size(); ++i) {
+            const CycleRecord &c = cycles[i];
+            csv << i << ',' << c.time_ns << ',' << c.period_ns << ',' << c.tx_frames << ',' << c.rx_frames
+                << ',' << c.datagrams << ',' << c.wkc_errors << ',' << c.status << '\n';
+        }
+        if (!csv)
+            std::cerr << "[ERROR] Can not write " << FLAGS_csv << "." << std::endl;
+    }
+
+    if (!FLAGS_bin.empty()) {
+        std::ofstream bin(FLAGS_bin, std::ios::binary);
+        CycleFileHeader header;
+        header.record_num = cycles.size();
+        header.nominal_cycle_ns = (uint64_t) nominalNs;
+        bin.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        bin.write(reinterpret_cast<const char *>(cycles.data()), (std::streamsize) (cycles.size() * sizeof(CycleRecord)));
+        if (!bin)
+            std::cerr << "[ERROR] Can not write " << FLAGS_bin << "." << std::endl;
+    }
+
+    return 0;
+}
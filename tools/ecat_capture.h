@@ -0,0 +1,135 @@
+/*-----------------------------------------------------------------------------
+ * ecat_capture.h
+ * Description              Decoding of recorded EtherCAT frames, shared by the
+ *                          offline tools
+ *---------------------------------------------------------------------------*/
+
+#ifndef ECAT_CAPTURE_H_INCLUDED
+#define ECAT_CAPTURE_H_INCLUDED
+
+#include "ecat_eni.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace rocos {
+namespace capture {
+
+    using namespace rocos::eni;
+
+    const uint16_t ETHERTYPE_ETHERCAT = 0x88a4;
+    const uint16_t ETHERTYPE_VLAN = 0x8100;
+
+    const uint32_t PCAP_MAGIC_USEC = 0xa1b2c3d4; // written by rocos_ecm
+    const uint32_t PCAP_MAGIC_NSEC = 0xa1b23c4d;
+
+#pragma pack(push, 1)
+    struct PcapFileHeader {
+        uint32_t magic;
+        uint16_t version_major;
+        uint16_t version_minor;
+        int32_t  thiszone;
+        uint32_t sigfigs;
+        uint32_t snaplen;
+        uint32_t linktype;
+    };
+
+    struct PcapPacketHeader {
+        uint32_t sec;
+        uint32_t usec; // nsec for PCAP_MAGIC_NSEC
+        uint32_t caplen;
+        uint32_t len;
+    };
+#pragma pack(pop)
+
+    inline bool isLogicalCommand(int cmd) {
+        return cmd == LRD || cmd == LWR || cmd == LRW;
+    }
+
+    inline bool isConfiguredAddressCommand(int cmd) {
+        return cmd == FPRD || cmd == FPWR || cmd == FPRW || cmd == FRMW;
+    }
+
+    //! ADP is incremented by every slave for auto increment and broadcast addressing
+    inline bool isPositionIndependent(int cmd) {
+        return cmd == APRD || cmd == APWR || cmd == APRW || cmd == ARMW || cmd == BRD || cmd == BWR || cmd == BRW;
+    }
+
+    inline bool isSameAddress(int cmd, uint32_t eniAddr, uint32_t addr) {
+        return isPositionIndependent(cmd) ? (eniAddr >> 16) == (addr >> 16) : eniAddr == addr;
+    }
+
+    inline uint16_t getWord(const uint8_t *p) {
+        return (uint16_t) (p[0] | (p[1] << 8));
+    }
+
+    inline uint32_t getDword(const uint8_t *p) {
+        return (uint32_t) getWord(p) | ((uint32_t) getWord(p + 2) << 16);
+    }
+
+    struct Datagram {
+        int            cmd    {NOP};
+        uint8_t        index  {0};
+        uint32_t       addr   {0};
+        int            length {0};
+        const uint8_t *data   {nullptr};
+        uint16_t       wkc    {0};
+    };
+
+    //! Index of the ENI cyclic command a datagram belongs to, -1 if it is acyclic
+    inline int findCyclicCmd(const BusLayout &layout, const Datagram &dg) {
+        for (std::size_t i = 0; i < layout.cmds.size(); ++i) {
+            const CyclicCmd &c = layout.cmds[i];
+            if (c.cmd == dg.cmd && c.length == dg.length && isSameAddress(dg.cmd, c.addr, dg.addr))
+                return (int) i;
+        }
+        return -1;
+    }
+
+    /** Call handler(const Datagram &) for every datagram of an EtherCAT frame.
+     *  Returned frames carry the locally administered bit in the source MAC, it is set by the first slave.
+     *  \return false if this is not an EtherCAT frame
+     */
+    template<typename Handler>
+    bool forEachDatagram(const uint8_t *frame, uint32_t size, bool &received, Handler handler) {
+        if (size < 14)
+            return false;
+
+        uint32_t pos = 12;
+        uint16_t etherType = (uint16_t) ((frame[pos] << 8) | frame[pos + 1]);
+        if (etherType == ETHERTYPE_VLAN && size >= 18) {
+            pos += 4;
+            etherType = (uint16_t) ((frame[pos] << 8) | frame[pos + 1]);
+        }
+        if (etherType != ETHERTYPE_ETHERCAT || size < pos + 4)
+            return false;
+        pos += 2;
+
+        received = (frame[6] & 0x02) != 0;
+        uint32_t end = std::min<uint32_t>(size, pos + 2 + (getWord(frame + pos) & 0x7ff));
+        pos += 2;
+
+        bool more = true;
+        while (more && pos + 12 <= end) {
+            Datagram dg;
+            dg.cmd = frame[pos];
+            dg.index = frame[pos + 1];
+            dg.addr = getDword(frame + pos + 2);
+            const uint16_t lenFlags = getWord(frame + pos + 6);
+            dg.length = lenFlags & 0x7ff;
+            dg.data = frame + pos + 10;
+            more = (lenFlags & 0x8000) != 0;
+            if (pos + 12 + dg.length > end)
+                break;
+            dg.wkc = getWord(frame + pos + 10 + dg.length);
+            pos += 12 + dg.length;
+
+            handler(dg);
+        }
+        return true;
+    }
+
+}
+}
+
+#endif //ECAT_CAPTURE_H_INCLUDED
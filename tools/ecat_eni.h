@@ -0,0 +1,203 @@
+/*-----------------------------------------------------------------------------
+ * ecat_eni.h
+ * Description              Bus layout from the ENI (cyclic commands, process
+ *                          image and slave table), shared by the offline tools
+ *                          and the simulator
+ *---------------------------------------------------------------------------*/
+
+#ifndef ECAT_ENI_H_INCLUDED
+#define ECAT_ENI_H_INCLUDED
+
+#include <ecat_type.h>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace rocos {
+namespace eni {
+
+    const uint16_t AL_STATUS_REGISTER = 0x130;
+
+    //! EtherCAT datagram commands, see ETG.1000.4
+    enum Command {
+        NOP = 0, APRD, APWR, APRW, FPRD, FPWR, FPRW, BRD, BWR, BRW, LRD, LWR, LRW, ARMW, FRMW
+    };
+
+    inline bool isReadCommand(int cmd) {
+        switch (cmd) {
+            case APRD: case APRW: case FPRD: case FPRW: case BRD: case BRW: case LRD: case LRW: case ARMW: case FRMW:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    inline bool isWriteCommand(int cmd) {
+        switch (cmd) {
+            case APWR: case APRW: case FPWR: case FPRW: case BWR: case BRW: case LWR: case LRW: case ARMW: case FRMW:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    //! ENI numbers are decimal, PDO and entry indices "#x1a00"
+    inline long parseNumber(const std::string &text) {
+        std::string s = boost::algorithm::trim_copy(text);
+        if (s.compare(0, 2, "#x") == 0)
+            return std::strtol(s.c_str() + 2, nullptr, 16);
+        return std::strtol(s.c_str(), nullptr, 10);
+    }
+
+    //! Cyclic command of the ENI, addr is the logical address or ADP | ADO << 16 as sent on the wire
+    struct CyclicCmd {
+        int      cmd          {NOP};
+        uint32_t addr         {0};
+        int      length       {0};
+        int      input_offs   {-1};
+        int      output_offs  {-1};
+        int      expected_wkc {-1}; // -1: not given in the ENI
+    };
+
+    struct BusLayout {
+        std::vector<CyclicCmd> cmds;
+        int input_size    {0};
+        int output_size   {0};
+        int al_status     {-1}; // index of the cyclic BRD of the AL status register
+        int cycle_time_us {0};  // 0: not given in the ENI
+    };
+
+    //! Cyclic commands of all <Cyclic> entries of EtherCATConfig.Config, in the order they are sent
+    inline void parseBusLayout(const boost::property_tree::ptree &config, BusLayout &layout) {
+        for (auto &cyclic: config) {
+            if (cyclic.first != "Cyclic")
+                continue;
+            if (layout.cycle_time_us == 0)
+                layout.cycle_time_us = (int) parseNumber(cyclic.second.get<std::string>("CycleTime", "0"));
+            for (auto &frame: cyclic.second) {
+                if (frame.first != "Frame")
+                    continue;
+                for (auto &node: frame.second) {
+                    if (node.first != "Cmd")
+                        continue;
+                    const auto &c = node.second;
+                    CyclicCmd cmd;
+                    cmd.cmd = (int) parseNumber(c.get<std::string>("Cmd", "0"));
+                    if (c.count("Addr"))
+                        cmd.addr = (uint32_t) parseNumber(c.get<std::string>("Addr"));
+                    else
+                        cmd.addr = (uint32_t) parseNumber(c.get<std::string>("Adp", "0"))
+                                   | ((uint32_t) parseNumber(c.get<std::string>("Ado", "0")) << 16);
+                    cmd.length = (int) parseNumber(c.get<std::string>("DataLength", "0"));
+                    cmd.input_offs = (int) parseNumber(c.get<std::string>("InputOffs", "-1"));
+                    cmd.output_offs = (int) parseNumber(c.get<std::string>("OutputOffs", "-1"));
+                    cmd.expected_wkc = (int) parseNumber(c.get<std::string>("Cnt", "-1"));
+
+                    if (cmd.cmd == BRD && (cmd.addr >> 16) == AL_STATUS_REGISTER)
+                        layout.al_status = (int) layout.cmds.size();
+                    layout.cmds.push_back(cmd);
+                }
+            }
+        }
+        layout.input_size = config.get<int>("ProcessImage.Inputs.ByteSize", 0);
+        layout.output_size = config.get<int>("ProcessImage.Outputs.ByteSize", 0);
+    }
+
+    inline void copyName(char *dst, std::size_t size, const std::string &src) {
+        std::memset(dst, '\0', size);
+        std::memcpy(dst, src.c_str(), std::min(size - 1, src.size()));
+    }
+
+    //! PDO entry index / subindex by entry name, only PDOs assigned to a sync manager
+    inline std::map<std::string, std::pair<uint16_t, uint8_t>>
+    parsePdoEntries(const boost::property_tree::ptree &processData, const char *pdoTag) {
+        std::vector<long> assigned;
+        for (auto &sm: processData) {
+            if (sm.first.compare(0, 2, "Sm") != 0)
+                continue;
+            for (auto &pdo: sm.second)
+                if (pdo.first == "Pdo")
+                    assigned.push_back(parseNumber(pdo.second.data()));
+        }
+
+        std::map<std::string, std::pair<uint16_t, uint8_t>> entries;
+        for (auto &pdo: processData) {
+            if (pdo.first != pdoTag)
+                continue;
+            long index = parseNumber(pdo.second.get<std::string>("Index", "0"));
+            if (std::find(assigned.begin(), assigned.end(), index) == assigned.end())
+                continue;
+            for (auto &entry: pdo.second) {
+                if (entry.first != "Entry" || !entry.second.count("Name"))
+                    continue;
+                entries[boost::algorithm::trim_copy(entry.second.get<std::string>("Name"))] =
+                        std::make_pair((uint16_t) parseNumber(entry.second.get<std::string>("Index", "0")),
+                                       (uint8_t) parseNumber(entry.second.get<std::string>("SubIndex", "0")));
+            }
+        }
+        return entries;
+    }
+
+    //! Add the process image variables of a slave, same naming as EcDemoApp myAppSetup()
+    inline int parseVars(const boost::property_tree::ptree &image, const std::string &prefix,
+                  const std::map<std::string, std::pair<uint16_t, uint8_t>> &entries,
+                  rocos::PdVar *vars, int maxVars) {
+        int num = 0;
+        for (auto &node: image) {
+            if (node.first != "Variable" || num >= maxVars)
+                continue;
+            std::string name = node.second.get<std::string>("Name", "");
+            if (name.compare(0, prefix.size(), prefix) != 0)
+                continue;
+
+            rocos::PdVar &var = vars[num++];
+            std::string shortName = name.substr(name.rfind('.') + 1);
+            copyName(var.name, sizeof(var.name), shortName);
+            var.offset = (int) parseNumber(node.second.get<std::string>("BitOffs", "0")) / 8;
+            var.size = (int) parseNumber(node.second.get<std::string>("BitSize", "0")) / 8;
+
+            auto it = entries.find(shortName);
+            if (it != entries.end()) {
+                var.index = it->second.first;
+                var.sub_index = it->second.second;
+            }
+        }
+        return num;
+    }
+
+    //! Slave table of the bus as filled by EcDemoApp myAppSetup() from the configured slaves
+    inline void parseSlaves(const boost::property_tree::ptree &config, rocos::EcatBus *bus) {
+        const auto &inputs = config.get_child("ProcessImage.Inputs");
+        const auto &outputs = config.get_child("ProcessImage.Outputs");
+
+        bus->slave_num = 0;
+        for (auto &node: config) {
+            if (node.first != "Slave" || bus->slave_num >= MAX_SLAVE_NUM)
+                continue;
+
+            rocos::Slave &slave = bus->slaves[bus->slave_num];
+            std::string name = node.second.get<std::string>("Info.Name", "");
+            copyName(slave.name, sizeof(slave.name), name);
+            slave.id = bus->slave_num++;
+
+            boost::property_tree::ptree empty;
+            const auto &processData = node.second.get_child("ProcessData", empty);
+            slave.input_var_num = parseVars(inputs, name + ".", parsePdoEntries(processData, "TxPdo"),
+                                            slave.input_vars, MAX_PDINPUT_NUM);
+            slave.output_var_num = parseVars(outputs, name + ".", parsePdoEntries(processData, "RxPdo"),
+                                             slave.output_vars, MAX_PDOUTPUT_NUM);
+        }
+    }
+
+}
+}
+
+#endif //ECAT_ENI_H_INCLUDED
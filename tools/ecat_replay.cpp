@@ -0,0 +1,204 @@
+/*-----------------------------------------------------------------------------
+ * ecat_replay.cpp
+ * Description              Offline replay of recorded EtherCAT frames
+ *
+ * Rebuilds the process images of every recorded bus cycle from a pcap file
+ * (--pcap of rocos_ecm, flight recorder dumps) and publishes them in the same
+ * shared memory a running master would create, so clients can be debugged
+ * without the bus. The cyclic commands and the process image layout are taken
+ * from the ENI the recording was made with.
+ *---------------------------------------------------------------------------*/
+
+#include <ecat_config_master.h>
+#include "ecat_capture.h"
+#include "ecat_eni.h"
+
+#include <gflags/gflags.h>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/xml_parser.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+DEFINE_int32(id, 0, "Ec-Master ID, the shared memory of this master is created");
+DEFINE_string(eni, "/opt/rocos/ecm/config/eni.xml", "Path to the ENI file the frames were recorded with.");
+DEFINE_string(pcap, "", "Recorded frames (pcap file).");
+DEFINE_bool(maxspeed, false, "Replay as fast as possible instead of at recorded speed.");
+DEFINE_int32(skip, 0, "Number of bus cycles to skip at the start of the recording.");
+
+namespace {
+
+    using namespace rocos::capture;
+    using namespace rocos::eni;
+
+    struct ReplayStat {
+        uint64_t frames           {0};
+        uint64_t ethercat_frames  {0};
+        uint64_t unknown_datagram {0};
+        uint64_t cycles           {0};
+        uint64_t skipped_cycles   {0};
+        uint64_t late_cycles      {0}; // recorded speed could not be kept
+    };
+
+    volatile std::sig_atomic_t bRun = 1;
+
+    void signalHandler(int) {
+        bRun = 0;
+    }
+
+    //! Rebuild the process images from one recorded frame
+    //! \return true if the frame closes a bus cycle (received frame with the last cyclic command)
+    bool processFrame(const uint8_t *frame, uint32_t size, const BusLayout &layout,
+                      EcatConfigMaster &master, ReplayStat &stat) {
+        bool received = false;
+        bool cycleDone = false;
+        bool isEtherCAT = forEachDatagram(frame, size, received, [&](const Datagram &dg) {
+            if (dg.cmd == NOP)
+                return;
+
+            int i = findCyclicCmd(layout, dg);
+            if (i < 0) {
+                stat.unknown_datagram++;
+                return;
+            }
+
+            const CyclicCmd &c = layout.cmds[i];
+            if (received && isReadCommand(dg.cmd) && c.input_offs >= 0 && c.input_offs + dg.length <= layout.input_size)
+                std::memcpy((char *) master.pdInputPtr + c.input_offs, dg.data, dg.length);
+            if (!received && isWriteCommand(dg.cmd) && c.output_offs >= 0 && c.output_offs + dg.length <= layout.output_size)
+                std::memcpy((char *) master.pdOutputPtr + c.output_offs, dg.data, dg.length);
+
+            if (received && i == layout.al_status)
+                master.ecatBus->current_state = getWord(dg.data) & 0x0f;
+            if (received && i + 1 == (int) layout.cmds.size())
+                cycleDone = true;
+        });
+        if (isEtherCAT)
+            stat.ethercat_frames++;
+        return cycleDone;
+    }
+
+}
+
+int main(int argc, char *argv[]) {
+    gflags::SetUsageMessage("Replay recorded EtherCAT frames into the shared memory of a master");
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+    if (FLAGS_pcap.empty()) {
+        std::cerr << "[ERROR] No recording given, use --pcap=<file>." << std::endl;
+        return 1;
+    }
+
+    ////////////// Bus layout from the ENI //////////////
+    boost::property_tree::ptree eni;
+    try {
+        boost::property_tree::read_xml(FLAGS_eni, eni);
+    } catch (std::exception &e) {
+        std::cerr << "[ERROR] Can not read ENI " << FLAGS_eni << ": " << e.what() << std::endl;
+        return 1;
+    }
+    const auto &config = eni.get_child("EtherCATConfig.Config");
+
+    BusLayout layout;
+    parseBusLayout(config, layout);
+    if (layout.cmds.empty()) {
+        std::cerr << "[ERROR] No cyclic commands in " << FLAGS_eni << "." << std::endl;
+        return 1;
+    }
+
+    ////////////// Recording //////////////
+    FILE *pcap = std::fopen(FLAGS_pcap.c_str(), "rb");
+    PcapFileHeader fileHeader{};
+    if (pcap == nullptr || std::fread(&fileHeader, sizeof(fileHeader), 1, pcap) != 1 || (fileHeader.magic != PCAP_MAGIC_USEC && fileHeader.magic != PCAP_MAGIC_NSEC)) {
+        std::cerr << "[ERROR] " << FLAGS_pcap << " is not a pcap file." << std::endl;
+        if (pcap != nullptr)
+            std::fclose(pcap);
+        return 1;
+    }
+
+    ////////////// Stand-in shared memory, same names as the master //////////////
+    EcatConfigMaster master(FLAGS_id);
+    if (!master.createSharedMemory()) {
+        std::fclose(pcap);
+        return 1;
+    }
+    master.createPdDataMemoryProvider(layout.input_size, layout.output_size);
+    parseSlaves(config, master.ecatBus);
+    master.ecatBus->cycle_count = 0;
+    master.ecatBus->current_state = ECAT_STATE_OP;
+    master.ecatBus->is_authorized = true;
+    master.publishGeneration();
+
+    std::cout << boost::format("[REPLAY] %s: %d slaves, %d cyclic commands, %d bytes in / %d bytes out, %s speed")
+                 % FLAGS_pcap % master.ecatBus->slave_num % layout.cmds.size() % layout.input_size
+                 % layout.output_size % (FLAGS_maxspeed ? "maximum" : "recorded") << std::endl;
+
+    std::signal(SIGINT, signalHandler);
+    std::signal(SIGTERM, signalHandler);
+
+    ReplayStat stat;
+    std::vector<uint8_t> frame(65536);
+    PcapPacketHeader packetHeader{};
+    long firstTime = -1;
+    long lastTime = -1;
+    auto start = std::chrono::steady_clock::now();
+
+    while (bRun && std::fread(&packetHeader, sizeof(packetHeader), 1, pcap) == 1) {
+        if (packetHeader.caplen > frame.size() || std::fread(frame.data(), 1, packetHeader.caplen, pcap) != packetHeader.caplen)
+            break;
+        stat.frames++;
+
+        if (!processFrame(frame.data(), packetHeader.caplen, layout, master, stat))
+            continue;
+
+        const long recordTime = (long) packetHeader.sec * 1000000 + // us
+                                 (fileHeader.magic == PCAP_MAGIC_NSEC ? packetHeader.usec / 1000 : packetHeader.usec);
+        if (stat.skipped_cycles < (uint64_t) FLAGS_skip) {
+            stat.skipped_cycles++;
+            continue;
+        }
+
+        if (firstTime < 0) {
+            firstTime = recordTime;
+            start = std::chrono::steady_clock::now();
+        }
+
+        if (!FLAGS_maxspeed) {
+            auto due = start + std::chrono::microseconds(recordTime - firstTime);
+            if (std::chrono::steady_clock::now() > due + std::chrono::microseconds(500))
+                stat.late_cycles++;
+            std::this_thread::sleep_until(due);
+        }
+
+        rocos::EcatBus *bus = master.ecatBus;
+        if (lastTime >= 0) {
+            double cycleTime = (double) (recordTime - lastTime);
+            bus->current_cycle_time = cycleTime;
+            if (stat.cycles == 1 || cycleTime < bus->min_cycle_time)
+                bus->min_cycle_time = cycleTime;
+            if (cycleTime > bus->max_cycle_time)
+                bus->max_cycle_time = cycleTime;
+            bus->avg_cycle_time = (double) (recordTime - firstTime) / (double) stat.cycles;
+        }
+        lastTime = recordTime;
+
+        bus->timestamp = recordTime; // recorded time, not the replay time
+        bus->cycle_count++;
+        stat.cycles++;
+
+        master.updateSempahore();
+    }
+    std::fclose(pcap);
+
+    std::cout << boost::format("[REPLAY] %d frames (%d EtherCAT), %d cycles replayed, %d skipped, %d late, "
+                               "%d datagrams not in the ENI")
+                 % stat.frames % stat.ethercat_frames % stat.cycles % stat.skipped_cycles % stat.late_cycles
+                 % stat.unknown_datagram << std::endl;
+
+    return stat.cycles > 0 ? 0 : 1;
+}
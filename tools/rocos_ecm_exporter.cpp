@@ -0,0 +1,665 @@
+/*-----------------------------------------------------------------------------
+ * rocos_ecm_exporter.cpp
+ * Description              OpenMetrics exporter of the master's shared memory
+ *
+ * Maps the bus segment and process data of a running master read-only and
+ * serves the bus state, cycle times, the process data variables of the slave
+ * table and the statistics regions (notifications, per slave diagnostics,
+ * client watchdogs, DC time series) as OpenMetrics text over a
+ * Unix domain socket and/or a localhost TCP port. The response is rendered
+ * every --interval msec into a reused buffer, a scrape only copies it to the
+ * socket. The master itself does no work for the exporter.
+ *---------------------------------------------------------------------------*/
+
+#include <ecat_shm.h>
+
+#include <gflags/gflags.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <poll.h>
+#include <sched.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+DEFINE_int32(id, 0, "Ec-Master ID whose shared memory is exported");
+DEFINE_string(socket, "/tmp/rocos_ecm_exporter.sock", "Unix domain socket to serve the metrics on, empty = off.");
+DEFINE_int32(port, 0, "Localhost TCP port to serve the metrics on (e.g. 9464), 0 = off.");
+DEFINE_int32(interval, 1000, "Msec between two renderings of the metrics.");
+DEFINE_bool(idle, true, "Run with SCHED_IDLE, the exporter only gets CPU time no other task wants.");
+
+namespace {
+
+    using namespace rocos;
+
+    volatile std::sig_atomic_t bRun = 1;
+
+    void signalHandler(int) {
+        bRun = 0;
+    }
+
+    //! Read-only view of the master's bus segment and process data, remapped when the master recreated it
+    class Segment {
+    public:
+        explicit Segment(int id) : name_(EC_SHM + std::to_string(id)), id_(std::to_string(id)) {}
+
+        //! (Re)map the segment if the master created a new one since the last call
+        //! \return false if no master is running
+        bool update() {
+            struct stat st{};
+            std::string path = hugePagePath(name_);
+            if (stat(path.c_str(), &st) != 0 && stat(shmPath(name_).c_str(), &st) != 0) {
+                reset();
+                return false;
+            }
+            if (segment_ && st.st_ino == inode_) {
+                if (pdInput_ == nullptr)
+                    pdInput = map("pd_input", pdInput_);
+                if (pdOutput_ == nullptr)
+                    pdOutput = map("pd_output", pdOutput_);
+                return bus != nullptr;
+            }
+
+            reset();
+            try {
+                segment_.reset(openSegmentReadOnly(name_));
+            } catch (std::exception &e) {
+                return false;
+            }
+            inode_ = st.st_ino;
+            bus = find<EcatBus>("ecat");
+            watchdog = find<Watchdog>("watchdog");
+            ownership = find<OutputOwnership>("ownership");
+            notificationStat = find<NotificationStat>("notifications");
+            eventRing = find<EventRing>("events");
+            diagnostics = find<EcatDiagnostics>("diagnostics");
+            dcTimeSeries = find<DcTimeSeries>("dc");
+            layout = find<EcatLayout>("layout");
+            startup = find<StartupTimings>("startup");
+            // the process data regions are created after the segment, rendered from the next update on if missing
+            pdInput = map("pd_input", pdInput_);
+            pdOutput = map("pd_output", pdOutput_);
+            attaches++;
+            return bus != nullptr;
+        }
+
+        const EcatBus *bus {nullptr};
+        const Watchdog *watchdog {nullptr};
+        const OutputOwnership *ownership {nullptr};
+        const NotificationStat *notificationStat {nullptr};
+        const EventRing *eventRing {nullptr};
+        const EcatDiagnostics *diagnostics {nullptr};
+        const DcTimeSeries *dcTimeSeries {nullptr};
+        const EcatLayout *layout {nullptr};
+        const StartupTimings *startup {nullptr};
+        const char *pdInput {nullptr};
+        const char *pdOutput {nullptr};
+        uint64_t attaches {0};
+
+        //! Size of a mapped process data region
+        std::size_t pdInputSize() const {
+            return pdInput_ ? pdInput_->get_size() : 0;
+        }
+
+        std::size_t pdOutputSize() const {
+            return pdOutput_ ? pdOutput_->get_size() : 0;
+        }
+
+    private:
+        template<typename T>
+        const T *find(const char *name) {
+            return segment_->get_segment_manager()->find_no_lock<T>(name).first;
+        }
+
+        const char *map(const char *name, std::unique_ptr<boost::interprocess::mapped_region> &region) {
+            std::size_t pageSize = 0;
+            try {
+                region.reset(openRegionReadOnly(name + id_, pageSize));
+            } catch (std::exception &e) {
+                region.reset();
+                return nullptr;
+            }
+            return static_cast<const char *>(region->get_address());
+        }
+
+        void reset() {
+            segment_.reset();
+            pdInput_.reset();
+            pdOutput_.reset();
+            pdInput = nullptr;
+            pdOutput = nullptr;
+            inode_ = 0;
+            bus = nullptr;
+            watchdog = nullptr;
+            ownership = nullptr;
+            notificationStat = nullptr;
+            eventRing = nullptr;
+            diagnostics = nullptr;
+            dcTimeSeries = nullptr;
+            layout = nullptr;
+            startup = nullptr;
+        }
+
+        std::string name_;
+        std::string id_;
+        std::unique_ptr<boost::interprocess::managed_mapped_file> segment_;
+        std::unique_ptr<boost::interprocess::mapped_region> pdInput_;
+        std::unique_ptr<boost::interprocess::mapped_region> pdOutput_;
+        ino_t inode_ {0};
+    };
+
+    //! OpenMetrics text, appended into a buffer whose capacity is kept between renderings
+    class Writer {
+    public:
+        void clear() {
+            text_.clear();
+        }
+
+        const std::string &text() const {
+            return text_;
+        }
+
+        void family(const char *name, const char *type, const char *help, const char *unit = nullptr) {
+            append("# TYPE %s %s\n", name, type);
+            if (unit != nullptr)
+                append("# UNIT %s %s\n", name, unit);
+            append("# HELP %s %s\n", name, help);
+        }
+
+        void sample(const char *name, const char *labels, double value) {
+            append("%s%s%s%s %.9g\n", name, *labels ? "{" : "", labels, *labels ? "}" : "", value);
+        }
+
+        void sample(const char *name, const char *labels, uint64_t value) {
+            append("%s%s%s%s %llu\n", name, *labels ? "{" : "", labels, *labels ? "}" : "",
+                   (unsigned long long) value);
+        }
+
+        void gauge(const char *name, const char *help, double value, const char *unit = nullptr) {
+            family(name, "gauge", help, unit);
+            sample(name, "", value);
+        }
+
+        void counter(const char *name, const char *help, uint64_t value) {
+            family(name, "counter", help);
+            sample(total(name), "", value);
+        }
+
+        //! name + "_total", valid until the next call
+        const char *total(const char *name) {
+            name_.assign(name).append("_total");
+            return name_.c_str();
+        }
+
+        //! Lines longer than the stack buffer are formatted a second time straight into the text, never cut
+        void append(const char *fmt, ...) __attribute__((format(printf, 2, 3))) {
+            char line[512];
+            va_list args, again;
+            va_start(args, fmt);
+            va_copy(again, args);
+            int n = std::vsnprintf(line, sizeof(line), fmt, args);
+            if (n >= (int) sizeof(line)) {
+                const std::size_t end = text_.size();
+                text_.resize(end + (std::size_t) n + 1);
+                std::vsnprintf(&text_[end], (std::size_t) n + 1, fmt, again);
+                text_.resize(end + (std::size_t) n);
+            } else if (n > 0) {
+                text_.append(line, (std::size_t) n);
+            }
+            va_end(again);
+            va_end(args);
+        }
+
+    private:
+        std::string text_;
+        std::string name_;
+    };
+
+    //! snprintf of the labels of a sample, false if they did not fit: the sample is skipped then, never exported
+    //! with a cut label set
+    __attribute__((format(printf, 3, 4)))
+    bool formatLabels(char *labels, std::size_t size, const char *fmt, ...) {
+        va_list args;
+        va_start(args, fmt);
+        int n = std::vsnprintf(labels, size, fmt, args);
+        va_end(args);
+        return n >= 0 && (std::size_t) n < size;
+    }
+
+    constexpr std::size_t INT_DIGITS = 11; // "-2147483648"
+
+    //! Copy of a label value with \, " and newlines escaped
+    void escapeLabel(const char *in, char *out, std::size_t size) {
+        std::size_t n = 0;
+        for (; *in != '\0' && n + 2 < size; ++in) {
+            if (*in == '\\' || *in == '"' || *in == '\n') {
+                out[n++] = '\\';
+                out[n++] = *in == '\n' ? 'n' : *in;
+            } else {
+                out[n++] = *in;
+            }
+        }
+        out[n] = '\0';
+    }
+
+    inline uint64_t load(const uint64_t &value) {
+        return __atomic_load_n(&value, __ATOMIC_RELAXED);
+    }
+
+    void renderBus(Writer &w, const EcatBus &bus) {
+        w.counter("rocos_ecm_cycles", "Bus cycles since the master started.", (uint64_t) bus.cycle_count);
+        w.gauge("rocos_ecm_timestamp_seconds", "Start time of the last bus cycle (UNIX time).",
+                (double) bus.timestamp * 1e-6, "seconds");
+
+        w.family("rocos_ecm_cycle_time_seconds", "gauge", "Bus cycle time measured by the master.", "seconds");
+        w.sample("rocos_ecm_cycle_time_seconds", "stat=\"current\"", bus.current_cycle_time * 1e-6);
+        w.sample("rocos_ecm_cycle_time_seconds", "stat=\"min\"", bus.min_cycle_time * 1e-6);
+        w.sample("rocos_ecm_cycle_time_seconds", "stat=\"avg\"", bus.avg_cycle_time * 1e-6);
+        w.sample("rocos_ecm_cycle_time_seconds", "stat=\"max\"", bus.max_cycle_time * 1e-6);
+        w.gauge("rocos_ecm_cycle_jitter_seconds", "Spread of the bus cycle time (max - min).",
+                (bus.max_cycle_time - bus.min_cycle_time) * 1e-6, "seconds");
+
+        w.gauge("rocos_ecm_state", "Current master state (1 INIT, 2 PREOP, 3 BOOTSTRAP, 4 SAFEOP, 8 OP).",
+                bus.current_state);
+        w.gauge("rocos_ecm_request_state", "Master state requested by the clients.", bus.request_state);
+        w.gauge("rocos_ecm_authorized", "1 if the master runs with a license.", bus.is_authorized ? 1 : 0);
+        w.gauge("rocos_ecm_slaves", "Slaves in the configuration.", bus.slave_num);
+        w.counter("rocos_ecm_capture_requests", "Flight recorder dumps requested by clients.", bus.capture_request);
+    }
+
+    void renderNotifications(Writer &w, const NotificationStat &stat) {
+        char labels[sizeof("code=\"0x\",station=\"\"") + 2 * INT_DIGITS];
+        w.family("rocos_ecm_notifications", "counter", "Error notifications of the master by code.");
+        for (int i = 0; i < MAX_NOTIFY_CODES; ++i) {
+            uint64_t count = load(stat.error_count[i]);
+            if (count == 0)
+                continue;
+            if (!formatLabels(labels, sizeof(labels), "code=\"0x%x\"", 0x00010000u | (unsigned) i))
+                continue;
+            w.sample(w.total("rocos_ecm_notifications"), labels, count);
+        }
+        w.family("rocos_ecm_slave_notifications", "counter", "Notifications by code and slave.");
+        for (const NotifyCount &entry: stat.entries) {
+            if (load(entry.key) == 0)
+                continue;
+            if (!formatLabels(labels, sizeof(labels), "code=\"0x%x\",station=\"%u\"", entry.code,
+                              (unsigned) entry.station_address))
+                continue;
+            w.sample(w.total("rocos_ecm_slave_notifications"), labels, load(entry.count));
+        }
+        w.counter("rocos_ecm_notifications_filtered", "Notifications dropped by --notifyfilter.",
+                  load(stat.filtered));
+        w.counter("rocos_ecm_notifications_suppressed", "Notifications not logged because of --notifyrate.",
+                  load(stat.suppressed));
+        w.counter("rocos_ecm_notification_entries_full", "Notifications not counted per slave, table full.",
+                  load(stat.entries_full));
+    }
+
+    void renderDiagnostics(Writer &w, const EcatBus &bus, const Slave *slaves, const EcatDiagnostics &diag) {
+        w.counter("rocos_ecm_cyclic_wkc_errors", "Cyclic commands with a wrong working counter.",
+                  load(diag.cyclic_wkc_errors));
+        w.counter("rocos_ecm_cyclic_frame_losses", "Cyclic frames without response.",
+                  load(diag.cyclic_frame_losses));
+
+        struct Field {
+            const char *name;
+            const char *type;
+            const char *help;
+            uint64_t (*get)(const SlaveDiagnostics &);
+        };
+        static const Field fields[] = {
+                {"rocos_ecm_slave_state", "gauge", "Slave state (ECAT_STATE_xxx).",
+                        [](const SlaveDiagnostics &s) { return (uint64_t) s.state; }},
+                {"rocos_ecm_slave_al_status_code", "gauge", "Last AL status code of the slave.",
+                        [](const SlaveDiagnostics &s) { return (uint64_t) s.al_status_code; }},
+                {"rocos_ecm_slave_wkc_errors", "counter", "Cycles the process data of the slave was invalid.",
+                        [](const SlaveDiagnostics &s) { return load(s.wkc_errors); }},
+                {"rocos_ecm_slave_frame_losses", "counter", "Frames lost behind the slave.",
+                        [](const SlaveDiagnostics &s) { return load(s.frame_losses); }},
+                {"rocos_ecm_slave_al_status_errors", "counter", "AL status errors of the slave.",
+                        [](const SlaveDiagnostics &s) { return load(s.al_status_errors); }},
+                {"rocos_ecm_slave_state_changes", "counter", "State changes of the slave.",
+                        [](const SlaveDiagnostics &s) { return load(s.state_changes); }},
+                {"rocos_ecm_slave_unexpected_states", "counter", "Slave left the state requested by the master.",
+                        [](const SlaveDiagnostics &s) { return load(s.unexpected_states); }},
+                {"rocos_ecm_slave_mailbox_errors", "counter", "Mailbox errors of the slave.",
+                        [](const SlaveDiagnostics &s) { return load(s.mailbox_errors); }},
+                {"rocos_ecm_slave_pdi_watchdogs", "counter", "PDI watchdog expirations of the slave.",
+                        [](const SlaveDiagnostics &s) { return load(s.pdi_watchdogs); }},
+        };
+
+        const int slaveNum = std::max(0, std::min(bus.slave_num, MAX_SLAVE_NUM));
+        char name[2 * MAX_SLAVE_NAME_LEN + 1];
+        char labels[sizeof("slave=\"\",station=\"\",name=\"\"") + 2 * INT_DIGITS + sizeof(name)];
+        for (const Field &field: fields) {
+            const bool isCounter = field.type[0] == 'c';
+            w.family(field.name, field.type, field.help);
+            for (int i = 0; i < slaveNum; ++i) {
+                char slaveName[MAX_SLAVE_NAME_LEN + 1] {};
+                std::memcpy(slaveName, slaves[i].name, MAX_SLAVE_NAME_LEN);
+                escapeLabel(slaveName, name, sizeof(name));
+                if (!formatLabels(labels, sizeof(labels), "slave=\"%d\",station=\"%d\",name=\"%s\"", i,
+                                  diag.slaves[i].station_address, name))
+                    continue;
+                w.sample(isCounter ? w.total(field.name) : field.name, labels, field.get(diag.slaves[i]));
+            }
+        }
+    }
+
+    void renderWatchdog(Writer &w, const Watchdog &watchdog, const OutputOwnership &ownership) {
+        char labels[sizeof("client=\"\",pid=\"\"") + 2 * INT_DIGITS];
+        int clients = 0;
+        for (const ClientWatchdog &client: watchdog.clients)
+            clients += client.pid != 0 ? 1 : 0;
+        w.gauge("rocos_ecm_clients", "Client processes holding a watchdog slot.", clients);
+        w.gauge("rocos_ecm_output_ranges", "pd_output ranges owned by clients.", ownership.range_num);
+
+        w.family("rocos_ecm_client_tripped", "gauge", "1 if the watchdog applied the safe outputs of the client.");
+        for (int i = 0; i < MAX_CLIENT_NUM; ++i) {
+            if (watchdog.clients[i].pid == 0 ||
+                !formatLabels(labels, sizeof(labels), "client=\"%d\",pid=\"%d\"", i, watchdog.clients[i].pid))
+                continue;
+            w.sample("rocos_ecm_client_tripped", labels, watchdog.clients[i].tripped ? 1.0 : 0.0);
+        }
+        w.family("rocos_ecm_client_trips", "counter", "Watchdog trips of the client.");
+        for (int i = 0; i < MAX_CLIENT_NUM; ++i) {
+            if (watchdog.clients[i].pid == 0 ||
+                !formatLabels(labels, sizeof(labels), "client=\"%d\",pid=\"%d\"", i, watchdog.clients[i].pid))
+                continue;
+            w.sample(w.total("rocos_ecm_client_trips"), labels, (uint64_t) watchdog.clients[i].trip_count);
+        }
+        w.family("rocos_ecm_client_reaction_time_seconds", "gauge",
+                 "Longest time from cycle start to the safe outputs of the client.", "seconds");
+        for (int i = 0; i < MAX_CLIENT_NUM; ++i) {
+            if (watchdog.clients[i].pid == 0 ||
+                !formatLabels(labels, sizeof(labels), "client=\"%d\",pid=\"%d\"", i, watchdog.clients[i].pid))
+                continue;
+            w.sample("rocos_ecm_client_reaction_time_seconds", labels, watchdog.clients[i].max_reaction_time * 1e-6);
+        }
+    }
+
+    void renderDc(Writer &w, const DcTimeSeries &dc) {
+        const uint64_t count = __atomic_load_n(&dc.write_pos, __ATOMIC_ACQUIRE);
+        w.gauge("rocos_ecm_dcm_mode", "DCM mode (--dcmmode).", dc.dcm_mode);
+        w.counter("rocos_ecm_dc_out_of_sync", "DCM samples with the controller out of sync.", load(dc.out_of_sync));
+        w.gauge("rocos_ecm_dc_deviation_min_seconds", "Smallest DCM deviation of all samples.",
+                dc.min_diff * 1e-9, "seconds");
+        w.gauge("rocos_ecm_dc_deviation_max_seconds", "Largest DCM deviation of all samples.",
+                dc.max_diff * 1e-9, "seconds");
+        if (count > 0) {
+            const DcSample &last = dc.samples[(count - 1) % MAX_DC_SAMPLES];
+            w.gauge("rocos_ecm_dc_deviation_seconds", "Current DCM deviation of the last sample.",
+                    last.diff_cur * 1e-9, "seconds");
+        }
+
+        // the histogram of the master has DC_HISTOGRAM_BUCKETS linear buckets, exported with power of 2 bounds
+        w.family("rocos_ecm_dc_abs_deviation_seconds", "histogram", "Absolute DCM deviation.", "seconds");
+        char labels[64];
+        uint64_t cumulative = 0;
+        int next = 1;
+        for (int i = 0; i < DC_HISTOGRAM_BUCKETS - 1; ++i) {
+            cumulative += load(dc.histogram[i]);
+            if (i + 1 != next)
+                continue;
+            next *= 2;
+            if (!formatLabels(labels, sizeof(labels), "le=\"%.9g\"", (i + 1) * DC_HISTOGRAM_RESOLUTION * 1e-9))
+                continue;
+            w.sample("rocos_ecm_dc_abs_deviation_seconds_bucket", labels, cumulative);
+        }
+        cumulative += load(dc.histogram[DC_HISTOGRAM_BUCKETS - 1]);
+        w.sample("rocos_ecm_dc_abs_deviation_seconds_bucket", "le=\"+Inf\"", cumulative);
+        w.sample("rocos_ecm_dc_abs_deviation_seconds_count", "", cumulative);
+    }
+
+    void renderLayout(Writer &w, const EcatBus &bus, const EcatLayout &layout) {
+        w.gauge("rocos_ecm_layout_version", "Slave tables switched to since master start (hot connect).",
+                (double) __atomic_load_n(&layout.version, __ATOMIC_ACQUIRE));
+        const uint64_t present = __atomic_load_n(&layout.present_mask, __ATOMIC_ACQUIRE);
+        char labels[sizeof("slave=\"\"") + INT_DIGITS];
+        w.family("rocos_ecm_slave_present", "gauge", "1 if the slave is connected.");
+        for (int i = 0; i < std::min(bus.slave_num, MAX_SLAVE_NUM); ++i) {
+            if (!formatLabels(labels, sizeof(labels), "slave=\"%d\"", i))
+                continue;
+            w.sample("rocos_ecm_slave_present", labels, (present >> i) & 1 ? 1.0 : 0.0);
+        }
+    }
+
+    //! Process data variables of 1, 2, 4 or 8 byte as signed little endian integers, other sizes are not exported
+    void renderProcessData(Writer &w, const char *family, const char *help, const EcatBus &bus, const Slave *slaves,
+                           bool inputs, const char *image, std::size_t imageSize) {
+        char slaveName[2 * MAX_SLAVE_NAME_LEN + 1];
+        char varName[2 * MAX_PD_NAME_LEN + 1];
+        char labels[sizeof("slave=\"\",name=\"\",var=\"\"") + INT_DIGITS + sizeof(slaveName) + sizeof(varName)];
+        w.family(family, "gauge", help);
+        for (int i = 0; i < std::max(0, std::min(bus.slave_num, MAX_SLAVE_NUM)); ++i) {
+            const Slave &slave = slaves[i];
+            const int varNum = inputs ? std::min(slave.input_var_num, MAX_PDINPUT_NUM)
+                                      : std::min(slave.output_var_num, MAX_PDOUTPUT_NUM);
+            char name[MAX_SLAVE_NAME_LEN + 1] {};
+            std::memcpy(name, slave.name, MAX_SLAVE_NAME_LEN);
+            escapeLabel(name, slaveName, sizeof(slaveName));
+            for (int j = 0; j < varNum; ++j) {
+                const PdVar &var = inputs ? slave.input_vars[j] : slave.output_vars[j];
+                if (var.offset < 0 || (std::size_t) var.offset + (std::size_t) std::max(var.size, 0) > imageSize)
+                    continue;
+                int64_t value;
+                switch (var.size) {
+                    case 1: { int8_t v; std::memcpy(&v, image + var.offset, sizeof(v)); value = v; break; }
+                    case 2: { int16_t v; std::memcpy(&v, image + var.offset, sizeof(v)); value = v; break; }
+                    case 4: { int32_t v; std::memcpy(&v, image + var.offset, sizeof(v)); value = v; break; }
+                    case 8: { std::memcpy(&value, image + var.offset, sizeof(value)); break; }
+                    default: continue;
+                }
+                char pdName[MAX_PD_NAME_LEN + 1] {};
+                std::memcpy(pdName, var.name, MAX_PD_NAME_LEN);
+                escapeLabel(pdName, varName, sizeof(varName));
+                if (!formatLabels(labels, sizeof(labels), "slave=\"%d\",name=\"%s\",var=\"%s\"", i, slaveName, varName))
+                    continue;
+                w.sample(family, labels, (double) value);
+            }
+        }
+    }
+
+    void renderStartup(Writer &w, const StartupTimings &startup) {
+        const long reached = __atomic_load_n(&startup.reached, __ATOMIC_ACQUIRE);
+        if (reached < 0)
+            return; // still starting, the phases are incomplete
+        w.gauge("rocos_ecm_startup_seconds", "Time from master process start until the bus reached the requested state.",
+                (double) reached * 1e-6, "seconds");
+        char name[2 * MAX_STARTUP_PHASE_NAME + 1];
+        char labels[sizeof("index=\"\",phase=\"\"") + INT_DIGITS + sizeof(name)];
+        w.family("rocos_ecm_startup_phase_seconds", "gauge", "Duration of a start-up phase of the master.", "seconds");
+        for (int i = 0; i < std::min(startup.phase_num, MAX_STARTUP_PHASES); ++i) {
+            const StartupPhase &phase = startup.phases[i];
+            if (phase.end < 0)
+                continue;
+            char phaseName[MAX_STARTUP_PHASE_NAME + 1] {};
+            std::memcpy(phaseName, phase.name, MAX_STARTUP_PHASE_NAME);
+            escapeLabel(phaseName, name, sizeof(name));
+            if (!formatLabels(labels, sizeof(labels), "index=\"%d\",phase=\"%s\"", i, name))
+                continue;
+            w.sample("rocos_ecm_startup_phase_seconds", labels, (double) (phase.end - phase.begin) * 1e-6);
+        }
+    }
+
+    void render(Writer &w, Segment &segment, const std::chrono::steady_clock::duration &renderTime) {
+        w.clear();
+        const bool up = segment.update();
+        w.gauge("rocos_ecm_up", "1 if the shared memory of the master is mapped.", up ? 1 : 0);
+        w.counter("rocos_ecm_exporter_attaches", "Times the exporter mapped a new shared memory of the master.",
+                  segment.attaches);
+        w.gauge("rocos_ecm_exporter_render_seconds", "Time the previous rendering of the metrics took.",
+                std::chrono::duration<double>(renderTime).count(), "seconds");
+        if (up) {
+            renderBus(w, *segment.bus);
+            if (segment.notificationStat)
+                renderNotifications(w, *segment.notificationStat);
+            if (segment.eventRing)
+                w.counter("rocos_ecm_events", "Events posted to the event ring.",
+                          __atomic_load_n(&segment.eventRing->write_pos, __ATOMIC_RELAXED));
+            const Slave *slaves = activeSlaves(segment.bus, segment.layout);
+            if (segment.diagnostics)
+                renderDiagnostics(w, *segment.bus, slaves, *segment.diagnostics);
+            if (segment.pdInput)
+                renderProcessData(w, "rocos_ecm_pd_input", "Process data input variable of a slave.", *segment.bus,
+                                  slaves, true, segment.pdInput, segment.pdInputSize());
+            if (segment.pdOutput)
+                renderProcessData(w, "rocos_ecm_pd_output", "Process data output variable of a slave.", *segment.bus,
+                                  slaves, false, segment.pdOutput, segment.pdOutputSize());
+            if (segment.watchdog && segment.ownership)
+                renderWatchdog(w, *segment.watchdog, *segment.ownership);
+            if (segment.dcTimeSeries)
+                renderDc(w, *segment.dcTimeSeries);
+            if (segment.layout)
+                renderLayout(w, *segment.bus, *segment.layout);
+            if (segment.startup)
+                renderStartup(w, *segment.startup);
+        }
+        w.append("# EOF\n");
+    }
+
+    int listenUnix(const std::string &path) {
+        sockaddr_un addr{};
+        if (path.size() >= sizeof(addr.sun_path))
+            return -1;
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            return -1;
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        unlink(path.c_str());
+        if (bind(fd, (sockaddr *) &addr, sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    int listenTcp(int port) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            return -1;
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t) port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // never exposed beyond the host
+        if (bind(fd, (sockaddr *) &addr, sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    //! Answer one scrape with the last rendered metrics, the request itself is not parsed
+    void serve(int listenFd, const std::string &header, const std::string &body) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0)
+            return;
+        timeval timeout{0, 100000};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        char request[1024];
+        (void) recv(fd, request, sizeof(request), 0);
+
+        iovec iov[2] = {{(void *) header.data(), header.size()}, {(void *) body.data(), body.size()}};
+        msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = 2;
+        (void) sendmsg(fd, &msg, MSG_NOSIGNAL);
+        close(fd);
+    }
+
+}
+
+int main(int argc, char *argv[]) {
+    gflags::SetUsageMessage("Serve the shared memory of a master as OpenMetrics");
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+    if (FLAGS_idle) {
+        sched_param param{};
+        if (sched_setscheduler(0, SCHED_IDLE, &param) != 0)
+            std::cerr << "[WARNING] Can not switch to SCHED_IDLE: " << std::strerror(errno) << std::endl;
+    }
+
+    pollfd fds[2];
+    nfds_t fdNum = 0;
+    if (!FLAGS_socket.empty()) {
+        int fd = listenUnix(FLAGS_socket);
+        if (fd < 0) {
+            std::cerr << "[ERROR] Can not listen on " << FLAGS_socket << ": " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+        fds[fdNum++] = {fd, POLLIN, 0};
+    }
+    if (FLAGS_port > 0) {
+        int fd = listenTcp(FLAGS_port);
+        if (fd < 0) {
+            std::cerr << "[ERROR] Can not listen on 127.0.0.1:" << FLAGS_port << ": " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+        fds[fdNum++] = {fd, POLLIN, 0};
+    }
+    if (fdNum == 0) {
+        std::cerr << "[ERROR] Nothing to serve on, use --socket=<path> or --port=<port>." << std::endl;
+        return 1;
+    }
+
+    std::signal(SIGINT, signalHandler);
+    std::signal(SIGTERM, signalHandler);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::cout << boost::format("[EXPORTER] Ec-Master %d on %s%s%s, rendered every %d msec")
+                 % FLAGS_id % FLAGS_socket % (!FLAGS_socket.empty() && FLAGS_port > 0 ? " and " : "")
+                 % (FLAGS_port > 0 ? "127.0.0.1:" + std::to_string(FLAGS_port) : std::string())
+                 % FLAGS_interval << std::endl;
+
+    Segment segment(FLAGS_id);
+    Writer writer;
+    std::string header;
+    std::chrono::steady_clock::duration renderTime{0};
+    auto nextRender = std::chrono::steady_clock::now();
+
+    while (bRun) {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= nextRender) {
+            render(writer, segment, renderTime);
+            renderTime = std::chrono::steady_clock::now() - now;
+            header = (boost::format("HTTP/1.0 200 OK\r\n"
+                                    "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+                                    "Content-Length: %d\r\nConnection: close\r\n\r\n") % writer.text().size()).str();
+            nextRender = now + std::chrono::milliseconds(std::max(1, FLAGS_interval));
+        }
+
+        int timeout = (int) std::chrono::duration_cast<std::chrono::milliseconds>(
+                nextRender - std::chrono::steady_clock::now()).count();
+        if (poll(fds, fdNum, std::max(0, timeout)) <= 0)
+            continue;
+        for (nfds_t i = 0; i < fdNum; ++i) {
+            if (fds[i].revents & POLLIN)
+                serve(fds[i].fd, header, writer.text());
+        }
+    }
+
+    for (nfds_t i = 0; i < fdNum; ++i)
+        close(fds[i].fd);
+    if (!FLAGS_socket.empty())
+        unlink(FLAGS_socket.c_str());
+    return 0;
+}
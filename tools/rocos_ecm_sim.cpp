@@ -0,0 +1,638 @@
+/*-----------------------------------------------------------------------------
+ * rocos_ecm_sim.cpp
+ * Description              Hardware-free stand-in for rocos_ecm
+ *
+ * Reads the ENI, creates the shared memory and semaphores exactly as the real
+ * master (EcatConfigMaster) and cycles at --cycle with simple slave models:
+ *   - DS402 drives (slaves with Control word / Status word) run the CiA 402
+ *     state machine and follow the targets in CSP, CSV and CST
+ *   - all other slaves loop their output bytes back to their inputs
+ * Master state handling (--state, request_state), timestamp, cycle count and
+ * cycle time statistics follow EcDemoApp, so clients run unchanged. Accepts the
+ * flags and flagfile of rocos_ecm, options without meaning here are ignored.
+ *---------------------------------------------------------------------------*/
+
+#include <ecat_config_master.h>
+#include <ecat_shm.h>
+#include "EcFlags.h"
+#include "ecat_eni.h"
+
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/xml_parser.hpp>
+
+#include <atomic>
+#include <cmath>
+#include <cctype>
+#include <csignal>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+#include <strings.h>
+#include <sys/time.h>
+#include <time.h>
+
+DEFINE_int32(simstatedelay, 100, "Simulator: time in msec each EtherCAT state transition takes. The default is 100.");
+DEFINE_double(siminertia, 1000.0, "Simulator: acceleration of a drive in CST in counts/s^2 per 1/1000 of rated torque. The default is 1000.");
+
+namespace {
+
+    using namespace rocos::eni;
+
+    //! Process data variable of one slave, offset -1 if not mapped
+    struct PdRef {
+        int offset {-1};
+        int size   {0};
+    };
+
+    int64_t readVar(const void *base, const PdRef &var) {
+        int64_t value = 0;
+        if (var.offset < 0 || var.size <= 0 || var.size > (int) sizeof(value))
+            return 0;
+        std::memcpy(&value, (const char *) base + var.offset, var.size);
+        if (var.size < (int) sizeof(value) && (value >> (var.size * 8 - 1)) & 1) // sign extension
+            value |= -((int64_t) 1 << (var.size * 8));
+        return value;
+    }
+
+    void writeVar(void *base, const PdRef &var, int64_t value) {
+        if (var.offset < 0 || var.size <= 0 || var.size > (int) sizeof(value))
+            return;
+        std::memcpy((char *) base + var.offset, &value, var.size); // little endian, same as EtherCAT
+    }
+
+    // compare PD variable names ignoring case, blanks and underscores, e.g. "Control word" == "Controlword"
+    bool isSameVarName(const char *name, const char *key) {
+        while (*name != '\0' || *key != '\0') {
+            if (*name == ' ' || *name == '_') {
+                ++name;
+                continue;
+            }
+            if (std::tolower(*name) != std::tolower(*key))
+                return false;
+            ++name;
+            ++key;
+        }
+        return true;
+    }
+
+    PdRef findVar(const rocos::PdVar *vars, int num, const char *key) {
+        PdRef ref;
+        for (int i = 0; i < num; ++i) {
+            if (isSameVarName(vars[i].name, key)) {
+                ref.offset = vars[i].offset;
+                ref.size = vars[i].size;
+                break;
+            }
+        }
+        return ref;
+    }
+
+    //! CiA 402 drive, states as in the status word (bits 0..6)
+    class Ds402Drive {
+    public:
+        enum State {
+            SWITCH_ON_DISABLED, READY_TO_SWITCH_ON, SWITCHED_ON, OPERATION_ENABLED, QUICK_STOP_ACTIVE, FAULT
+        };
+
+        enum Mode {
+            CSP = 8, CSV = 9, CST = 10
+        };
+
+        explicit Ds402Drive(const rocos::Slave &slave) {
+            controlWord = findVar(slave.output_vars, slave.output_var_num, "controlword");
+            modeOfOperation = findVar(slave.output_vars, slave.output_var_num, "modeofoperation");
+            targetPosition = findVar(slave.output_vars, slave.output_var_num, "targetposition");
+            targetVelocity = findVar(slave.output_vars, slave.output_var_num, "targetvelocity");
+            targetTorque = findVar(slave.output_vars, slave.output_var_num, "targettorque");
+
+            statusWord = findVar(slave.input_vars, slave.input_var_num, "statusword");
+            modeDisplay = findVar(slave.input_vars, slave.input_var_num, "modeofoperationdisplay");
+            positionActual = findVar(slave.input_vars, slave.input_var_num, "positionactualvalue");
+            velocityActual = findVar(slave.input_vars, slave.input_var_num, "velocityactualvalue");
+            torqueActual = findVar(slave.input_vars, slave.input_var_num, "torqueactualvalue");
+            currentActual = findVar(slave.input_vars, slave.input_var_num, "currentactualvalue");
+        }
+
+        static bool isDrive(const rocos::Slave &slave) {
+            return findVar(slave.output_vars, slave.output_var_num, "controlword").offset >= 0 &&
+                   findVar(slave.input_vars, slave.input_var_num, "statusword").offset >= 0;
+        }
+
+        //! Outputs are only applied in OP, in SAFEOP the drive stays disabled
+        void step(const void *outputs, bool operational, double dt) {
+            if (!operational) {
+                state = SWITCH_ON_DISABLED;
+                velocity = 0.0;
+                torque = 0.0;
+                return;
+            }
+
+            const uint16_t cw = (uint16_t) readVar(outputs, controlWord);
+            mode = (int) readVar(outputs, modeOfOperation);
+            updateState(cw);
+            lastControlWord = cw;
+
+            if (state != OPERATION_ENABLED) {
+                velocity = 0.0;
+                torque = 0.0;
+                return;
+            }
+
+            switch (mode) {
+                case CSP: {
+                    double target = (double) readVar(outputs, targetPosition);
+                    velocity = (target - position) / dt;
+                    position = target;
+                    torque = 0.0;
+                    break;
+                }
+                case CSV:
+                    velocity = (double) readVar(outputs, targetVelocity);
+                    position += velocity * dt;
+                    torque = 0.0;
+                    break;
+                case CST:
+                    torque = (double) readVar(outputs, targetTorque);
+                    velocity += torque * FLAGS_siminertia * dt;
+                    position += velocity * dt;
+                    break;
+                default:
+                    velocity = 0.0;
+                    torque = 0.0;
+                    break;
+            }
+        }
+
+        void publish(void *inputs) const {
+            static const uint16_t stateWord[] = {0x0250, 0x0231, 0x0233, 0x0237, 0x0217, 0x0218};
+            uint16_t sw = stateWord[state];
+            if (state == OPERATION_ENABLED && mode == CSP)
+                sw |= 0x0400; // target reached
+            writeVar(inputs, statusWord, sw);
+            writeVar(inputs, modeDisplay, mode);
+            writeVar(inputs, positionActual, std::llround(position));
+            writeVar(inputs, velocityActual, std::llround(velocity));
+            writeVar(inputs, torqueActual, std::llround(torque));
+            writeVar(inputs, currentActual, std::llround(torque));
+        }
+
+    protected:
+        void updateState(uint16_t cw) {
+            if (state == FAULT) {
+                if ((cw & 0x80) && !(lastControlWord & 0x80)) // fault reset on rising edge
+                    state = SWITCH_ON_DISABLED;
+                return;
+            }
+
+            if ((cw & 0x82) == 0x00) {        // disable voltage
+                state = SWITCH_ON_DISABLED;
+            } else if ((cw & 0x86) == 0x02) { // quick stop
+                if (state == OPERATION_ENABLED)
+                    state = QUICK_STOP_ACTIVE;
+                else if (state != QUICK_STOP_ACTIVE)
+                    state = SWITCH_ON_DISABLED;
+            } else if ((cw & 0x87) == 0x06) { // shutdown
+                if (state != QUICK_STOP_ACTIVE)
+                    state = READY_TO_SWITCH_ON;
+            } else if ((cw & 0x8f) == 0x07) { // switch on, disable operation
+                if (state == READY_TO_SWITCH_ON || state == OPERATION_ENABLED)
+                    state = SWITCHED_ON;
+            } else if ((cw & 0x8f) == 0x0f) { // enable operation, RTSO passes SO in the first cycle
+                if (state == READY_TO_SWITCH_ON)
+                    state = SWITCHED_ON;
+                else if (state == SWITCHED_ON || state == QUICK_STOP_ACTIVE)
+                    state = OPERATION_ENABLED;
+            }
+        }
+
+        PdRef controlWord, modeOfOperation, targetPosition, targetVelocity, targetTorque;
+        PdRef statusWord, modeDisplay, positionActual, velocityActual, torqueActual, currentActual;
+
+        State    state           {SWITCH_ON_DISABLED};
+        int      mode            {0};
+        uint16_t lastControlWord {0};
+        double   position        {0.0};
+        double   velocity        {0.0};
+        double   torque          {0.0};
+    };
+
+    //! Any other slave, the output bytes are looped back to the input bytes
+    struct IoLoopback {
+        int input_offs  {0};
+        int output_offs {0};
+        int size        {0};
+
+        explicit IoLoopback(const rocos::Slave &slave) {
+            int inBegin = INT32_MAX, inEnd = 0, outBegin = INT32_MAX, outEnd = 0;
+            for (int i = 0; i < slave.input_var_num; ++i) {
+                inBegin = std::min(inBegin, slave.input_vars[i].offset);
+                inEnd = std::max(inEnd, slave.input_vars[i].offset + slave.input_vars[i].size);
+            }
+            for (int i = 0; i < slave.output_var_num; ++i) {
+                outBegin = std::min(outBegin, slave.output_vars[i].offset);
+                outEnd = std::max(outEnd, slave.output_vars[i].offset + slave.output_vars[i].size);
+            }
+            input_offs = inBegin;
+            output_offs = outBegin;
+            size = std::max(0, std::min(inEnd - inBegin, outEnd - outBegin));
+        }
+
+        void step(const void *outputs, void *inputs) const {
+            if (size > 0)
+                std::memcpy((char *) inputs + input_offs, (const char *) outputs + output_offs, size);
+        }
+    };
+
+    class Simulator {
+    public:
+        Simulator(EcatConfigMaster &master, const boost::property_tree::ptree &config)
+                : master(master), config(config) {}
+
+        //! EcDemoApp myAppPrepare()
+        void prepare() {
+            master.ecatBus->slave_num = 0;
+            for (auto &node: config)
+                if (node.first == "Slave" && master.ecatBus->slave_num < MAX_SLAVE_NUM)
+                    master.ecatBus->slave_num++;
+        }
+
+        //! EcDemoApp myAppSetup(), slave table and models
+        void setup() {
+            std::unique_lock<std::mutex> lock(modelMutex);
+            parseSlaves(config, master.ecatBus);
+            drives.clear();
+            ios.clear();
+            for (int i = 0; i < master.ecatBus->slave_num; ++i) {
+                const rocos::Slave &slave = master.ecatBus->slaves[i];
+                master.diagnostics->slaves[i].station_address = EC_STATION_ADDRESS_BASE + i;
+                if (Ds402Drive::isDrive(slave))
+                    drives.emplace_back(slave);
+                else
+                    ios.emplace_back(slave);
+            }
+            master.setupWatchdog(FLAGS_wdcycles, parseSafeOutput(FLAGS_safeoutput));
+            lock.unlock(); // the job task publishes a pending layout
+            while (!master.commitLayout(rocos::allSlavesMask(master.ecatBus->slave_num))) // no hot connect groups, all slaves are present
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            resetCycleTime = true;
+        }
+
+        //! ecatSetMasterState(), one transition after the other
+        void setMasterState(int target) {
+            static const int order[] = {ECAT_STATE_INIT, ECAT_STATE_PREOP, ECAT_STATE_SAFEOP, ECAT_STATE_OP};
+            auto rank = [](int state) {
+                for (int i = 0; i < 4; ++i)
+                    if (order[i] == state)
+                        return i;
+                return 0;
+            };
+
+            int current = rank(state);
+            const int wanted = rank(target);
+            while (current != wanted && bRun) {
+                current += current < wanted ? 1 : -1;
+                std::this_thread::sleep_for(std::chrono::milliseconds(FLAGS_simstatedelay));
+                timeval tv{};
+                gettimeofday(&tv, nullptr);
+                rocos::EcatEvent event;
+                event.type = ECAT_EVENT_MASTER_STATE;
+                event.code = 0x00000001; // EC_NOTIFY_STATECHANGED
+                event.timestamp = tv.tv_sec * 1000000 + tv.tv_usec; // us
+                event.value[0] = state;
+                event.state = state = order[current];
+                rocos::postEvent(master.eventRing, event);
+                for (int i = 0; i < master.ecatBus->slave_num; ++i) { // all slaves follow the master
+                    rocos::SlaveDiagnostics &diag = master.diagnostics->slaves[i];
+                    diag.state = state;
+                    diag.state_changes++;
+                    diag.last_state_change = event.timestamp;
+                }
+                std::cout << "[SIM] Master state " << stateName(state) << std::endl;
+            }
+            if (state == ECAT_STATE_OP)
+                resetCycleTime = true; // job times of the startup phase are cleared when OP is reached
+        }
+
+        int getMasterState() const {
+            return state;
+        }
+
+        void startJobTask() {
+            jobTask = std::thread(&Simulator::jobTaskLoop, this);
+        }
+
+        void stopJobTask() {
+            bJobTaskShutdown = true;
+            if (jobTask.joinable())
+                jobTask.join();
+        }
+
+        static std::atomic<bool> bRun;
+
+    protected:
+        static const char *stateName(int state) {
+            switch (state) {
+                case ECAT_STATE_INIT: return "INIT";
+                case ECAT_STATE_PREOP: return "PREOP";
+                case ECAT_STATE_SAFEOP: return "SAFEOP";
+                case ECAT_STATE_OP: return "OP";
+                default: return "UNKNOWN";
+            }
+        }
+
+        static int parseSafeOutput(const std::string &szSafeOutput) {
+            if (strcasecmp(szSafeOutput.c_str(), "none") == 0)
+                return SAFE_OUTPUT_NONE;
+            else if (strcasecmp(szSafeOutput.c_str(), "zerotorque") == 0)
+                return SAFE_OUTPUT_ZERO_TORQUE;
+            else if (strcasecmp(szSafeOutput.c_str(), "hold") == 0)
+                return SAFE_OUTPUT_HOLD;
+            return SAFE_OUTPUT_QUICK_STOP; // "quickstop", other values are refused by the --safeoutput validator
+        }
+
+        //! EcMasterJobTask: one bus cycle
+        void jobTaskCycle(double period) {
+            rocos::EcatBus *bus = master.ecatBus;
+
+            timeval tv{};
+            gettimeofday(&tv, nullptr);
+            bus->timestamp = tv.tv_sec * 1000000 + tv.tv_usec; // us
+            bus->cycle_count++;
+
+            /* "Cycle Time" job measurement in us */
+            if (resetCycleTime.exchange(false) || bus->resetCycleTime) {
+                bus->resetCycleTime = false;
+                cycleTimeNum = 0;
+                cycleTimeSum = 0.0;
+                bus->min_cycle_time = bus->max_cycle_time = bus->avg_cycle_time = 0.0;
+            }
+            if (period > 0.0) {
+                cycleTimeSum += period;
+                cycleTimeNum++;
+                bus->min_cycle_time = cycleTimeNum == 1 ? period : std::min(bus->min_cycle_time, period);
+                bus->max_cycle_time = std::max(bus->max_cycle_time, period);
+                bus->avg_cycle_time = cycleTimeSum / cycleTimeNum;
+                bus->current_cycle_time = period;
+            }
+
+            const int masterState = state;
+            const bool processData = masterState == ECAT_STATE_SAFEOP || masterState == ECAT_STATE_OP;
+
+            std::lock_guard<std::mutex> lock(modelMutex);
+
+            /* process all received frames (read new input values) */
+            if (processData) {
+                for (auto &drive: drives)
+                    drive.publish(master.pdInputPtr);
+            }
+
+            bus->current_state = masterState;
+
+            if (processData) {
+                master.mergeOutputs();
+                master.checkWatchdog();
+            }
+
+            /* send all cyclic frames (write output values of current cycle) */
+            if (processData) {
+                const double dt = FLAGS_cycle * 1e-6;
+                for (auto &drive: drives)
+                    drive.step(master.pdOutputPtr, masterState == ECAT_STATE_OP, dt);
+                for (auto &io: ios)
+                    io.step(master.pdOutputPtr, master.pdInputPtr);
+            }
+
+            master.switchLayout();
+            master.updateSempahore();
+        }
+
+        void jobTaskLoop() {
+            cpu_set_t cpuSet;
+            CPU_ZERO(&cpuSet);
+            CPU_SET(FLAGS_cpuidx, &cpuSet);
+            pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+            sched_param param{};
+            param.sched_priority = 98;
+            if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0)
+                std::cout << "[SIM] Job task runs without real-time priority." << std::endl;
+
+            const long periodNs = (long) FLAGS_cycle * 1000;
+            timespec next{}, last{}, now{};
+            clock_gettime(CLOCK_MONOTONIC, &next);
+            bool first = true;
+
+            while (!bJobTaskShutdown) {
+                next.tv_nsec += periodNs;
+                while (next.tv_nsec >= 1000000000) {
+                    next.tv_nsec -= 1000000000;
+                    next.tv_sec++;
+                }
+                clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr);
+
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                double period = first ? 0.0 : (now.tv_sec - last.tv_sec) * 1e6 + (now.tv_nsec - last.tv_nsec) / 1e3;
+                last = now;
+                first = false;
+
+                jobTaskCycle(period);
+
+                /* overrun: continue from now instead of catching up with a burst of cycles */
+                if ((now.tv_sec - next.tv_sec) * 1000000000L + (now.tv_nsec - next.tv_nsec) > periodNs)
+                    next = now;
+            }
+        }
+
+        EcatConfigMaster &master;
+        const boost::property_tree::ptree &config;
+
+        std::atomic<int>  state {ECAT_STATE_INIT};
+        std::atomic<bool> resetCycleTime {true};
+        std::atomic<bool> bJobTaskShutdown {false};
+        std::thread       jobTask;
+
+        std::mutex              modelMutex;
+        std::vector<Ds402Drive> drives;
+        std::vector<IoLoopback> ios;
+
+        long   cycleTimeNum {0};
+        double cycleTimeSum {0.0};
+    };
+
+    std::atomic<bool> Simulator::bRun {true};
+
+    void signalHandler(int) {
+        Simulator::bRun = false;
+    }
+
+}
+
+int main(int argc, char *argv[]) {
+    gflags::SetUsageMessage("Hardware-free EtherCAT master simulator serving the shared memory of rocos_ecm");
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    const long mainEnd = EcatConfigMaster::getProcessUptime(); // start-up phases before the shared memory exists
+
+    ////////////// Bus layout from the ENI //////////////
+    boost::property_tree::ptree eni;
+    try {
+        boost::property_tree::read_xml(FLAGS_eni, eni);
+    } catch (std::exception &e) {
+        std::cerr << "[ERROR] Can not read ENI " << FLAGS_eni << ": " << e.what() << std::endl;
+        return 1;
+    }
+    const auto &config = eni.get_child("EtherCATConfig.Config");
+    BusLayout layout;
+    parseBusLayout(config, layout);
+    const long eniEnd = EcatConfigMaster::getProcessUptime();
+
+    ////////////// Shared memory, as myAppInit() and the memory provider of EcDemoApp //////////////
+    EcatConfigMaster master(FLAGS_id);
+    if (FLAGS_hugepages)
+        master.enableHugePages();
+    if (!master.createSharedMemory())
+        return 1;
+    master.bindNumaNode(FLAGS_shmnode);
+
+    if (strcasecmp(FLAGS_state.c_str(), "init") == 0)
+        master.ecatBus->request_state = ECAT_STATE_INIT;
+    else if (strcasecmp(FLAGS_state.c_str(), "preop") == 0)
+        master.ecatBus->request_state = ECAT_STATE_PREOP;
+    else if (strcasecmp(FLAGS_state.c_str(), "safeop") == 0)
+        master.ecatBus->request_state = ECAT_STATE_SAFEOP;
+    else if (strcasecmp(FLAGS_state.c_str(), "op") == 0)
+        master.ecatBus->request_state = ECAT_STATE_OP;
+    else
+        master.ecatBus->request_state = 0; // eEcatState_UNKNOWN
+    master.ecatBus->is_authorized = true; // no license needed
+
+    master.createPdDataMemoryProvider(layout.input_size, layout.output_size);
+    master.bindNumaNode(FLAGS_shmnode);
+    master.publishGeneration();
+    master.startup->fast_start = FLAGS_faststart;
+    master.addStartupPhase("main", 0, mainEnd);
+    master.addStartupPhase("eni", mainEnd, eniEnd);
+    master.addStartupPhase("shared memory", eniEnd, EcatConfigMaster::getProcessUptime());
+
+    std::signal(SIGINT, signalHandler);
+    std::signal(SIGTERM, signalHandler);
+
+    Simulator sim(master, config);
+    int phase = master.beginStartupPhase("job task");
+    sim.startJobTask();
+    master.endStartupPhase(phase);
+
+    // as myAppTraceStartup() once the bus reached the requested state, or at shutdown if it never did
+    auto traceStartup = [&master]() {
+        const std::string trace = master.getStartupTraceName(FLAGS_starttrace);
+        std::cout << master.getStartupSummary() << std::endl;
+        if (!trace.empty() && !master.writeStartupTrace(trace))
+            std::cerr << "[ERROR] Can not write start-up trace " << trace << "." << std::endl;
+    };
+    auto reached = [&master, &traceStartup](int state) {
+        if (master.setStartupReached(state))
+            traceStartup();
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&]() {
+        return FLAGS_duration != 0 && std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(FLAGS_duration);
+    };
+
+    ////////////// State machine, same as the while loop of EcDemoApp //////////////
+    rocos::EcatBus *bus = master.ecatBus;
+    while (Simulator::bRun && !elapsed()) {
+        bus->current_state = sim.getMasterState();
+        switch (bus->request_state) {
+            case ECAT_STATE_INIT:
+                bus->next_expected_state = ECAT_STATE_INIT;
+                break;
+            case ECAT_STATE_PREOP:
+                bus->next_expected_state = ECAT_STATE_PREOP;
+                break;
+            case ECAT_STATE_SAFEOP:
+                bus->next_expected_state = bus->current_state == ECAT_STATE_INIT ? ECAT_STATE_PREOP : ECAT_STATE_SAFEOP;
+                break;
+            case ECAT_STATE_OP:
+                if (bus->current_state == ECAT_STATE_INIT)
+                    bus->next_expected_state = ECAT_STATE_PREOP;
+                else if (bus->current_state == ECAT_STATE_PREOP || bus->current_state == ECAT_STATE_SAFEOP ||
+                         bus->current_state == ECAT_STATE_OP)
+                    bus->next_expected_state = ECAT_STATE_OP;
+                break;
+            default:
+                std::cerr << "[ERROR] Invaid Request Master State!" << std::endl;
+                break;
+        }
+
+        if (bus->next_expected_state == ECAT_STATE_INIT) {
+            phase = master.beginStartupPhase("init");
+            sim.setMasterState(ECAT_STATE_INIT);
+            master.endStartupPhase(phase);
+            bus->current_state = sim.getMasterState();
+            phase = master.beginStartupPhase("prepare");
+            sim.prepare();
+            master.endStartupPhase(phase);
+        } else if (bus->next_expected_state == ECAT_STATE_PREOP && FLAGS_faststart && bus->current_state == ECAT_STATE_INIT &&
+                   (bus->request_state == ECAT_STATE_SAFEOP || bus->request_state == ECAT_STATE_OP)) {
+            // as myAppFastStart(): set up while going to PREOP, then a single transition to the requested state
+            const int preop = master.beginStartupPhase("preop");
+            std::thread transition([&sim]() { sim.setMasterState(ECAT_STATE_PREOP); });
+            phase = master.beginStartupPhase("setup");
+            sim.setup();
+            master.endStartupPhase(phase);
+            transition.join();
+            master.endStartupPhase(preop);
+            phase = master.beginStartupPhase(bus->request_state == ECAT_STATE_OP ? "safeop+op" : "safeop");
+            sim.setMasterState(bus->request_state);
+            master.endStartupPhase(phase);
+            bus->current_state = sim.getMasterState();
+            bus->next_expected_state = bus->request_state;
+            reached(bus->current_state);
+            continue;
+        } else if (bus->next_expected_state == ECAT_STATE_PREOP) {
+            phase = master.beginStartupPhase("preop");
+            sim.setMasterState(ECAT_STATE_PREOP);
+            master.endStartupPhase(phase);
+            bus->current_state = sim.getMasterState();
+            phase = master.beginStartupPhase("setup");
+            sim.setup();
+            master.endStartupPhase(phase);
+        } else if (bus->next_expected_state == ECAT_STATE_SAFEOP) {
+            phase = master.beginStartupPhase("safeop");
+            sim.setMasterState(ECAT_STATE_SAFEOP);
+            master.endStartupPhase(phase);
+            bus->current_state = sim.getMasterState();
+        } else if (bus->next_expected_state == ECAT_STATE_OP) {
+            phase = master.beginStartupPhase("op");
+            sim.setMasterState(ECAT_STATE_OP);
+            master.endStartupPhase(phase);
+            bus->current_state = sim.getMasterState();
+            reached(bus->current_state);
+
+            // like the real master the OP state is kept until the application terminates
+            while (bus->current_state == ECAT_STATE_OP && Simulator::bRun && !elapsed())
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+
+        // no pause between the steps to a valid requested state
+        const int request = bus->request_state;
+        if (bus->current_state == request)
+            reached(request);
+        if (bus->current_state == request ||
+            (request != ECAT_STATE_INIT && request != ECAT_STATE_PREOP && request != ECAT_STATE_SAFEOP && request != ECAT_STATE_OP))
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+
+    if (master.startup->reached < 0)
+        traceStartup();
+
+    Simulator::bRun = true; // leave through the states like ecatSetMasterState(INIT) at shutdown
+    sim.setMasterState(ECAT_STATE_INIT);
+    sim.stopJobTask();
+    bus->current_state = sim.getMasterState();
+
+    return 0;
+}